@@ -24,12 +24,13 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), shares_memory_(false) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
       const int width);
   explicit Blob(const vector<int>& shape);
+  virtual ~Blob() {}
 
   /// @brief Deprecated; use <code>Reshape(const vector<int>& shape)</code>.
   void Reshape(const int num, const int channels, const int height,
@@ -47,8 +48,11 @@ class Blob {
    * Note that reshaping an input blob and immediately calling Net::Backward is
    * an error; either Net::Forward or Net::Reshape need to be called to
    * propagate the new input shape to higher layers.
+   *
+   * Virtual so that blobs with another memory layout, such as SparseBlob,
+   * keep it when generic code reshapes them.
    */
-  void Reshape(const vector<int>& shape);
+  virtual void Reshape(const vector<int>& shape);
   void Reshape(const BlobShape& shape);
   void ReshapeLike(const Blob& other);
   inline string shape_string() const {
@@ -262,16 +266,55 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Makes the data and diff views of the count() elements of those of
+   *        Blob other from offset on -- useful in Layer%s which copy their
+   *        bottoms to or from parts of their tops.
+   *
+   * Writing to the views writes to other. A reshape to a larger count, or
+   * set_cpu_data, gives this Blob memory of its own again.
+   */
+  void ShareView(const Blob& other, int offset);
+  /// @brief Whether the data and diff are views of those of Blob other from
+  ///        offset on.
+  bool IsViewOf(const Blob& other, int offset) const;
+  /// @brief Whether ShareData or ShareDiff made this Blob use the memory of
+  ///        another since it last got memory of its own.
+  inline bool shares_memory() const { return shares_memory_; }
+
+  /**
+   * @brief Makes the diff row-sparse, or dense again.
+   *
+   * A row-sparse diff is still stored densely, but it is known to be zero
+   * outside of the rows (indices along the first axis) recorded with
+   * AddDiffRows since the last ClearDiffRows, so Net::ClearParamDiffs and the
+   * CPU solvers only visit those rows. This is for params, such as embedding
+   * tables, whose gradient only reaches a few rows per batch; every writer of
+   * their diff must record the rows it writes. ShareDiff shares the rows too.
+   */
+  void set_row_sparse_diff(bool row_sparse);
+  inline bool row_sparse_diff() const { return diff_rows_.get() != NULL; }
+  /// @brief The recorded rows of a row-sparse diff, sorted and distinct.
+  inline const vector<int>& diff_rows() const {
+    CHECK(diff_rows_) << "The diff is not row-sparse.";
+    return *diff_rows_;
+  }
+  /// @brief Records rows of a row-sparse diff that may now be nonzero.
+  void AddDiffRows(const vector<int>& rows);
+  /// @brief Forgets the recorded rows, once the diff has been zeroed.
+  void ClearDiffRows();
 
   bool ShapeEquals(const BlobProto& other);
 
  protected:
   shared_ptr<SyncedMemory> data_;
   shared_ptr<SyncedMemory> diff_;
+  shared_ptr<vector<int> > diff_rows_;
   shared_ptr<SyncedMemory> shape_data_;
   vector<int> shape_;
   int count_;
   int capacity_;
+  bool shares_memory_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
@@ -9,6 +9,8 @@
 
 namespace caffe {
 
+class Philox;
+
 /**
  * @brief Applies common transformations to the input data, such as
  * scaling, mirroring, substracting the image mean...
@@ -24,6 +26,17 @@ class DataTransformer {
    *    transformation.
    */
   void InitRand();
+  /**
+   * @brief Initialize the random numbers to the stream of a given key, so
+   *    that transformers sharing it can draw from the same stream.
+   */
+  void InitRand(uint64_t key);
+  /**
+   * @brief Makes the random numbers of the next transformation those of
+   *    the given item of the stream, whichever transformer applies it and
+   *    whatever the order items are transformed in.
+   */
+  void SeekRand(uint64_t item);
 
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -143,7 +156,9 @@ class DataTransformer {
   TransformationParameter param_;
 
 
-  shared_ptr<Caffe::RNG> rng_;
+  shared_ptr<Philox> rng_;
+  // The index in the stream of the next random number.
+  uint64_t rand_offset_;
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
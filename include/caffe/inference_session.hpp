@@ -0,0 +1,56 @@
+#ifndef CAFFE_INFERENCE_SESSION_HPP_
+#define CAFFE_INFERENCE_SESSION_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A replica of a TEST net for serving concurrent inference requests in
+ *        one process.
+ *
+ * A session has the layers of its model net, but they use the model's param
+ * blobs as they are: only the activations and the layer buffers of the
+ * session are its own. Its layers are not shared, as they are in data
+ * parallelism, so they run Forward without locking. Any number of sessions of
+ * a model can run Forward concurrently, each from its own thread, as long as
+ * the model's params are not modified meanwhile. Sessions only support
+ * Forward, since Backward would write to the shared param diffs.
+ */
+template <typename Dtype>
+class InferenceSession {
+ public:
+  explicit InferenceSession(const shared_ptr<Net<Dtype> >& model);
+
+  /**
+   * @brief Runs Forward on the session's net, with its input blobs already
+   *        filled; see Net::ForwardPrefilled.
+   *
+   * The model's params must be synced to the device of the current mode, as
+   * they are after construction, or sessions would all sync them at once.
+   */
+  const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+  /**
+   * @brief Syncs the model's params to the device of the current mode. Call
+   *        it from one thread while no session runs, after changing the
+   *        params or the mode.
+   */
+  void SyncParams();
+  /// @brief The session's net, e.g. to access its input and output blobs.
+  inline const shared_ptr<Net<Dtype> >& net() const { return net_; }
+  inline const shared_ptr<Net<Dtype> >& model() const { return model_; }
+
+ protected:
+  shared_ptr<Net<Dtype> > model_;
+  shared_ptr<Net<Dtype> > net_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceSession);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SESSION_HPP_
@@ -38,7 +38,7 @@ class Layer {
    * layer.
    */
   explicit Layer(const LayerParameter& param)
-    : layer_param_(param), is_shared_(false) {
+    : layer_param_(param), share_views_(false), is_shared_(false) {
       // Set phase and copy blobs (if there are any).
       phase_ = param.phase();
       if (layer_param_.blobs_size() > 0) {
@@ -282,6 +282,16 @@ class Layer {
    */
   virtual inline bool AutoTopBlobs() const { return false; }
 
+  /**
+   * @brief Return whether top blob top_index is a SparseBlob.
+   *
+   * Net::Init creates a SparseBlob instead of a Blob for the top blobs of
+   * the layer for which this returns true.
+   */
+  virtual inline bool SparseTopBlob(const int top_index) const {
+    return false;
+  }
+
   /**
    * @brief Return whether to allow force_backward for a given bottom blob
    *        index.
@@ -294,6 +304,20 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether Forward_cpu can take bottoms and give tops in the
+   *        blocked layout of util/blocked_layout.hpp, as set by
+   *        set_blocked_layout.
+   */
+  virtual inline bool HandlesBlockedLayout() const { return false; }
+
+  /**
+   * @brief Return whether the layer computes the same whatever the layout of
+   *        its bottoms and tops, as long as they all have the same one, e.g.
+   *        as elementwise layers do.
+   */
+  virtual inline bool LayoutAgnostic() const { return false; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -316,6 +340,31 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Sets whether the layer may make its bottom and top blobs views of
+   *        one another (see Blob::ShareView) rather than copy between them.
+   *
+   * The Net allows it unless a layer computes in place on one of the tops,
+   * which would then also overwrite the bottoms.
+   */
+  inline void set_share_views(const bool value) { share_views_ = value; }
+
+  /**
+   * @brief Sets which bottoms and tops are in the blocked layout, for a layer
+   *        that HandlesBlockedLayout. Forward_cpu then computes in the
+   *        blocked layout, converting the other bottoms and tops.
+   *
+   * The Net sets this for chains of such layers in the TEST phase and CPU
+   * mode, and the layers need not implement Backward in the blocked layout.
+   * Forward and Backward fail in GPU mode while any is set.
+   */
+  inline void set_blocked_layout(const vector<bool>& bottoms,
+      const vector<bool>& tops) {
+    CHECK(HandlesBlockedLayout()) << type() << " layer " << layer_param_.name()
+        << " does not handle the blocked layout.";
+    blocked_bottoms_ = bottoms;
+    blocked_tops_ = tops;
+  }
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -331,6 +380,11 @@ class Layer {
    *  the objective function. */
   vector<Dtype> loss_;
 
+  /** Whether the bottom and top blobs may be views of one another. */
+  bool share_views_;
+  /** Whether each bottom and top blob is in the blocked layout, if set. */
+  vector<bool> blocked_bottoms_, blocked_tops_;
+
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
@@ -466,6 +520,11 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
     }
     break;
   case Caffe::GPU:
+    // The blocked layout is set up for the CPU, and the GPU kernels would
+    // read it as the usual one.
+    CHECK(blocked_bottoms_.empty()) << type() << " layer "
+        << layer_param_.name() << " is in the blocked layout, which is only "
+        << "computed in CPU mode.";
     Forward_gpu(bottom, top);
 #ifndef CPU_ONLY
     for (int top_id = 0; top_id < top.size(); ++top_id) {
@@ -495,6 +554,9 @@ inline void Layer<Dtype>::Backward(const vector<Blob<Dtype>*>& top,
     Backward_cpu(top, propagate_down, bottom);
     break;
   case Caffe::GPU:
+    CHECK(blocked_bottoms_.empty()) << type() << " layer "
+        << layer_param_.name() << " is in the blocked layout, which is only "
+        << "computed in CPU mode.";
     Backward_gpu(top, propagate_down, bottom);
     break;
   default:
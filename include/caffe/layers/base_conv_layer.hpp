@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half_blob.hpp"
 #include "caffe/util/im2col.hpp"
 
 namespace caffe {
@@ -31,7 +32,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // we just called weight_cpu_gemm with the same input. forward_cpu_gemm
+  // multiplies by half_weight_ instead of weights if forward_half().
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
@@ -92,6 +94,14 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The weights in the storage precision, for Forward_cpu of
+  ///        convolution in the TEST phase, if not FP32.
+  shared_ptr<HalfBlob<Dtype> > half_weight_;
+  /// @brief Whether forward_cpu_gemm uses half_weight_: only when the output
+  ///        of an image is small enough for the product to be memory-bound.
+  inline bool forward_half() const {
+    return half_weight_ && HalfBlob<Dtype>::MemoryBound(conv_out_spatial_dim_);
+  }
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -73,6 +73,9 @@ class BasePrefetchingDataLayer :
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Pops the next loaded batch, recording in the Metrics how many were ready
+  // and how long it waited for one.
+  Batch<Dtype>* PopBatch();
 
   Batch<Dtype> prefetch_[PREFETCH_COUNT];
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
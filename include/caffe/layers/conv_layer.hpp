@@ -62,9 +62,15 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *    kernels + stream parallelism) engines.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), blocked_weight_version_(0) {}
 
   virtual inline const char* type() const { return "Convolution"; }
+  // 2D convolution without groups computes in the blocked layout, unless it
+  // reads reduced-precision weights.
+  virtual inline bool HandlesBlockedLayout() const {
+    return this->num_spatial_axes_ == 2 && this->channel_axis_ == 1 &&
+        this->group_ == 1 && !this->half_weight_;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -77,6 +83,21 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+
+  /// @brief Forward_cpu in the blocked layout, by direct convolution.
+  void Forward_cpu_blocked(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  /// @brief Makes blocked_weight_ the current weights, unless it already is.
+  void UpdateBlockedWeight();
+
+  // The weights, as (output block, input block, kernel height, kernel width,
+  // input channel of the block, output channel of the block), and the data
+  // and version they were rearranged from.
+  Blob<Dtype> blocked_weight_;
+  shared_ptr<SyncedMemory> blocked_weight_source_;
+  uint64_t blocked_weight_version_;
+  // The bottom and top in the blocked layout, when they are not.
+  Blob<Dtype> blocked_bottom_, blocked_top_;
 };
 
 }  // namespace caffe
@@ -39,6 +39,8 @@ class EmbedLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// Records the weight rows indexed by bottom in the row-sparse weight diff.
+  void AddWeightDiffRows(const Blob<Dtype>* bottom);
 
   int M_;
   int K_;
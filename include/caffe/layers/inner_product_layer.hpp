@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half_blob.hpp"
 
 namespace caffe {
 
@@ -44,6 +45,10 @@ class InnerProductLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  /// @brief The weights in the storage precision, for Forward_cpu in the
+  ///        TEST phase, if not FP32, on batches small enough for the product
+  ///        to be memory-bound.
+  shared_ptr<HalfBlob<Dtype> > half_weight_;
 };
 
 }  // namespace caffe
@@ -1,6 +1,8 @@
 #ifndef CAFFE_MEMORY_DATA_LAYER_HPP_
 #define CAFFE_MEMORY_DATA_LAYER_HPP_
 
+#include <stdint.h>
+
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -14,6 +16,14 @@ namespace caffe {
 /**
  * @brief Provides data to the Net from memory.
  *
+ * In streaming mode (memory_data_param.streaming), producers push samples one
+ * at a time, from any number of threads, into a bounded queue of
+ * queue_capacity samples, where background threads transform them. Forward
+ * outputs the oldest samples, in push order, as soon as batch_size of them are
+ * ready, or, with a batch_timeout_ms, as many as are ready that long after the
+ * first one: the batch is then smaller than batch_size. This batches the
+ * requests of an online server dynamically.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -21,6 +31,7 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
  public:
   explicit MemoryDataLayer(const LayerParameter& param)
       : BaseDataLayer<Dtype>(param), has_new_data_(false) {}
+  virtual ~MemoryDataLayer();
   virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
@@ -39,7 +50,28 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
   void Reset(Dtype* data, Dtype* label, int n);
   void set_batch_size(int new_size);
 
-  const Dtype* get_data_ptr(){ return (const Dtype*)data_; }
+  /**
+   * @brief Adds a sample to the stream, to be transformed in the background.
+   *        Blocks while the queue is full. Returns false if the stream is
+   *        closed; otherwise sets id, if not NULL, to the id of the sample:
+   *        the number of samples pushed before it.
+   */
+  bool PushDatum(const Datum& datum, uint64_t* id = NULL);
+#ifdef USE_OPENCV
+  bool PushMat(const cv::Mat& mat, int label, uint64_t* id = NULL);
+#endif  // USE_OPENCV
+  /// @brief Adds a sample of channels x height x width values, as they are.
+  bool PushData(const Dtype* data, Dtype label, uint64_t* id = NULL);
+  /**
+   * @brief Closes the stream, waking the pushes and the Forward waiting on
+   *        it. Pushes then fail, and Forward leaves the tops as they are and
+   *        clears batch_ids(). Destroying the layer closes it too.
+   */
+  void CloseStream();
+  /// @brief The ids of the samples of the last batch, in order.
+  const vector<uint64_t>& batch_ids() const { return batch_ids_; }
+
+  const Dtype* get_data_ptr() { return (const Dtype*)data_; }
   int batch_size() { return batch_size_; }
   int channels() { return channels_; }
   int height() { return height_; }
@@ -49,6 +81,12 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class Stream;
+
   int batch_size_, channels_, height_, width_, size_;
   Dtype* data_;
   Dtype* labels_;
@@ -57,6 +95,8 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
   Blob<Dtype> added_data_;
   Blob<Dtype> added_label_;
   bool has_new_data_;
+  shared_ptr<Stream> stream_;
+  vector<uint64_t> batch_ids_;
 };
 
 }  // namespace caffe
@@ -33,6 +33,12 @@ class PoolingLayer : public Layer<Dtype> {
     return (this->layer_param_.pooling_param().pool() ==
             PoolingParameter_PoolMethod_MAX) ? 2 : 1;
   }
+  // MAX and AVE pooling without a mask top compute in the blocked layout.
+  virtual inline bool HandlesBlockedLayout() const {
+    return this->layer_param_.top_size() <= 1 &&
+        this->layer_param_.pooling_param().pool() !=
+        PoolingParameter_PoolMethod_STOCHASTIC;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -53,6 +59,8 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // The bottom and top in the blocked layout, when they are not.
+  Blob<Dtype> blocked_bottom_, blocked_top_;
 };
 
 }  // namespace caffe
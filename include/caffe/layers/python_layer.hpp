@@ -10,6 +10,21 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+/**
+ * @brief Holds the GIL for the lifetime of the object. Python layers need it
+ *        to run their Python code, as pycaffe releases it while nets run.
+ */
+class ScopedGILAcquire {
+ public:
+  ScopedGILAcquire() : state_(PyGILState_Ensure()) {}
+  ~ScopedGILAcquire() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILAcquire);
+};
+
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
@@ -24,12 +39,14 @@ class PythonLayer : public Layer<Dtype> {
         && !ShareInParallel()) {
       LOG(FATAL) << "PythonLayer is not implemented in Multi-GPU training";
     }
+    ScopedGILAcquire gil;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("setup")(bottom, top);
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    ScopedGILAcquire gil;
     self_.attr("reshape")(bottom, top);
   }
 
@@ -42,10 +59,12 @@ class PythonLayer : public Layer<Dtype> {
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    ScopedGILAcquire gil;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    ScopedGILAcquire gil;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
@@ -28,6 +28,7 @@ class ReLULayer : public NeuronLayer<Dtype> {
       : NeuronLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "ReLU"; }
+  virtual inline bool LayoutAgnostic() const { return true; }
 
  protected:
   /**
@@ -0,0 +1,53 @@
+#ifndef CAFFE_SPARSE_HDF5_DATA_LAYER_HPP_
+#define CAFFE_SPARSE_HDF5_DATA_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/hdf5_data_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides sparse data to the Net from HDF5 files, as a SparseBlob.
+ *
+ * The first top is sparse. It is read from the HDF5 group with its name,
+ * which holds a (num, dim) matrix in CSR format with the datasets used by
+ * scipy.sparse.csr_matrix: "data" (the nonzero values), "indices" (their
+ * column indices), "indptr" (the num + 1 row offsets) and "shape". The
+ * other tops are dense, and read as by HDF5DataLayer. hdf5_data_param is
+ * interpreted the same way.
+ */
+template <typename Dtype>
+class SparseHDF5DataLayer : public HDF5DataLayer<Dtype> {
+ public:
+  explicit SparseHDF5DataLayer(const LayerParameter& param)
+      : HDF5DataLayer<Dtype>(param) {}
+
+  virtual inline const char* type() const { return "SparseHDF5Data"; }
+  virtual inline bool SparseTopBlob(const int top_index) const {
+    return top_index == 0;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // The batches are assembled on the CPU either way.
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+  virtual void LoadHDF5FileData(const char* filename);
+
+  // The sparse rows of the batch being assembled.
+  vector<Dtype> batch_values_;
+  vector<int> batch_indices_;
+  vector<int> batch_ptr_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_SPARSE_HDF5_DATA_LAYER_HPP_
@@ -11,6 +11,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/decoded_image_cache.hpp"
+#include "caffe/util/worker_pool.hpp"
 
 namespace caffe {
 
@@ -18,6 +20,13 @@ namespace caffe {
  * @brief Provides data to the Net from windows of images files, specified
  *        by a window data file.
  *
+ * With image_cache_file, the decoded images are kept in a DecodedImageCache
+ * in that file, which several training processes can share and later runs
+ * reuse, instead of being decoded again for each window. The windows of a
+ * batch are loaded in parallel on num_threads threads; they are sampled
+ * beforehand on the prefetch thread, so batches don't depend on the number of
+ * threads.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -36,6 +45,10 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   virtual unsigned int PrefetchRand();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Crops, warps and normalizes window item_id of the batch, sampled by
+  // load_batch, into the batch data and labels, which load_batch gets on the
+  // prefetch thread.
+  void load_window(Dtype* top_data, Dtype* top_label, int item_id);
 
   shared_ptr<Caffe::RNG> prefetch_rng_;
   vector<std::pair<std::string, vector<int> > > image_database_;
@@ -48,6 +61,10 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
   bool has_mean_values_;
   bool cache_images_;
   vector<std::pair<std::string, Datum > > image_database_cache_;
+  shared_ptr<DecodedImageCache> decoded_image_cache_;
+  shared_ptr<WorkerPool> worker_pool_;
+  vector<const vector<float>*> batch_windows_;
+  vector<bool> batch_mirror_;
 };
 
 }  // namespace caffe
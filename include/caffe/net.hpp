@@ -11,9 +11,12 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/mapped_weights.hpp"
 
 namespace caffe {
 
+template <typename Dtype> class NetProfiler;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -23,7 +26,14 @@ namespace caffe {
 template <typename Dtype>
 class Net {
  public:
-  explicit Net(const NetParameter& param, const Net* root_net = NULL);
+  /**
+   * @brief Creates a net from param. If param_net is given, layers use the
+   *        param blobs of the layer of the same name in param_net as they are,
+   *        instead of allocating and initializing their own (see
+   *        InferenceSession).
+   */
+  explicit Net(const NetParameter& param, const Net* root_net = NULL,
+      const Net* param_net = NULL);
   explicit Net(const string& param_file, Phase phase,
       const Net* root_net = NULL);
   virtual ~Net() {}
@@ -61,6 +71,9 @@ class Net {
   /**
    * @brief Zeroes out the diffs of all net parameters.
    *        Should be run before Backward.
+   *
+   * On the CPU, only the recorded rows of row-sparse diffs are zeroed (see
+   * Blob::set_row_sparse_diff).
    */
   void ClearParamDiffs();
 
@@ -114,6 +127,12 @@ class Net {
   void CopyTrainedLayersFrom(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Makes the params use the values of a weights file in the mapped
+   *        format (see MappedWeights) in place, without copying them. The
+   *        mapping lives as long as the net.
+   */
+  void MapTrainedLayersFrom(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -170,6 +189,15 @@ class Net {
   inline const vector<bool>& layer_need_backward() const {
     return layer_need_backward_;
   }
+  /**
+   * @brief Returns whether each blob holds its data in the blocked layout of
+   *        util/blocked_layout.hpp rather than as (num, channels, height,
+   *        width), which only the blobs between layers that compute in it
+   *        do when the net sets blocked_layout.
+   */
+  inline const vector<bool>& blob_blocked_layout() const {
+    return blob_blocked_layout_;
+  }
   /// @brief returns the parameters
   inline const vector<shared_ptr<Blob<Dtype> > >& params() const {
     return params_;
@@ -215,6 +243,11 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /**
+   * @brief Sets the profiler recording the layer passes of ForwardFromTo and
+   *        BackwardFromTo, or NULL to stop profiling. Not owned by the net.
+   */
+  void set_profiler(NetProfiler<Dtype>* profiler) { profiler_ = profiler; }
 
   // Helpers for Init.
   /**
@@ -240,6 +273,11 @@ class Net {
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
+  /**
+   * @brief Chooses the blobs to keep in the blocked layout: those that only
+   *        layers handling it produce and consume, and tells the layers.
+   */
+  void SetUpBlockedLayout();
 
   /// @brief Helper for displaying debug info in Forward about input Blobs.
   void InputDebugInfo(const int layer_id);
@@ -264,6 +302,7 @@ class Net {
   vector<string> blob_names_;
   map<string, int> blob_names_index_;
   vector<bool> blob_need_backward_;
+  vector<bool> blob_blocked_layout_;
   /// bottom_vecs stores the vectors containing the input for each layer.
   /// They don't actually host the blobs (blobs_ does), so we simply store
   /// pointers.
@@ -307,8 +346,17 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// The profiler of the layer passes, if any
+  NetProfiler<Dtype>* profiler_;
+  /// Whether the recorded rows of row-sparse param diffs cover all of their
+  /// nonzero values, i.e. the diffs were last cleared on the CPU.
+  bool diff_rows_valid_;
+  /// Mapped weights files whose values are used by params_
+  vector<shared_ptr<MappedWeights> > mapped_weights_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
+  /// The net whose param blobs the layers of this net use, if any
+  const Net* const param_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
 };
 
@@ -8,6 +8,48 @@
 
 namespace caffe {
 
+/**
+ * @brief Per-element gradient preprocessing of the fused update path:
+ *        iter_size normalization followed by L2 or L1 weight decay, matching
+ *        SGDSolver::Normalize and SGDSolver::Regularize.
+ */
+template <typename Dtype>
+struct FusedGradient {
+  Dtype scale;
+  Dtype l2_decay;
+  Dtype l1_decay;
+
+  inline Dtype operator()(Dtype diff, Dtype data) const {
+    return diff * scale + l2_decay * data
+        + l1_decay * ((Dtype(0) < data) - (data < Dtype(0)));
+  }
+};
+
+/**
+ * @brief The elements a fused update visits: all of a param, or only the
+ *        recorded diff rows of a row-sparse param (see
+ *        Blob::set_row_sparse_diff). The latter makes the update lazy: rows
+ *        without gradient keep their data and history as they are, instead of
+ *        having weight decay and momentum applied to them.
+ */
+template <typename Dtype>
+class FusedUpdateRanges {
+ public:
+  explicit FusedUpdateRanges(const Blob<Dtype>& param)
+      : rows_(param.row_sparse_diff() ? &param.diff_rows() : NULL),
+        range_size_(rows_ ? param.count(1) : param.count()) {}
+
+  inline int size() const { return rows_ ? rows_->size() : 1; }
+  inline int begin(int range) const {
+    return rows_ ? (*rows_)[range] * range_size_ : 0;
+  }
+  inline int end(int range) const { return begin(range) + range_size_; }
+
+ private:
+  const vector<int>* rows_;
+  int range_size_;
+};
+
 /**
  * @brief Optimizes the parameters of a Net using
  *        stochastic gradient descent (SGD) with momentum.
@@ -31,6 +73,21 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  // Fused CPU update (see SolverParameter.fused_update). FuseParams moves the
+  // learnable params and history into fused_params_ and fused_history_;
+  // ComputeFusedUpdate then normalizes, regularizes, updates the history and
+  // the param data of param_id in one pass, leaving the update value in the
+  // param diff as the unfused path does. Solvers that derive from SGDSolver
+  // override ComputeFusedUpdate with their own update rule. Row-sparse params
+  // always take this path on the CPU, and the fused rules only update their
+  // recorded diff rows (see FusedUpdateRanges).
+  void FuseParams();
+  FusedGradient<Dtype> GetFusedGradient(int param_id);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
+  // Whether ComputeFusedUpdate implements the update rule of the solver.
+  // Derived solvers that change the rule without a fused version of it must
+  // return false: they then always run their unfused update, which is dense.
+  virtual inline bool HasFusedUpdate() const { return true; }
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
@@ -41,6 +98,9 @@ class SGDSolver : public Solver<Dtype> {
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  // Contiguous backing storage of the learnable params (data and diff) and of
+  // history_ for the fused update. Empty until FuseParams is called.
+  Blob<Dtype> fused_params_, fused_history_;
 
   DISABLE_COPY_AND_ASSIGN(SGDSolver);
 };
@@ -56,6 +116,7 @@ class NesterovSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -71,6 +132,7 @@ class AdaGradSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with AdaGrad.";
@@ -91,6 +153,7 @@ class RMSPropSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
@@ -115,6 +178,7 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
  protected:
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(AdaDeltaSolver);
 };
@@ -139,6 +203,7 @@ class AdamSolver : public SGDSolver<Dtype> {
  protected:
   void AdamPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
@@ -6,6 +6,7 @@
 
 #include "caffe/net.hpp"
 #include "caffe/solver_factory.hpp"
+#include "caffe/util/snapshot_writer.hpp"
 
 namespace caffe {
 
@@ -66,6 +67,9 @@ class Solver {
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
   void Snapshot();
+  // With snapshot_async, Snapshot returns before the files are on disk; this
+  // blocks until all pending snapshots have been written.
+  void WaitForSnapshots();
   virtual ~Solver() {}
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
@@ -100,6 +104,11 @@ class Solver {
   string SnapshotFilename(const string extension);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  // Writes a snapshot file in binary proto format, or as a chunked snapshot
+  // manifest named filename + ".manifest", or hands proto over to the
+  // snapshot writer thread when snapshotting asynchronously. proto may be
+  // left empty. Returns the name of the snapshot file.
+  string WriteSnapshotProto(Message* proto, const string& filename);
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
@@ -129,6 +138,11 @@ class Solver {
   // True iff a request to stop early was received.
   bool requested_early_exit_;
 
+  // Background writer for snapshot_async, and the snapshot being assembled
+  // by the current call to Snapshot.
+  shared_ptr<SnapshotWriter> snapshot_writer_;
+  shared_ptr<SnapshotWriter::Snapshot> async_snapshot_;
+
   DISABLE_COPY_AND_ASSIGN(Solver);
 };
 
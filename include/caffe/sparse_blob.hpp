@@ -0,0 +1,60 @@
+#ifndef CAFFE_SPARSE_BLOB_HPP_
+#define CAFFE_SPARSE_BLOB_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A batch of sparse rows in compressed sparse row (CSR) format, for
+ *        high-dimensional inputs with few nonzeros such as bag-of-words
+ *        features.
+ *
+ * A SparseBlob has shape (num, dim), but only stores its nnz() nonzero
+ * values: data() holds the values row after row, indices() their column
+ * indices and ptr() the num + 1 offsets of the rows into both, so the values
+ * of row i are data[ptr[i]] to data[ptr[i + 1] - 1]. count() is nnz(), as
+ * the dense num x dim matrix is never allocated. The diff has the same size
+ * as the data and is unused, since sparse blobs are inputs.
+ *
+ * Layers that produce sparse blobs say so with Layer::SparseTopBlob, and
+ * layers that consume them recognize them with a dynamic_cast. A sparse blob
+ * can be the bottom of only one layer, as Net cannot split it.
+ */
+template <typename Dtype>
+class SparseBlob : public Blob<Dtype> {
+ public:
+  SparseBlob() : Blob<Dtype>(), nnz_(0) {}
+  SparseBlob(const vector<int>& shape, const int nnz);
+
+  using Blob<Dtype>::Reshape;
+  /// @brief Changes the shape (num, dim) and keeps the values.
+  virtual void Reshape(const vector<int>& shape);
+  /// @brief Changes the shape (num, dim) and the number of values.
+  void Reshape(const vector<int>& shape, const int nnz);
+
+  inline int nnz() const { return nnz_; }
+
+  const int* cpu_indices() const;
+  const int* cpu_ptr() const;
+  int* mutable_cpu_indices();
+  int* mutable_cpu_ptr();
+
+  /// @brief Writes the dense num x dim matrix of the blob to dense.
+  void ToDense(Dtype* dense) const;
+
+ protected:
+  int nnz_;
+  shared_ptr<SyncedMemory> indices_;
+  shared_ptr<SyncedMemory> ptr_;
+
+  DISABLE_COPY_AND_ASSIGN(SparseBlob);
+};  // class SparseBlob
+
+}  // namespace caffe
+
+#endif  // CAFFE_SPARSE_BLOB_HPP_
@@ -47,11 +47,20 @@ class SyncedMemory {
   SyncedMemory()
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), offset_(0), version_(0) {}
   explicit SyncedMemory(size_t size)
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), offset_(0), version_(0) {}
+  /**
+   * @brief A view of the size bytes of other from offset on.
+   *
+   * The view reads and writes the memory of other, which keeps it in sync
+   * between the host and device, until it is given memory of its own by
+   * set_cpu_data or set_gpu_data.
+   */
+  SyncedMemory(const shared_ptr<SyncedMemory>& other, size_t offset,
+      size_t size);
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -60,8 +69,25 @@ class SyncedMemory {
   void* mutable_cpu_data();
   void* mutable_gpu_data();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
-  SyncedHead head() { return head_; }
+  SyncedHead head() { return parent_ ? parent_->head() : head_; }
   size_t size() { return size_; }
+  /// @brief Whether this is a view of other from offset on.
+  bool is_view_of(const SyncedMemory& other, size_t offset) const;
+  /**
+   * @brief A number that changes whenever the memory may have been written
+   *        by the mutable accessors or replaced by the setters, for keeping
+   *        copies of it, e.g. in other formats, up to date.
+   *
+   * Numbers only increase, so a copy is up to date as long as the instance
+   * and its version are those it was made from.
+   */
+  uint64_t version() const { return parent_ ? parent_->version() : version_; }
+
+  /// @brief The number of host and device buffers allocated so far by all the
+  ///        SyncedMemory instances of the process, e.g. for profiling.
+  static uint64_t num_allocations();
+  /// @brief The total size in bytes of these buffers.
+  static uint64_t allocated_bytes();
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -70,6 +96,10 @@ class SyncedMemory {
  private:
   void to_cpu();
   void to_gpu();
+  static void CountAllocation(size_t size);
+  void NewVersion();
+  // Makes a view the owner of its memory.
+  void Detach();
   void* cpu_ptr_;
   void* gpu_ptr_;
   size_t size_;
@@ -78,6 +108,10 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int gpu_device_;
+  // The memory a view is of, and the offset of the view in it.
+  shared_ptr<SyncedMemory> parent_;
+  size_t offset_;
+  uint64_t version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -2,6 +2,9 @@
 #define CAFFE_UTIL_BENCHMARK_H_
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <vector>
 
 #include "caffe/util/device_alternate.hpp"
 
@@ -47,6 +50,38 @@ class CPUTimer : public Timer {
   virtual float MicroSeconds();
 };
 
+/**
+ * @brief Statistics of the times of the repetitions of a benchmark, in
+ *        microseconds.
+ */
+struct BenchmarkStats {
+  BenchmarkStats() : repetitions(0), min(0), max(0), mean(0), stddev(0),
+      median(0), p90(0), p99(0) {}
+  int repetitions;
+  double min;
+  double max;
+  double mean;
+  double stddev;
+  double median;
+  double p90;
+  double p99;
+};
+
+/**
+ * @brief The p-th percentile of values, for p in [0, 100], interpolating
+ *        linearly between the closest ranks.
+ */
+double Percentile(std::vector<double> values, double p);
+
+BenchmarkStats SummarizeTimes(const std::vector<double>& microseconds);
+
+/**
+ * @brief Calls run warmup times, e.g. to fill the caches and do the lazy
+ *        allocations, then times repetitions more calls with a Timer.
+ */
+BenchmarkStats RunBenchmark(const boost::function<void()>& run, int warmup,
+    int repetitions);
+
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_BENCHMARK_H_
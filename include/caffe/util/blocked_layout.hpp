@@ -0,0 +1,39 @@
+#ifndef CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
+#define CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
+
+namespace caffe {
+
+/**
+ * @brief The number of channels in a block of the blocked layout.
+ *
+ * In the blocked layout of a (num, channels, height, width) blob, the
+ * channels of each image are split into blocks of kChannelBlock, and each
+ * block is stored as a (height, width, kChannelBlock) array, so that the
+ * channels of a pixel are contiguous and can be processed a vector at a
+ * time. The blocks of an image follow one another, and the last one is
+ * padded with zeros if channels is not a multiple of kChannelBlock.
+ */
+const int kChannelBlock = 8;
+
+/// @brief The number of blocks that hold channels channels.
+inline int channel_blocks(const int channels) {
+  return (channels + kChannelBlock - 1) / kChannelBlock;
+}
+
+/**
+ * @brief Converts num images of channels x spatial_dim values to the blocked
+ *        layout, in which y holds num * channel_blocks(channels) *
+ *        kChannelBlock * spatial_dim values.
+ */
+template <typename Dtype>
+void caffe_cpu_to_blocked(const int num, const int channels,
+    const int spatial_dim, const Dtype* x, Dtype* y);
+
+/// @brief Converts num images from the blocked layout back.
+template <typename Dtype>
+void caffe_cpu_from_blocked(const int num, const int channels,
+    const int spatial_dim, const Dtype* x, Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BLOCKED_LAYOUT_HPP_
@@ -0,0 +1,57 @@
+#ifndef CAFFE_UTIL_CHUNKED_SNAPSHOT_HPP_
+#define CAFFE_UTIL_CHUNKED_SNAPSHOT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/message.h"
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+using ::google::protobuf::Message;
+
+/**
+ * Chunked snapshots store the values of every blob of a NetParameter or a
+ * SolverState in chunks of at most kSnapshotChunkSize values. Each chunk is a
+ * file named after a hash of its content, in a chunk directory shared by all
+ * the snapshots of a solver. What remains of the proto, the manifest, refers
+ * to the chunk files through the data_chunk and diff_chunk fields of its
+ * BlobProtos.
+ *
+ * Chunks that are already on disk are not written again, so a snapshot only
+ * costs I/O for the parameters (and solver history) that changed since an
+ * earlier one, e.g. not for frozen layers with lr_mult 0.
+ */
+const int kSnapshotChunkSize = 1 << 20;
+
+inline bool IsChunkedManifest(const string& filename) {
+  const string suffix = ".manifest";
+  return filename.size() >= suffix.size() && filename.compare(
+      filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * @brief Moves the blob values of proto, a NetParameter or a SolverState,
+ *        into chunk files and writes the resulting manifest to
+ *        manifest_filename.
+ *
+ * chunk_dir is the directory holding the chunk files, relative to the
+ * directory of the manifest. Returns the number of bytes written.
+ */
+int64_t WriteChunkedProto(Message* proto, const string& manifest_filename,
+    const string& chunk_dir);
+
+/// @brief Reads a manifest and loads the blob values back from its chunks.
+void ReadChunkedProtoOrDie(const string& manifest_filename, Message* proto);
+
+/**
+ * @brief Appends the chunk files referenced by manifest, relative to its
+ *        directory, to chunks.
+ */
+void GetSnapshotChunks(const Message& manifest, vector<string>* chunks);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CHUNKED_SNAPSHOT_HPP_
@@ -0,0 +1,87 @@
+#ifndef CAFFE_UTIL_DECODED_IMAGE_CACHE_HPP_
+#define CAFFE_UTIL_DECODED_IMAGE_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::mutex instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/**
+ * @brief A bounded cache of decoded images in a memory-mapped file, which
+ *        several processes can share and later runs can reuse.
+ *
+ * Images are stored as their interleaved 8-bit pixels (e.g. the data of a
+ * continuous CV_8UC3 cv::Mat), under a key such as their path. The file holds
+ * a header, a table of entries and a data region of the given size, written as
+ * a circular log: each new image goes after the previous one, and the images
+ * it overwrites are evicted, so the oldest insertions are evicted first. An
+ * image is also evicted when the kAssociativity table slots its key hashes to
+ * are all in use.
+ *
+ * The file is mapped shared, so the images added by one process are seen by
+ * the others. Accesses lock the file with flock, shared to read and exclusive
+ * to write, and a mutex orders the threads of a process. All the users of a
+ * file must open it with the same sizes.
+ */
+class DecodedImageCache {
+ public:
+  /**
+   * @brief Opens the cache in filename, or creates it, with a data region of
+   *        size bytes. The table has one slot per min_image_size bytes.
+   */
+  DecodedImageCache(const string& filename, uint64_t size,
+      uint64_t min_image_size = kDefaultMinImageSize);
+  ~DecodedImageCache();
+
+  /**
+   * @brief Copies the image of key into pixels and returns true, or returns
+   *        false if it isn't cached.
+   */
+  bool Get(const string& key, int* height, int* width, int* channels,
+      vector<uint8_t>* pixels);
+  /// @brief Adds the image of key, unless it is larger than the cache.
+  void Put(const string& key, int height, int width, int channels,
+      const uint8_t* pixels);
+
+  /// @brief Cache statistics, accumulated over all the processes.
+  uint64_t hits() const;
+  uint64_t misses() const;
+  uint64_t evictions() const;
+  /// @brief Number of images currently cached.
+  int num_images() const;
+
+  static const int kAssociativity = 8;
+  static const uint64_t kDefaultMinImageSize = 64 * 1024;
+
+ protected:
+  struct Header;
+  struct Entry;
+
+  Entry* entries() const;
+  uint8_t* data() const;
+  // Marks the entries of the data in [begin, end) as free.
+  void Evict(uint64_t begin, uint64_t end);
+
+  string filename_;
+  int fd_;
+  void* map_;
+  size_t map_size_;
+  Header* header_;
+  shared_ptr<boost::mutex> mutex_;
+
+  DISABLE_COPY_AND_ASSIGN(DecodedImageCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DECODED_IMAGE_CACHE_HPP_
@@ -0,0 +1,34 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief Converts to IEEE 754 half precision, rounding to nearest even.
+ *        Values beyond the range of half become infinite, and NaNs stay NaNs.
+ */
+uint16_t float_to_half(float value);
+
+/// @brief Converts from IEEE 754 half precision, which is exact.
+float half_to_float(uint16_t value);
+
+/**
+ * @brief Converts to bfloat16, the top 16 bits of a float, rounding to
+ *        nearest even. NaNs stay NaNs.
+ */
+uint16_t float_to_bfloat16(float value);
+
+/// @brief Converts from bfloat16, which is exact.
+float bfloat16_to_float(uint16_t value);
+
+// The array conversions use the F16C instructions when compiled for them.
+void caffe_cpu_float_to_half(const int n, const float* x, uint16_t* y);
+void caffe_cpu_half_to_float(const int n, const uint16_t* x, float* y);
+void caffe_cpu_float_to_bfloat16(const int n, const float* x, uint16_t* y);
+void caffe_cpu_bfloat16_to_float(const int n, const uint16_t* x, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
@@ -0,0 +1,88 @@
+#ifndef CAFFE_UTIL_HALF_BLOB_HPP_
+#define CAFFE_UTIL_HALF_BLOB_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A copy of the data of a Blob in 16-bit floats, FP16 or BF16, for
+ *        layers to read their weights from with half the memory traffic.
+ *
+ * The products with the copy convert it back a tile at a time, which stays
+ * in cache when the other operand is small, as in inference on small
+ * batches, and multiply and accumulate in Dtype with the BLAS.
+ * Update converts the data again only when it was written since, as told by
+ * SyncedMemory::version, so a copy of weights shared with a net in training
+ * follows them. The copy is in addition to the source, so it saves memory
+ * bandwidth, not memory.
+ */
+template <typename Dtype>
+class HalfBlob {
+ public:
+  explicit HalfBlob(Precision precision);
+
+  /// @brief Makes this a copy of the data of source, unless it already is.
+  void Update(const Blob<Dtype>& source);
+
+  inline Precision precision() const { return precision_; }
+  inline int count() const { return data_.size(); }
+  inline const uint16_t* cpu_data() const {
+    return data_.empty() ? NULL : &data_[0];
+  }
+  /// @brief Converts the n values from offset on back to y.
+  void ToDtype(const int offset, const int n, Dtype* y) const;
+
+  /**
+   * @brief Whether a product of the copy with an operand of other_dim rows or
+   *        columns, besides those the copy spans, is bound by reading the
+   *        copy, so that reading it in 16 bits pays for converting it back.
+   *        Products using each value more often are compute-bound, and
+   *        should use the source instead.
+   */
+  static inline bool MemoryBound(const int other_dim) {
+    return other_dim <= 16;
+  }
+
+  /**
+   * @brief Computes C = W * B like caffe_cpu_gemm, where W is the M x K
+   *        matrix of the copy from offset on, B is K x N and C is M x N.
+   */
+  void cpu_gemm(const int offset, const int M, const int N, const int K,
+      const Dtype* B, Dtype* C);
+  /**
+   * @brief Computes C = A * W^T like caffe_cpu_gemm, where A is M x K, W is
+   *        the N x K matrix of the copy and C is M x N.
+   */
+  void cpu_gemm_trans(const int M, const int N, const int K, const Dtype* A,
+      Dtype* C);
+
+ protected:
+  /**
+   * @brief The number of rows of length row_size to convert at a time: as
+   *        many as fit in cache, but at least min_rows, the other outer
+   *        dimension of the product, so that reading the other operand again
+   *        for every tile costs no more than converting the tile.
+   */
+  int TileRows(const int row_size, const int min_rows) const;
+
+  Precision precision_;
+  vector<uint16_t> data_;
+  // The data converted from, and its version then.
+  shared_ptr<SyncedMemory> source_;
+  uint64_t version_;
+  // A tile of the copy converted back.
+  vector<Dtype> tile_;
+
+  DISABLE_COPY_AND_ASSIGN(HalfBlob);
+};  // class HalfBlob
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_BLOB_HPP_
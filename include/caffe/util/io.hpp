@@ -90,6 +90,12 @@ inline void WriteProtoToBinaryFile(
   WriteProtoToBinaryFile(proto, filename.c_str());
 }
 
+// Writes proto to filename + ".tmp", syncs it to disk and renames it to
+// filename, so that a crash never leaves a truncated file behind.
+// Returns the number of bytes written.
+int64_t WriteProtoToBinaryFileAtomically(const Message& proto,
+    const string& filename);
+
 bool ReadFileToDatum(const string& filename, const int label, Datum* datum);
 
 inline bool ReadFileToDatum(const string& filename, Datum* datum) {
@@ -0,0 +1,64 @@
+#ifndef CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A memory mapping of a weights file in the mapped format
+ *        (.caffemodel.mmap), which lets a Net use the param values in place.
+ *
+ * The file starts with a header and an index, a NetParameter holding the layer
+ * names and param blob shapes but no values. The values of each blob follow,
+ * in index order, as raw floats or doubles aligned to kMappedWeightsAlignment
+ * bytes. The file is mapped copy-on-write: all the processes loading it share
+ * one page cache copy, and a process writing to the params (e.g. fine-tuning)
+ * only gets private copies of the pages it modifies.
+ */
+class MappedWeights {
+ public:
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  /// @brief Layer names and param blob shapes, without values.
+  inline const NetParameter& index() const { return index_; }
+  /// @brief Size in bytes of a value, i.e. 4 for floats and 8 for doubles.
+  inline int value_size() const { return value_size_; }
+  /// @brief Values of param blob j of layer i of the index.
+  inline void* blob_data(int i, int j) const {
+    return static_cast<char*>(data_) + offsets_[i][j];
+  }
+
+ protected:
+  void* data_;
+  size_t size_;
+  int value_size_;
+  NetParameter index_;
+  vector<vector<uint64_t> > offsets_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+const int kMappedWeightsAlignment = 64;
+
+inline bool IsMappedWeights(const string& filename) {
+  const string suffix = ".mmap";
+  return filename.size() >= suffix.size() && filename.compare(
+      filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * @brief Writes the params of param, e.g. read from a .caffemodel, to a
+ *        weights file in the mapped format. Values are stored as doubles if
+ *        param holds double_data, as floats otherwise.
+ */
+void WriteMappedWeights(const NetParameter& param, const string& filename);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
@@ -25,6 +25,22 @@ void caffe_cpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     const Dtype alpha, const Dtype* A, const Dtype* x, const Dtype beta,
     Dtype* y);
 
+// Products with a sparse M x K matrix A in compressed sparse row (CSR)
+// format: its nonzero values A, their column indices and its M + 1 row
+// offsets into both.
+// C = alpha * A * op(B) + beta * C, where op(B) is K x N and C is M x N.
+template <typename Dtype>
+void caffe_cpu_csrmm(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const Dtype alpha, const Dtype* A, const int* A_indices,
+    const int* A_ptr, const Dtype* B, const Dtype beta, Dtype* C);
+
+// C = alpha * op(B) * A + beta * C, where op(B) is N x M and C is N x K.
+template <typename Dtype>
+void caffe_cpu_gemm_csr(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const Dtype alpha, const Dtype* A,
+    const int* A_indices, const int* A_ptr, const Dtype* B, const Dtype beta,
+    Dtype* C);
+
 template <typename Dtype>
 void caffe_axpy(const int N, const Dtype alpha, const Dtype* X,
     Dtype* Y);
@@ -105,6 +121,11 @@ Dtype caffe_cpu_strided_dot(const int n, const Dtype* x, const int incx,
 template <typename Dtype>
 Dtype caffe_cpu_asum(const int n, const Dtype* x);
 
+// Sets y to the softmax of the n contiguous values of x, and returns the log
+// of its normalizer, max(x) + log(sum(exp(x - max(x)))).
+template <typename Dtype>
+Dtype caffe_cpu_softmax(const int n, const Dtype* x, Dtype* y);
+
 // the branchless, type-safe version from
 // http://stackoverflow.com/questions/1903954/is-there-a-standard-sign-function-signum-sgn-in-c-c
 template<typename Dtype>
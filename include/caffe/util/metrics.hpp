@@ -0,0 +1,109 @@
+#ifndef CAFFE_UTIL_METRICS_HPP_
+#define CAFFE_UTIL_METRICS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/internal_thread.hpp"
+
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/**
+ * @brief The process-wide registry of the telemetry metrics: counters,
+ *        gauges and histograms, updated by the solver and the layers while
+ *        training, and exported in the Prometheus text format.
+ *
+ * A metric name may carry labels, e.g. caffe_prefetch_queue_size{layer="data"}.
+ * Times are in seconds and sizes in bytes. Updates are cheap but not free, so
+ * instrumented code checks enabled(), which a MetricsExporter turns on.
+ */
+class Metrics {
+ public:
+  /// @brief The registry of the process.
+  static Metrics& Get();
+
+  inline bool enabled() const { return enabled_; }
+  inline void set_enabled(bool enabled) { enabled_ = enabled; }
+
+  /// @brief Adds value to a counter, which only increases.
+  void Increment(const string& name, double value = 1);
+  /// @brief Sets a gauge, a value which may go up and down.
+  void Set(const string& name, double value);
+  /// @brief Adds an observation to a histogram, e.g. a duration.
+  void Observe(const string& name, double value);
+
+  double counter(const string& name) const;
+  double gauge(const string& name) const;
+  /// @brief The number of observations of a histogram.
+  uint64_t histogram_count(const string& name) const;
+  double histogram_sum(const string& name) const;
+
+  /// @brief The upper bounds of the buckets of the histograms, in seconds.
+  static const vector<double>& bucket_bounds();
+
+  /// @brief All the metrics, in the Prometheus text exposition format.
+  string ToText() const;
+  void Clear();
+
+ protected:
+  struct Histogram {
+    Histogram() : count(0), sum(0) {}
+    // Observations in each bucket, cumulated when exported.
+    vector<uint64_t> buckets;
+    uint64_t count;
+    double sum;
+  };
+
+  Metrics();
+  static void Create();
+
+  bool enabled_;
+  shared_ptr<boost::mutex> mutex_;
+  map<string, double> counters_;
+  map<string, double> gauges_;
+  map<string, Histogram> histograms_;
+
+  DISABLE_COPY_AND_ASSIGN(Metrics);
+};
+
+/**
+ * @brief Exports the Metrics of the process, on a local HTTP endpoint which
+ *        serves them for any GET request, and/or to a file rewritten every
+ *        interval, e.g. for the node exporter's textfile collector. Also
+ *        updates the memory gauges before each export.
+ */
+class MetricsExporter : public InternalThread {
+ public:
+  /**
+   * @brief Listens on port of the loopback interface if port >= 0, using
+   *        any free port if 0, and writes filename every interval_seconds if
+   *        filename is not empty. Enables the Metrics.
+   */
+  MetricsExporter(int port, const string& filename, double interval_seconds);
+  virtual ~MetricsExporter();
+
+  /// @brief The port listened on, or -1.
+  inline int port() const { return port_; }
+
+  /// @brief Writes the metrics to filename, replacing it atomically.
+  static void WriteFile(const string& filename);
+
+ protected:
+  virtual void InternalThreadEntry();
+  void Serve(int connection);
+
+  int socket_;
+  int port_;
+  const string filename_;
+  const double interval_seconds_;
+
+  DISABLE_COPY_AND_ASSIGN(MetricsExporter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_METRICS_HPP_
@@ -0,0 +1,118 @@
+#ifndef CAFFE_UTIL_NET_PROFILER_HPP_
+#define CAFFE_UTIL_NET_PROFILER_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records the layer passes of the Net%s it is set on (see
+ *        Net::set_profiler): wall time, invocation counts, estimated FLOPs
+ *        and bytes moved, and SyncedMemory allocations.
+ *
+ * FLOPs and bytes are estimated from the layer type and the blob shapes, so
+ * they are the same for every implementation of a layer. Together with the
+ * times, they give the achieved FLOP/s and bandwidth of each layer, and its
+ * arithmetic intensity (FLOPs per byte) to place it on a roofline. Each pass
+ * is also kept as an event for WriteChromeTrace, up to max_trace_events.
+ *
+ * In GPU mode, passes are timed with CUDA events, which synchronizes the
+ * device after each layer.
+ */
+template <typename Dtype>
+class NetProfiler {
+ public:
+  enum Pass { FORWARD, BACKWARD };
+
+  /// @brief Totals over the passes of a layer in one direction.
+  struct Totals {
+    Totals() : calls(0), microseconds(0), flops(0), bytes(0),
+        allocations(0), allocated_bytes(0) {}
+    int calls;
+    double microseconds;
+    double flops;
+    double bytes;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+  };
+
+  struct LayerStats {
+    string name;
+    string type;
+    Totals forward;
+    Totals backward;
+  };
+
+  explicit NetProfiler(int max_trace_events = 1 << 20);
+
+  /// @brief Starts timing a layer pass, to be followed by LayerEnd.
+  void LayerStart();
+  /// @brief Records the pass of layer started by the last LayerStart.
+  void LayerEnd(const string& name, Pass pass, Layer<Dtype>* layer,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+  /// @brief Clears the stats and the events, e.g. after warm-up iterations.
+  void Reset();
+
+  /// @brief Stats of the layers profiled so far, in order of first pass.
+  inline const vector<LayerStats>& layer_stats() const { return stats_; }
+
+  /**
+   * @brief Writes the events in the Trace Event Format of chrome://tracing:
+   *        one complete event per pass, with its type, FLOPs and bytes.
+   */
+  void WriteChromeTrace(const string& filename) const;
+  /**
+   * @brief Writes one row per layer and pass, with per-call FLOPs and bytes,
+   *        times in microseconds, GFLOP/s, GB/s and FLOPs per byte.
+   */
+  void WriteCSV(const string& filename) const;
+  /// @brief Logs the average time and throughput of each layer and pass.
+  void LogSummary() const;
+
+  /// @brief Estimated floating point operations of a pass of layer.
+  static double EstimateFlops(Layer<Dtype>* layer, Pass pass,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+  /**
+   * @brief Estimated bytes read and written by a pass of layer, counting the
+   *        bottom, top and param blobs once each, and their diffs backward.
+   */
+  static double EstimateBytes(Layer<Dtype>* layer, Pass pass,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+ protected:
+  struct Event {
+    int layer;
+    Pass pass;
+    double start;
+    double duration;
+    double flops;
+    double bytes;
+  };
+
+  const int max_trace_events_;
+  vector<LayerStats> stats_;
+  map<string, int> layer_indices_;
+  vector<Event> events_;
+  // Start of the trace, from which event times are measured.
+  boost::posix_time::ptime origin_;
+  boost::posix_time::ptime start_;
+  Timer timer_;
+  uint64_t start_allocations_;
+  uint64_t start_allocated_bytes_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NET_PROFILER_HPP_
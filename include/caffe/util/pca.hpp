@@ -0,0 +1,58 @@
+#ifndef CAFFE_UTIL_PCA_HPP_
+#define CAFFE_UTIL_PCA_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Principal component analysis of the rows of a matrix, e.g. to
+ *        reduce features before storing them.
+ *
+ * Fit finds the directions of highest variance by subspace iteration with
+ * GEMMs, which never forms the dim x dim covariance, then diagonalizes the
+ * covariance within the subspace found. Its starting subspace is drawn from
+ * the Caffe RNG.
+ */
+template <typename Dtype>
+class PCA {
+ public:
+  PCA() {}
+
+  /**
+   * @brief Fits num_components components to the num x dim row-major data,
+   *        with num_iterations steps of subspace iteration.
+   */
+  void Fit(int num, int dim, const Dtype* data, int num_components,
+      int num_iterations = 6);
+  /// @brief Projects num rows of data, centered, onto the components.
+  void Project(int num, const Dtype* data, Dtype* projection) const;
+
+  /// @brief The number of components, or 0 before Fit.
+  inline int num_components() const {
+    return components_.count() ? components_.shape(0) : 0;
+  }
+  inline int dim() const {
+    return components_.count() ? components_.shape(1) : 0;
+  }
+  /// @brief The mean of the rows, subtracted before projecting.
+  inline const Blob<Dtype>& mean() const { return mean_; }
+  /// @brief The num_components x dim components, by decreasing variance.
+  inline const Blob<Dtype>& components() const { return components_; }
+  /// @brief The variance of the data along each component.
+  inline const vector<Dtype>& variances() const { return variances_; }
+
+ protected:
+  Blob<Dtype> mean_;
+  Blob<Dtype> components_;
+  vector<Dtype> variances_;
+
+  DISABLE_COPY_AND_ASSIGN(PCA);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PCA_HPP_
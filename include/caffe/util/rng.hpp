@@ -1,6 +1,8 @@
 #ifndef CAFFE_RNG_CPP_HPP_
 #define CAFFE_RNG_CPP_HPP_
 
+#include <stdint.h>
+
 #include <algorithm>
 #include <iterator>
 
@@ -38,6 +40,48 @@ template <class RandomAccessIterator>
 inline void shuffle(RandomAccessIterator begin, RandomAccessIterator end) {
   shuffle(begin, end, caffe_rng());
 }
+
+/**
+ * @brief The Philox4x32-10 counter-based generator of Salmon et al.,
+ *        "Parallel Random Numbers: As Easy as 1, 2, 3" (SC 2011).
+ *
+ * A stream is the sequence of 32-bit words hashed from their index under
+ * a 64-bit key, so any range of it is generated without the words before,
+ * and the same range always gives the same numbers. A range of an array can
+ * then be filled by any thread, making results independent of the number
+ * of threads. Words are generated by blocks of 4, several blocks at a time,
+ * in loops compilers vectorize.
+ *
+ * Element i of an array filled at offset uses word offset + i, or for
+ * Gaussian, words 2 * ((offset + i) / 2) and the one after.
+ */
+class Philox {
+ public:
+  explicit Philox(uint64_t key);
+
+  /// @brief A key drawn from the Caffe RNG, to start a stream.
+  static uint64_t RandomKey();
+
+  /// @brief Sets r[i] to word offset + i of the stream.
+  void Random(uint64_t offset, int n, uint32_t* r) const;
+  /// @brief Uniform values in [a, b].
+  template <typename Dtype>
+  void Uniform(uint64_t offset, int n, Dtype a, Dtype b, Dtype* r) const;
+  /// @brief Normal values, by the Box-Muller transform.
+  template <typename Dtype>
+  void Gaussian(uint64_t offset, int n, Dtype mu, Dtype sigma,
+      Dtype* r) const;
+  /// @brief 1 with probability p, 0 otherwise.
+  template <typename Dtype>
+  void Bernoulli(uint64_t offset, int n, Dtype p, unsigned int* r) const;
+
+ protected:
+  // Sets the 4 * num_blocks words of blocks first to first + num_blocks.
+  void Blocks(uint64_t first, int num_blocks, uint32_t* r) const;
+
+  uint32_t key_[2];
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_RNG_HPP_
@@ -0,0 +1,87 @@
+#ifndef CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
+#define CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/message.h"
+
+#include "caffe/common.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace caffe {
+
+using ::google::protobuf::Message;
+
+/**
+ * @brief Writes solver snapshots to disk on a background thread.
+ *
+ * A snapshot is a set of protocol buffers, e.g. the NetParameter and the
+ * SolverState of one iteration, handed over by the solver once it has copied
+ * the parameters into them. Serialization and disk I/O then happen on the
+ * writer thread while training continues. Each file is written under a
+ * temporary name, flushed to disk with fsync and renamed over its final name,
+ * so a crash never leaves a truncated snapshot behind.
+ *
+ * At most max_pending snapshots are held in memory (2 gives double buffering);
+ * Write blocks until the oldest one has been written when that limit is
+ * reached.
+ */
+class SnapshotWriter : public InternalThread {
+ public:
+  class Snapshot {
+   public:
+    explicit Snapshot(int iter) : iter_(iter), stall_ms_(0) {}
+
+    /**
+     * @brief Takes over the content of proto, leaving it empty. If chunk_dir
+     *        is set, proto is written as a chunked snapshot manifest (see
+     *        WriteChunkedProto).
+     */
+    void Add(const string& filename, Message* proto,
+        const string& chunk_dir = "");
+
+    inline int iter() const { return iter_; }
+    /// @brief Time the training thread spent producing and queuing it.
+    inline float stall_ms() const { return stall_ms_; }
+    inline void set_stall_ms(float stall_ms) { stall_ms_ = stall_ms; }
+
+   protected:
+    int iter_;
+    float stall_ms_;
+    vector<string> filenames_;
+    vector<string> chunk_dirs_;
+    vector<shared_ptr<Message> > protos_;
+
+    friend class SnapshotWriter;
+
+  DISABLE_COPY_AND_ASSIGN(Snapshot);
+  };
+
+  explicit SnapshotWriter(int max_pending = 2);
+  virtual ~SnapshotWriter();
+
+  /**
+   * @brief Queues a snapshot for writing, waiting for a free buffer if needed.
+   *        The waiting time is added to the snapshot's stall_ms.
+   */
+  void Write(const shared_ptr<Snapshot>& snapshot);
+  /// @brief Blocks until every queued snapshot is on disk.
+  void Wait();
+
+ protected:
+  virtual void InternalThreadEntry();
+  void WriteSnapshot(const Snapshot& snapshot);
+
+  const int max_pending_;
+  BlockingQueue<shared_ptr<Snapshot> > pending_;
+  // One token per snapshot that may be buffered without blocking.
+  BlockingQueue<int> free_;
+
+DISABLE_COPY_AND_ASSIGN(SnapshotWriter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
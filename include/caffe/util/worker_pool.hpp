@@ -0,0 +1,66 @@
+#ifndef CAFFE_UTIL_WORKER_POOL_HPP_
+#define CAFFE_UTIL_WORKER_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads running the iterations of parallel loops,
+ *        e.g. the items of a batch in a data layer's prefetch thread.
+ *
+ * Run hands out the iterations one at a time to the workers and to the
+ * calling thread, so uneven iterations balance out. The workers have the
+ * default Caffe thread state, so tasks shouldn't depend on the mode or the
+ * random streams of the caller; draw their random numbers beforehand instead,
+ * which also keeps results independent of the number of threads.
+ */
+class WorkerPool {
+ public:
+  /**
+   * @brief Starts num_threads - 1 workers, since the calling thread also runs
+   *        iterations: with 1 thread, loops run serially.
+   */
+  explicit WorkerPool(int num_threads);
+  ~WorkerPool();
+
+  /**
+   * @brief Runs task(i) for i in [0, n), returning when all are done. Only one
+   *        thread may call Run at a time, and tasks may not call it.
+   */
+  void Run(int n, const boost::function<void(int)>& task);
+
+  inline int num_threads() const { return num_threads_; }
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  void WorkerEntry();
+  // Runs the remaining iterations of the current loop, with sync_->mutex_
+  // locked by lock outside of the tasks.
+  template <typename Lock>
+  void RunIterations(Lock* lock);
+
+  const int num_threads_;
+  shared_ptr<sync> sync_;
+  const boost::function<void(int)>* task_;
+  int num_iterations_;
+  int next_iteration_;
+  // Number of workers that haven't finished the current loop.
+  int num_running_;
+  // Incremented for each loop, so the workers see when a new one starts.
+  int generation_;
+  bool stop_;
+
+  DISABLE_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WORKER_POOL_HPP_
@@ -37,6 +37,21 @@ const int NPY_DTYPE = NPY_FLOAT32;
 // Selecting mode.
 void set_mode_cpu() { Caffe::set_mode(Caffe::CPU); }
 void set_mode_gpu() { Caffe::set_mode(Caffe::GPU); }
+bool is_mode_gpu() { return Caffe::mode() == Caffe::GPU; }
+
+// Releases the GIL for the lifetime of the object, so that other Python
+// threads can run while Caffe computes. Python layers take it back to run
+// their Python code (see PythonLayer).
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILRelease);
+};
 
 // For convenience, check that input files can be opened, and raise an
 // exception that boost will send to Python if not (caffe could still crash
@@ -91,16 +106,91 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
 
   shared_ptr<Net<Dtype> > net(new Net<Dtype>(param_file,
       static_cast<Phase>(phase)));
-  net->CopyTrainedLayersFrom(pretrained_param_file);
+  {
+    ScopedGILRelease gil;
+    net->CopyTrainedLayersFrom(pretrained_param_file);
+  }
   return net;
 }
 
 void Net_Save(const Net<Dtype>& net, string filename) {
+  ScopedGILRelease gil;
   NetParameter net_param;
   net.ToProto(&net_param, false);
   WriteProtoToBinaryFile(net_param, filename.c_str());
 }
 
+// Binds array as the data of the blob at index in net with no copy,
+// reshaping the blob to the shape of array. The array must outlive the
+// binding, so the caller keeps a reference on it (see Net.bind_input).
+void Net_BindInput(Net<Dtype>* net, int index, bp::object array_obj) {
+  if (!PyArray_Check(array_obj.ptr())) {
+    throw std::runtime_error("Input must be a numpy array");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(array_obj.ptr());
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error("Input must be C contiguous");
+  }
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_ALIGNED)) {
+    throw std::runtime_error("Input must be aligned");
+  }
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_WRITEABLE)) {
+    throw std::runtime_error("Input must be writeable");
+  }
+  if (PyArray_TYPE(arr) != NPY_DTYPE) {
+    throw std::runtime_error("Input must be float32");
+  }
+  if (PyArray_SIZE(arr) == 0) {
+    throw std::runtime_error("Input must not be empty");
+  }
+  const vector<int> shape(PyArray_DIMS(arr),
+      PyArray_DIMS(arr) + PyArray_NDIM(arr));
+  Blob<Dtype>* blob = net->blobs()[index].get();
+  blob->Reshape(shape);
+  blob->set_cpu_data(static_cast<Dtype*>(PyArray_DATA(arr)));
+}
+
+// The following wrappers release the GIL while the net or solver runs.
+// Net construction keeps it, as it calls into Python to make Python layers.
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil;
+  net->BackwardFromTo(start, end);
+}
+
+void Net_CopyFrom(Net<Dtype>* net, string filename) {
+  ScopedGILRelease gil;
+  net->CopyTrainedLayersFrom(filename);
+}
+
+void Solver_Solve(Solver<Dtype>* solver, bp::object resume_file) {
+  string filename;
+  if (!resume_file.is_none()) {
+    filename = bp::extract<string>(resume_file);
+  }
+  ScopedGILRelease gil;
+  solver->Solve(filename.empty() ? NULL : filename.c_str());
+}
+
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  ScopedGILRelease gil;
+  solver->Step(iters);
+}
+
+void Solver_Restore(Solver<Dtype>* solver, string resume_file) {
+  ScopedGILRelease gil;
+  solver->Restore(resume_file.c_str());
+}
+
+void Solver_Snapshot(Solver<Dtype>* solver) {
+  ScopedGILRelease gil;
+  solver->Snapshot();
+}
+
 void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
     bp::object labels_obj) {
   // check that this network has an input MemoryDataLayer
@@ -207,8 +297,6 @@ bp::object BlobVec_add_blob(bp::tuple args, bp::dict kwargs) {
   return bp::object();
 }
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SolveOverloads, Solve, 0, 1);
-
 BOOST_PYTHON_MODULE(_caffe) {
   // below, we prepend an underscore to methods that will be replaced
   // in Python
@@ -219,6 +307,7 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_mode_cpu", &set_mode_cpu);
   bp::def("set_mode_gpu", &set_mode_gpu);
   bp::def("set_device", &Caffe::SetDevice);
+  bp::def("_is_mode_gpu", &is_mode_gpu);
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
 
@@ -226,12 +315,10 @@ BOOST_PYTHON_MODULE(_caffe) {
     bp::no_init)
     .def("__init__", bp::make_constructor(&Net_Init))
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
     .def("reshape", &Net<Dtype>::Reshape)
-    // The cast is to select a particular overload.
-    .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
-        &Net<Dtype>::CopyTrainedLayersFrom))
+    .def("copy_from", &Net_CopyFrom)
     .def("share_with", &Net<Dtype>::ShareTrainedLayersWith)
     .add_property("_blob_loss_weights", bp::make_function(
         &Net<Dtype>::blob_loss_weights, bp::return_internal_reference<>()))
@@ -254,6 +341,7 @@ BOOST_PYTHON_MODULE(_caffe) {
         bp::return_value_policy<bp::copy_const_reference>()))
     .def("_set_input_arrays", &Net_SetInputArrays,
         bp::with_custodian_and_ward<1, 2, bp::with_custodian_and_ward<1, 3> >())
+    .def("_bind_input", &Net_BindInput)
     .def("save", &Net_Save);
 
   bp::class_<Blob<Dtype>, shared_ptr<Blob<Dtype> >, boost::noncopyable>(
@@ -292,11 +380,10 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("test_nets", bp::make_function(&Solver<Dtype>::test_nets,
           bp::return_internal_reference<>()))
     .add_property("iter", &Solver<Dtype>::iter)
-    .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
-          &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
-    .def("restore", &Solver<Dtype>::Restore)
-    .def("snapshot", &Solver<Dtype>::Snapshot);
+    .def("solve", &Solver_Solve, (bp::arg("resume_file") = bp::object()))
+    .def("step", &Solver_Step)
+    .def("restore", &Solver_Restore)
+    .def("snapshot", &Solver_Snapshot);
 
   bp::class_<SGDSolver<Dtype>, bp::bases<Solver<Dtype> >,
     shared_ptr<SGDSolver<Dtype> >, boost::noncopyable>(
@@ -339,6 +426,12 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::class_<vector<bool> >("BoolVec")
     .def(bp::vector_indexing_suite<vector<bool> >());
 
+  // Nets and solvers release the GIL, so Python threads must be initialized
+  // (Python 3.7 and later always do it).
+#if PY_VERSION_HEX < 0x03070000
+  PyEval_InitThreads();
+#endif
+
   // boost python expects a void (missing) return value, while import_array
   // returns NULL for python3. import_array1() forces a void return value.
   import_array1();
@@ -3,7 +3,13 @@ Wrap the internal caffe C++ module (_caffe.so) with a clean, Pythonic
 interface.
 """
 
+import atexit
 from collections import OrderedDict
+import weakref
+try:
+    from concurrent.futures import ThreadPoolExecutor
+except ImportError:  # Python 2 without the futures backport
+    ThreadPoolExecutor = None
 try:
     from itertools import izip_longest
 except:
@@ -11,7 +17,8 @@ except:
 import numpy as np
 
 from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
-        RMSPropSolver, AdaDeltaSolver, AdamSolver
+        RMSPropSolver, AdaDeltaSolver, AdamSolver, set_mode_cpu, \
+        set_mode_gpu, _is_mode_gpu
 import caffe.io
 
 # We directly update methods from Net here (rather than using composition or
@@ -59,6 +66,35 @@ def _Net_outputs(self):
     return [list(self.blobs.keys())[i] for i in self._outputs]
 
 
+@property
+def _Net_bound_inputs(self):
+    """
+    An OrderedDict of the arrays bound as input blob data by bind_input(),
+    indexed by input name; the net keeps them alive through this reference.
+    """
+    return self.__dict__.setdefault('_bound_input_arrays', OrderedDict())
+
+
+def _Net_bind_input(self, name, array):
+    """
+    Bind an ndarray as the data of an input blob, without copying it.
+
+    The blob takes the shape of the array and uses its memory in place, so
+    forward() sees whatever the array holds when it runs. The array must be
+    float32 and C-contiguous. It stays bound until another array is bound
+    to the same input.
+
+    Parameters
+    ----------
+    name : name of the input blob
+    array : ndarray to bind
+    """
+    if name not in self.inputs:
+        raise Exception('{} is not an input of the net.'.format(name))
+    self._bind_input(list(self._blob_names).index(name), array)
+    self.bound_inputs[name] = array
+
+
 def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     """
     Forward pass: prepare inputs and run the net forward.
@@ -69,6 +105,8 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     kwargs : Keys are input blob names and values are blob ndarrays.
              For formatting inputs for Caffe, see Net.preprocess().
              If None, input is taken from data layers.
+             Inputs bound by bind_input() are bound to the given arrays
+             instead of having them copied in.
     start : optional name of layer at which to begin the forward pass
     end : optional name of layer at which to finish the forward pass
           (inclusive)
@@ -97,10 +135,19 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
             raise Exception('Input blob arguments do not match net inputs.')
         # Set input according to defined shapes and make arrays single and
         # C-contiguous as Caffe expects.
-        for in_, blob in kwargs.iteritems():
+        for in_, blob in kwargs.items():
+            if in_ in self.bound_inputs:
+                self.bind_input(in_, np.ascontiguousarray(blob, np.float32))
+                continue
             if blob.shape[0] != self.blobs[in_].num:
                 raise Exception('Input is not batch sized')
             self.blobs[in_].data[...] = blob
+    # Bind the inputs again, as a reshape may have given their blobs new
+    # memory, and to have the current contents of the arrays copied to the
+    # GPU.
+    for in_, array in self.bound_inputs.items():
+        if in_ not in kwargs:
+            self.bind_input(in_, array)
 
     self._forward(start_ind, end_ind)
 
@@ -108,6 +155,64 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     return {out: self.blobs[out].data for out in outputs}
 
 
+# The executors of forward_async(), shut down at exit so that pending passes
+# finish while the nets and the interpreter are still alive.
+_forward_executors = weakref.WeakSet()
+
+
+@atexit.register
+def _shutdown_forward_executors():
+    for executor in list(_forward_executors):
+        executor.shutdown(wait=True)
+
+
+def _Net_forward_async(self, blobs=None, **kwargs):
+    """
+    Submit a forward pass to run in the background.
+
+    Passes run one at a time, in the order they were submitted, on a thread
+    of the net that runs in the Caffe mode of the submitting thread. Since
+    the net releases the GIL while it runs, the caller can prepare the next
+    inputs meanwhile. Inputs are bound as by bind_input() when the pass
+    starts, not copied: do not modify them until the pass is done. Do not
+    call forward() either while passes are pending.
+
+    Parameters
+    ----------
+    blobs : list of blobs to return in addition to output blobs.
+    kwargs : Keys are input blob names and values are blob ndarrays.
+             If None, input is taken from data layers and bound inputs.
+
+    Returns
+    -------
+    future : concurrent.futures.Future of the {blob name: blob ndarray} dict
+             of the pass, holding copies of the blobs.
+    """
+    if ThreadPoolExecutor is None:
+        raise NotImplementedError('forward_async needs concurrent.futures; '
+                                  'install the futures package on Python 2.')
+    for in_ in kwargs:
+        if in_ not in self.inputs:
+            raise Exception('{} is not an input of the net.'.format(in_))
+    executor = self.__dict__.get('_forward_executor')
+    if executor is None:
+        executor = ThreadPoolExecutor(max_workers=1)
+        self.__dict__['_forward_executor'] = executor
+        _forward_executors.add(executor)
+    gpu = _is_mode_gpu()
+
+    def forward():
+        if gpu:
+            set_mode_gpu()
+        else:
+            set_mode_cpu()
+        for in_, array in kwargs.items():
+            self.bind_input(in_, np.ascontiguousarray(array, np.float32))
+        outs = self.forward(blobs=blobs)
+        return {out: data.copy() for out, data in outs.items()}
+    return executor.submit(forward)
+
+
 def _Net_backward(self, diffs=None, start=None, end=None, **kwargs):
     """
     Backward pass: prepare diffs and run the net backward.
@@ -297,10 +402,13 @@ Net.blobs = _Net_blobs
 Net.blob_loss_weights = _Net_blob_loss_weights
 Net.params = _Net_params
 Net.forward = _Net_forward
+Net.forward_async = _Net_forward_async
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
 Net.set_input_arrays = _Net_set_input_arrays
+Net.bound_inputs = _Net_bound_inputs
+Net.bind_input = _Net_bind_input
 Net._batch = _Net_batch
 Net.inputs = _Net_inputs
 Net.outputs = _Net_outputs
@@ -1,6 +1,8 @@
 import unittest
 import tempfile
 import os
+import threading
+import time
 import numpy as np
 import six
 
@@ -34,6 +36,36 @@ def simple_net_file(num_output):
     return f.name
 
 
+def slow_net_file():
+    """Make a net whose forward takes a while, returning the name of the
+    (temporary) file."""
+
+    f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+    f.write("""name: 'slownet'
+    input: 'data' input_shape { dim: 256 dim: 2048 }
+    layer { type: 'InnerProduct' name: 'ip1' bottom: 'data' top: 'ip1'
+      inner_product_param { num_output: 2048 } }
+    layer { type: 'InnerProduct' name: 'ip2' bottom: 'ip1' top: 'ip2'
+      inner_product_param { num_output: 2048 } }""")
+    f.close()
+    return f.name
+
+
+def input_net_file():
+    """Make a net with an input blob, returning the name of the (temporary)
+    file."""
+
+    f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+    f.write("""name: 'inputnet'
+    input: 'data' input_shape { dim: 4 dim: 5 }
+    layer { type: 'InnerProduct' name: 'ip' bottom: 'data' top: 'ip'
+      inner_product_param { num_output: 3
+        weight_filler { type: 'gaussian' std: 1 }
+        bias_filler { type: 'constant' value: 1 } } }""")
+    f.close()
+    return f.name
+
+
 class TestNet(unittest.TestCase):
     def setUp(self):
         self.num_output = 13
@@ -79,3 +111,66 @@ class TestNet(unittest.TestCase):
             for i in range(len(self.net.params[name])):
                 self.assertEqual(abs(self.net.params[name][i].data
                     - net2.params[name][i].data).sum(), 0)
+
+    def test_forward_releases_gil(self):
+        """Check that Python threads run while a net runs forward"""
+
+        net_file = slow_net_file()
+        net = caffe.Net(net_file, caffe.TEST)
+        os.remove(net_file)
+        span = []
+
+        def forward():
+            start = time.time()
+            net.forward()
+            span.extend([start, time.time()])
+
+        thread = threading.Thread(target=forward)
+        ticks = []
+        thread.start()
+        while thread.is_alive():
+            ticks.append(time.time())
+        thread.join()
+        # The main thread ran in the middle of the forward pass.
+        start, end = span
+        quarter = (end - start) / 4
+        self.assertTrue(any(start + quarter < t < end - quarter
+                            for t in ticks))
+
+    def test_bind_input(self):
+        net_file = input_net_file()
+        net = caffe.Net(net_file, caffe.TEST)
+        os.remove(net_file)
+        weights, bias = net.params['ip'][0].data, net.params['ip'][1].data
+        x = np.random.randn(4, 5).astype(np.float32)
+        net.bind_input('data', x)
+        self.assertTrue(np.shares_memory(net.blobs['data'].data, x))
+        np.testing.assert_allclose(net.forward()['ip'],
+                                   x.dot(weights.T) + bias, rtol=1e-5)
+        # Writes to the array are seen by the next pass.
+        x[...] = np.random.randn(4, 5)
+        np.testing.assert_allclose(net.forward()['ip'],
+                                   x.dot(weights.T) + bias, rtol=1e-5)
+        # The blob takes the shape of the array.
+        y = np.random.randn(7, 5).astype(np.float32)
+        ip = net.forward(data=y)['ip']
+        self.assertIs(net.bound_inputs['data'], y)
+        self.assertEqual(ip.shape, (7, 3))
+        np.testing.assert_allclose(ip, y.dot(weights.T) + bias, rtol=1e-5)
+        self.assertRaises(Exception, net.bind_input, 'data',
+                          np.zeros((4, 5), np.float64))
+        self.assertRaises(Exception, net.bind_input, 'data',
+                          np.zeros((5, 4), np.float32).T)
+        self.assertRaises(Exception, net.bind_input, 'ip',
+                          np.zeros((4, 3), np.float32))
+
+    def test_forward_async(self):
+        net_file = input_net_file()
+        net = caffe.Net(net_file, caffe.TEST)
+        os.remove(net_file)
+        weights, bias = net.params['ip'][0].data, net.params['ip'][1].data
+        inputs = [np.random.randn(4, 5).astype(np.float32) for _ in range(3)]
+        futures = [net.forward_async(data=x) for x in inputs]
+        for x, future in zip(inputs, futures):
+            np.testing.assert_allclose(future.result()['ip'],
+                                       x.dot(weights.T) + bias, rtol=1e-5)
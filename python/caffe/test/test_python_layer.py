@@ -1,6 +1,7 @@
 import unittest
 import tempfile
 import os
+import threading
 import six
 
 import caffe
@@ -107,6 +108,18 @@ class TestPythonLayer(unittest.TestCase):
             for d in blob.data.shape:
                 self.assertEqual(s, d)
 
+    def test_forward_in_thread(self):
+        # Nets run without the GIL; Python layers must take it back.
+        x = 3
+        self.net.blobs['data'].data[...] = x
+        threads = [threading.Thread(target=self.net.forward)
+                   for _ in range(2)]
+        for thread in threads:
+            thread.start()
+            thread.join()
+        for y in self.net.blobs['three'].data.flat:
+            self.assertEqual(y, 10**3 * x)
+
     def test_exception(self):
         net_file = exception_net_file()
         self.assertRaises(RuntimeError, caffe.Net, net_file, caffe.TEST)
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -39,6 +40,7 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    shares_memory_ = false;
   }
 }
 
@@ -61,14 +63,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), shares_memory_(false) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), shares_memory_(false) {
   Reshape(shape);
 }
 
@@ -87,6 +89,9 @@ const Dtype* Blob<Dtype>::cpu_data() const {
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  // The external data may only hold count_ elements, so a reshape to any
+  // larger count must allocate new memory.
+  capacity_ = count_;
   data_->set_cpu_data(data);
 }
 
@@ -136,12 +141,68 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  shares_memory_ = true;
 }
 
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
   diff_ = other.diff();
+  diff_rows_ = other.diff_rows_;
+  shares_memory_ = true;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareView(const Blob& other, int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset, other.count() - count_);
+  data_.reset(new SyncedMemory(other.data(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  diff_.reset(new SyncedMemory(other.diff(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  diff_rows_.reset();
+  // The rest of other isn't this Blob's to grow into.
+  capacity_ = count_;
+  shares_memory_ = false;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::IsViewOf(const Blob& other, int offset) const {
+  return data_ && diff_ && other.data_ && other.diff_ &&
+      data_->is_view_of(*other.data_, offset * sizeof(Dtype)) &&
+      diff_->is_view_of(*other.diff_, offset * sizeof(Dtype));
+}
+
+template <typename Dtype>
+void Blob<Dtype>::set_row_sparse_diff(bool row_sparse) {
+  if (row_sparse && !diff_rows_) {
+    CHECK_GT(num_axes(), 0) << "A row-sparse diff needs at least one axis.";
+    diff_rows_.reset(new vector<int>());
+  } else if (!row_sparse) {
+    diff_rows_.reset();
+  }
+}
+
+template <typename Dtype>
+void Blob<Dtype>::AddDiffRows(const vector<int>& rows) {
+  CHECK(diff_rows_) << "The diff is not row-sparse.";
+  vector<int>& diff_rows = *diff_rows_;
+  const int old_size = diff_rows.size();
+  diff_rows.insert(diff_rows.end(), rows.begin(), rows.end());
+  std::sort(diff_rows.begin() + old_size, diff_rows.end());
+  std::inplace_merge(diff_rows.begin(), diff_rows.begin() + old_size,
+      diff_rows.end());
+  diff_rows.erase(std::unique(diff_rows.begin(), diff_rows.end()),
+      diff_rows.end());
+  DCHECK(diff_rows.empty() || (diff_rows.front() >= 0 &&
+      diff_rows.back() < shape(0))) << "diff row out of range";
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ClearDiffRows() {
+  if (diff_rows_) {
+    diff_rows_->clear();
+  }
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -15,7 +15,7 @@ namespace caffe {
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
-    : param_(param), phase_(phase) {
+    : param_(param), rand_offset_(0), phase_(phase) {
   // check if we want to use mean_file
   if (param_.has_mean_file()) {
     CHECK_EQ(param_.mean_value_size(), 0) <<
@@ -524,20 +524,31 @@ void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
       (phase_ == TRAIN && param_.crop_size());
   if (needs_rand) {
-    const unsigned int rng_seed = caffe_rng_rand();
-    rng_.reset(new Caffe::RNG(rng_seed));
+    InitRand(Philox::RandomKey());
   } else {
     rng_.reset();
   }
 }
 
+template <typename Dtype>
+void DataTransformer<Dtype>::InitRand(uint64_t key) {
+  rng_.reset(new Philox(key));
+  rand_offset_ = 0;
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::SeekRand(uint64_t item) {
+  // A transformation draws at most 3 numbers: the mirror and the crop.
+  rand_offset_ = item * 4;
+}
+
 template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
   CHECK(rng_);
   CHECK_GT(n, 0);
-  caffe::rng_t* rng =
-      static_cast<caffe::rng_t*>(rng_->generator());
-  return ((*rng)() % n);
+  uint32_t r;
+  rng_->Random(rand_offset_++, 1, &r);
+  return (r % n);
 }
 
 INSTANTIATE_CLASS(DataTransformer);
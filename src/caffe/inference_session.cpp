@@ -0,0 +1,69 @@
+#include <vector>
+
+#include "caffe/inference_session.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceSession<Dtype>::InferenceSession(
+    const shared_ptr<Net<Dtype> >& model) : model_(model) {
+  CHECK_EQ(model_->phase(), TEST) << "Inference sessions need a TEST net.";
+  // Rebuild the definition of the model from its layers, which were already
+  // filtered for its NetState and have the splits inserted.
+  NetParameter param;
+  param.set_name(model_->name());
+  param.mutable_state()->set_phase(TEST);
+  for (int i = 0; i < model_->num_inputs(); ++i) {
+    param.add_input(model_->blob_names()[model_->input_blob_indices()[i]]);
+    const vector<int>& shape = model_->input_blobs()[i]->shape();
+    BlobShape* input_shape = param.add_input_shape();
+    for (int j = 0; j < shape.size(); ++j) {
+      input_shape->add_dim(shape[j]);
+    }
+  }
+  const vector<shared_ptr<Layer<Dtype> > >& layers = model_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    LayerParameter* layer_param = param.add_layer();
+    layer_param->CopyFrom(layers[i]->layer_param());
+    layer_param->clear_blobs();
+    layer_param->clear_include();
+    layer_param->clear_exclude();
+  }
+  net_.reset(new Net<Dtype>(param, NULL, model_.get()));
+  SyncParams();
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& InferenceSession<Dtype>::Forward(Dtype* loss) {
+  const SyncedMemory::SyncedHead mode_head = Caffe::mode() == Caffe::CPU ?
+      SyncedMemory::HEAD_AT_CPU : SyncedMemory::HEAD_AT_GPU;
+  const vector<shared_ptr<Blob<Dtype> > >& params = model_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    const SyncedMemory::SyncedHead head = params[i]->data()->head();
+    CHECK(head == SyncedMemory::SYNCED || head == mode_head)
+        << "Param " << i << " of the model is not synced to the device of "
+        << "the current mode; call SyncParams before running the sessions.";
+  }
+  return net_->ForwardPrefilled(loss);
+}
+
+template <typename Dtype>
+void InferenceSession<Dtype>::SyncParams() {
+  const vector<shared_ptr<Blob<Dtype> > >& params = model_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    switch (Caffe::mode()) {
+    case Caffe::CPU:
+      params[i]->cpu_data();
+      break;
+    case Caffe::GPU:
+      params[i]->gpu_data();
+      break;
+    default:
+      LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+    }
+  }
+}
+
+INSTANTIATE_CLASS(InferenceSession);
+
+}  // namespace caffe
@@ -180,6 +180,12 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  // Deconvolution multiplies by the weights in backward_cpu_gemm instead.
+  if (this->phase_ == TEST && !reverse_dimensions() &&
+      this->layer_param_.storage_precision() != FP32) {
+    half_weight_.reset(
+        new HalfBlob<Dtype>(this->layer_param_.storage_precision()));
+  }
 }
 
 template <typename Dtype>
@@ -264,10 +270,16 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+    if (forward_half()) {
+      half_weight_->cpu_gemm(weight_offset_ * g, conv_out_channels_ / group_,
+          conv_out_spatial_dim_, kernel_dim_, col_buff + col_offset_ * g,
+          output + output_offset_ * g);
+    } else {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+          group_, conv_out_spatial_dim_, kernel_dim_,
+          (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
+          (Dtype)0., output + output_offset_ * g);
+    }
   }
 }
 
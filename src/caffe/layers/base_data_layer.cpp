@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,7 +8,9 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/metrics.hpp"
 
 namespace caffe {
 
@@ -103,10 +106,27 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::PopBatch() {
+  Metrics& metrics = Metrics::Get();
+  if (!metrics.enabled()) {
+    return prefetch_full_.pop("Data layer prefetch queue empty");
+  }
+  const string labels = "{layer=\"" + this->layer_param_.name() + "\"}";
+  metrics.Set("caffe_prefetch_queue_size" + labels, prefetch_full_.size());
+  metrics.Set("caffe_prefetch_queue_capacity" + labels, PREFETCH_COUNT);
+  CPUTimer timer;
+  timer.Start();
+  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  metrics.Increment("caffe_prefetch_wait_seconds_total" + labels,
+      timer.MicroSeconds() / 1e6);
+  return batch;
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch = PopBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -50,6 +50,41 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bottom.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+  } else if (this->share_views_ && num_concats_ == 1) {
+    // The bottoms lie one after the other in the top, so they can be views
+    // of it which their producers fill in place, making the copies of
+    // Forward and Backward no-ops. Bottoms sharing the memory of another
+    // blob, e.g. the top of a Reshape layer, are still copied.
+    vector<int> views, offsets;
+    int offset = 0;
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (bottom[i]->count() > 0 && !bottom[i]->shares_memory() &&
+          !bottom[i]->IsViewOf(*top[0], offset)) {
+        views.push_back(i);
+        offsets.push_back(offset);
+      }
+      offset += bottom[i]->count();
+    }
+    // The new views keep the data of the bottoms, which is saved first as it
+    // may lie where another view goes after the top was reshaped.
+    vector<Dtype> saved;
+    for (int j = 0; j < views.size(); ++j) {
+      const Blob<Dtype>* blob = bottom[views[j]];
+      if (blob->data()->head() != SyncedMemory::UNINITIALIZED) {
+        saved.insert(saved.end(), blob->cpu_data(),
+            blob->cpu_data() + blob->count());
+      }
+    }
+    offset = 0;
+    for (int j = 0; j < views.size(); ++j) {
+      Blob<Dtype>* blob = bottom[views[j]];
+      if (blob->data()->head() != SyncedMemory::UNINITIALIZED) {
+        caffe_copy(blob->count(), &saved[offset],
+            top[0]->mutable_cpu_data() + offsets[j]);
+        offset += blob->count();
+      }
+      blob->ShareView(*top[0], offsets[j]);
+    }
   }
 }
 
@@ -63,6 +98,7 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    // caffe_copy does nothing for a bottom which is a view of the top.
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(bottom_concat_axis * concat_input_size_,
           bottom_data + n * bottom_concat_axis * concat_input_size_,
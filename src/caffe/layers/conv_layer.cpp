@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -24,7 +27,14 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (!this->blocked_bottoms_.empty()) {
+    Forward_cpu_blocked(bottom, top);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (this->forward_half()) {
+    this->half_weight_->Update(*this->blobs_[0]);
+  }
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
@@ -42,6 +52,8 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(this->blocked_bottoms_.empty())
+      << "Backward is not implemented in the blocked layout.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
@@ -72,6 +84,139 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::UpdateBlockedWeight() {
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  if (weight.data() == blocked_weight_source_ &&
+      blocked_weight_source_->version() == blocked_weight_version_) {
+    return;
+  }
+  blocked_weight_source_ = weight.data();
+  blocked_weight_version_ = blocked_weight_source_->version();
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int in_blocks = channel_blocks(this->channels_);
+  const int out_blocks = channel_blocks(this->num_output_);
+  const int block_size = kChannelBlock * kChannelBlock;
+  blocked_weight_.Reshape(vector<int>(1,
+      out_blocks * in_blocks * kernel_h * kernel_w * block_size));
+  Dtype* blocked = blocked_weight_.mutable_cpu_data();
+  // The channels beyond the last in the padded blocks get zero weights.
+  caffe_set(blocked_weight_.count(), Dtype(0), blocked);
+  const Dtype* data = weight.cpu_data();
+  for (int o = 0; o < this->num_output_; ++o) {
+    for (int c = 0; c < this->channels_; ++c) {
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          const int block = (o / kChannelBlock * in_blocks + c / kChannelBlock)
+              * kernel_h * kernel_w + kh * kernel_w + kw;
+          blocked[block * block_size + c % kChannelBlock * kChannelBlock +
+              o % kChannelBlock] = *data++;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::Forward_cpu_blocked(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  UpdateBlockedWeight();
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int dilation_h = this->dilation_.cpu_data()[0];
+  const int dilation_w = this->dilation_.cpu_data()[1];
+  const int in_blocks = channel_blocks(this->channels_);
+  const int out_blocks = channel_blocks(this->num_output_);
+  const int block_size = kChannelBlock * kChannelBlock;
+  const Dtype* weight = blocked_weight_.cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    if (!this->blocked_bottoms_[i]) {
+      blocked_bottom_.Reshape(vector<int>(1,
+          this->num_ * in_blocks * kChannelBlock * height * width));
+      caffe_cpu_to_blocked(this->num_, this->channels_, height * width,
+          bottom_data, blocked_bottom_.mutable_cpu_data());
+      bottom_data = blocked_bottom_.cpu_data();
+    }
+    Dtype* top_data;
+    if (this->blocked_tops_[i]) {
+      top_data = top[i]->mutable_cpu_data();
+    } else {
+      blocked_top_.Reshape(vector<int>(1,
+          this->num_ * out_blocks * kChannelBlock * output_h * output_w));
+      top_data = blocked_top_.mutable_cpu_data();
+    }
+    // Each output row of a block of output channels sums, over the input
+    // blocks and the kernel, the products of the input pixels with the
+    // block_size weights of their channels, which vectorize along the
+    // output channels.
+    for (int n = 0; n < this->num_; ++n) {
+      for (int ob = 0; ob < out_blocks; ++ob) {
+        Dtype bias_block[kChannelBlock];
+        for (int c = 0; c < kChannelBlock; ++c) {
+          const int o = ob * kChannelBlock + c;
+          bias_block[c] = bias && o < this->num_output_ ? bias[o] : Dtype(0);
+        }
+        for (int oh = 0; oh < output_h; ++oh) {
+          Dtype* top_row = top_data + ((n * out_blocks + ob) * output_h + oh)
+              * output_w * kChannelBlock;
+          for (int ow = 0; ow < output_w; ++ow) {
+            for (int c = 0; c < kChannelBlock; ++c) {
+              top_row[ow * kChannelBlock + c] = bias_block[c];
+            }
+          }
+          for (int ib = 0; ib < in_blocks; ++ib) {
+            for (int kh = 0; kh < kernel_h; ++kh) {
+              const int h = oh * stride_h - pad_h + kh * dilation_h;
+              if (h < 0 || h >= height) {
+                continue;
+              }
+              const Dtype* bottom_row = bottom_data +
+                  ((n * in_blocks + ib) * height + h) * width * kChannelBlock;
+              for (int kw = 0; kw < kernel_w; ++kw) {
+                const Dtype* tap = weight + (((ob * in_blocks + ib) *
+                    kernel_h + kh) * kernel_w + kw) * block_size;
+                const int offset = kw * dilation_w - pad_w;
+                // The outputs whose input column lies inside the input.
+                const int ow_begin = offset < 0 ?
+                    (-offset + stride_w - 1) / stride_w : 0;
+                const int ow_end = width - offset > 0 ? std::min(output_w,
+                    (width - offset - 1) / stride_w + 1) : 0;
+                for (int ow = ow_begin; ow < ow_end; ++ow) {
+                  const Dtype* pixel = bottom_row +
+                      (ow * stride_w + offset) * kChannelBlock;
+                  Dtype* out = top_row + ow * kChannelBlock;
+                  for (int ci = 0; ci < kChannelBlock; ++ci) {
+                    const Dtype value = pixel[ci];
+                    const Dtype* w = tap + ci * kChannelBlock;
+                    for (int co = 0; co < kChannelBlock; ++co) {
+                      out[co] += value * w[co];
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    if (!this->blocked_tops_[i]) {
+      caffe_cpu_from_blocked(this->num_, this->num_output_,
+          output_h * output_w, top_data, top[i]->mutable_cpu_data());
+    }
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(ConvolutionLayer);
 #endif
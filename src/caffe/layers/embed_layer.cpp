@@ -42,6 +42,8 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       bias_filler->Fill(this->blobs_[1].get());
     }
   }  // parameter initialization
+  this->blobs_[0]->set_row_sparse_diff(
+      this->layer_param_.embed_param().sparse_gradient());
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
 
@@ -100,6 +102,9 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
     }
+    if (this->blobs_[0]->row_sparse_diff()) {
+      AddWeightDiffRows(bottom[0]);
+    }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
     const Dtype* top_diff = top[0]->cpu_diff();
@@ -109,6 +114,16 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void EmbedLayer<Dtype>::AddWeightDiffRows(const Blob<Dtype>* bottom) {
+  const Dtype* bottom_data = bottom->cpu_data();
+  vector<int> rows(M_);
+  for (int n = 0; n < M_; ++n) {
+    rows[n] = static_cast<int>(bottom_data[n]);
+  }
+  this->blobs_[0]->AddDiffRows(rows);
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(EmbedLayer);
 #endif
@@ -124,28 +124,34 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// Moves on to the first row of the next file, once all the rows of the
+// current one have been read.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::NextFile() {
+  if (num_files_ > 1) {
+    ++current_file_;
+    if (current_file_ == num_files_) {
+      current_file_ = 0;
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        std::random_shuffle(file_permutation_.begin(),
+                            file_permutation_.end());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+    LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  }
+  current_row_ = 0;
+  if (this->layer_param_.hdf5_data_param().shuffle())
+    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
+}
+
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   for (int i = 0; i < batch_size; ++i, ++current_row_) {
     if (current_row_ == hdf_blobs_[0]->shape(0)) {
-      if (num_files_ > 1) {
-        ++current_file_;
-        if (current_file_ == num_files_) {
-          current_file_ = 0;
-          if (this->layer_param_.hdf5_data_param().shuffle()) {
-            std::random_shuffle(file_permutation_.begin(),
-                                file_permutation_.end());
-          }
-          DLOG(INFO) << "Looping around to first file.";
-        }
-        LoadHDF5FileData(
-            hdf_filenames_[file_permutation_[current_file_]].c_str());
-      }
-      current_row_ = 0;
-      if (this->layer_param_.hdf5_data_param().shuffle())
-        std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
+      NextFile();
     }
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/sparse_blob.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -46,6 +47,10 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  if (this->phase_ == TEST && this->layer_param_.storage_precision() != FP32) {
+    half_weight_.reset(
+        new HalfBlob<Dtype>(this->layer_param_.storage_precision()));
+  }
 }
 
 template <typename Dtype>
@@ -54,6 +59,9 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   // Figure out the dimensions
   const int axis = bottom[0]->CanonicalAxisIndex(
       this->layer_param_.inner_product_param().axis());
+  if (dynamic_cast<SparseBlob<Dtype>*>(bottom[0])) {
+    CHECK_EQ(axis, 1) << "Sparse inputs have shape (num, dim).";
+  }
   const int new_K = bottom[0]->count(axis);
   CHECK_EQ(K_, new_K)
       << "Input size incompatible with inner product parameters.";
@@ -80,8 +88,19 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  const SparseBlob<Dtype>* sparse_bottom =
+      dynamic_cast<const SparseBlob<Dtype>*>(bottom[0]);
+  if (sparse_bottom) {
+    caffe_cpu_csrmm<Dtype>(CblasTrans, M_, N_, K_, (Dtype)1., bottom_data,
+        sparse_bottom->cpu_indices(), sparse_bottom->cpu_ptr(), weight,
+        (Dtype)0., top_data);
+  } else if (half_weight_ && HalfBlob<Dtype>::MemoryBound(M_)) {
+    half_weight_->Update(*this->blobs_[0]);
+    half_weight_->cpu_gemm_trans(M_, N_, K_, bottom_data, top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -93,12 +112,22 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  const SparseBlob<Dtype>* sparse_bottom =
+      dynamic_cast<const SparseBlob<Dtype>*>(bottom[0]);
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
     // Gradient with respect to weight
-    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, N_, K_, M_, (Dtype)1.,
-        top_diff, bottom_data, (Dtype)1., this->blobs_[0]->mutable_cpu_diff());
+    if (sparse_bottom) {
+      // Only the weight columns of the nonzero inputs get gradient.
+      caffe_cpu_gemm_csr<Dtype>(CblasTrans, M_, N_, K_, (Dtype)1.,
+          bottom_data, sparse_bottom->cpu_indices(), sparse_bottom->cpu_ptr(),
+          top_diff, (Dtype)1., this->blobs_[0]->mutable_cpu_diff());
+    } else {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, N_, K_, M_, (Dtype)1.,
+          top_diff, bottom_data, (Dtype)1.,
+          this->blobs_[0]->mutable_cpu_diff());
+    }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
     const Dtype* top_diff = top[0]->cpu_diff();
@@ -108,6 +137,7 @@ void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         this->blobs_[1]->mutable_cpu_diff());
   }
   if (propagate_down[0]) {
+    CHECK(!sparse_bottom) << "Can't backpropagate to a sparse input.";
     const Dtype* top_diff = top[0]->cpu_diff();
     // Gradient with respect to bottom data
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, K_, N_, (Dtype)1.,
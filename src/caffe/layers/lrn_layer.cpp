@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
@@ -5,6 +7,72 @@
 
 namespace caffe {
 
+namespace {
+
+// The spatial positions are normalized across channels in blocks of this
+// many, so that the window sums of a block stay in cache.
+const int kLRNBlockSize = 256;
+
+// Computes y[i] = a[i] * s[i]^-beta, with fast paths for the usual values
+// of beta.
+template <typename Dtype>
+void MulNegativePow(int n, const Dtype* a, const Dtype* s, Dtype beta,
+    Dtype* y) {
+  if (beta == Dtype(0.75)) {
+    for (int i = 0; i < n; ++i) {
+      const Dtype r = 1 / std::sqrt(s[i]);
+      y[i] = a[i] * r * std::sqrt(r);
+    }
+  } else if (beta == Dtype(1)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i] / s[i];
+    }
+  } else if (beta == Dtype(0.5)) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i] / std::sqrt(s[i]);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i] * std::pow(s[i], -beta);
+    }
+  }
+}
+
+// Sums the windows of size (2 * pad + 1) x (2 * pad + 1) of a plane, which is
+// padded with zeros. The sums over rows go to buffer, also the size of a
+// plane.
+template <typename Dtype>
+void WindowSum(int height, int width, int pad, const Dtype* in,
+    Dtype* buffer, Dtype* out) {
+  for (int h = 0; h < height; ++h) {
+    const Dtype* in_row = in + h * width;
+    Dtype* buffer_row = buffer + h * width;
+    for (int w = 0; w < width; ++w) {
+      const int wstart = std::max(w - pad, 0);
+      const int wend = std::min(w + pad + 1, width);
+      Dtype sum = 0;
+      for (int i = wstart; i < wend; ++i) {
+        sum += in_row[i];
+      }
+      buffer_row[w] = sum;
+    }
+  }
+  for (int h = 0; h < height; ++h) {
+    const int hstart = std::max(h - pad, 0);
+    const int hend = std::min(h + pad + 1, height);
+    Dtype* out_row = out + h * width;
+    caffe_copy(width, buffer + hstart * width, out_row);
+    for (int i = hstart + 1; i < hend; ++i) {
+      const Dtype* buffer_row = buffer + i * width;
+      for (int w = 0; w < width; ++w) {
+        out_row[w] += buffer_row[w];
+      }
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -80,6 +148,7 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     scale_.Reshape(num_, channels_, height_, width_);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
+    scale_.Reshape(num_, channels_, height_, width_);
     split_layer_->Reshape(bottom, split_top_vec_);
     square_layer_->Reshape(square_bottom_vec_, square_top_vec_);
     pool_layer_->Reshape(square_top_vec_, pool_top_vec_);
@@ -97,58 +166,61 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     CrossChannelForward_cpu(bottom, top);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelForward(bottom, top);
+    WithinChannelForward_cpu(bottom, top);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
   }
 }
 
+// The scale of each channel is k plus alpha / size times the sum of the
+// squares in its window of channels. It is computed in a single pass over
+// the channels for a block of positions, adding the square of the channel
+// entering the window and subtracting the one leaving it.
 template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelForward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
+  const int spatial_dim = height_ * width_;
+  const Dtype alpha_over_size = alpha_ / size_;
+  Dtype accum[kLRNBlockSize];
   for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+    const Dtype* bottom_n = bottom_data + bottom[0]->offset(n);
+    for (int block = 0; block < spatial_dim; block += kLRNBlockSize) {
+      const int block_size = std::min(kLRNBlockSize, spatial_dim - block);
+      const Dtype* bottom_block = bottom_n + block;
+      std::fill(accum, accum + block_size, Dtype(0));
+      for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+        const Dtype* head = bottom_block + c * spatial_dim;
+        for (int i = 0; i < block_size; ++i) {
+          accum[i] += head[i] * head[i];
+        }
+      }
+      for (int c = 0; c < channels_; ++c) {
+        if (c + pre_pad_ < channels_) {
+          const Dtype* head = bottom_block + (c + pre_pad_) * spatial_dim;
+          for (int i = 0; i < block_size; ++i) {
+            accum[i] += head[i] * head[i];
+          }
+        }
+        if (c - pre_pad_ - 1 >= 0) {
+          const Dtype* tail = bottom_block + (c - pre_pad_ - 1) * spatial_dim;
+          for (int i = 0; i < block_size; ++i) {
+            accum[i] -= tail[i] * tail[i];
+          }
+        }
+        const int offset = scale_.offset(n, c) + block;
+        Dtype* scale = scale_data + offset;
+        for (int i = 0; i < block_size; ++i) {
+          scale[i] = k_ + alpha_over_size * accum[i];
+        }
+        MulNegativePow(block_size, bottom_data + offset, scale, beta_,
+            top_data + offset);
+      }
     }
   }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -161,6 +233,31 @@ void LRNLayer<Dtype>::WithinChannelForward(
   product_layer_->Forward(product_bottom_vec_, top);
 }
 
+// The scale of each position is 1 plus alpha / size^2 times the sum of the
+// squares in its window, as computed on the GPU by the internal layers.
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* scale_data = scale_.mutable_cpu_data();
+  const int spatial_dim = height_ * width_;
+  const Dtype alpha_over_size = alpha_ / (size_ * size_);
+  vector<Dtype> square(spatial_dim), buffer(spatial_dim);
+  for (int i = 0; i < num_ * channels_; ++i) {
+    const int offset = i * spatial_dim;
+    caffe_sqr(spatial_dim, bottom_data + offset, &square[0]);
+    WindowSum(height_, width_, pre_pad_, &square[0], &buffer[0],
+        scale_data + offset);
+    Dtype* scale = scale_data + offset;
+    for (int j = 0; j < spatial_dim; ++j) {
+      scale[j] = 1 + alpha_over_size * scale[j];
+    }
+    MulNegativePow(spatial_dim, bottom_data + offset, scale, beta_,
+        top_data + offset);
+  }
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
@@ -169,7 +266,7 @@ void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     CrossChannelBackward_cpu(top, propagate_down, bottom);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelBackward(top, propagate_down, bottom);
+    WithinChannelBackward_cpu(top, propagate_down, bottom);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
@@ -194,8 +291,7 @@ void LRNLayer<Dtype>::CrossChannelBackward_cpu(
   caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
   Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
 
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
+  MulNegativePow(scale_.count(), top_diff, scale_data, beta_, bottom_diff);
 
   // go through individual data
   int inverse_pre_pad = size_ - (size_ + 1) / 2;
@@ -246,6 +342,39 @@ void LRNLayer<Dtype>::WithinChannelBackward(
   }
 }
 
+// With y = x s^-beta, the diff of x_j is dy_j s_j^-beta minus
+// 2 alpha beta / size^2 x_j times the sum of dy_i y_i / s_i over the window
+// of j.
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelBackward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* top_data = top[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* scale_data = scale_.cpu_data();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int spatial_dim = height_ * width_;
+  const Dtype cache_ratio_value = 2 * alpha_ * beta_ / (size_ * size_);
+  vector<Dtype> ratio(spatial_dim), buffer(spatial_dim);
+  MulNegativePow(scale_.count(), top_diff, scale_data, beta_, bottom_diff);
+  for (int i = 0; i < num_ * channels_; ++i) {
+    const int offset = i * spatial_dim;
+    for (int j = 0; j < spatial_dim; ++j) {
+      ratio[j] = top_diff[offset + j] * top_data[offset + j]
+          / scale_data[offset + j];
+    }
+    WindowSum(height_, width_, pre_pad_, &ratio[0], &buffer[0], &ratio[0]);
+    for (int j = 0; j < spatial_dim; ++j) {
+      bottom_diff[offset + j] -=
+          cache_ratio_value * bottom_data[offset + j] * ratio[j];
+    }
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(LRNLayer);
 STUB_GPU_FORWARD(LRNLayer, CrossChannelForward);
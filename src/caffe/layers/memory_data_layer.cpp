@@ -2,12 +2,263 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <stdint.h>
+
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <vector>
 
+#include "caffe/data_transformer.hpp"
 #include "caffe/layers/memory_data_layer.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+// The bounded queue of the streaming mode, as a ring buffer of samples.
+// Samples are pushed at tail_, taken by the transform threads at
+// next_transform_ and output at head_, which count the samples since the
+// start, so the samples of a batch are ready from head_ on. Once closed_, Push
+// and Pop return false, and the destructor waits for the threads still in them.
+template <typename Dtype>
+class MemoryDataLayer<Dtype>::Stream {
+ public:
+  Stream(MemoryDataLayer<Dtype>* layer, int capacity, int num_threads);
+  ~Stream();
+
+  // Pushes datum, mat or data, whichever isn't NULL, setting id if not NULL.
+  bool Push(const Datum* datum, const void* mat, const Dtype* data,
+      Dtype label, uint64_t* id);
+  // Waits for a batch of up to batch_size samples, as described in the
+  // class, and outputs it.
+  bool Pop(int batch_size, int timeout_ms, Blob<Dtype>* data,
+      Blob<Dtype>* labels, vector<uint64_t>* ids);
+  void Close();
+
+ protected:
+  struct Slot {
+    Slot() : ready(false), has_datum(false) {}
+    bool ready;
+    bool has_datum;
+    Datum datum;
+#ifdef USE_OPENCV
+    cv::Mat mat;
+#endif  // USE_OPENCV
+    Dtype label;
+  };
+
+  void TransformEntry(DataTransformer<Dtype>* transformer);
+  // Number of ready samples from head_ on, up to batch_size.
+  int NumReady(int batch_size) const;
+  // Ends a Push or Pop, with mutex_ held.
+  void Leave();
+
+  const int capacity_;
+  const int channels_, height_, width_, size_;
+  vector<Slot> slots_;
+  Blob<Dtype> data_;
+  Dtype* buffer_;
+  uint64_t head_;
+  uint64_t next_transform_;
+  uint64_t tail_;
+  bool closed_;
+  // Number of threads in Push or Pop.
+  int callers_;
+  bool stop_;
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  boost::mutex mutex_;
+  boost::condition_variable not_full_;
+  boost::condition_variable pushed_;
+  boost::condition_variable ready_;
+  boost::condition_variable idle_;
+  boost::thread_group threads_;
+};
+
+template <typename Dtype>
+MemoryDataLayer<Dtype>::Stream::Stream(MemoryDataLayer<Dtype>* layer,
+    int capacity, int num_threads)
+    : capacity_(capacity), channels_(layer->channels_),
+      height_(layer->height_), width_(layer->width_), size_(layer->size_),
+      slots_(capacity), data_(capacity, layer->channels_, layer->height_,
+      layer->width_), head_(0), next_transform_(0), tail_(0), closed_(false),
+      callers_(0), stop_(false) {
+  CHECK_GT(num_threads, 0);
+  buffer_ = data_.mutable_cpu_data();
+  // Each thread has its own transformer, all drawing from one random stream
+  // at the sample's id, so the augmentation doesn't depend on the threads.
+  const uint64_t key = Philox::RandomKey();
+  for (int i = 0; i < num_threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(layer->transform_param_, layer->phase_)));
+    transformers_[i]->InitRand(key);
+    threads_.create_thread(boost::bind(&Stream::TransformEntry, this,
+        transformers_[i].get()));
+  }
+}
+
+template <typename Dtype>
+MemoryDataLayer<Dtype>::Stream::~Stream() {
+  Close();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (callers_ > 0) {
+      idle_.wait(lock);
+    }
+    stop_ = true;
+  }
+  pushed_.notify_all();
+  threads_.join_all();
+}
+
+template <typename Dtype>
+void MemoryDataLayer<Dtype>::Stream::Close() {
+  boost::mutex::scoped_lock lock(mutex_);
+  closed_ = true;
+  not_full_.notify_all();
+  ready_.notify_all();
+}
+
+template <typename Dtype>
+void MemoryDataLayer<Dtype>::Stream::Leave() {
+  if (--callers_ == 0 && closed_) {
+    idle_.notify_all();
+  }
+}
+
+template <typename Dtype>
+bool MemoryDataLayer<Dtype>::Stream::Push(const Datum* datum,
+    const void* mat, const Dtype* data, Dtype label, uint64_t* id) {
+  boost::mutex::scoped_lock lock(mutex_);
+  ++callers_;
+  while (!closed_ && tail_ - head_ == capacity_) {
+    not_full_.wait(lock);
+  }
+  if (closed_) {
+    Leave();
+    return false;
+  }
+  const uint64_t sample_id = tail_++;
+  Slot& slot = slots_[sample_id % capacity_];
+  slot.label = label;
+  if (data) {
+    std::copy(data, data + size_, buffer_ + (sample_id % capacity_) * size_);
+    slot.ready = true;
+    if (next_transform_ == sample_id) {
+      ++next_transform_;
+    }
+    ready_.notify_all();
+  } else if (datum) {
+    slot.datum = *datum;
+    slot.has_datum = true;
+  } else {
+#ifdef USE_OPENCV
+    slot.mat = static_cast<const cv::Mat*>(mat)->clone();
+#endif  // USE_OPENCV
+  }
+  pushed_.notify_one();
+  if (id) {
+    *id = sample_id;
+  }
+  Leave();
+  return true;
+}
+
+template <typename Dtype>
+void MemoryDataLayer<Dtype>::Stream::TransformEntry(
+    DataTransformer<Dtype>* transformer) {
+  Blob<Dtype> sample(1, channels_, height_, width_);
+  boost::mutex::scoped_lock lock(mutex_);
+  while (true) {
+    while (!stop_ && next_transform_ == tail_) {
+      pushed_.wait(lock);
+    }
+    if (stop_) {
+      return;
+    }
+    const uint64_t id = next_transform_++;
+    const int index = id % capacity_;
+    Slot& slot = slots_[index];
+    // Samples pushed transformed are ready as they come, and may already
+    // have been output, their slot holding a later sample by now.
+    if (id < head_ || slot.ready) {
+      continue;
+    }
+    // The slot is this thread's until it is ready.
+    lock.unlock();
+    sample.set_cpu_data(buffer_ + index * size_);
+    transformer->SeekRand(id);
+    if (slot.has_datum) {
+      transformer->Transform(slot.datum, &sample);
+    } else {
+#ifdef USE_OPENCV
+      transformer->Transform(slot.mat, &sample);
+#endif  // USE_OPENCV
+    }
+    lock.lock();
+    slot.ready = true;
+    ready_.notify_all();
+  }
+}
+
+template <typename Dtype>
+int MemoryDataLayer<Dtype>::Stream::NumReady(int batch_size) const {
+  int num_ready = 0;
+  while (num_ready < batch_size && head_ + num_ready < tail_ &&
+      slots_[(head_ + num_ready) % capacity_].ready) {
+    ++num_ready;
+  }
+  return num_ready;
+}
+
+template <typename Dtype>
+bool MemoryDataLayer<Dtype>::Stream::Pop(int batch_size, int timeout_ms,
+    Blob<Dtype>* data, Blob<Dtype>* labels, vector<uint64_t>* ids) {
+  CHECK_LE(batch_size, capacity_) << "The batch can't exceed the queue.";
+  boost::mutex::scoped_lock lock(mutex_);
+  ++callers_;
+  while (!closed_ && NumReady(1) == 0) {
+    ready_.wait(lock);
+  }
+  if (timeout_ms > 0) {
+    const boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::milliseconds(timeout_ms);
+    while (!closed_ && NumReady(batch_size) < batch_size &&
+        ready_.timed_wait(lock, deadline)) {}
+  } else {
+    while (!closed_ && NumReady(batch_size) < batch_size) {
+      ready_.wait(lock);
+    }
+  }
+  if (closed_) {
+    Leave();
+    return false;
+  }
+  const int num = NumReady(batch_size);
+  // The slots from head_ on aren't modified until head_ moves past them.
+  lock.unlock();
+  data->Reshape(num, channels_, height_, width_);
+  labels->Reshape(num, 1, 1, 1);
+  Dtype* top_data = data->mutable_cpu_data();
+  Dtype* top_label = labels->mutable_cpu_data();
+  ids->resize(num);
+  for (int i = 0; i < num; ++i) {
+    const int index = (head_ + i) % capacity_;
+    std::copy(buffer_ + index * size_, buffer_ + (index + 1) * size_,
+        top_data + i * size_);
+    top_label[i] = slots_[index].label;
+    (*ids)[i] = head_ + i;
+  }
+  lock.lock();
+  for (int i = 0; i < num; ++i) {
+    Slot& slot = slots_[(head_ + i) % capacity_];
+    slot.ready = false;
+    slot.has_datum = false;
+  }
+  head_ += num;
+  not_full_.notify_all();
+  Leave();
+  return true;
+}
+
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
      const vector<Blob<Dtype>*>& top) {
@@ -28,10 +279,51 @@ void MemoryDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   labels_ = NULL;
   added_data_.cpu_data();
   added_label_.cpu_data();
+  const MemoryDataParameter& param = this->layer_param_.memory_data_param();
+  if (param.streaming()) {
+    const int capacity = param.queue_capacity() > 0 ?
+        param.queue_capacity() : 4 * batch_size_;
+    CHECK_GE(capacity, batch_size_) << "queue_capacity must hold a batch.";
+    stream_.reset(new Stream(this, capacity, param.num_transform_threads()));
+  } else {
+    stream_.reset();
+  }
+}
+
+template <typename Dtype>
+MemoryDataLayer<Dtype>::~MemoryDataLayer() {}
+
+template <typename Dtype>
+bool MemoryDataLayer<Dtype>::PushDatum(const Datum& datum, uint64_t* id) {
+  CHECK(stream_) << "PushDatum needs memory_data_param.streaming.";
+  return stream_->Push(&datum, NULL, NULL, datum.label(), id);
+}
+
+#ifdef USE_OPENCV
+template <typename Dtype>
+bool MemoryDataLayer<Dtype>::PushMat(const cv::Mat& mat, int label,
+    uint64_t* id) {
+  CHECK(stream_) << "PushMat needs memory_data_param.streaming.";
+  return stream_->Push(NULL, &mat, NULL, label, id);
+}
+#endif  // USE_OPENCV
+
+template <typename Dtype>
+bool MemoryDataLayer<Dtype>::PushData(const Dtype* data, Dtype label,
+    uint64_t* id) {
+  CHECK(stream_) << "PushData needs memory_data_param.streaming.";
+  return stream_->Push(NULL, NULL, data, label, id);
+}
+
+template <typename Dtype>
+void MemoryDataLayer<Dtype>::CloseStream() {
+  CHECK(stream_) << "CloseStream needs memory_data_param.streaming.";
+  stream_->Close();
 }
 
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::AddDatumVector(const vector<Datum>& datum_vector) {
+  CHECK(!stream_) << "Use PushDatum in streaming mode.";
   CHECK(!has_new_data_) <<
       "Can't add data until current data has been consumed.";
   size_t num = datum_vector.size();
@@ -58,6 +350,7 @@ template <typename Dtype>
 void MemoryDataLayer<Dtype>::AddMatVector(const vector<cv::Mat>& mat_vector,
     const vector<int>& labels) {
   size_t num = mat_vector.size();
+  CHECK(!stream_) << "Use PushMat in streaming mode.";
   CHECK(!has_new_data_) <<
       "Can't add mat until current data has been consumed.";
   CHECK_GT(num, 0) << "There is no mat to add";
@@ -81,6 +374,7 @@ void MemoryDataLayer<Dtype>::AddMatVector(const vector<cv::Mat>& mat_vector,
 
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::Reset(Dtype* data, Dtype* labels, int n) {
+  CHECK(!stream_) << "Use PushData in streaming mode.";
   CHECK(data);
   CHECK(labels);
   CHECK_EQ(n % batch_size_, 0) << "n must be a multiple of batch size";
@@ -107,6 +401,14 @@ void MemoryDataLayer<Dtype>::set_batch_size(int new_size) {
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (stream_) {
+    if (!stream_->Pop(batch_size_,
+        this->layer_param_.memory_data_param().batch_timeout_ms(),
+        top[0], top[1], &batch_ids_)) {
+      batch_ids_.clear();
+    }
+    return;
+  }
   CHECK(data_) << "MemoryDataLayer needs to be initalized by calling Reset";
   top[0]->Reshape(batch_size_, channels_, height_, width_);
   top[1]->Reshape(batch_size_, 1, 1, 1);
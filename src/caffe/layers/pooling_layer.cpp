@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -122,101 +123,375 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+namespace {
+
+// The pooling windows of one channel.
+struct PoolGeometry {
+  int height, width;
+  int pooled_height, pooled_width;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+};
+
+// Sets [begin, end) to the outputs along one axis whose windows lie inside
+// the input, so that they need no clipping.
+inline void InteriorRange(int size, int pad, int kernel, int stride,
+    int pooled, int* begin, int* end) {
+  *begin = min((pad + stride - 1) / stride, pooled);
+  *end = size + pad >= kernel ?
+      min((size + pad - kernel) / stride + 1, pooled) : 0;
+  *end = max(*end, *begin);
+}
+
+// Max pools the window of output (ph, pw) of one channel. The first maximum
+// in row-major order wins, and the index stays -1 if no value exceeds
+// -FLT_MAX. The mask is not written if NULL.
+template <typename Dtype, typename MaskT>
+inline void MaxPoolWindow(const PoolGeometry& g, const Dtype* bottom,
+    int ph, int pw, Dtype* top, MaskT* mask) {
+  int hstart = ph * g.stride_h - g.pad_h;
+  int wstart = pw * g.stride_w - g.pad_w;
+  const int hend = min(hstart + g.kernel_h, g.height);
+  const int wend = min(wstart + g.kernel_w, g.width);
+  hstart = max(hstart, 0);
+  wstart = max(wstart, 0);
+  Dtype max_value = -FLT_MAX;
+  int max_index = -1;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      const int index = h * g.width + w;
+      if (bottom[index] > max_value) {
+        max_value = bottom[index];
+        max_index = index;
+      }
+    }
+  }
+  const int pool_index = ph * g.pooled_width + pw;
+  top[pool_index] = max_value;
+  if (mask) {
+    mask[pool_index] = static_cast<MaskT>(max_index);
+  }
+}
+
+// Max pools one channel with a KxK kernel and stride S. The windows inside
+// the input are unrolled, and the outputs of a row are independent, so the
+// compiler can vectorize along the row; only the borders take the general
+// path. The result is the same as the general path's.
+template <typename Dtype, typename MaskT, int K, int S>
+void MaxPoolChannel(const PoolGeometry& g, const Dtype* bottom, Dtype* top,
+    MaskT* mask) {
+  int ph_begin, ph_end, pw_begin, pw_end;
+  InteriorRange(g.height, g.pad_h, K, S, g.pooled_height, &ph_begin, &ph_end);
+  InteriorRange(g.width, g.pad_w, K, S, g.pooled_width, &pw_begin, &pw_end);
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    if (ph < ph_begin || ph >= ph_end) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        MaxPoolWindow(g, bottom, ph, pw, top, mask);
+      }
+      continue;
+    }
+    for (int pw = 0; pw < pw_begin; ++pw) {
+      MaxPoolWindow(g, bottom, ph, pw, top, mask);
+    }
+    const int hstart = ph * S - g.pad_h;
+    Dtype* top_row = top + ph * g.pooled_width;
+    MaskT* mask_row = mask ? mask + ph * g.pooled_width : NULL;
+    for (int pw = pw_begin; pw < pw_end; ++pw) {
+      const int start = hstart * g.width + pw * S - g.pad_w;
+      Dtype max_value = -FLT_MAX;
+      int max_index = -1;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          const int index = start + kh * g.width + kw;
+          if (bottom[index] > max_value) {
+            max_value = bottom[index];
+            max_index = index;
+          }
+        }
+      }
+      top_row[pw] = max_value;
+      if (mask_row) {
+        mask_row[pw] = static_cast<MaskT>(max_index);
+      }
+    }
+    for (int pw = pw_end; pw < g.pooled_width; ++pw) {
+      MaxPoolWindow(g, bottom, ph, pw, top, mask);
+    }
+  }
+}
+
+// Max pools one channel over the whole input.
+template <typename Dtype, typename MaskT>
+void GlobalMaxPoolChannel(const PoolGeometry& g, const Dtype* bottom,
+    Dtype* top, MaskT* mask) {
+  const int count = g.height * g.width;
+  Dtype max_value = -FLT_MAX;
+  int max_index = -1;
+  for (int i = 0; i < count; ++i) {
+    if (bottom[i] > max_value) {
+      max_value = bottom[i];
+      max_index = i;
+    }
+  }
+  top[0] = max_value;
+  if (mask) {
+    mask[0] = static_cast<MaskT>(max_index);
+  }
+}
+
+// Max pools num channels of bottom into top, writing the argmax of each
+// output to mask unless it is NULL.
+template <typename Dtype, typename MaskT>
+void MaxPool(const PoolGeometry& g, bool global_pooling, int num,
+    const Dtype* bottom, Dtype* top, MaskT* mask) {
+  const int bottom_offset = g.height * g.width;
+  const int top_offset = g.pooled_height * g.pooled_width;
+  const bool square = g.kernel_h == g.kernel_w && g.stride_h == g.stride_w;
+  for (int c = 0; c < num; ++c) {
+    MaskT* channel_mask = mask ? mask + c * top_offset : NULL;
+    if (global_pooling) {
+      GlobalMaxPoolChannel(g, bottom, top, channel_mask);
+    } else if (square && g.kernel_h == 2 && g.stride_h == 2) {
+      MaxPoolChannel<Dtype, MaskT, 2, 2>(g, bottom, top, channel_mask);
+    } else if (square && g.kernel_h == 3 && g.stride_h == 2) {
+      MaxPoolChannel<Dtype, MaskT, 3, 2>(g, bottom, top, channel_mask);
+    } else {
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw) {
+          MaxPoolWindow(g, bottom, ph, pw, top, channel_mask);
+        }
+      }
+    }
+    bottom += bottom_offset;
+    top += top_offset;
+  }
+}
+
+// Average pools the window of output (ph, pw) of one channel. Padding counts
+// toward the size of the window.
 template <typename Dtype>
-void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
-  // We'll output the mask to top[1] if it's of size >1.
-  const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
-  Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
-  switch (this->layer_param_.pooling_param().pool()) {
-  case PoolingParameter_PoolMethod_MAX:
-    // Initialize
-    if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
+inline void AvePoolWindow(const PoolGeometry& g, const Dtype* bottom,
+    int ph, int pw, Dtype* top) {
+  int hstart = ph * g.stride_h - g.pad_h;
+  int wstart = pw * g.stride_w - g.pad_w;
+  int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+  int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+  const int pool_size = (hend - hstart) * (wend - wstart);
+  hstart = max(hstart, 0);
+  wstart = max(wstart, 0);
+  hend = min(hend, g.height);
+  wend = min(wend, g.width);
+  Dtype sum = 0;
+  for (int h = hstart; h < hend; ++h) {
+    for (int w = wstart; w < wend; ++w) {
+      sum += bottom[h * g.width + w];
+    }
+  }
+  top[ph * g.pooled_width + pw] = sum / pool_size;
+}
+
+// Average pools one channel with a KxK kernel and stride S, like
+// MaxPoolChannel. The sums are taken in the same order as the general path,
+// so the result is the same.
+template <typename Dtype, int K, int S>
+void AvePoolChannel(const PoolGeometry& g, const Dtype* bottom, Dtype* top) {
+  int ph_begin, ph_end, pw_begin, pw_end;
+  InteriorRange(g.height, g.pad_h, K, S, g.pooled_height, &ph_begin, &ph_end);
+  InteriorRange(g.width, g.pad_w, K, S, g.pooled_width, &pw_begin, &pw_end);
+  const Dtype pool_size = K * K;
+  for (int ph = 0; ph < g.pooled_height; ++ph) {
+    if (ph < ph_begin || ph >= ph_end) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        AvePoolWindow(g, bottom, ph, pw, top);
+      }
+      continue;
+    }
+    for (int pw = 0; pw < pw_begin; ++pw) {
+      AvePoolWindow(g, bottom, ph, pw, top);
+    }
+    const Dtype* bottom_row = bottom + (ph * S - g.pad_h) * g.width;
+    Dtype* top_row = top + ph * g.pooled_width;
+    for (int pw = pw_begin; pw < pw_end; ++pw) {
+      const int wstart = pw * S - g.pad_w;
+      Dtype sum = 0;
+      for (int kh = 0; kh < K; ++kh) {
+        for (int kw = 0; kw < K; ++kw) {
+          sum += bottom_row[kh * g.width + wstart + kw];
+        }
+      }
+      top_row[pw] = sum / pool_size;
+    }
+    for (int pw = pw_end; pw < g.pooled_width; ++pw) {
+      AvePoolWindow(g, bottom, ph, pw, top);
+    }
+  }
+}
+
+// Average pools num channels of bottom into top.
+template <typename Dtype>
+void AvePool(const PoolGeometry& g, bool global_pooling, int num,
+    const Dtype* bottom, Dtype* top) {
+  const int bottom_offset = g.height * g.width;
+  const int top_offset = g.pooled_height * g.pooled_width;
+  const bool square = g.kernel_h == g.kernel_w && g.stride_h == g.stride_w;
+  for (int c = 0; c < num; ++c) {
+    if (global_pooling) {
+      Dtype sum = 0;
+      for (int i = 0; i < bottom_offset; ++i) {
+        sum += bottom[i];
+      }
+      top[0] = sum / bottom_offset;
+    } else if (square && g.kernel_h == 2 && g.stride_h == 2) {
+      AvePoolChannel<Dtype, 2, 2>(g, bottom, top);
+    } else if (square && g.kernel_h == 3 && g.stride_h == 2) {
+      AvePoolChannel<Dtype, 3, 2>(g, bottom, top);
     } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
+      for (int ph = 0; ph < g.pooled_height; ++ph) {
+        for (int pw = 0; pw < g.pooled_width; ++pw) {
+          AvePoolWindow(g, bottom, ph, pw, top);
+        }
+      }
     }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
+    bottom += bottom_offset;
+    top += top_offset;
+  }
+}
+
+// Max pools num blocks of channels in the blocked layout, a block of
+// channels of each window at a time, as MaxPoolWindow does one channel.
+template <typename Dtype>
+void MaxPoolBlocked(const PoolGeometry& g, int num, const Dtype* bottom,
+    Dtype* top) {
+  const int bottom_offset = g.height * g.width * kChannelBlock;
+  const int top_offset = g.pooled_height * g.pooled_width * kChannelBlock;
+  for (int b = 0; b < num; ++b) {
+    for (int ph = 0; ph < g.pooled_height; ++ph) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        int hstart = ph * g.stride_h - g.pad_h;
+        int wstart = pw * g.stride_w - g.pad_w;
+        const int hend = min(hstart + g.kernel_h, g.height);
+        const int wend = min(wstart + g.kernel_w, g.width);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        Dtype* max_value = top + (ph * g.pooled_width + pw) * kChannelBlock;
+        for (int c = 0; c < kChannelBlock; ++c) {
+          max_value[c] = -FLT_MAX;
+        }
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* value = bottom + (h * g.width + w) * kChannelBlock;
+            for (int c = 0; c < kChannelBlock; ++c) {
+              max_value[c] = value[c] > max_value[c] ? value[c] : max_value[c];
             }
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
       }
     }
-    break;
-  case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
+    bottom += bottom_offset;
+    top += top_offset;
+  }
+}
+
+// Average pools num blocks of channels in the blocked layout, like
+// AvePoolWindow and in the same order, so the result is the same.
+template <typename Dtype>
+void AvePoolBlocked(const PoolGeometry& g, int num, const Dtype* bottom,
+    Dtype* top) {
+  const int bottom_offset = g.height * g.width * kChannelBlock;
+  const int top_offset = g.pooled_height * g.pooled_width * kChannelBlock;
+  for (int b = 0; b < num; ++b) {
+    for (int ph = 0; ph < g.pooled_height; ++ph) {
+      for (int pw = 0; pw < g.pooled_width; ++pw) {
+        int hstart = ph * g.stride_h - g.pad_h;
+        int wstart = pw * g.stride_w - g.pad_w;
+        int hend = min(hstart + g.kernel_h, g.height + g.pad_h);
+        int wend = min(wstart + g.kernel_w, g.width + g.pad_w);
+        const int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, g.height);
+        wend = min(wend, g.width);
+        Dtype sum[kChannelBlock] = {0};
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* value = bottom + (h * g.width + w) * kChannelBlock;
+            for (int c = 0; c < kChannelBlock; ++c) {
+              sum[c] += value[c];
             }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
+        Dtype* average = top + (ph * g.pooled_width + pw) * kChannelBlock;
+        for (int c = 0; c < kChannelBlock; ++c) {
+          average[c] = sum[c] / pool_size;
+        }
       }
     }
+    bottom += bottom_offset;
+    top += top_offset;
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const PoolGeometry geometry = {height_, width_, pooled_height_,
+      pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_, pad_h_,
+      pad_w_};
+  const int num = bottom[0]->num() * channels_;
+  if (!this->blocked_bottoms_.empty()) {
+    // Pool in the blocked layout, converting the bottom and top if they are
+    // not in it.
+    const int blocks = bottom[0]->num() * channel_blocks(channels_);
+    const Dtype* blocked_bottom = bottom_data;
+    if (!this->blocked_bottoms_[0]) {
+      blocked_bottom_.Reshape(vector<int>(1,
+          blocks * kChannelBlock * height_ * width_));
+      caffe_cpu_to_blocked(bottom[0]->num(), channels_, height_ * width_,
+          bottom_data, blocked_bottom_.mutable_cpu_data());
+      blocked_bottom = blocked_bottom_.cpu_data();
+    }
+    Dtype* blocked_top = top_data;
+    if (!this->blocked_tops_[0]) {
+      blocked_top_.Reshape(vector<int>(1,
+          blocks * kChannelBlock * pooled_height_ * pooled_width_));
+      blocked_top = blocked_top_.mutable_cpu_data();
+    }
+    if (this->layer_param_.pooling_param().pool() ==
+        PoolingParameter_PoolMethod_MAX) {
+      MaxPoolBlocked(geometry, blocks, blocked_bottom, blocked_top);
+    } else {
+      AvePoolBlocked(geometry, blocks, blocked_bottom, blocked_top);
+    }
+    if (!this->blocked_tops_[0]) {
+      caffe_cpu_from_blocked(bottom[0]->num(), channels_,
+          pooled_height_ * pooled_width_, blocked_top, top_data);
+    }
+    return;
+  }
+  // Different pooling methods. We explicitly do the switch outside the for
+  // loop to save time, although this results in more code.
+  switch (this->layer_param_.pooling_param().pool()) {
+  case PoolingParameter_PoolMethod_MAX:
+    // We'll output the mask to top[1] if it's of size >1. Otherwise the mask
+    // is only needed for Backward, so it is skipped in the TEST phase.
+    if (top.size() > 1) {
+      MaxPool(geometry, global_pooling_, num, bottom_data, top_data,
+          top[1]->mutable_cpu_data());
+    } else if (this->phase_ == TEST) {
+      MaxPool(geometry, global_pooling_, num, bottom_data, top_data,
+          static_cast<int*>(NULL));
+    } else {
+      MaxPool(geometry, global_pooling_, num, bottom_data, top_data,
+          max_idx_.mutable_cpu_data());
+    }
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    AvePool(geometry, global_pooling_, num, bottom_data, top_data);
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -232,6 +507,8 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  CHECK(this->blocked_bottoms_.empty())
+      << "Backward is not implemented in the blocked layout.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
@@ -247,6 +524,15 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
+      if (this->phase_ == TEST) {
+        // Forward skipped the mask; work it out again.
+        const PoolGeometry geometry = {height_, width_, pooled_height_,
+            pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_,
+            pad_h_, pad_w_};
+        vector<Dtype> pooled(top[0]->count());
+        MaxPool(geometry, global_pooling_, top[0]->num() * channels_,
+            bottom[0]->cpu_data(), &pooled[0], max_idx_.mutable_cpu_data());
+      }
       mask = max_idx_.cpu_data();
     }
     for (int n = 0; n < top[0]->num(); ++n) {
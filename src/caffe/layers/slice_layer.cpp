@@ -69,6 +69,16 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+  } else if (this->share_views_ && num_slices_ == 1) {
+    // The tops lie one after the other in the bottom, so they can be views
+    // of it, making the copies of Forward and Backward no-ops.
+    int offset = 0;
+    for (int i = 0; i < top.size(); ++i) {
+      if (top[i]->count() > 0 && !top[i]->IsViewOf(*bottom[0], offset)) {
+        top[i]->ShareView(*bottom[0], offset);
+      }
+      offset += top[i]->count();
+    }
   }
 }
 
@@ -82,6 +92,7 @@ void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < top.size(); ++i) {
     Dtype* top_data = top[i]->mutable_cpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    // caffe_copy does nothing for a top which is a view of the bottom.
     for (int n = 0; n < num_slices_; ++n) {
       const int top_offset = n * top_slice_axis * slice_size_;
       const int bottom_offset =
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/softmax_layer.hpp"
@@ -12,10 +13,6 @@ void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   softmax_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.softmax_param().axis());
   top[0]->ReshapeLike(*bottom[0]);
-  vector<int> mult_dims(1, bottom[0]->shape(softmax_axis_));
-  sum_multiplier_.Reshape(mult_dims);
-  Dtype* multiplier_data = sum_multiplier_.mutable_cpu_data();
-  caffe_set(sum_multiplier_.count(), Dtype(1), multiplier_data);
   outer_num_ = bottom[0]->count(0, softmax_axis_);
   inner_num_ = bottom[0]->count(softmax_axis_ + 1);
   vector<int> scale_dims = bottom[0]->shape();
@@ -23,6 +20,10 @@ void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   scale_.Reshape(scale_dims);
 }
 
+// Each softmax is computed in three fused passes over its inputs, which stay
+// in cache: the max, the exponentials of the inputs minus the max with their
+// sum, and the normalization. When inner_num_ > 1, the softmaxes of the
+// inner positions run side by side, vectorized over the positions.
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -31,34 +32,46 @@ void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* scale_data = scale_.mutable_cpu_data();
   int channels = bottom[0]->shape(softmax_axis_);
   int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
   for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
+    const Dtype* x = bottom_data + i * dim;
+    Dtype* y = top_data + i * dim;
+    if (inner_num_ == 1) {
+      caffe_cpu_softmax(channels, x, y);
+      continue;
+    }
+    // We need to subtract the max to avoid numerical issues, compute the
+    // exp, and then normalize.
+    caffe_copy(inner_num_, x, scale_data);
+    for (int j = 1; j < channels; ++j) {
+      const Dtype* x_j = x + j * inner_num_;
+      for (int k = 0; k < inner_num_; ++k) {
+        scale_data[k] = std::max(scale_data[k], x_j[k]);
+      }
+    }
+    for (int j = 0; j < channels; ++j) {
+      const Dtype* x_j = x + j * inner_num_;
+      Dtype* y_j = y + j * inner_num_;
+      for (int k = 0; k < inner_num_; ++k) {
+        y_j[k] = std::exp(x_j[k] - scale_data[k]);
       }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
+    // The max is not needed anymore: sum into scale_ instead.
+    caffe_copy(inner_num_, y, scale_data);
+    for (int j = 1; j < channels; ++j) {
+      caffe_axpy(inner_num_, Dtype(1), y + j * inner_num_, scale_data);
+    }
+    for (int k = 0; k < inner_num_; ++k) {
+      scale_data[k] = Dtype(1) / scale_data[k];
+    }
+    for (int j = 0; j < channels; ++j) {
+      caffe_mul(inner_num_, y + j * inner_num_, scale_data,
+          y + j * inner_num_);
     }
   }
 }
 
+// The bottom diff is (top_diff - dot(top_diff, top_data)) * top_data, with
+// the dot product taken along the softmax axis.
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
@@ -69,20 +82,34 @@ void SoftmaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   Dtype* scale_data = scale_.mutable_cpu_data();
   int channels = top[0]->shape(softmax_axis_);
   int dim = top[0]->count() / outer_num_;
-  caffe_copy(top[0]->count(), top_diff, bottom_diff);
   for (int i = 0; i < outer_num_; ++i) {
-    // compute dot(top_diff, top_data) and subtract them from the bottom diff
-    for (int k = 0; k < inner_num_; ++k) {
-      scale_data[k] = caffe_cpu_strided_dot<Dtype>(channels,
-          bottom_diff + i * dim + k, inner_num_,
-          top_data + i * dim + k, inner_num_);
+    const Dtype* dy = top_diff + i * dim;
+    const Dtype* y = top_data + i * dim;
+    Dtype* dx = bottom_diff + i * dim;
+    if (inner_num_ == 1) {
+      const Dtype dot = caffe_cpu_dot(channels, dy, y);
+      for (int j = 0; j < channels; ++j) {
+        dx[j] = (dy[j] - dot) * y[j];
+      }
+      continue;
+    }
+    caffe_mul(inner_num_, dy, y, scale_data);
+    for (int j = 1; j < channels; ++j) {
+      const Dtype* dy_j = dy + j * inner_num_;
+      const Dtype* y_j = y + j * inner_num_;
+      for (int k = 0; k < inner_num_; ++k) {
+        scale_data[k] += dy_j[k] * y_j[k];
+      }
+    }
+    for (int j = 0; j < channels; ++j) {
+      const Dtype* dy_j = dy + j * inner_num_;
+      const Dtype* y_j = y + j * inner_num_;
+      Dtype* dx_j = dx + j * inner_num_;
+      for (int k = 0; k < inner_num_; ++k) {
+        dx_j[k] = (dy_j[k] - scale_data[k]) * y_j[k];
+      }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_, 1,
-        -1., sum_multiplier_.cpu_data(), scale_data, 1., bottom_diff + i * dim);
   }
-  // elementwise multiplication
-  caffe_mul(top[0]->count(), bottom_diff, top_data, bottom_diff);
 }
 
 
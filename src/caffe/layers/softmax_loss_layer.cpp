@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <cfloat>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/softmax_loss_layer.hpp"
@@ -13,6 +14,7 @@ void SoftmaxWithLossLayer<Dtype>::LayerSetUp(
   LossLayer<Dtype>::LayerSetUp(bottom, top);
   LayerParameter softmax_param(this->layer_param_);
   softmax_param.set_type("Softmax");
+  softmax_param.clear_loss_weight();
   softmax_layer_ = LayerRegistry<Dtype>::CreateLayer(softmax_param);
   softmax_bottom_vec_.clear();
   softmax_bottom_vec_.push_back(bottom[0]);
@@ -44,6 +46,8 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
       bottom[0]->CanonicalAxisIndex(this->layer_param_.softmax_param().axis());
   outer_num_ = bottom[0]->count(0, softmax_axis_);
   inner_num_ = bottom[0]->count(softmax_axis_ + 1);
+  max_.Reshape(vector<int>(1, inner_num_));
+  sum_.Reshape(vector<int>(1, inner_num_));
   CHECK_EQ(outer_num_ * inner_num_, bottom[1]->count())
       << "Number of labels must match number of predictions; "
       << "e.g., if softmax axis == 1 and prediction shape is (N, C, H, W), "
@@ -85,27 +89,72 @@ Dtype SoftmaxWithLossLayer<Dtype>::get_normalizer(
   return std::max(Dtype(1.0), normalizer);
 }
 
+// The softmax and the loss are computed in the same passes over each sample
+// as in SoftmaxLayer: the max, the exponentials of the inputs minus the max
+// with their sum, and the normalization. The log-probability of the label is
+// taken as its input minus the max and the log of the sum, rather than from
+// the normalized probability. When inner_num_ == 1, each sample is a single
+// contiguous softmax, computed by caffe_cpu_softmax as in SoftmaxLayer.
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
-  int dim = prob_.count() / outer_num_;
+  Dtype* prob_data = prob_.mutable_cpu_data();
+  Dtype* max_data = max_.mutable_cpu_data();
+  Dtype* sum_data = sum_.mutable_cpu_data();
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = prob_.count() / outer_num_;
+  // The loss of a label is at most -log(FLT_MIN), as if its probability
+  // were at least FLT_MIN.
+  const Dtype min_log_prob = log(Dtype(FLT_MIN));
   int count = 0;
   Dtype loss = 0;
   for (int i = 0; i < outer_num_; ++i) {
-    for (int j = 0; j < inner_num_; j++) {
+    const Dtype* x = bottom_data + i * dim;
+    Dtype* y = prob_data + i * dim;
+    if (inner_num_ == 1) {
+      // One contiguous softmax per sample, as for large classifiers.
+      const Dtype log_norm = caffe_cpu_softmax(channels, x, y);
+      const int label_value = static_cast<int>(label[i]);
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        DCHECK_GE(label_value, 0);
+        DCHECK_LT(label_value, channels);
+        loss -= std::max(x[label_value] - log_norm, min_log_prob);
+        ++count;
+      }
+      continue;
+    }
+    caffe_copy(inner_num_, x, max_data);
+    for (int c = 1; c < channels; ++c) {
+      const Dtype* x_c = x + c * inner_num_;
+      for (int j = 0; j < inner_num_; ++j) {
+        max_data[j] = std::max(max_data[j], x_c[j]);
+      }
+    }
+    caffe_set(inner_num_, Dtype(0), sum_data);
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* x_c = x + c * inner_num_;
+      Dtype* y_c = y + c * inner_num_;
+      for (int j = 0; j < inner_num_; ++j) {
+        y_c[j] = exp(x_c[j] - max_data[j]);
+        sum_data[j] += y_c[j];
+      }
+    }
+    for (int j = 0; j < inner_num_; ++j) {
       const int label_value = static_cast<int>(label[i * inner_num_ + j]);
-      if (has_ignore_label_ && label_value == ignore_label_) {
-        continue;
+      if (!has_ignore_label_ || label_value != ignore_label_) {
+        DCHECK_GE(label_value, 0);
+        DCHECK_LT(label_value, channels);
+        const Dtype log_prob = x[label_value * inner_num_ + j] - max_data[j]
+            - log(sum_data[j]);
+        loss -= std::max(log_prob, min_log_prob);
+        ++count;
       }
-      DCHECK_GE(label_value, 0);
-      DCHECK_LT(label_value, prob_.shape(softmax_axis_));
-      loss -= log(std::max(prob_data[i * dim + label_value * inner_num_ + j],
-                           Dtype(FLT_MIN)));
-      ++count;
+      sum_data[j] = Dtype(1) / sum_data[j];
+    }
+    for (int c = 0; c < channels; ++c) {
+      caffe_mul(inner_num_, y + c * inner_num_, sum_data, y + c * inner_num_);
     }
   }
   top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_, count);
@@ -122,29 +171,37 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
+    // The gradient is (prob - 1{label}) * loss_weight / normalizer, zero for
+    // the ignored labels. The labels are counted first so that it can be
+    // written in a single pass.
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const Dtype* prob_data = prob_.cpu_data();
-    caffe_copy(prob_.count(), prob_data, bottom_diff);
     const Dtype* label = bottom[1]->cpu_data();
+    const int channels = bottom[0]->shape(softmax_axis_);
     int dim = prob_.count() / outer_num_;
     int count = 0;
+    for (int i = 0; i < outer_num_ * inner_num_; ++i) {
+      if (!has_ignore_label_ || static_cast<int>(label[i]) != ignore_label_) {
+        ++count;
+      }
+    }
+    // Scale gradient
+    const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                              get_normalizer(normalization_, count);
     for (int i = 0; i < outer_num_; ++i) {
+      caffe_cpu_scale(dim, loss_weight, prob_data + i * dim,
+          bottom_diff + i * dim);
       for (int j = 0; j < inner_num_; ++j) {
         const int label_value = static_cast<int>(label[i * inner_num_ + j]);
         if (has_ignore_label_ && label_value == ignore_label_) {
-          for (int c = 0; c < bottom[0]->shape(softmax_axis_); ++c) {
+          for (int c = 0; c < channels; ++c) {
             bottom_diff[i * dim + c * inner_num_ + j] = 0;
           }
         } else {
-          bottom_diff[i * dim + label_value * inner_num_ + j] -= 1;
-          ++count;
+          bottom_diff[i * dim + label_value * inner_num_ + j] -= loss_weight;
         }
       }
     }
-    // Scale gradient
-    Dtype loss_weight = top[0]->cpu_diff()[0] /
-                        get_normalizer(normalization_, count);
-    caffe_scal(prob_.count(), loss_weight, bottom_diff);
   }
 }
 
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#include "caffe/layers/sparse_hdf5_data_layer.hpp"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/hdf5.hpp"
+
+namespace caffe {
+
+// Load the sparse matrix of the first top, and the dense data of the others,
+// from HDF5 filename into the class property blobs.
+template <typename Dtype>
+void SparseHDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
+  DLOG(INFO) << "Loading HDF5 file: " << filename;
+  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file_id < 0) {
+    LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+  }
+  const int top_size = this->layer_param_.top_size();
+  this->hdf_blobs_.resize(top_size);
+
+  const string& sparse_name = this->layer_param_.top(0);
+  hid_t group_id = H5Gopen2(file_id, sparse_name.c_str(), H5P_DEFAULT);
+  CHECK_GE(group_id, 0) << "Failed to find HDF5 group " << sparse_name;
+  vector<int> shape, indices, ptr;
+  hdf5_load_int_vector(group_id, "shape", &shape);
+  CHECK_EQ(shape.size(), 2) << "Sparse data must have shape (num, dim).";
+  hdf5_load_int_vector(group_id, "indptr", &ptr);
+  CHECK_EQ(ptr.size(), shape[0] + 1) << "indptr must have num + 1 offsets.";
+  hdf5_load_int_vector(group_id, "indices", &indices);
+  Blob<Dtype> values;
+  hdf5_load_nd_dataset(group_id, "data", 1, 1, &values);
+  const int nnz = values.count();
+  CHECK_EQ(indices.size(), nnz) << "data and indices must have the same size.";
+  CHECK_EQ(ptr.front(), 0);
+  CHECK_EQ(ptr.back(), nnz);
+  for (int i = 0; i < nnz; ++i) {
+    CHECK(indices[i] >= 0 && indices[i] < shape[1])
+        << "Column index " << indices[i] << " out of range.";
+  }
+  herr_t status = H5Gclose(group_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 group " << sparse_name;
+  SparseBlob<Dtype>* sparse_blob = new SparseBlob<Dtype>(shape, nnz);
+  this->hdf_blobs_[0].reset(sparse_blob);
+  caffe_copy(nnz, values.cpu_data(), sparse_blob->mutable_cpu_data());
+  std::copy(indices.begin(), indices.end(),
+      sparse_blob->mutable_cpu_indices());
+  std::copy(ptr.begin(), ptr.end(), sparse_blob->mutable_cpu_ptr());
+
+  const int MIN_DATA_DIM = 1;
+  const int MAX_DATA_DIM = INT_MAX;
+  for (int i = 1; i < top_size; ++i) {
+    this->hdf_blobs_[i].reset(new Blob<Dtype>());
+    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
+        MIN_DATA_DIM, MAX_DATA_DIM, this->hdf_blobs_[i].get());
+  }
+  status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+
+  const int num = shape[0];
+  for (int i = 1; i < top_size; ++i) {
+    CHECK_EQ(this->hdf_blobs_[i]->shape(0), num);
+  }
+  // Default to identity permutation.
+  this->data_permutation_.resize(num);
+  for (int i = 0; i < num; i++) {
+    this->data_permutation_[i] = i;
+  }
+  // Shuffle if needed.
+  if (this->layer_param_.hdf5_data_param().shuffle()) {
+    std::random_shuffle(this->data_permutation_.begin(),
+        this->data_permutation_.end());
+  }
+  DLOG(INFO) << "Successully loaded " << num << " rows with " << nnz
+      << " nonzeros";
+}
+
+template <typename Dtype>
+void SparseHDF5DataLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  batch_values_.clear();
+  batch_indices_.clear();
+  batch_ptr_.assign(1, 0);
+  for (int i = 0; i < batch_size; ++i, ++this->current_row_) {
+    if (this->current_row_ == this->hdf_blobs_[0]->shape(0)) {
+      this->NextFile();
+    }
+    const int row = this->data_permutation_[this->current_row_];
+    // The rows of a batch can come from two files, so they are gathered
+    // before the top is reshaped for their nonzeros.
+    const SparseBlob<Dtype>* sparse_blob =
+        static_cast<const SparseBlob<Dtype>*>(this->hdf_blobs_[0].get());
+    const int begin = sparse_blob->cpu_ptr()[row];
+    const int end = sparse_blob->cpu_ptr()[row + 1];
+    batch_values_.insert(batch_values_.end(),
+        sparse_blob->cpu_data() + begin, sparse_blob->cpu_data() + end);
+    batch_indices_.insert(batch_indices_.end(),
+        sparse_blob->cpu_indices() + begin, sparse_blob->cpu_indices() + end);
+    batch_ptr_.push_back(batch_values_.size());
+    for (int j = 1; j < this->layer_param_.top_size(); ++j) {
+      int data_dim = top[j]->count() / top[j]->shape(0);
+      caffe_copy(data_dim,
+          &this->hdf_blobs_[j]->cpu_data()[row * data_dim],
+          &top[j]->mutable_cpu_data()[i * data_dim]);
+    }
+  }
+  SparseBlob<Dtype>* sparse_top = dynamic_cast<SparseBlob<Dtype>*>(top[0]);
+  CHECK(sparse_top) << "The first top of " << this->type()
+      << " must be a SparseBlob.";
+  sparse_top->Reshape(top[0]->shape(), batch_values_.size());
+  std::copy(batch_values_.begin(), batch_values_.end(),
+      sparse_top->mutable_cpu_data());
+  std::copy(batch_indices_.begin(), batch_indices_.end(),
+      sparse_top->mutable_cpu_indices());
+  std::copy(batch_ptr_.begin(), batch_ptr_.end(),
+      sparse_top->mutable_cpu_ptr());
+}
+
+INSTANTIATE_CLASS(SparseHDF5DataLayer);
+REGISTER_LAYER_CLASS(SparseHDF5Data);
+
+}  // namespace caffe
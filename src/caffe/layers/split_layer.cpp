@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/split_layer.hpp"
@@ -38,13 +39,22 @@ void SplitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     caffe_copy(count_, top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
     return;
   }
-  caffe_add(count_, top[0]->cpu_diff(), top[1]->cpu_diff(),
-            bottom[0]->mutable_cpu_diff());
-  // Add remaining top blob diffs.
-  for (int i = 2; i < top.size(); ++i) {
-    const Dtype* top_diff = top[i]->cpu_diff();
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    caffe_axpy(count_, Dtype(1.), top_diff, bottom_diff);
+  vector<const Dtype*> top_diffs(top.size());
+  for (int i = 0; i < top.size(); ++i) {
+    top_diffs[i] = top[i]->cpu_diff();
+  }
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  // Add the top blob diffs block by block, so that the partial sums stay in
+  // cache instead of making a pass over the whole bottom diff per top.
+  const int kBlockSize = 4096;
+  for (int start = 0; start < count_; start += kBlockSize) {
+    const int block_size = std::min(kBlockSize, count_ - start);
+    caffe_add(block_size, top_diffs[0] + start, top_diffs[1] + start,
+              bottom_diff + start);
+    for (int i = 2; i < top.size(); ++i) {
+      caffe_axpy(block_size, Dtype(1.), top_diffs[i] + start,
+                 bottom_diff + start);
+    }
   }
 }
 
@@ -12,9 +12,13 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/net_profiler.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -22,14 +26,15 @@
 namespace caffe {
 
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+Net<Dtype>::Net(const NetParameter& param, const Net* root_net,
+    const Net* param_net)
+    : root_net_(root_net), param_net_(param_net) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), param_net_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   param.mutable_state()->set_phase(phase);
@@ -67,6 +72,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         << "Exactly one input_shape must be specified per input.";
   }
   memory_used_ = 0;
+  diff_rows_valid_ = false;
   // set the input blobs
   for (int input_id = 0; input_id < param.input_size(); ++input_id) {
     const int layer_id = -1;  // inputs have fake layer ID -1
@@ -79,6 +85,46 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   param_id_vecs_.resize(param.layer_size());
   top_id_vecs_.resize(param.layer_size());
   bottom_need_backward_.resize(param.layer_size());
+  // The blobs computed in place by some layer, which therefore may not be
+  // views of other blobs (see Layer::set_share_views), and the tops of Slice
+  // layers, which are already views of their bottom.
+  set<string> in_place_blobs, slice_tops;
+  for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
+    const LayerParameter& layer_param = param.layer(layer_id);
+    if (layer_param.type() == "Slice") {
+      slice_tops.insert(layer_param.top().begin(), layer_param.top().end());
+    }
+    for (int top_id = 0; top_id < layer_param.top_size(); ++top_id) {
+      for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
+           ++bottom_id) {
+        if (layer_param.top(top_id) == layer_param.bottom(bottom_id)) {
+          in_place_blobs.insert(layer_param.top(top_id));
+        }
+      }
+    }
+  }
+  // So are the blobs sharing data with one of them, through the layers whose
+  // tops share the data of their bottom.
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
+      const LayerParameter& layer_param = param.layer(layer_id);
+      const string& type = layer_param.type();
+      if (layer_param.bottom_size() != 1 || (type != "Split" &&
+          type != "Flatten" && type != "Reshape")) {
+        continue;
+      }
+      const string& bottom = layer_param.bottom(0);
+      for (int top_id = 0; top_id < layer_param.top_size(); ++top_id) {
+        const string& top = layer_param.top(top_id);
+        if (in_place_blobs.count(top) != in_place_blobs.count(bottom)) {
+          in_place_blobs.insert(top);
+          in_place_blobs.insert(bottom);
+          changed = true;
+        }
+      }
+    }
+  }
   for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
     // For non-root solvers, whether this layer is shared from root_net_.
     bool share_from_root = !Caffe::root_solver()
@@ -87,6 +133,12 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     if (!param.layer(layer_id).has_phase()) {
       param.mutable_layer(layer_id)->set_phase(phase_);
     }
+    // Likewise the storage precision.
+    if (param.has_storage_precision() &&
+        !param.layer(layer_id).has_storage_precision()) {
+      param.mutable_layer(layer_id)->set_storage_precision(
+          param.storage_precision());
+    }
     // Setup layer.
     const LayerParameter& layer_param = param.layer(layer_id);
     if (layer_param.propagate_down_size() > 0) {
@@ -102,6 +154,15 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     } else {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     }
+    if (param_net_) {
+      map<string, int>::const_iterator param_layer =
+          param_net_->layer_names_index_.find(layer_param.name());
+      CHECK(param_layer != param_net_->layer_names_index_.end())
+          << "Unknown layer " << layer_param.name() << " in param net";
+      // Layers skip param initialization when they already have blobs.
+      layers_[layer_id]->blobs() =
+          param_net_->layers_[param_layer->second]->blobs();
+    }
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
         << "Creating Layer " << layer_param.name();
@@ -145,6 +206,19 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
             << layer_param.name();
       }
     } else {
+      bool share_views = true;
+      for (int top_id = 0; top_id < layer_param.top_size(); ++top_id) {
+        share_views &= !in_place_blobs.count(layer_param.top(top_id));
+      }
+      // A Concat making them views of its top would undo the Slice's views
+      // on every Reshape, and copy them back.
+      if (layer_param.type() == "Concat") {
+        for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
+             ++bottom_id) {
+          share_views &= !slice_tops.count(layer_param.bottom(bottom_id));
+        }
+      }
+      layers_[layer_id]->set_share_views(share_views);
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     }
     LOG_IF(INFO, Caffe::root_solver())
@@ -272,17 +346,111 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     net_output_blobs_.push_back(blobs_[blob_name_to_idx[*it]].get());
     net_output_blob_indices_.push_back(blob_name_to_idx[*it]);
   }
+  blob_blocked_layout_.assign(blobs_.size(), false);
+  if (param.blocked_layout() && phase_ == TEST && !param.force_backward() &&
+      Caffe::mode() == Caffe::CPU) {
+    SetUpBlockedLayout();
+  }
   for (size_t blob_id = 0; blob_id < blob_names_.size(); ++blob_id) {
     blob_names_index_[blob_names_[blob_id]] = blob_id;
   }
   for (size_t layer_id = 0; layer_id < layer_names_.size(); ++layer_id) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
-  ShareWeights();
+  // The param blobs of param_net_ are already shared, and must not be
+  // modified as other nets may be using them.
+  if (!param_net_) {
+    ShareWeights();
+  }
   debug_info_ = param.debug_info();
+  profiler_ = NULL;
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::SetUpBlockedLayout() {
+  vector<bool>& blocked = blob_blocked_layout_;
+  // Start from the 4D outputs of the layers handling the layout or agnostic
+  // to it whose channels fill whole blocks, so that they need no padding.
+  for (int i = 0; i < layers_.size(); ++i) {
+    const bool handles = layers_[i]->HandlesBlockedLayout() ||
+        layers_[i]->LayoutAgnostic();
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      const Blob<Dtype>& top = *top_vecs_[i][j];
+      blocked[top_id_vecs_[i][j]] = handles && top.num_axes() == 4 &&
+          top.channels() % kChannelBlock == 0;
+    }
+  }
+  // Leave out the outputs, and what other layers read or write.
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    blocked[net_output_blob_indices_[i]] = false;
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->HandlesBlockedLayout() || layers_[i]->LayoutAgnostic()) {
+      continue;
+    }
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      blocked[bottom_id_vecs_[i][j]] = false;
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      blocked[top_id_vecs_[i][j]] = false;
+    }
+  }
+  // The blobs of an agnostic layer are all blocked or none is, which can
+  // leave out more blobs, and so on.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < layers_.size(); ++i) {
+      if (!layers_[i]->LayoutAgnostic()) {
+        continue;
+      }
+      bool all_blocked = true;
+      for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+        all_blocked &= blocked[bottom_id_vecs_[i][j]];
+      }
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        all_blocked &= blocked[top_id_vecs_[i][j]];
+      }
+      if (all_blocked) {
+        continue;
+      }
+      for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+        changed |= blocked[bottom_id_vecs_[i][j]];
+        blocked[bottom_id_vecs_[i][j]] = false;
+      }
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        changed |= blocked[top_id_vecs_[i][j]];
+        blocked[top_id_vecs_[i][j]] = false;
+      }
+    }
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (!layers_[i]->HandlesBlockedLayout()) {
+      continue;
+    }
+    vector<bool> bottoms, tops;
+    bool any_blocked = false;
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      bottoms.push_back(blocked[bottom_id_vecs_[i][j]]);
+      any_blocked |= bottoms.back();
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      tops.push_back(blocked[top_id_vecs_[i][j]]);
+      any_blocked |= tops.back();
+    }
+    if (any_blocked) {
+      layers_[i]->set_blocked_layout(bottoms, tops);
+    }
+  }
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (blocked[i]) {
+      LOG_IF(INFO, Caffe::root_solver())
+          << blob_names_[i] << " is in the blocked layout";
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -413,7 +581,9 @@ void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
         LOG(INFO) << "Input " << top_id << " -> " << blob_name;
       }
     }
-    shared_ptr<Blob<Dtype> > blob_pointer(new Blob<Dtype>());
+    shared_ptr<Blob<Dtype> > blob_pointer(
+        layer_id >= 0 && layers_[layer_id]->SparseTopBlob(top_id) ?
+        new SparseBlob<Dtype>() : new Blob<Dtype>());
     const int blob_id = blobs_.size();
     blobs_.push_back(blob_pointer);
     blob_names_.push_back(blob_name);
@@ -451,6 +621,13 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
                << layer_param.name() << "', bottom index " << bottom_id << ")";
   }
   const int blob_id = (*blob_name_to_idx)[blob_name];
+  // InsertSplits gives a blob with several consumers a Split layer, whose
+  // tops share its dense data only.
+  if (layer_param.type() == "Split" &&
+      dynamic_cast<SparseBlob<Dtype>*>(blobs_[blob_id].get())) {
+    LOG(FATAL) << "Sparse blob '" << blob_name << "' is a bottom of more "
+               << "than one layer, but a sparse blob can feed only one layer.";
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << layer_names_[layer_id] << " <- " << blob_name;
   bottom_vecs_[layer_id].push_back(blobs_[blob_id].get());
@@ -537,6 +714,11 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
           << "shape is " << owner_blob->shape_string() << "; sharing layer "
           << "expects shape " << this_blob->shape_string();
     }
+    CHECK_EQ(this_blob->row_sparse_diff(), owner_blob->row_sparse_diff())
+        << "Cannot share param '" << param_name << "' owned by layer '"
+        << layer_names_[owner_layer_id] << "' with layer '"
+        << layer_names_[layer_id] << "'; only one of them keeps a row-sparse "
+        << "diff.";
     const int learnable_param_id = learnable_param_ids_[owner_net_param_id];
     learnable_param_ids_.push_back(learnable_param_id);
     if (param_spec->has_lr_mult()) {
@@ -573,7 +755,12 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    if (profiler_) { profiler_->LayerStart(); }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    if (profiler_) {
+      profiler_->LayerEnd(layer_names_[i], NetProfiler<Dtype>::FORWARD,
+          layers_[i].get(), bottom_vecs_[i], top_vecs_[i]);
+    }
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
   }
@@ -637,8 +824,13 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
+      if (profiler_) { profiler_->LayerStart(); }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      if (profiler_) {
+        profiler_->LayerEnd(layer_names_[i], NetProfiler<Dtype>::BACKWARD,
+            layers_[i].get(), bottom_vecs_[i], top_vecs_[i]);
+      }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
   }
@@ -844,6 +1036,8 @@ void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
   if (trained_filename.size() >= 3 &&
       trained_filename.compare(trained_filename.size() - 3, 3, ".h5") == 0) {
     CopyTrainedLayersFromHDF5(trained_filename);
+  } else if (IsMappedWeights(trained_filename)) {
+    MapTrainedLayersFrom(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
   }
@@ -853,7 +1047,11 @@ template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
     const string trained_filename) {
   NetParameter param;
-  ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
+  if (IsChunkedManifest(trained_filename)) {
+    ReadChunkedProtoOrDie(trained_filename, &param);
+  } else {
+    ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
+  }
   CopyTrainedLayersFrom(param);
 }
 
@@ -907,6 +1105,57 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void Net<Dtype>::MapTrainedLayersFrom(const string trained_filename) {
+  shared_ptr<MappedWeights> weights(new MappedWeights(trained_filename));
+  const NetParameter& index = weights->index();
+  bool mapped = false;
+  for (int i = 0; i < index.layer_size(); ++i) {
+    const LayerParameter& source_layer = index.layer(i);
+    const string& source_layer_name = source_layer.name();
+    if (!layer_names_index_.count(source_layer_name)) {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    int target_layer_id = layer_names_index_[source_layer_name];
+    DLOG(INFO) << "Mapping source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
+        Blob<Dtype> source_blob;
+        const bool kReshape = true;
+        source_blob.FromProto(source_layer.blobs(j), kReshape);
+        LOG(FATAL) << "Cannot map param " << j << " weights from layer '"
+            << source_layer_name << "'; shape mismatch.  Source param shape is "
+            << source_blob.shape_string() << "; target param shape is "
+            << target_blobs[j]->shape_string() << ".";
+      }
+      // Weight-shared params use the values of their owner.
+      if (param_owners_[param_id_vecs_[target_layer_id][j]] != -1) {
+        continue;
+      }
+      const int count = target_blobs[j]->count();
+      if (weights->value_size() == sizeof(Dtype)) {
+        target_blobs[j]->set_cpu_data(
+            static_cast<Dtype*>(weights->blob_data(i, j)));
+        mapped = true;
+      } else if (weights->value_size() == sizeof(float)) {
+        const float* source = static_cast<float*>(weights->blob_data(i, j));
+        std::copy(source, source + count, target_blobs[j]->mutable_cpu_data());
+      } else {
+        const double* source = static_cast<double*>(weights->blob_data(i, j));
+        std::copy(source, source + count, target_blobs[j]->mutable_cpu_data());
+      }
+    }
+  }
+  if (mapped) {
+    mapped_weights_.push_back(weights);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -992,8 +1241,18 @@ void Net<Dtype>::ClearParamDiffs() {
     Blob<Dtype>* blob = learnable_params_[i];
     switch (Caffe::mode()) {
     case Caffe::CPU:
-      caffe_set(blob->count(), static_cast<Dtype>(0),
-                blob->mutable_cpu_diff());
+      if (blob->row_sparse_diff() && diff_rows_valid_) {
+        // Only the recorded rows can be nonzero.
+        const vector<int>& rows = blob->diff_rows();
+        const int row_size = blob->count(1);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int j = 0; j < rows.size(); ++j) {
+          caffe_set(row_size, static_cast<Dtype>(0), diff + rows[j] * row_size);
+        }
+      } else {
+        caffe_set(blob->count(), static_cast<Dtype>(0),
+                  blob->mutable_cpu_diff());
+      }
       break;
     case Caffe::GPU:
 #ifndef CPU_ONLY
@@ -1004,7 +1263,12 @@ void Net<Dtype>::ClearParamDiffs() {
 #endif
       break;
     }
+    blob->ClearDiffRows();
   }
+  // The GPU solvers update row-sparse params densely, writing to all of
+  // their diff, so the recorded rows only bound the nonzero diffs after a
+  // clear on the CPU.
+  diff_rows_valid_ = Caffe::mode() == Caffe::CPU;
 }
 
 template <typename Dtype>
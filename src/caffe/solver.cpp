@@ -4,9 +4,12 @@
 #include <vector>
 
 #include "caffe/solver.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/metrics.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -53,6 +56,14 @@ void Solver<Dtype>::Init(const SolverParameter& param) {
   if (Caffe::root_solver() && param_.random_seed() >= 0) {
     Caffe::set_random_seed(param_.random_seed());
   }
+  if (Caffe::root_solver() && param_.snapshot_async()) {
+    if (param_.snapshot_format() == SolverParameter_SnapshotFormat_HDF5) {
+      LOG(WARNING) << "snapshot_async is not supported for HDF5 snapshots, "
+          << "which will be written synchronously.";
+    } else {
+      snapshot_writer_.reset(new SnapshotWriter());
+    }
+  }
   // Scaffolding code
   InitTrainNet();
   if (Caffe::root_solver()) {
@@ -217,10 +228,27 @@ void Solver<Dtype>::Step(int iters) {
     }
     const bool display = param_.display() && iter_ % param_.display() == 0;
     net_->set_debug_info(display && param_.debug_info());
+    Metrics& metrics = Metrics::Get();
+    const bool record = metrics.enabled();
+    Timer iteration_timer, timer;
+    if (record) { iteration_timer.Start(); }
     // accumulate the loss and gradient
     Dtype loss = 0;
+    double forward_seconds = 0, backward_seconds = 0;
     for (int i = 0; i < param_.iter_size(); ++i) {
-      loss += net_->ForwardBackward(bottom_vec);
+      if (record) {
+        // The same as ForwardBackward, timing both passes.
+        Dtype iter_loss;
+        timer.Start();
+        net_->Forward(bottom_vec, &iter_loss);
+        forward_seconds += timer.MicroSeconds() / 1e6;
+        timer.Start();
+        net_->Backward();
+        backward_seconds += timer.MicroSeconds() / 1e6;
+        loss += iter_loss;
+      } else {
+        loss += net_->ForwardBackward(bottom_vec);
+      }
     }
     loss /= param_.iter_size();
     // average the loss across iterations for smoothed reporting
@@ -251,11 +279,33 @@ void Solver<Dtype>::Step(int iters) {
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
+    if (record) { timer.Start(); }
     ApplyUpdate();
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
     ++iter_;
+    if (record) {
+      const double update_seconds = timer.MicroSeconds() / 1e6;
+      const double iteration_seconds = iteration_timer.MicroSeconds() / 1e6;
+      // The images are the items of the first top of the net, i.e. of the
+      // data layer.
+      const vector<vector<Blob<Dtype>*> >& tops = net_->top_vecs();
+      const double images = tops.empty() || tops[0].empty() ? 0 :
+          tops[0][0]->shape(0) * param_.iter_size();
+      metrics.Observe("caffe_forward_seconds", forward_seconds);
+      metrics.Observe("caffe_backward_seconds", backward_seconds);
+      metrics.Observe("caffe_update_seconds", update_seconds);
+      metrics.Observe("caffe_iteration_seconds", iteration_seconds);
+      metrics.Increment("caffe_images_total", images);
+      if (Caffe::root_solver()) {
+        metrics.Increment("caffe_iterations_total");
+        metrics.Set("caffe_iteration", iter_);
+        metrics.Set("caffe_loss", smoothed_loss_);
+        metrics.Set("caffe_images_per_second", iteration_seconds > 0 ?
+            images * Caffe::solver_count() / iteration_seconds : 0);
+      }
+    }
 
     SolverAction::Enum request = GetRequestedAction();
 
@@ -298,6 +348,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
       && (!param_.snapshot() || iter_ % param_.snapshot() != 0)) {
     Snapshot();
   }
+  WaitForSnapshots();
   if (requested_early_exit_) {
     LOG(INFO) << "Optimization stopped early.";
     return;
@@ -411,9 +462,15 @@ void Solver<Dtype>::Test(const int test_net_id) {
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
+  CPUTimer timer;
+  timer.Start();
+  if (snapshot_writer_) {
+    async_snapshot_.reset(new SnapshotWriter::Snapshot(iter_));
+  }
   string model_filename;
   switch (param_.snapshot_format()) {
   case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
+  case caffe::SolverParameter_SnapshotFormat_CHUNKED:
     model_filename = SnapshotToBinaryProto();
     break;
   case caffe::SolverParameter_SnapshotFormat_HDF5:
@@ -424,6 +481,46 @@ void Solver<Dtype>::Snapshot() {
   }
 
   SnapshotSolverState(model_filename);
+  if (Metrics::Get().enabled()) {
+    Metrics::Get().Observe("caffe_snapshot_seconds",
+        timer.MicroSeconds() / 1e6);
+  }
+  if (async_snapshot_) {
+    async_snapshot_->set_stall_ms(timer.MilliSeconds());
+    snapshot_writer_->Write(async_snapshot_);
+    async_snapshot_.reset();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForSnapshots() {
+  if (snapshot_writer_) {
+    snapshot_writer_->Wait();
+  }
+}
+
+template <typename Dtype>
+string Solver<Dtype>::WriteSnapshotProto(Message* proto,
+    const string& filename) {
+  if (param_.snapshot_format() != SolverParameter_SnapshotFormat_CHUNKED) {
+    if (async_snapshot_) {
+      async_snapshot_->Add(filename, proto);
+    } else {
+      WriteProtoToBinaryFile(*proto, filename);
+    }
+    return filename;
+  }
+  // The chunks go to <snapshot_prefix>_chunks, next to the manifests.
+  const string& prefix = param_.snapshot_prefix();
+  const string chunk_dir = prefix.substr(prefix.find_last_of('/') + 1)
+      + "_chunks";
+  const string manifest_filename = filename + ".manifest";
+  if (async_snapshot_) {
+    async_snapshot_->Add(manifest_filename, proto, chunk_dir);
+  } else {
+    WriteChunkedProto(proto, manifest_filename, chunk_dir);
+  }
+  return manifest_filename;
 }
 
 template <typename Dtype>
@@ -456,8 +553,7 @@ string Solver<Dtype>::SnapshotToBinaryProto() {
   LOG(INFO) << "Snapshotting to binary proto file " << model_filename;
   NetParameter net_param;
   net_->ToProto(&net_param, param_.snapshot_diff());
-  WriteProtoToBinaryFile(net_param, model_filename);
-  return model_filename;
+  return WriteSnapshotProto(&net_param, model_filename);
 }
 
 template <typename Dtype>
@@ -106,6 +106,32 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaDeltaSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = this->GetFusedGradient(param_id);
+  const Dtype delta = this->param_.delta();
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const size_t update_history_offset = this->net_->learnable_params().size();
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* h = this->history_[param_id]->mutable_cpu_data();
+  Dtype* h2 =
+      this->history_[update_history_offset + param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      h[i] = (Dtype(1) - momentum) * g * g + momentum * h[i];
+      const Dtype u = g * std::sqrt((h2[i] + delta) / (h[i] + delta));
+      h2[i] = (Dtype(1) - momentum) * u * u + momentum * h2[i];
+      diff[i] = local_rate * u;
+      data[i] -= diff[i];
+    }
+  }
+}
+
 INSTANTIATE_CLASS(AdaDeltaSolver);
 REGISTER_SOLVER_CLASS(AdaDelta);
 
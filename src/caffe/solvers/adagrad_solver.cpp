@@ -64,6 +64,26 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaGradSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = this->GetFusedGradient(param_id);
+  const Dtype delta = this->param_.delta();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* h = this->history_[param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      h[i] += g * g;
+      diff[i] = local_rate * g / (std::sqrt(h[i]) + delta);
+      data[i] -= diff[i];
+    }
+  }
+}
+
 INSTANTIATE_CLASS(AdaGradSolver);
 REGISTER_SOLVER_CLASS(AdaGrad);
 
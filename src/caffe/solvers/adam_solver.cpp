@@ -88,6 +88,36 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdamSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = this->GetFusedGradient(param_id);
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const Dtype eps_hat = this->param_.delta();
+  const int t = this->iter_ + 1;
+  const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
+      (Dtype(1.) - pow(beta1, t));
+  const Dtype corrected_local_rate = local_rate * correction;
+  const size_t update_history_offset = this->net_->learnable_params().size();
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* m = this->history_[param_id]->mutable_cpu_data();
+  Dtype* v =
+      this->history_[update_history_offset + param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      m[i] = (Dtype(1) - beta1) * g + beta1 * m[i];
+      v[i] = (Dtype(1) - beta2) * g * g + beta2 * v[i];
+      diff[i] = corrected_local_rate * m[i] / (std::sqrt(v[i]) + eps_hat);
+      data[i] -= diff[i];
+    }
+  }
+}
+
 INSTANTIATE_CLASS(AdamSolver);
 REGISTER_SOLVER_CLASS(Adam);
 
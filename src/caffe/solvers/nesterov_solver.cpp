@@ -56,6 +56,28 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void NesterovSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = this->GetFusedGradient(param_id);
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* h = this->history_[param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      const Dtype h_prev = h[i];
+      h[i] = local_rate * g + momentum * h[i];
+      // step back then over step
+      diff[i] = (Dtype(1) + momentum) * h[i] - momentum * h_prev;
+      data[i] -= diff[i];
+    }
+  }
+}
+
 INSTANTIATE_CLASS(NesterovSolver);
 REGISTER_SOLVER_CLASS(Nesterov);
 
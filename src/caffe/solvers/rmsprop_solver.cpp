@@ -64,6 +64,27 @@ void RMSPropSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void RMSPropSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = this->GetFusedGradient(param_id);
+  const Dtype delta = this->param_.delta();
+  const Dtype rms_decay = this->param_.rms_decay();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* h = this->history_[param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      h[i] = Dtype(1 - rms_decay) * g * g + rms_decay * h[i];
+      diff[i] = local_rate * g / (std::sqrt(h[i]) + delta);
+      data[i] -= diff[i];
+    }
+  }
+}
+
 INSTANTIATE_CLASS(RMSPropSolver);
 REGISTER_SOLVER_CLASS(RMSProp);
 
@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/metrics.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -105,14 +108,100 @@ void SGDSolver<Dtype>::ApplyUpdate() {
   if (this->param_.display() && this->iter_ % this->param_.display() == 0) {
     LOG(INFO) << "Iteration " << this->iter_ << ", lr = " << rate;
   }
+  if (Metrics::Get().enabled()) {
+    Metrics::Get().Set("caffe_learning_rate", rate);
+  }
   ClipGradients();
-  for (int param_id = 0; param_id < this->net_->learnable_params().size();
-       ++param_id) {
-    Normalize(param_id);
-    Regularize(param_id);
-    ComputeUpdateValue(param_id, rate);
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const bool cpu = Caffe::mode() == Caffe::CPU;
+  const bool fused = this->param_.fused_update() && cpu && HasFusedUpdate();
+  if (fused && fused_params_.count() == 0) {
+    FuseParams();
+  }
+  for (int param_id = 0; param_id < net_params.size(); ++param_id) {
+    Blob<Dtype>* param = net_params[param_id];
+    if (fused || (cpu && param->row_sparse_diff() && HasFusedUpdate())) {
+      // The fused update also applies the update to the param data, so there
+      // is no need for Blob::Update.
+      ComputeFusedUpdate(param_id, rate);
+    } else {
+      if (cpu && param->row_sparse_diff()) {
+        // The unfused update writes to every row of the diff.
+        vector<int> rows(param->shape(0));
+        for (int i = 0; i < rows.size(); ++i) { rows[i] = i; }
+        param->AddDiffRows(rows);
+      }
+      Normalize(param_id);
+      Regularize(param_id);
+      ComputeUpdateValue(param_id, rate);
+      net_params[param_id]->Update();
+    }
   }
-  this->net_->Update();
+}
+
+// Replace the storage of the learnable params and of the history by
+// consecutive ranges of two flat buffers, the same way Params does for
+// parallel training, so the fused update streams through memory linearly
+// even for nets made of many small blobs. Called once, after the subclass
+// PreSolve has added its own history blobs.
+template <typename Dtype>
+void SGDSolver<Dtype>::FuseParams() {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  int params_count = 0;
+  for (int i = 0; i < net_params.size(); ++i) {
+    params_count += net_params[i]->count();
+  }
+  int history_count = 0;
+  for (int i = 0; i < history_.size(); ++i) {
+    history_count += history_[i]->count();
+  }
+  // Keep at least one element so that the buffers count as allocated.
+  fused_params_.Reshape(vector<int>(1, std::max(params_count, 1)));
+  fused_history_.Reshape(vector<int>(1, std::max(history_count, 1)));
+  Dtype* data = fused_params_.mutable_cpu_data();
+  Dtype* diff = fused_params_.mutable_cpu_diff();
+  for (int i = 0; i < net_params.size(); ++i) {
+    const int count = net_params[i]->count();
+    caffe_copy(count, net_params[i]->cpu_data(), data);
+    caffe_copy(count, net_params[i]->cpu_diff(), diff);
+    net_params[i]->data()->set_cpu_data(data);
+    net_params[i]->diff()->set_cpu_data(diff);
+    data += count;
+    diff += count;
+  }
+  Dtype* history = fused_history_.mutable_cpu_data();
+  for (int i = 0; i < history_.size(); ++i) {
+    const int count = history_[i]->count();
+    caffe_copy(count, history_[i]->cpu_data(), history);
+    history_[i]->data()->set_cpu_data(history);
+    history += count;
+  }
+  DLOG(INFO) << "Fused " << net_params.size() << " params (" << params_count
+      << " values) and " << history_.size() << " history blobs ("
+      << history_count << " values)";
+}
+
+template <typename Dtype>
+FusedGradient<Dtype> SGDSolver<Dtype>::GetFusedGradient(int param_id) {
+  const vector<float>& net_params_weight_decay =
+      this->net_->params_weight_decay();
+  const string& regularization_type = this->param_.regularization_type();
+  Dtype local_decay =
+      this->param_.weight_decay() * net_params_weight_decay[param_id];
+  FusedGradient<Dtype> gradient;
+  gradient.scale = Dtype(1) / this->param_.iter_size();
+  gradient.l2_decay = Dtype(0);
+  gradient.l1_decay = Dtype(0);
+  if (local_decay) {
+    if (regularization_type == "L2") {
+      gradient.l2_decay = local_decay;
+    } else if (regularization_type == "L1") {
+      gradient.l1_decay = local_decay;
+    } else {
+      LOG(FATAL) << "Unknown regularization type: " << regularization_type;
+    }
+  }
+  return gradient;
 }
 
 template <typename Dtype>
@@ -242,10 +331,30 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const FusedGradient<Dtype> gradient = GetFusedGradient(param_id);
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const FusedUpdateRanges<Dtype> ranges(*param);
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* h = history_[param_id]->mutable_cpu_data();
+  for (int r = 0; r < ranges.size(); ++r) {
+    for (int i = ranges.begin(r); i < ranges.end(r); ++i) {
+      const Dtype g = gradient(diff[i], data[i]);
+      diff[i] = h[i] = local_rate * g + momentum * h[i];
+      data[i] -= diff[i];
+    }
+  }
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
   switch (this->param_.snapshot_format()) {
     case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
+    case caffe::SolverParameter_SnapshotFormat_CHUNKED:
       SnapshotSolverStateToBinaryProto(model_filename);
       break;
     case caffe::SolverParameter_SnapshotFormat_HDF5:
@@ -272,7 +381,7 @@ void SGDSolver<Dtype>::SnapshotSolverStateToBinaryProto(
   string snapshot_filename = Solver<Dtype>::SnapshotFilename(".solverstate");
   LOG(INFO)
     << "Snapshotting solver state to binary proto file " << snapshot_filename;
-  WriteProtoToBinaryFile(state, snapshot_filename.c_str());
+  this->WriteSnapshotProto(&state, snapshot_filename);
 }
 
 template <typename Dtype>
@@ -305,12 +414,14 @@ template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
     const string& state_file) {
   SolverState state;
-  ReadProtoFromBinaryFile(state_file, &state);
+  if (IsChunkedManifest(state_file)) {
+    ReadChunkedProtoOrDie(state_file, &state);
+  } else {
+    ReadProtoFromBinaryFile(state_file, &state);
+  }
   this->iter_ = state.iter();
   if (state.has_learned_net()) {
-    NetParameter net_param;
-    ReadNetParamsFromBinaryFileOrDie(state.learned_net().c_str(), &net_param);
-    this->net_->CopyTrainedLayersFrom(net_param);
+    this->net_->CopyTrainedLayersFromBinaryProto(state.learned_net());
   }
   this->current_step_ = state.current_step();
   CHECK_EQ(state.history_size(), history_.size())
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+SparseBlob<Dtype>::SparseBlob(const vector<int>& shape, const int nnz)
+    : Blob<Dtype>(), nnz_(0) {
+  Reshape(shape, nnz);
+}
+
+template <typename Dtype>
+void SparseBlob<Dtype>::Reshape(const vector<int>& shape) {
+  Reshape(shape, nnz_);
+}
+
+template <typename Dtype>
+void SparseBlob<Dtype>::Reshape(const vector<int>& shape, const int nnz) {
+  CHECK_EQ(shape.size(), 2) << "A SparseBlob has shape (num, dim).";
+  CHECK_GE(shape[0], 0);
+  CHECK_GE(shape[1], 0);
+  CHECK_GE(nnz, 0);
+  this->shape_ = shape;
+  if (!this->shape_data_ ||
+      this->shape_data_->size() < shape.size() * sizeof(int)) {
+    this->shape_data_.reset(new SyncedMemory(shape.size() * sizeof(int)));
+  }
+  int* shape_data = static_cast<int*>(this->shape_data_->mutable_cpu_data());
+  std::copy(shape.begin(), shape.end(), shape_data);
+  nnz_ = nnz;
+  this->count_ = nnz;
+  // Keep the values allocated even without nonzeros, so empty batches can
+  // still be read.
+  if (!this->data_ || nnz > this->capacity_) {
+    this->capacity_ = std::max(nnz, 1);
+    this->data_.reset(new SyncedMemory(this->capacity_ * sizeof(Dtype)));
+    this->diff_.reset(new SyncedMemory(this->capacity_ * sizeof(Dtype)));
+    indices_.reset(new SyncedMemory(this->capacity_ * sizeof(int)));
+  }
+  const size_t ptr_size = (shape[0] + 1) * sizeof(int);
+  if (!ptr_ || ptr_->size() < ptr_size) {
+    ptr_.reset(new SyncedMemory(ptr_size));
+  }
+}
+
+template <typename Dtype>
+const int* SparseBlob<Dtype>::cpu_indices() const {
+  CHECK(indices_);
+  return static_cast<const int*>(indices_->cpu_data());
+}
+
+template <typename Dtype>
+const int* SparseBlob<Dtype>::cpu_ptr() const {
+  CHECK(ptr_);
+  return static_cast<const int*>(ptr_->cpu_data());
+}
+
+template <typename Dtype>
+int* SparseBlob<Dtype>::mutable_cpu_indices() {
+  CHECK(indices_);
+  return static_cast<int*>(indices_->mutable_cpu_data());
+}
+
+template <typename Dtype>
+int* SparseBlob<Dtype>::mutable_cpu_ptr() {
+  CHECK(ptr_);
+  return static_cast<int*>(ptr_->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void SparseBlob<Dtype>::ToDense(Dtype* dense) const {
+  const int num = this->shape(0);
+  const int dim = this->shape(1);
+  const Dtype* data = this->cpu_data();
+  const int* indices = cpu_indices();
+  const int* ptr = cpu_ptr();
+  caffe_set(num * dim, Dtype(0), dense);
+  for (int i = 0; i < num; ++i) {
+    for (int j = ptr[i]; j < ptr[i + 1]; ++j) {
+      dense[i * dim + indices[j]] += data[j];
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SparseBlob);
+
+}  // namespace caffe
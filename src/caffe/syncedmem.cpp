@@ -4,6 +4,57 @@
 
 namespace caffe {
 
+static uint64_t num_allocations_ = 0;
+static uint64_t allocated_bytes_ = 0;
+
+uint64_t SyncedMemory::num_allocations() {
+  return __sync_fetch_and_add(&num_allocations_, 0);
+}
+
+uint64_t SyncedMemory::allocated_bytes() {
+  return __sync_fetch_and_add(&allocated_bytes_, 0);
+}
+
+void SyncedMemory::CountAllocation(size_t size) {
+  // Buffers may be allocated concurrently, e.g. by prefetch threads.
+  __sync_fetch_and_add(&num_allocations_, 1);
+  __sync_fetch_and_add(&allocated_bytes_, size);
+}
+
+void SyncedMemory::NewVersion() {
+  ++version_;
+}
+
+void SyncedMemory::Detach() {
+  if (parent_) {
+    // Going on from the version of the memory keeps the numbers increasing.
+    version_ = parent_->version();
+    parent_.reset();
+  }
+}
+
+SyncedMemory::SyncedMemory(const shared_ptr<SyncedMemory>& other,
+    size_t offset, size_t size)
+    : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+      own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+      gpu_device_(-1), parent_(other), offset_(offset), version_(0) {
+  CHECK(other);
+  CHECK_LE(offset + size, other->size());
+  // A view of a view is of the memory of the latter.
+  if (other->parent_) {
+    parent_ = other->parent_;
+    offset_ += other->offset_;
+  }
+}
+
+bool SyncedMemory::is_view_of(const SyncedMemory& other, size_t offset)
+    const {
+  if (other.parent_) {
+    return parent_ == other.parent_ && offset_ == other.offset_ + offset;
+  }
+  return parent_.get() == &other && offset_ == offset;
+}
+
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
@@ -26,6 +77,7 @@ inline void SyncedMemory::to_cpu() {
   switch (head_) {
   case UNINITIALIZED:
     CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CountAllocation(size_);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -34,6 +86,7 @@ inline void SyncedMemory::to_cpu() {
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
       CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CountAllocation(size_);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -54,6 +107,7 @@ inline void SyncedMemory::to_gpu() {
   case UNINITIALIZED:
     CUDA_CHECK(cudaGetDevice(&gpu_device_));
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    CountAllocation(size_);
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
@@ -62,6 +116,7 @@ inline void SyncedMemory::to_gpu() {
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaGetDevice(&gpu_device_));
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      CountAllocation(size_);
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
@@ -77,22 +132,31 @@ inline void SyncedMemory::to_gpu() {
 }
 
 const void* SyncedMemory::cpu_data() {
+  if (parent_) {
+    return static_cast<const char*>(parent_->cpu_data()) + offset_;
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
 
 void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
+  // A view stops sharing the memory it was of.
+  Detach();
   if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  NewVersion();
 }
 
 const void* SyncedMemory::gpu_data() {
 #ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<const char*>(parent_->gpu_data()) + offset_;
+  }
   to_gpu();
   return (const void*)gpu_ptr_;
 #else
@@ -104,6 +168,7 @@ const void* SyncedMemory::gpu_data() {
 void SyncedMemory::set_gpu_data(void* data) {
 #ifndef CPU_ONLY
   CHECK(data);
+  Detach();
   if (own_gpu_data_) {
     int initial_device;
     cudaGetDevice(&initial_device);
@@ -116,21 +181,30 @@ void SyncedMemory::set_gpu_data(void* data) {
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  NewVersion();
 #else
   NO_GPU;
 #endif
 }
 
 void* SyncedMemory::mutable_cpu_data() {
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_cpu_data()) + offset_;
+  }
   to_cpu();
   head_ = HEAD_AT_CPU;
+  NewVersion();
   return cpu_ptr_;
 }
 
 void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_gpu_data()) + offset_;
+  }
   to_gpu();
   head_ = HEAD_AT_GPU;
+  NewVersion();
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -140,6 +214,10 @@ void* SyncedMemory::mutable_gpu_data() {
 
 #ifndef CPU_ONLY
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
+  if (parent_) {
+    parent_->async_gpu_push(stream);
+    return;
+  }
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
     CUDA_CHECK(cudaGetDevice(&gpu_device_));
@@ -1,5 +1,8 @@
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
@@ -87,4 +90,40 @@ TYPED_TEST(BenchmarkTest, TestTimerSeconds) {
   EXPECT_TRUE(timer.has_run_at_least_once());
 }
 
+TYPED_TEST(BenchmarkTest, TestPercentile) {
+  vector<double> values;
+  for (int i = 10; i > 0; --i) {
+    values.push_back(i);
+  }
+  EXPECT_EQ(1, Percentile(values, 0));
+  EXPECT_EQ(10, Percentile(values, 100));
+  EXPECT_DOUBLE_EQ(5.5, Percentile(values, 50));
+  EXPECT_DOUBLE_EQ(9.1, Percentile(values, 90));
+  EXPECT_EQ(3, Percentile(vector<double>(1, 3), 99));
+  const BenchmarkStats stats = SummarizeTimes(values);
+  EXPECT_EQ(10, stats.repetitions);
+  EXPECT_EQ(1, stats.min);
+  EXPECT_EQ(10, stats.max);
+  EXPECT_DOUBLE_EQ(5.5, stats.mean);
+  EXPECT_DOUBLE_EQ(5.5, stats.median);
+  EXPECT_NEAR(2.872, stats.stddev, 1e-3);
+}
+
+static void SleepAndCount(int* calls) {
+  ++*calls;
+  boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+}
+
+TYPED_TEST(BenchmarkTest, TestRunBenchmark) {
+  int calls = 0;
+  const BenchmarkStats stats =
+      RunBenchmark(boost::bind(&SleepAndCount, &calls), 2, 5);
+  EXPECT_EQ(7, calls);
+  EXPECT_EQ(5, stats.repetitions);
+  EXPECT_GE(stats.min, 10000 - kMillisecondsThreshold * 1000);
+  EXPECT_LE(stats.min, stats.median);
+  EXPECT_LE(stats.median, stats.p99);
+  EXPECT_LE(stats.p99, stats.max);
+}
+
 }  // namespace caffe
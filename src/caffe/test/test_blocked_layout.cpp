@@ -0,0 +1,45 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/blocked_layout.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class BlockedLayoutTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(BlockedLayoutTest, TestDtypes);
+
+TYPED_TEST(BlockedLayoutTest, TestRoundTrip) {
+  // Two images of 11 channels, the second block of which is padded.
+  const int kNum = 2, kChannels = 11, kSpatialDim = 3;
+  const int count = kNum * kChannels * kSpatialDim;
+  vector<TypeParam> data(count);
+  for (int i = 0; i < count; ++i) {
+    data[i] = i + 1;
+  }
+  ASSERT_EQ(2, channel_blocks(kChannels));
+  vector<TypeParam> blocked(kNum * 2 * kChannelBlock * kSpatialDim, -1);
+  caffe_cpu_to_blocked(kNum, kChannels, kSpatialDim, &data[0], &blocked[0]);
+  for (int n = 0; n < kNum; ++n) {
+    for (int c = 0; c < 2 * kChannelBlock; ++c) {
+      for (int i = 0; i < kSpatialDim; ++i) {
+        const TypeParam value = blocked[((n * 2 + c / kChannelBlock) *
+            kSpatialDim + i) * kChannelBlock + c % kChannelBlock];
+        EXPECT_EQ(c < kChannels ? data[(n * kChannels + c) * kSpatialDim + i]
+            : 0, value);
+      }
+    }
+  }
+  vector<TypeParam> result(count);
+  caffe_cpu_from_blocked(kNum, kChannels, kSpatialDim, &blocked[0],
+      &result[0]);
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(data[i], result[i]);
+  }
+}
+
+}  // namespace caffe
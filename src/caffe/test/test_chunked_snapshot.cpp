@@ -0,0 +1,98 @@
+#include <boost/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/chunked_snapshot.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ChunkedSnapshotTest : public ::testing::Test {
+ protected:
+  ChunkedSnapshotTest() {
+    MakeTempDir(&temp_dir_);
+    LayerParameter* layer_param = net_param_.add_layer();
+    layer_param->set_name("ip");
+    // A blob spanning two chunks, and a small one holding doubles.
+    BlobProto* weights = layer_param->add_blobs();
+    for (int i = 0; i < kSnapshotChunkSize + 3; ++i) {
+      weights->add_data(i * 0.5f);
+    }
+    BlobProto* bias = layer_param->add_blobs();
+    bias->add_double_data(1.25);
+    bias->add_double_diff(-2.5);
+  }
+
+  int NumChunkFiles() {
+    int count = 0;
+    for (boost::filesystem::directory_iterator it(temp_dir_ + "/chunks"), end;
+         it != end; ++it) {
+      ++count;
+    }
+    return count;
+  }
+
+  string temp_dir_;
+  NetParameter net_param_;
+};
+
+TEST_F(ChunkedSnapshotTest, TestRoundTrip) {
+  const string manifest = temp_dir_ + "/net.caffemodel.manifest";
+  NetParameter written(net_param_);
+  WriteChunkedProto(&written, manifest, "chunks");
+  EXPECT_EQ(0, written.layer(0).blobs(0).data_size());
+  EXPECT_EQ(2, written.layer(0).blobs(0).data_chunk_size());
+  EXPECT_EQ(1, written.layer(0).blobs(1).data_chunk_size());
+  EXPECT_EQ(1, written.layer(0).blobs(1).diff_chunk_size());
+  EXPECT_EQ(4, NumChunkFiles());
+  NetParameter read;
+  ReadChunkedProtoOrDie(manifest, &read);
+  EXPECT_EQ(net_param_.SerializeAsString(), read.SerializeAsString());
+  vector<string> chunks;
+  GetSnapshotChunks(written, &chunks);
+  EXPECT_EQ(4, chunks.size());
+}
+
+TEST_F(ChunkedSnapshotTest, TestOnlyChangedChunksAreWritten) {
+  NetParameter first(net_param_);
+  WriteChunkedProto(&first, temp_dir_ + "/1.caffemodel.manifest", "chunks");
+  EXPECT_EQ(4, NumChunkFiles());
+  // Same values: all chunks are reused.
+  NetParameter second(net_param_);
+  WriteChunkedProto(&second, temp_dir_ + "/2.caffemodel.manifest", "chunks");
+  EXPECT_EQ(4, NumChunkFiles());
+  // Changing the last weight only rewrites the second chunk of the weights.
+  NetParameter third(net_param_);
+  third.mutable_layer(0)->mutable_blobs(0)->set_data(kSnapshotChunkSize, -1);
+  WriteChunkedProto(&third, temp_dir_ + "/3.caffemodel.manifest", "chunks");
+  EXPECT_EQ(5, NumChunkFiles());
+  EXPECT_EQ(first.layer(0).blobs(0).data_chunk(0),
+            third.layer(0).blobs(0).data_chunk(0));
+  EXPECT_NE(first.layer(0).blobs(0).data_chunk(1),
+            third.layer(0).blobs(0).data_chunk(1));
+  NetParameter read;
+  ReadChunkedProtoOrDie(temp_dir_ + "/3.caffemodel.manifest", &read);
+  EXPECT_EQ(-1, read.layer(0).blobs(0).data(kSnapshotChunkSize));
+  EXPECT_EQ(kSnapshotChunkSize + 3, read.layer(0).blobs(0).data_size());
+}
+
+TEST_F(ChunkedSnapshotTest, TestSolverState) {
+  SolverState state;
+  state.set_iter(7);
+  state.set_learned_net("net.caffemodel.manifest");
+  state.add_history()->add_data(3);
+  SolverState written(state);
+  const string manifest = temp_dir_ + "/net.solverstate.manifest";
+  WriteChunkedProto(&written, manifest, "chunks");
+  SolverState read;
+  ReadChunkedProtoOrDie(manifest, &read);
+  EXPECT_EQ(state.SerializeAsString(), read.SerializeAsString());
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/concat_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -140,6 +141,35 @@ TYPED_TEST(ConcatLayerTest, TestForwardNum) {
   }
 }
 
+TYPED_TEST(ConcatLayerTest, TestForwardNumViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.set_share_views(true);
+  layer.SetUp(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  // The bottoms are now views of the top, and kept their values.
+  EXPECT_EQ(this->blob_top_->cpu_data(), this->blob_bottom_0_->cpu_data());
+  EXPECT_EQ(this->blob_top_->cpu_data() + this->blob_bottom_0_->count(),
+      this->blob_bottom_2_->cpu_data());
+  EXPECT_EQ(this->blob_top_->cpu_diff() + this->blob_bottom_0_->count(),
+      this->blob_bottom_2_->cpu_diff());
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(i < this->blob_bottom_0_->count() ? 1 : 3,
+        this->blob_top_->cpu_data()[i]);
+  }
+  // Bottoms writing to memory of their own are copied again.
+  Blob<Dtype> data(this->blob_bottom_2_->shape());
+  caffe_set(data.count(), Dtype(4), data.mutable_cpu_data());
+  this->blob_bottom_2_->set_cpu_data(data.mutable_cpu_data());
+  layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(i < this->blob_bottom_0_->count() ? 1 : 4,
+        this->blob_top_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(ConcatLayerTest, TestForwardChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -186,6 +216,17 @@ TYPED_TEST(ConcatLayerTest, TestGradientNum) {
     this->blob_top_vec_);
 }
 
+TYPED_TEST(ConcatLayerTest, TestGradientNumViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.set_share_views(true);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradient(&layer, this->blob_bottom_vec_1_,
+    this->blob_top_vec_);
+}
+
 TYPED_TEST(ConcatLayerTest, TestGradientChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
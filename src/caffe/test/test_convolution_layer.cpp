@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -495,6 +496,97 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestConvolutionStoragePrecision) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.set_storage_precision(FP16);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution, within the precision of the
+  // weights.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-2);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestBlockedLayout) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // 16 channels given in the blocked layout to 5 outputs taken in the usual
+  // one, then 11 channels in the usual layout to 8 outputs in the blocked
+  // one, with dilation.
+  const int kChannels[2] = {16, 11};
+  const int kNumOutput[2] = {5, 8};
+  for (int i = 0; i < 2; ++i) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(2 - i);
+    convolution_param->add_pad(1);
+    convolution_param->add_dilation(1 + i);
+    convolution_param->set_num_output(kNumOutput[i]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    this->blob_bottom_->Reshape(2, kChannels[i], 7, 6);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_TRUE(layer.HandlesBlockedLayout());
+    caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    Blob<Dtype> blocked_bottom(this->blob_bottom_->shape());
+    vector<Blob<Dtype>*> bottom_vec(1, i == 0 ? &blocked_bottom :
+        this->blob_bottom_);
+    if (i == 0) {
+      caffe_cpu_to_blocked(2, kChannels[i], this->blob_bottom_->count(2),
+          this->blob_bottom_->cpu_data(), blocked_bottom.mutable_cpu_data());
+    }
+    layer.set_blocked_layout(vector<bool>(1, i == 0), vector<bool>(1, i == 1));
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    Blob<Dtype> top(this->blob_top_->shape());
+    if (i == 1) {
+      caffe_cpu_from_blocked(2, kNumOutput[i], this->blob_top_->count(2),
+          this->blob_top_->cpu_data(), top.mutable_cpu_data());
+    } else {
+      top.CopyFrom(*this->blob_top_);
+    }
+    const Dtype* top_data = top.cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int j = 0; j < top.count(); ++j) {
+      EXPECT_NEAR(top_data[j], ref_top_data[j], 1e-3);
+    }
+    // Without blocked bottoms and tops, the layer is back to the usual one.
+    layer.set_blocked_layout(vector<bool>(), vector<bool>());
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int j = 0; j < top.count(); ++j) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[j], ref_top_data[j], 1e-3);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -0,0 +1,107 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/decoded_image_cache.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DecodedImageCacheTest : public ::testing::Test {
+ protected:
+  DecodedImageCacheTest() {
+    MakeTempFilename(&filename_);
+  }
+
+  // A height x width x 3 image whose pixels depend on seed.
+  static vector<uint8_t> MakeImage(int height, int width, int seed) {
+    vector<uint8_t> pixels(height * width * 3);
+    for (int i = 0; i < pixels.size(); ++i) {
+      pixels[i] = static_cast<uint8_t>(i * 7 + seed);
+    }
+    return pixels;
+  }
+
+  static void ExpectImage(DecodedImageCache* cache, const string& key,
+      int height, int width, int seed) {
+    int cached_height, cached_width, cached_channels;
+    vector<uint8_t> pixels;
+    ASSERT_TRUE(cache->Get(key, &cached_height, &cached_width,
+        &cached_channels, &pixels)) << key;
+    EXPECT_EQ(height, cached_height);
+    EXPECT_EQ(width, cached_width);
+    EXPECT_EQ(3, cached_channels);
+    EXPECT_TRUE(pixels == MakeImage(height, width, seed)) << key;
+  }
+
+  static bool Contains(DecodedImageCache* cache, const string& key) {
+    int height, width, channels;
+    vector<uint8_t> pixels;
+    return cache->Get(key, &height, &width, &channels, &pixels);
+  }
+
+  string filename_;
+};
+
+TEST_F(DecodedImageCacheTest, TestPutGet) {
+  DecodedImageCache cache(filename_, 1 << 20, 1024);
+  EXPECT_FALSE(Contains(&cache, "a.jpg"));
+  cache.Put("a.jpg", 10, 20, 3, &MakeImage(10, 20, 1)[0]);
+  cache.Put("b.jpg", 5, 4, 3, &MakeImage(5, 4, 2)[0]);
+  ExpectImage(&cache, "a.jpg", 10, 20, 1);
+  ExpectImage(&cache, "b.jpg", 5, 4, 2);
+  EXPECT_FALSE(Contains(&cache, "c.jpg"));
+  EXPECT_EQ(2, cache.num_images());
+  EXPECT_EQ(2u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+  EXPECT_EQ(0u, cache.evictions());
+}
+
+TEST_F(DecodedImageCacheTest, TestShared) {
+  // A second mapping, as another process would have, sees the images of the
+  // first one, as does a later run.
+  DecodedImageCache* cache = new DecodedImageCache(filename_, 1 << 20, 1024);
+  DecodedImageCache other(filename_, 1 << 20, 1024);
+  cache->Put("a.jpg", 10, 20, 3, &MakeImage(10, 20, 1)[0]);
+  ExpectImage(&other, "a.jpg", 10, 20, 1);
+  other.Put("b.jpg", 5, 4, 3, &MakeImage(5, 4, 2)[0]);
+  ExpectImage(cache, "b.jpg", 5, 4, 2);
+  delete cache;
+  DecodedImageCache reopened(filename_, 1 << 20, 1024);
+  ExpectImage(&reopened, "a.jpg", 10, 20, 1);
+  ExpectImage(&reopened, "b.jpg", 5, 4, 2);
+}
+
+TEST_F(DecodedImageCacheTest, TestEviction) {
+  // Room for about 3 images of 10 x 10 x 3: adding more evicts the oldest.
+  DecodedImageCache cache(filename_, 1000, 100);
+  for (int i = 0; i < 6; ++i) {
+    cache.Put(format_int(i), 10, 10, 3, &MakeImage(10, 10, i)[0]);
+    ExpectImage(&cache, format_int(i), 10, 10, i);
+  }
+  EXPECT_LE(cache.num_images(), 3);
+  EXPECT_GT(cache.evictions(), 0u);
+  EXPECT_FALSE(Contains(&cache, format_int(0)));
+  ExpectImage(&cache, format_int(5), 10, 10, 5);
+  // Images larger than the cache are not added.
+  cache.Put("large", 20, 20, 3, &MakeImage(20, 20, 0)[0]);
+  EXPECT_FALSE(Contains(&cache, "large"));
+  ExpectImage(&cache, format_int(5), 10, 10, 5);
+}
+
+TEST_F(DecodedImageCacheTest, TestPutExisting) {
+  DecodedImageCache cache(filename_, 1 << 20, 1024);
+  cache.Put("a.jpg", 10, 20, 3, &MakeImage(10, 20, 1)[0]);
+  cache.Put("a.jpg", 10, 20, 3, &MakeImage(10, 20, 1)[0]);
+  EXPECT_EQ(1, cache.num_images());
+  ExpectImage(&cache, "a.jpg", 10, 20, 1);
+}
+
+}  // namespace caffe
@@ -175,4 +175,69 @@ TYPED_TEST(EmbedLayerTest, TestGradientWithBias) {
       this->blob_top_vec_, -2);
 }
 
+TYPED_TEST(EmbedLayerTest, TestGradientSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(10);
+  embed_param->set_input_dim(5);
+  embed_param->set_sparse_gradient(true);
+  embed_param->mutable_weight_filler()->set_type("uniform");
+  embed_param->mutable_weight_filler()->set_min(-10);
+  embed_param->mutable_weight_filler()->set_max(10);
+  embed_param->mutable_bias_filler()->CopyFrom(embed_param->weight_filler());
+  EmbedLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  this->blob_bottom_->mutable_cpu_data()[0] = 4;
+  this->blob_bottom_->mutable_cpu_data()[1] = 2;
+  this->blob_bottom_->mutable_cpu_data()[2] = 2;
+  this->blob_bottom_->mutable_cpu_data()[3] = 3;
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, -2);
+}
+
+TYPED_TEST(EmbedLayerTest, TestBackwardSparseGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(10);
+  embed_param->set_input_dim(8);
+  embed_param->mutable_weight_filler()->set_type("gaussian");
+  EmbedLayer<Dtype> dense_layer(layer_param);
+  dense_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_FALSE(dense_layer.blobs()[0]->row_sparse_diff());
+  embed_param->set_sparse_gradient(true);
+  EmbedLayer<Dtype> sparse_layer(layer_param);
+  sparse_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype>* weights = sparse_layer.blobs()[0].get();
+  ASSERT_TRUE(weights->row_sparse_diff());
+  EXPECT_EQ(0, weights->diff_rows().size());
+  // Accumulate the gradients of two batches, as with iter_size 2.
+  const int kIndices[2][4] = { { 6, 1, 6, 3 }, { 0, 3, 7, 1 } };
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  vector<bool> propagate_down(1, false);
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      this->blob_bottom_->mutable_cpu_data()[j] = kIndices[i][j];
+    }
+    filler.Fill(this->blob_top_);
+    dense_layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    sparse_layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+  }
+  const int kRows[] = { 0, 1, 3, 6, 7 };
+  ASSERT_EQ(5, weights->diff_rows().size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(kRows[i], weights->diff_rows()[i]);
+  }
+  const Blob<Dtype>* dense_weights = dense_layer.blobs()[0].get();
+  for (int i = 0; i < weights->count(); ++i) {
+    EXPECT_EQ(dense_weights->cpu_diff()[i], weights->cpu_diff()[i]);
+  }
+  weights->ClearDiffRows();
+  EXPECT_EQ(0, weights->diff_rows().size());
+}
+
 }  // namespace caffe
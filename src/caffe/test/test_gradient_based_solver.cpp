@@ -8,9 +8,11 @@
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
+#include "caffe/filler.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/solver_factory.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -26,7 +28,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
  protected:
   GradientBasedSolverTest() :
       seed_(1701), num_(4), channels_(3), height_(10), width_(10),
-      share_(false) {
+      share_(false), fused_(false), snapshot_async_(false),
+      snapshot_chunked_(false) {
         input_file_ = new string(
         CMAKE_SOURCE_DIR "caffe/test/test_data/solver_data_list.txt" CMAKE_EXT);
       }
@@ -42,6 +45,9 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   // TODO this is brittle and the hdf5 file should be checked instead.
   int num_, channels_, height_, width_;
   bool share_;
+  bool fused_;
+  bool snapshot_async_;
+  bool snapshot_chunked_;
   Dtype delta_;  // Stability constant for RMSProp, AdaGrad, AdaDelta and Adam
 
   // Test data: check out generate_sample_data.py in the same directory.
@@ -176,6 +182,15 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     if (momentum != 0) {
       proto << "momentum: " << momentum << " ";
     }
+    if (fused_) {
+      proto << "fused_update: true ";
+    }
+    if (snapshot_async_) {
+      proto << "snapshot_async: true ";
+    }
+    if (snapshot_chunked_) {
+      proto << "snapshot_format: CHUNKED ";
+    }
     MakeTempDir(&snapshot_prefix_);
     proto << "snapshot_prefix: '" << snapshot_prefix_ << "/' ";
     if (snapshot) {
@@ -212,6 +227,9 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
       ostringstream resume_file;
       resume_file << snapshot_prefix_ << "/_iter_" << num_iters
                   << ".solverstate";
+      if (snapshot_chunked_) {
+        resume_file << ".manifest";
+      }
       string resume_filename = resume_file.str();
       return resume_filename;
     }
@@ -650,6 +668,18 @@ TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.5;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -673,6 +703,18 @@ TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(SGDSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -696,6 +738,112 @@ TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(SGDSolverTest, TestSnapshotAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_async_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(SGDSolverTest, TestSnapshotChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_chunked_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(SGDSolverTest, TestSnapshotChunkedAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_async_ = true;
+  this->snapshot_chunked_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+
+// An SGDSolver subclass with its own unfused update rule only.
+template <typename Dtype>
+class HalfRateSGDSolver : public SGDSolver<Dtype> {
+ public:
+  explicit HalfRateSGDSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) {}
+
+ protected:
+  virtual void ComputeUpdateValue(int param_id, Dtype rate) {
+    SGDSolver<Dtype>::ComputeUpdateValue(param_id, rate / 2);
+  }
+  virtual inline bool HasFusedUpdate() const { return false; }
+};
+
+template <typename TypeParam>
+class HalfRateSGDSolverTest : public GradientBasedSolverTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitSolver(const SolverParameter& param) {
+    this->solver_.reset(new HalfRateSGDSolver<Dtype>(param));
+  }
+};
+
+TYPED_TEST_CASE(HalfRateSGDSolverTest, TestDtypesAndDevices);
+
+TYPED_TEST(HalfRateSGDSolverTest, TestFusedUpdateFallsBack) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Without a fused rule of its own, the fused update runs the solver's
+  // unfused one rather than the SGD rule.
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->RunLeastSquaresSolver(kLearningRate, kWeightDecay, kMomentum,
+      kNumIters);
+  vector<shared_ptr<Blob<Dtype> > > param_copies;
+  const vector<Blob<Dtype>*>& params = this->solver_->net()->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    param_copies.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    param_copies[i]->CopyFrom(*params[i], false, true);
+  }
+  this->fused_ = true;
+  this->RunLeastSquaresSolver(kLearningRate, kWeightDecay, kMomentum,
+      kNumIters);
+  const vector<Blob<Dtype>*>& fused_params =
+      this->solver_->net()->learnable_params();
+  ASSERT_EQ(param_copies.size(), fused_params.size());
+  for (int i = 0; i < fused_params.size(); ++i) {
+    for (int j = 0; j < fused_params[i]->count(); ++j) {
+      EXPECT_EQ(param_copies[i]->cpu_data()[j], fused_params[i]->cpu_data()[j])
+          << "param " << i << " data differed at dim " << j;
+    }
+  }
+}
+
 
 template <typename TypeParam>
 class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
@@ -750,6 +898,19 @@ TYPED_TEST(AdaGradSolverTest,
   }
 }
 
+TYPED_TEST(AdaGradSolverTest,
+      TestAdaGradLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(AdaGradSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -773,6 +934,18 @@ TYPED_TEST(AdaGradSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(AdaGradSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(AdaGradSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -796,6 +969,18 @@ TYPED_TEST(AdaGradSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(AdaGradSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 
 template <typename TypeParam>
 class NesterovSolverTest : public GradientBasedSolverTest<TypeParam> {
@@ -884,6 +1069,19 @@ TYPED_TEST(NesterovSolverTest,
   }
 }
 
+TYPED_TEST(NesterovSolverTest,
+           TestNesterovLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(NesterovSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -907,6 +1105,18 @@ TYPED_TEST(NesterovSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(NesterovSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(NesterovSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -930,6 +1140,18 @@ TYPED_TEST(NesterovSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(NesterovSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 template <typename TypeParam>
 class AdaDeltaSolverTest : public GradientBasedSolverTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -1013,6 +1235,19 @@ TYPED_TEST(AdaDeltaSolverTest,
   }
 }
 
+TYPED_TEST(AdaDeltaSolverTest,
+           TestAdaDeltaLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.1;
+  const Dtype kMomentum = 0.95;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(AdaDeltaSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.1;
@@ -1036,6 +1271,18 @@ TYPED_TEST(AdaDeltaSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(AdaDeltaSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.1;
+  const Dtype kMomentum = 0.95;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(AdaDeltaSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.1;
@@ -1059,6 +1306,18 @@ TYPED_TEST(AdaDeltaSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(AdaDeltaSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.1;
+  const Dtype kMomentum = 0.95;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 template <typename TypeParam>
 class AdamSolverTest : public GradientBasedSolverTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -1115,6 +1374,18 @@ TYPED_TEST(AdamSolverTest, TestAdamLeastSquaresUpdateWithEverythingShare) {
   }
 }
 
+TYPED_TEST(AdamSolverTest, TestAdamLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(AdamSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1138,6 +1409,18 @@ TYPED_TEST(AdamSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(AdamSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(AdamSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1161,6 +1444,42 @@ TYPED_TEST(AdamSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(AdamSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(AdamSolverTest, TestSnapshotAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_async_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(AdamSolverTest, TestSnapshotChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_chunked_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 template <typename TypeParam>
 class RMSPropSolverTest : public GradientBasedSolverTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -1218,6 +1537,19 @@ TYPED_TEST(RMSPropSolverTest,
   }
 }
 
+TYPED_TEST(RMSPropSolverTest,
+      TestRMSPropLeastSquaresUpdateWithEverythingFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.0;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(RMSPropSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1241,6 +1573,18 @@ TYPED_TEST(RMSPropSolverTest, TestLeastSquaresUpdateWithEverythingAccumShare) {
       kIterSize);
 }
 
+TYPED_TEST(RMSPropSolverTest, TestLeastSquaresUpdateWithEverythingAccumFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.0;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->fused_ = true;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
 TYPED_TEST(RMSPropSolverTest, TestSnapshot) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1264,4 +1608,155 @@ TYPED_TEST(RMSPropSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(RMSPropSolverTest, TestSnapshotFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  this->fused_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+
+template <typename Dtype>
+class SparseGradientSolverTest : public CPUDeviceTest<Dtype> {
+ protected:
+  SparseGradientSolverTest() : seed_(1701), input_dim_(10), num_output_(3) {}
+
+  // Trains an embedding of input_dim_ rows towards random targets, on a new
+  // batch of indices every iteration, and returns the initial and the final
+  // weights. Batches of input_dim_ indices visit all rows.
+  void Train(const string& solver_params, bool sparse_gradient,
+      int batch_size, int num_iters, vector<Dtype>* initial_weights,
+      vector<Dtype>* weights) {
+    ostringstream proto;
+    proto <<
+       "net_param { "
+       "  name: 'EmbedTestNet' "
+       "  input: 'data' "
+       "  input_shape { dim: " << batch_size << " } "
+       "  input: 'targets' "
+       "  input_shape { dim: " << batch_size << " dim: " << num_output_
+       << " } "
+       "  layer { "
+       "    name: 'embed' "
+       "    type: 'Embed' "
+       "    embed_param { "
+       "      num_output: " << num_output_ << " "
+       "      input_dim: " << input_dim_ << " "
+       "      sparse_gradient: " << (sparse_gradient ? "true" : "false") << " "
+       "      weight_filler { type: 'gaussian' } "
+       "      bias_filler { type: 'gaussian' } "
+       "    } "
+       "    bottom: 'data' "
+       "    top: 'embed' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'EuclideanLoss' "
+       "    bottom: 'embed' "
+       "    bottom: 'targets' "
+       "  } "
+       "} "
+       "base_lr: 0.1 "
+       "lr_policy: 'fixed' "
+       "solver_mode: CPU "
+       << solver_params;
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    Caffe::set_random_seed(seed_);
+    shared_ptr<Solver<Dtype> > solver(
+        SolverRegistry<Dtype>::CreateSolver(param));
+    const Blob<Dtype>& weight_blob = *solver->net()->params()[0];
+    ASSERT_EQ(sparse_gradient, weight_blob.row_sparse_diff());
+    initial_weights->assign(weight_blob.cpu_data(),
+        weight_blob.cpu_data() + weight_blob.count());
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < num_iters; ++i) {
+      Blob<Dtype>* data = solver->net()->input_blobs()[0];
+      for (int n = 0; n < batch_size; ++n) {
+        data->mutable_cpu_data()[n] = (3 * n + i) % input_dim_;
+      }
+      filler.Fill(solver->net()->input_blobs()[1]);
+      solver->Step(1);
+    }
+    weights->assign(weight_blob.cpu_data(),
+        weight_blob.cpu_data() + weight_blob.count());
+  }
+
+  // Checks that lazy updates give the same weights as dense ones.
+  void TestMatchesDense(const string& solver_params, int batch_size,
+      int num_iters) {
+    vector<Dtype> initial_weights, dense_weights, sparse_weights;
+    Train(solver_params, false, batch_size, num_iters, &initial_weights,
+        &dense_weights);
+    Train(solver_params, true, batch_size, num_iters, &initial_weights,
+        &sparse_weights);
+    ASSERT_EQ(dense_weights.size(), sparse_weights.size());
+    for (int i = 0; i < dense_weights.size(); ++i) {
+      EXPECT_NEAR(dense_weights[i], sparse_weights[i], 1e-5);
+      EXPECT_NE(initial_weights[i], sparse_weights[i]);
+    }
+  }
+
+  int seed_;
+  int input_dim_;
+  int num_output_;
+};
+
+TYPED_TEST_CASE(SparseGradientSolverTest, TestDtypes);
+
+// Without momentum and weight decay, rows without gradient are not updated
+// by dense updates either.
+TYPED_TEST(SparseGradientSolverTest, TestSGDMatchesDense) {
+  this->TestMatchesDense("type: 'SGD' ", 4, 10);
+}
+
+TYPED_TEST(SparseGradientSolverTest, TestAdaGradMatchesDense) {
+  this->TestMatchesDense("type: 'AdaGrad' iter_size: 2 ", 4, 10);
+}
+
+TYPED_TEST(SparseGradientSolverTest, TestAdaGradFusedMatchesDense) {
+  this->TestMatchesDense("type: 'AdaGrad' fused_update: true ", 4, 10);
+}
+
+// With momentum and weight decay, the updates only match when every row has
+// a gradient.
+TYPED_TEST(SparseGradientSolverTest, TestSGDMomentumMatchesDenseOnAllRows) {
+  this->TestMatchesDense(
+      "type: 'SGD' momentum: 0.9 weight_decay: 0.01 ", this->input_dim_, 5);
+}
+
+TYPED_TEST(SparseGradientSolverTest, TestAdamMatchesDenseOnAllRows) {
+  this->TestMatchesDense(
+      "type: 'Adam' momentum: 0.9 weight_decay: 0.01 ", this->input_dim_, 5);
+}
+
+TYPED_TEST(SparseGradientSolverTest, TestAdamLazyUpdate) {
+  typedef TypeParam Dtype;
+  const string solver_params =
+      "type: 'Adam' momentum: 0.9 weight_decay: 0.01 ";
+  vector<Dtype> initial_weights, dense_weights, sparse_weights;
+  this->Train(solver_params, false, 4, 1, &initial_weights, &dense_weights);
+  this->Train(solver_params, true, 4, 1, &initial_weights, &sparse_weights);
+  // The batch has rows 0, 3, 6 and 9. The other rows keep their weights,
+  // rather than being decayed as by the dense update.
+  for (int row = 0; row < this->input_dim_; ++row) {
+    for (int j = 0; j < this->num_output_; ++j) {
+      const int i = row * this->num_output_ + j;
+      if (row % 3 == 0) {
+        EXPECT_NEAR(dense_weights[i], sparse_weights[i], 1e-5);
+        EXPECT_NE(initial_weights[i], sparse_weights[i]);
+      } else {
+        EXPECT_EQ(initial_weights[i], sparse_weights[i]);
+        EXPECT_NE(initial_weights[i], dense_weights[i]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
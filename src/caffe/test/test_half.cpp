@@ -0,0 +1,207 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/half_blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {};
+
+union FloatBitsForTest {
+  float value;
+  uint32_t bits;
+};
+
+TEST_F(HalfTest, TestValues) {
+  EXPECT_EQ(0x0000, float_to_half(0.f));
+  EXPECT_EQ(0x8000, float_to_half(-0.f));
+  EXPECT_EQ(0x3c00, float_to_half(1.f));
+  EXPECT_EQ(0xc000, float_to_half(-2.f));
+  EXPECT_EQ(0x3555, float_to_half(1.f / 3));
+  EXPECT_EQ(0x7bff, float_to_half(65504.f));
+  // The smallest normal and subnormal halves.
+  EXPECT_EQ(0x0400, float_to_half(std::ldexp(1.f, -14)));
+  EXPECT_EQ(0x0001, float_to_half(std::ldexp(1.f, -24)));
+  EXPECT_EQ(0x0000, float_to_half(std::ldexp(1.f, -26)));
+  EXPECT_EQ(0x7c00, float_to_half(std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0xfc00, float_to_half(-1e6f));
+  const uint16_t nan = float_to_half(std::numeric_limits<float>::quiet_NaN());
+  EXPECT_EQ(0x7c00, nan & 0x7c00);
+  EXPECT_NE(0, nan & 0x3ff);
+}
+
+TEST_F(HalfTest, TestRounding) {
+  // Halfway between two halves, ties go to the even one.
+  EXPECT_EQ(0x3c00, float_to_half(1.f + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, float_to_half(1.f + 3 * std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c01, float_to_half(1.f + std::ldexp(1.f, -11) +
+      std::ldexp(1.f, -20)));
+  EXPECT_EQ(0x7bff, float_to_half(65519.f));
+  EXPECT_EQ(0x7c00, float_to_half(65520.f));
+  EXPECT_EQ(0x0000, float_to_half(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0002, float_to_half(3 * std::ldexp(1.f, -25)));
+}
+
+TEST_F(HalfTest, TestRoundTrip) {
+  // Every half but the NaNs converts to a float and back to itself.
+  for (int i = 0; i < 65536; ++i) {
+    const uint16_t half = i;
+    const float value = half_to_float(half);
+    if ((half & 0x7c00) == 0x7c00 && (half & 0x3ff)) {
+      EXPECT_TRUE(std::isnan(value));
+    } else {
+      EXPECT_EQ(half, float_to_half(value));
+    }
+  }
+  EXPECT_EQ(1.f, half_to_float(0x3c00));
+  EXPECT_EQ(std::ldexp(1.f, -24), half_to_float(0x0001));
+}
+
+TEST_F(HalfTest, TestBfloat16Values) {
+  EXPECT_EQ(0x0000, float_to_bfloat16(0.f));
+  EXPECT_EQ(0x8000, float_to_bfloat16(-0.f));
+  EXPECT_EQ(0x3f80, float_to_bfloat16(1.f));
+  EXPECT_EQ(0xc000, float_to_bfloat16(-2.f));
+  EXPECT_EQ(0x3eab, float_to_bfloat16(1.f / 3));
+  EXPECT_EQ(0x7f80, float_to_bfloat16(std::numeric_limits<float>::infinity()));
+  // Halfway between two bfloat16s, ties go to the even one.
+  EXPECT_EQ(0x3f80, float_to_bfloat16(1.f + std::ldexp(1.f, -8)));
+  EXPECT_EQ(0x3f82, float_to_bfloat16(1.f + 3 * std::ldexp(1.f, -8)));
+  EXPECT_EQ(0x7f80, float_to_bfloat16(std::numeric_limits<float>::max()));
+  // A NaN with only low payload bits stays NaN.
+  FloatBitsForTest nan;
+  nan.bits = 0x7f800001;
+  EXPECT_TRUE(std::isnan(bfloat16_to_float(float_to_bfloat16(nan.value))));
+  // Every bfloat16 but the NaNs converts to a float and back to itself.
+  for (int i = 0; i < 65536; ++i) {
+    const uint16_t bfloat16 = i;
+    const float value = bfloat16_to_float(bfloat16);
+    if ((bfloat16 & 0x7f80) == 0x7f80 && (bfloat16 & 0x7f)) {
+      EXPECT_TRUE(std::isnan(value));
+    } else {
+      EXPECT_EQ(bfloat16, float_to_bfloat16(value));
+    }
+  }
+}
+
+TEST_F(HalfTest, TestArrays) {
+  // Longer than a vector of the F16C path, with a remainder.
+  const int kCount = 21;
+  float values[kCount];
+  for (int i = 0; i < kCount; ++i) {
+    values[i] = (i % 2 ? -1 : 1) * std::ldexp(1.f + i / 7.f, i - 10);
+  }
+  uint16_t halves[kCount];
+  float results[kCount];
+  caffe_cpu_float_to_half(kCount, values, halves);
+  caffe_cpu_half_to_float(kCount, halves, results);
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ(float_to_half(values[i]), halves[i]);
+    EXPECT_EQ(half_to_float(halves[i]), results[i]);
+    EXPECT_NEAR(values[i], results[i], std::fabs(values[i]) * 1e-3);
+  }
+  caffe_cpu_float_to_bfloat16(kCount, values, halves);
+  caffe_cpu_bfloat16_to_float(kCount, halves, results);
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ(float_to_bfloat16(values[i]), halves[i]);
+    EXPECT_NEAR(values[i], results[i], std::fabs(values[i]) * 4e-3);
+  }
+}
+
+template <typename Dtype>
+class HalfBlobTest : public ::testing::Test {
+ protected:
+  HalfBlobTest()
+      : weights_(new Blob<Dtype>(6, 4000, 1, 1)),
+        input_(new Blob<Dtype>(4000, 2, 1, 1)) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(weights_);
+    filler.Fill(input_);
+  }
+  virtual ~HalfBlobTest() {
+    delete weights_;
+    delete input_;
+  }
+
+  // Checks the products with a copy against those with the weights it
+  // converts back to. The rows are long enough to take several tiles.
+  void TestProducts(HalfBlob<Dtype>* half) {
+    const int kRows = 6, kDim = 4000, kCols = 2;
+    half->Update(*weights_);
+    ASSERT_EQ(weights_->count(), half->count());
+    vector<Dtype> rounded(half->count());
+    half->ToDtype(0, half->count(), &rounded[0]);
+    for (int i = 0; i < half->count(); ++i) {
+      EXPECT_NEAR(weights_->cpu_data()[i], rounded[i],
+          std::fabs(weights_->cpu_data()[i]) * 4e-3);
+    }
+    // W * B, with W starting from its second row.
+    vector<Dtype> expected(kRows * kCols), result(kRows * kCols);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, kRows - 1, kCols, kDim,
+        (Dtype)1., &rounded[kDim], input_->cpu_data(), (Dtype)0.,
+        &expected[0]);
+    half->cpu_gemm(kDim, kRows - 1, kCols, kDim, input_->cpu_data(),
+        &result[0]);
+    for (int i = 0; i < (kRows - 1) * kCols; ++i) {
+      EXPECT_NEAR(expected[i], result[i], 2e-3);
+    }
+    // A * W^T, with A the transpose of the input.
+    vector<Dtype> input_t(kDim * kCols);
+    for (int i = 0; i < kDim; ++i) {
+      for (int j = 0; j < kCols; ++j) {
+        input_t[j * kDim + i] = input_->cpu_data()[i * kCols + j];
+      }
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, kCols, kRows, kDim,
+        (Dtype)1., &input_t[0], &rounded[0], (Dtype)0., &expected[0]);
+    half->cpu_gemm_trans(kCols, kRows, kDim, &input_t[0], &result[0]);
+    for (int i = 0; i < kRows * kCols; ++i) {
+      EXPECT_NEAR(expected[i], result[i], 2e-3);
+    }
+  }
+
+  Blob<Dtype>* const weights_;
+  Blob<Dtype>* const input_;
+};
+
+TYPED_TEST_CASE(HalfBlobTest, TestDtypes);
+
+TYPED_TEST(HalfBlobTest, TestFP16) {
+  HalfBlob<TypeParam> half(FP16);
+  this->TestProducts(&half);
+  EXPECT_EQ(float_to_half(this->weights_->cpu_data()[7]), half.cpu_data()[7]);
+}
+
+TYPED_TEST(HalfBlobTest, TestBF16) {
+  HalfBlob<TypeParam> half(BF16);
+  this->TestProducts(&half);
+  EXPECT_EQ(float_to_bfloat16(this->weights_->cpu_data()[7]),
+      half.cpu_data()[7]);
+}
+
+TYPED_TEST(HalfBlobTest, TestUpdate) {
+  HalfBlob<TypeParam> half(FP16);
+  half.Update(*this->weights_);
+  EXPECT_EQ(float_to_half(this->weights_->cpu_data()[0]), half.cpu_data()[0]);
+  // Writes to the data, and sharing other data, are converted again.
+  this->weights_->mutable_cpu_data()[0] = 2;
+  half.Update(*this->weights_);
+  EXPECT_EQ(float_to_half(2.f), half.cpu_data()[0]);
+  Blob<TypeParam> other(6, 4000, 1, 1);
+  caffe_set(other.count(), TypeParam(3), other.mutable_cpu_data());
+  this->weights_->ShareData(other);
+  half.Update(*this->weights_);
+  EXPECT_EQ(float_to_half(3.f), half.cpu_data()[0]);
+}
+
+}  // namespace caffe
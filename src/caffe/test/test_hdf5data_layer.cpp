@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
@@ -8,7 +10,11 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layers/hdf5_data_layer.hpp"
+#include "caffe/layers/sparse_hdf5_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -133,4 +139,97 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+// Writes rows [first, first + num) of the sparse matrix of TestReadSparse, and
+// their labels, to a new HDF5 file, in the layout of scipy.sparse.csr_matrix.
+template <typename Dtype>
+static string WriteSparseHDF5File(int first, int num, int dim) {
+  vector<Dtype> values;
+  vector<int> indices;
+  vector<int> ptr(1, 0);
+  Blob<Dtype> label(num, 1, 1, 1);
+  for (int i = 0; i < num; ++i) {
+    // Row g has g % 3 nonzeros, g * 10 + k at column (g + k) % dim.
+    const int g = first + i;
+    for (int k = 0; k < g % 3; ++k) {
+      values.push_back(g * 10 + k);
+      indices.push_back((g + k) % dim);
+    }
+    ptr.push_back(values.size());
+    label.mutable_cpu_data()[i] = g;
+  }
+  Blob<Dtype> data(vector<int>(1, values.size()));
+  std::copy(values.begin(), values.end(), data.mutable_cpu_data());
+  vector<int> shape(2);
+  shape[0] = num;
+  shape[1] = dim;
+  string filename;
+  MakeTempFilename(&filename);
+  hid_t file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+      H5P_DEFAULT);
+  CHECK_GE(file_id, 0);
+  hid_t group_id = H5Gcreate2(file_id, "data", H5P_DEFAULT, H5P_DEFAULT,
+      H5P_DEFAULT);
+  CHECK_GE(group_id, 0);
+  hdf5_save_nd_dataset(group_id, "data", data);
+  hdf5_save_int_vector(group_id, "indices", indices);
+  hdf5_save_int_vector(group_id, "indptr", ptr);
+  hdf5_save_int_vector(group_id, "shape", shape);
+  H5Gclose(group_id);
+  hdf5_save_nd_dataset(file_id, "label", label);
+  H5Fclose(file_id);
+  return filename;
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestReadSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Two files of 3 rows each, read in batches of 4 that cross them.
+  const int num_rows = 3;
+  const int dim = 10;
+  string source;
+  MakeTempFilename(&source);
+  std::ofstream source_file(source.c_str());
+  source_file << WriteSparseHDF5File<Dtype>(0, num_rows, dim) << std::endl;
+  source_file << WriteSparseHDF5File<Dtype>(num_rows, num_rows, dim)
+      << std::endl;
+  source_file.close();
+
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 4;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(source);
+  SparseHDF5DataLayer<Dtype> layer(param);
+  EXPECT_TRUE(layer.SparseTopBlob(0));
+  EXPECT_FALSE(layer.SparseTopBlob(1));
+  SparseBlob<Dtype> data;
+  Blob<Dtype> label;
+  vector<Blob<Dtype>*> top_vec;
+  top_vec.push_back(&data);
+  top_vec.push_back(&label);
+  layer.SetUp(this->blob_bottom_vec_, top_vec);
+  EXPECT_EQ(data.shape(0), batch_size);
+  EXPECT_EQ(data.shape(1), dim);
+  EXPECT_EQ(label.shape(0), batch_size);
+
+  for (int iter = 0; iter < 6; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    ASSERT_EQ(data.shape(0), batch_size);
+    const int* ptr = data.cpu_ptr();
+    const int* indices = data.cpu_indices();
+    EXPECT_EQ(ptr[0], 0);
+    EXPECT_EQ(ptr[batch_size], data.nnz());
+    for (int i = 0; i < batch_size; ++i) {
+      const int g = (iter * batch_size + i) % (2 * num_rows);
+      EXPECT_EQ(g, label.cpu_data()[i]);
+      ASSERT_EQ(g % 3, ptr[i + 1] - ptr[i]) << "row " << g;
+      for (int k = 0; k < g % 3; ++k) {
+        EXPECT_EQ(g * 10 + k, data.cpu_data()[ptr[i] + k]);
+        EXPECT_EQ((g + k) % dim, indices[ptr[i] + k]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,164 @@
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceSessionTest : public CPUDeviceTest<Dtype> {
+ protected:
+  InferenceSessionTest() : seed_(1701) {
+    const string proto =
+        "name: 'SessionTestNetwork' "
+        "input: 'data' "
+        "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' } "
+        "  } "
+        "  param { name: 'ip_weights' } "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.mutable_state()->set_phase(TEST);
+    Caffe::set_random_seed(seed_);
+    model_.reset(new Net<Dtype>(param));
+  }
+
+  // Fills the input of net with values drawn from seed, runs Forward and
+  // returns a copy of the output.
+  static void Run(Net<Dtype>* net, int seed, vector<Dtype>* output) {
+    Caffe::set_random_seed(seed);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(net->input_blobs()[0]);
+    const Blob<Dtype>* prob = net->ForwardPrefilled()[0];
+    output->assign(prob->cpu_data(), prob->cpu_data() + prob->count());
+  }
+
+  static void RunSession(InferenceSession<Dtype>* session, int seed,
+      int num_iters, vector<vector<Dtype> >* outputs) {
+    outputs->resize(num_iters);
+    for (int i = 0; i < num_iters; ++i) {
+      Run(session->net().get(), seed + i, &(*outputs)[i]);
+    }
+  }
+
+  int seed_;
+  shared_ptr<Net<Dtype> > model_;
+};
+
+TYPED_TEST_CASE(InferenceSessionTest, TestDtypes);
+
+TYPED_TEST(InferenceSessionTest, TestSharesParams) {
+  InferenceSession<TypeParam> session(this->model_);
+  const Net<TypeParam>& net = *session.net();
+  ASSERT_EQ(this->model_->params().size(), net.params().size());
+  for (int i = 0; i < net.params().size(); ++i) {
+    EXPECT_EQ(this->model_->params()[i], net.params()[i]);
+  }
+  // Activations are private.
+  ASSERT_EQ(this->model_->blobs().size(), net.blobs().size());
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_NE(this->model_->blobs()[i]->cpu_data(),
+              net.blobs()[i]->cpu_data());
+  }
+}
+
+TYPED_TEST(InferenceSessionTest, TestForward) {
+  InferenceSession<TypeParam> session(this->model_);
+  vector<TypeParam> expected, output;
+  this->Run(this->model_.get(), 1, &expected);
+  this->Run(session.net().get(), 1, &output);
+  ASSERT_EQ(expected.size(), output.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], output[i]);
+  }
+}
+
+TYPED_TEST(InferenceSessionTest, TestSyncsParams) {
+  // Sessions sync the params on the thread that creates them, and on the one
+  // calling SyncParams, so that session threads never do.
+  Blob<TypeParam>* param = this->model_->params()[0].get();
+  Blob<TypeParam> fresh(param->shape());
+  param->ShareData(fresh);
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, param->data()->head());
+  InferenceSession<TypeParam> session(this->model_);
+  EXPECT_EQ(SyncedMemory::HEAD_AT_CPU, param->data()->head());
+  Blob<TypeParam> other(param->shape());
+  param->ShareData(other);
+  session.SyncParams();
+  EXPECT_EQ(SyncedMemory::HEAD_AT_CPU, param->data()->head());
+}
+
+TYPED_TEST(InferenceSessionTest, TestConcurrentForward) {
+  const int kNumSessions = 4;
+  const int kNumIters = 10;
+  vector<shared_ptr<InferenceSession<TypeParam> > > sessions;
+  for (int i = 0; i < kNumSessions; ++i) {
+    sessions.push_back(shared_ptr<InferenceSession<TypeParam> >(
+        new InferenceSession<TypeParam>(this->model_)));
+  }
+  vector<vector<vector<TypeParam> > > outputs(kNumSessions);
+  boost::thread_group threads;
+  for (int i = 0; i < kNumSessions; ++i) {
+    threads.create_thread(boost::bind(&TestFixture::RunSession,
+        sessions[i].get(), 100 * i, kNumIters, &outputs[i]));
+  }
+  threads.join_all();
+  // Each session gets the results of running its inputs on the model alone.
+  for (int i = 0; i < kNumSessions; ++i) {
+    for (int j = 0; j < kNumIters; ++j) {
+      vector<TypeParam> expected;
+      this->Run(this->model_.get(), 100 * i + j, &expected);
+      ASSERT_EQ(expected.size(), outputs[i][j].size());
+      for (int k = 0; k < expected.size(); ++k) {
+        EXPECT_EQ(expected[k], outputs[i][j][k]);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/sparse_blob.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -148,4 +149,175 @@ TYPED_TEST(InnerProductLayerTest, TestGradient) {
   }
 }
 
+// Builds a SparseBlob of the entries of bottom above 0.5, with one row per
+// item, and writes the same matrix into dense.
+template <typename Dtype>
+static void MakeSparseBottom(const Blob<Dtype>& bottom,
+    SparseBlob<Dtype>* sparse, Blob<Dtype>* dense) {
+  const int num = bottom.shape(0);
+  const int dim = bottom.count(1);
+  vector<Dtype> values;
+  vector<int> indices;
+  vector<int> ptr(1, 0);
+  for (int i = 0; i < num; ++i) {
+    for (int j = 0; j < dim; ++j) {
+      const Dtype value = bottom.cpu_data()[i * dim + j];
+      if (value > 0.5) {
+        values.push_back(value);
+        indices.push_back(j);
+      }
+    }
+    ptr.push_back(values.size());
+  }
+  vector<int> shape(2);
+  shape[0] = num;
+  shape[1] = dim;
+  sparse->Reshape(shape, values.size());
+  caffe_copy(values.size(), &values[0], sparse->mutable_cpu_data());
+  caffe_copy(indices.size(), &indices[0], sparse->mutable_cpu_indices());
+  caffe_copy(ptr.size(), &ptr[0], sparse->mutable_cpu_ptr());
+  dense->Reshape(shape);
+  sparse->ToDense(dense->mutable_cpu_data());
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  SparseBlob<Dtype> sparse;
+  Blob<Dtype> dense;
+  MakeSparseBottom(*this->blob_bottom_, &sparse, &dense);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> dense_layer(layer_param);
+  vector<Blob<Dtype>*> dense_bottom(1, &dense);
+  Blob<Dtype> dense_top;
+  vector<Blob<Dtype>*> dense_top_vec(1, &dense_top);
+  dense_layer.SetUp(dense_bottom, dense_top_vec);
+  dense_layer.Forward(dense_bottom, dense_top_vec);
+  // The sparse layer shares the weights of the dense one.
+  InnerProductLayer<Dtype> sparse_layer(layer_param);
+  this->blob_bottom_vec_.push_back(&sparse);
+  sparse_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < 2; ++i) {
+    sparse_layer.blobs()[i]->ShareData(*dense_layer.blobs()[i]);
+  }
+  sparse_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(dense_top.shape(), this->blob_top_->shape());
+  for (int i = 0; i < dense_top.count(); ++i) {
+    EXPECT_NEAR(dense_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+        1e-4);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardStoragePrecision) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  const Precision precisions[2] = {FP16, BF16};
+  for (int p = 0; p < 2; ++p) {
+    layer_param.set_storage_precision(precisions[p]);
+    InnerProductLayer<Dtype> half_layer(layer_param);
+    half_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 2; ++i) {
+      half_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+    }
+    half_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          precisions[p] == FP16 ? 1e-2 : 5e-2);
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardStoragePrecisionLargeBatch) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Large batches are compute-bound, so they use the Dtype weights.
+  Blob<Dtype> bottom(32, 3, 4, 5);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  this->blob_bottom_vec_.push_back(&bottom);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  layer_param.set_storage_precision(FP16);
+  InnerProductLayer<Dtype> half_layer(layer_param);
+  half_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < 2; ++i) {
+    half_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+  }
+  half_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestBackwardSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  SparseBlob<Dtype> sparse;
+  Blob<Dtype> dense;
+  MakeSparseBottom(*this->blob_bottom_, &sparse, &dense);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> dense_layer(layer_param);
+  vector<Blob<Dtype>*> dense_bottom(1, &dense);
+  Blob<Dtype> dense_top;
+  vector<Blob<Dtype>*> dense_top_vec(1, &dense_top);
+  dense_layer.SetUp(dense_bottom, dense_top_vec);
+  InnerProductLayer<Dtype> sparse_layer(layer_param);
+  this->blob_bottom_vec_.push_back(&sparse);
+  sparse_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&dense_top);
+  caffe_copy(dense_top.count(), dense_top.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  caffe_copy(dense_top.count(), dense_top.cpu_data(),
+      dense_top.mutable_cpu_diff());
+  for (int i = 0; i < 2; ++i) {
+    sparse_layer.blobs()[i]->ShareData(*dense_layer.blobs()[i]);
+    caffe_set(dense_layer.blobs()[i]->count(), Dtype(0),
+        dense_layer.blobs()[i]->mutable_cpu_diff());
+    caffe_set(sparse_layer.blobs()[i]->count(), Dtype(0),
+        sparse_layer.blobs()[i]->mutable_cpu_diff());
+  }
+  dense_layer.Backward(dense_top_vec, vector<bool>(1, false), dense_bottom);
+  sparse_layer.Backward(this->blob_top_vec_, vector<bool>(1, false),
+      this->blob_bottom_vec_);
+  for (int i = 0; i < 2; ++i) {
+    const Blob<Dtype>& expected = *dense_layer.blobs()[i];
+    const Blob<Dtype>& actual = *sparse_layer.blobs()[i];
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_NEAR(expected.cpu_diff()[j], actual.cpu_diff()[j], 1e-4);
+    }
+  }
+}
+
 }  // namespace caffe
@@ -250,6 +250,56 @@ TYPED_TEST(LRNLayerTest, TestGradientWithinChannel) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(LRNLayerTest, TestForwardBeta) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Some values of beta have their own code paths. The input spans more
+  // than one block of positions.
+  this->blob_bottom_->Reshape(2, 7, 17, 19);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const Dtype kBetas[] = {0.5, 1, 0.6};
+  const LRNParameter_NormRegion kRegions[] = {
+      LRNParameter_NormRegion_ACROSS_CHANNELS,
+      LRNParameter_NormRegion_WITHIN_CHANNEL};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 2; ++j) {
+      LayerParameter layer_param;
+      layer_param.mutable_lrn_param()->set_norm_region(kRegions[j]);
+      layer_param.mutable_lrn_param()->set_local_size(3);
+      layer_param.mutable_lrn_param()->set_beta(kBetas[i]);
+      LRNLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      Blob<Dtype> top_reference;
+      this->ReferenceLRNForward(*(this->blob_bottom_), layer_param,
+          &top_reference);
+      for (int k = 0; k < this->blob_bottom_->count(); ++k) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[k],
+                    top_reference.cpu_data()[k], this->epsilon_);
+      }
+    }
+  }
+}
+
+TYPED_TEST(LRNLayerTest, TestGradientWithinChannelLargeRegion) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_lrn_param()->set_norm_region(
+      LRNParameter_NormRegion_WITHIN_CHANNEL);
+  layer_param.mutable_lrn_param()->set_local_size(5);
+  layer_param.mutable_lrn_param()->set_beta(0.6);
+  LRNLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    this->blob_top_->mutable_cpu_diff()[i] = 1.;
+  }
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNLRNLayerTest : public GPUDeviceTest<Dtype> {
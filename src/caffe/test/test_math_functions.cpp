@@ -119,6 +119,69 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+// A 3 x 4 matrix with an empty row, in CSR and dense form, for the sparse
+// products.
+static const int kCsrIndices[] = {1, 3, 0, 1, 2};
+static const int kCsrPtr[] = {0, 2, 2, 5};
+
+TYPED_TEST(CPUMathFunctionsTest, TestCsrmm) {
+  const int M = 3, N = 5, K = 4;
+  const TypeParam values[] = {2, -1, 0.5, 3, -4};
+  TypeParam dense[M * K];
+  caffe_set(M * K, TypeParam(0), dense);
+  for (int i = 0; i < M; ++i) {
+    for (int j = kCsrPtr[i]; j < kCsrPtr[i + 1]; ++j) {
+      dense[i * K + kCsrIndices[j]] = values[j];
+    }
+  }
+  const TypeParam* B = this->blob_bottom_->cpu_data();
+  const TypeParam* C0 = this->blob_top_->cpu_data();
+  const CBLAS_TRANSPOSE trans[] = {CblasNoTrans, CblasTrans};
+  for (int t = 0; t < 2; ++t) {
+    for (int beta = 0; beta < 2; ++beta) {
+      TypeParam expected[M * N], C[M * N];
+      caffe_copy(M * N, C0, expected);
+      caffe_copy(M * N, C0, C);
+      caffe_cpu_gemm<TypeParam>(CblasNoTrans, trans[t], M, N, K, 1.5, dense,
+          B, beta, expected);
+      caffe_cpu_csrmm<TypeParam>(trans[t], M, N, K, 1.5, values, kCsrIndices,
+          kCsrPtr, B, beta, C);
+      for (int i = 0; i < M * N; ++i) {
+        EXPECT_NEAR(expected[i], C[i], 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestGemmCsr) {
+  const int M = 3, N = 5, K = 4;
+  const TypeParam values[] = {2, -1, 0.5, 3, -4};
+  TypeParam dense[M * K];
+  caffe_set(M * K, TypeParam(0), dense);
+  for (int i = 0; i < M; ++i) {
+    for (int j = kCsrPtr[i]; j < kCsrPtr[i + 1]; ++j) {
+      dense[i * K + kCsrIndices[j]] = values[j];
+    }
+  }
+  const TypeParam* B = this->blob_bottom_->cpu_data();
+  const TypeParam* C0 = this->blob_top_->cpu_data();
+  const CBLAS_TRANSPOSE trans[] = {CblasNoTrans, CblasTrans};
+  for (int t = 0; t < 2; ++t) {
+    for (int beta = 0; beta < 2; ++beta) {
+      TypeParam expected[N * K], C[N * K];
+      caffe_copy(N * K, C0, expected);
+      caffe_copy(N * K, C0, C);
+      caffe_cpu_gemm<TypeParam>(trans[t], CblasNoTrans, N, K, M, 1.5, B,
+          dense, beta, expected);
+      caffe_cpu_gemm_csr<TypeParam>(trans[t], M, N, K, 1.5, values,
+          kCsrIndices, kCsrPtr, B, beta, C);
+      for (int i = 0; i < N * K; ++i) {
+        EXPECT_NEAR(expected[i], C[i], 1e-4);
+      }
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -2,6 +2,10 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <stdint.h>
+
+#include <boost/thread.hpp>
+
 #include <string>
 #include <vector>
 
@@ -115,6 +119,239 @@ TYPED_TEST(MemoryDataLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(MemoryDataLayerTest, TestStreamingForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(this->batch_size_);
+  md_param->set_channels(this->channels_);
+  md_param->set_height(this->height_);
+  md_param->set_width(this->width_);
+  md_param->set_streaming(true);
+  MemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int num = 3 * this->batch_size_;
+  const int size = this->data_->offset(1);
+  for (int i = 0; i < num; ++i) {
+    uint64_t id;
+    ASSERT_TRUE(layer.PushData(this->data_->cpu_data() + i * size,
+        this->labels_->cpu_data()[i], &id));
+    EXPECT_EQ(static_cast<uint64_t>(i), id);
+    // Batches come out as soon as they are complete.
+    if ((i + 1) % this->batch_size_ == 0) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int first = i + 1 - this->batch_size_;
+      ASSERT_EQ(this->batch_size_, this->data_blob_->num());
+      ASSERT_EQ(this->batch_size_, static_cast<int>(layer.batch_ids().size()));
+      for (int j = 0; j < this->batch_size_; ++j) {
+        EXPECT_EQ(static_cast<uint64_t>(first + j), layer.batch_ids()[j]);
+        EXPECT_EQ(this->labels_->cpu_data()[first + j],
+            this->label_blob_->cpu_data()[j]);
+      }
+      for (int j = 0; j < this->data_blob_->count(); ++j) {
+        EXPECT_EQ(this->data_->cpu_data()[first * size + j],
+            this->data_blob_->cpu_data()[j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestStreamingTimeout) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(this->batch_size_);
+  md_param->set_channels(this->channels_);
+  md_param->set_height(this->height_);
+  md_param->set_width(this->width_);
+  md_param->set_streaming(true);
+  md_param->set_batch_timeout_ms(10);
+  MemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // A partial batch is output after the timeout.
+  const int size = this->data_->offset(1);
+  for (int i = 0; i < 3; ++i) {
+    layer.PushData(this->data_->cpu_data() + i * size,
+        this->labels_->cpu_data()[i]);
+  }
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(3, this->data_blob_->num());
+  EXPECT_EQ(3, this->label_blob_->num());
+  for (int j = 0; j < this->data_blob_->count(); ++j) {
+    EXPECT_EQ(this->data_->cpu_data()[j], this->data_blob_->cpu_data()[j]);
+  }
+}
+
+template <typename Dtype>
+static void PushDatums(MemoryDataLayer<Dtype>* layer, int producer, int num,
+    int size) {
+  for (int i = 0; i < num; ++i) {
+    // The values and label of the datum identify the sample.
+    Datum datum;
+    datum.set_channels(size);
+    datum.set_height(1);
+    datum.set_width(1);
+    datum.set_label(producer * num + i);
+    for (int j = 0; j < size; ++j) {
+      datum.add_float_data(producer * num + i + j);
+    }
+    layer->PushDatum(datum);
+  }
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestStreamingConcurrentPush) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumProducers = 3;
+  const int kNumPerProducer = 20;
+  const int size = 5;
+  LayerParameter layer_param;
+  layer_param.mutable_transform_param()->set_scale(2);
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(4);
+  md_param->set_channels(size);
+  md_param->set_height(1);
+  md_param->set_width(1);
+  md_param->set_streaming(true);
+  md_param->set_queue_capacity(6);
+  md_param->set_num_transform_threads(2);
+  MemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  boost::thread_group producers;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.create_thread(boost::bind(&PushDatums<Dtype>, &layer, i,
+        kNumPerProducer, size));
+  }
+  // Each producer's samples arrive transformed, and in the order it pushed
+  // them.
+  vector<int> next(kNumProducers, 0);
+  uint64_t next_id = 0;
+  for (int batch = 0; batch < kNumProducers * kNumPerProducer / 4; ++batch) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(4, this->data_blob_->num());
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(next_id++, layer.batch_ids()[i]);
+      const int sample = this->label_blob_->cpu_data()[i];
+      const int producer = sample / kNumPerProducer;
+      EXPECT_EQ(next[producer]++, sample % kNumPerProducer);
+      for (int j = 0; j < size; ++j) {
+        EXPECT_EQ(2 * (sample + j), this->data_blob_->cpu_data()[i * size + j]);
+      }
+    }
+  }
+  producers.join_all();
+  for (int i = 0; i < kNumProducers; ++i) {
+    EXPECT_EQ(kNumPerProducer, next[i]);
+  }
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestStreamingMixedPush) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumBatches = 50;
+  const int size = 3;
+  LayerParameter layer_param;
+  layer_param.mutable_transform_param()->set_scale(2);
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(2);
+  md_param->set_channels(size);
+  md_param->set_height(1);
+  md_param->set_width(1);
+  md_param->set_streaming(true);
+  md_param->set_queue_capacity(3);
+  md_param->set_num_transform_threads(2);
+  MemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Samples pushed transformed and as datums alternate, and each batch is
+  // output right away, so slots of transformed samples are reused while
+  // the transform threads may still be behind them.
+  vector<Dtype> data(size);
+  for (int batch = 0; batch < kNumBatches; ++batch) {
+    const int first = 2 * batch;
+    for (int j = 0; j < size; ++j) {
+      data[j] = first + j;
+    }
+    layer.PushData(&data[0], first);
+    Datum datum;
+    datum.set_channels(size);
+    datum.set_height(1);
+    datum.set_width(1);
+    datum.set_label(first + 1);
+    for (int j = 0; j < size; ++j) {
+      datum.add_float_data(first + 1 + j);
+    }
+    layer.PushDatum(datum);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(2, this->data_blob_->num());
+    EXPECT_EQ(first, this->label_blob_->cpu_data()[0]);
+    EXPECT_EQ(first + 1, this->label_blob_->cpu_data()[1]);
+    for (int j = 0; j < size; ++j) {
+      EXPECT_EQ(first + j, this->data_blob_->cpu_data()[j]);
+      EXPECT_EQ(2 * (first + 1 + j), this->data_blob_->cpu_data()[size + j]);
+    }
+  }
+}
+
+template <typename Dtype>
+static void PushAndRecord(MemoryDataLayer<Dtype>* layer, const Dtype* data,
+    bool* pushed) {
+  *pushed = layer->PushData(data, 0);
+}
+
+template <typename Dtype>
+static void ForwardLayer(MemoryDataLayer<Dtype>* layer,
+    const vector<Blob<Dtype>*>* bottom, const vector<Blob<Dtype>*>* top) {
+  layer->Forward(*bottom, *top);
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestStreamingClose) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(this->batch_size_);
+  md_param->set_channels(this->channels_);
+  md_param->set_height(this->height_);
+  md_param->set_width(this->width_);
+  md_param->set_streaming(true);
+  md_param->set_queue_capacity(this->batch_size_);
+  MemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // A Forward waiting for samples returns once the stream is closed, with no
+  // samples.
+  boost::thread consumer(boost::bind(&ForwardLayer<Dtype>, &layer,
+      &this->blob_bottom_vec_, &this->blob_top_vec_));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  layer.CloseStream();
+  consumer.join();
+  EXPECT_TRUE(layer.batch_ids().empty());
+  EXPECT_FALSE(layer.PushData(this->data_->cpu_data(), 0));
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestStreamingDestroyWakesPush) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(this->batch_size_);
+  md_param->set_channels(this->channels_);
+  md_param->set_height(this->height_);
+  md_param->set_width(this->width_);
+  md_param->set_streaming(true);
+  md_param->set_queue_capacity(this->batch_size_);
+  shared_ptr<MemoryDataLayer<Dtype> > layer(
+      new MemoryDataLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->data_->cpu_data();
+  for (int i = 0; i < this->batch_size_; ++i) {
+    ASSERT_TRUE(layer->PushData(data, 0));
+  }
+  // The queue is full, so the producer waits until the layer is destroyed.
+  bool pushed = true;
+  boost::thread producer(boost::bind(&PushAndRecord<Dtype>, layer.get(),
+      data, &pushed));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  layer.reset();
+  producer.join();
+  EXPECT_FALSE(pushed);
+}
+
 #ifdef USE_OPENCV
 TYPED_TEST(MemoryDataLayerTest, AddDatumVectorDefaultTransform) {
   typedef typename TypeParam::Dtype Dtype;
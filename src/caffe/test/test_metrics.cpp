@@ -0,0 +1,169 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/metrics.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MetricsTest : public ::testing::Test {
+ protected:
+  MetricsTest() {
+    Metrics::Get().Clear();
+  }
+
+  virtual ~MetricsTest() {
+    Metrics::Get().set_enabled(false);
+    Metrics::Get().Clear();
+  }
+
+  static bool Contains(const string& text, const string& line) {
+    return text.find(line + "\n") != string::npos;
+  }
+};
+
+TEST_F(MetricsTest, TestUpdates) {
+  Metrics& metrics = Metrics::Get();
+  metrics.Increment("a_total");
+  metrics.Increment("a_total", 2.5);
+  metrics.Set("b", 3);
+  metrics.Set("b", -1);
+  metrics.Observe("c_seconds", 0.002);
+  metrics.Observe("c_seconds", 0.5);
+  metrics.Observe("c_seconds", 1000);
+  EXPECT_EQ(3.5, metrics.counter("a_total"));
+  EXPECT_EQ(-1, metrics.gauge("b"));
+  EXPECT_EQ(3u, metrics.histogram_count("c_seconds"));
+  EXPECT_DOUBLE_EQ(1000.502, metrics.histogram_sum("c_seconds"));
+  EXPECT_EQ(0, metrics.counter("missing"));
+  const string text = metrics.ToText();
+  EXPECT_TRUE(Contains(text, "# TYPE a_total counter\na_total 3.5")) << text;
+  EXPECT_TRUE(Contains(text, "# TYPE b gauge\nb -1")) << text;
+  EXPECT_TRUE(Contains(text, "# TYPE c_seconds histogram")) << text;
+  // Buckets are cumulative.
+  EXPECT_TRUE(Contains(text, "c_seconds_bucket{le=\"0.001\"} 0")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_bucket{le=\"0.0025\"} 1")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_bucket{le=\"0.5\"} 2")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_bucket{le=\"100\"} 2")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_bucket{le=\"+Inf\"} 3")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_sum 1000.502")) << text;
+  EXPECT_TRUE(Contains(text, "c_seconds_count 3")) << text;
+}
+
+TEST_F(MetricsTest, TestLabels) {
+  Metrics& metrics = Metrics::Get();
+  metrics.Set("size{layer=\"a\"}", 1);
+  metrics.Set("size{layer=\"b\"}", 2);
+  metrics.Observe("wait_seconds{layer=\"a\"}", 0.01);
+  const string text = metrics.ToText();
+  EXPECT_TRUE(Contains(text, "# TYPE size gauge\nsize{layer=\"a\"} 1\n"
+      "size{layer=\"b\"} 2")) << text;
+  EXPECT_TRUE(Contains(text,
+      "wait_seconds_bucket{layer=\"a\",le=\"0.01\"} 1")) << text;
+  EXPECT_TRUE(Contains(text, "wait_seconds_count{layer=\"a\"} 1")) << text;
+}
+
+TEST_F(MetricsTest, TestWriteFile) {
+  Metrics::Get().Set("b", 2);
+  string filename;
+  MakeTempFilename(&filename);
+  MetricsExporter::WriteFile(filename);
+  std::ifstream input(filename.c_str());
+  std::stringstream text;
+  text << input.rdbuf();
+  EXPECT_TRUE(Contains(text.str(), "b 2")) << text.str();
+  EXPECT_NE(string::npos, text.str().find("caffe_resident_memory_bytes "));
+}
+
+TEST_F(MetricsTest, TestServe) {
+  MetricsExporter exporter(0, "", 1);
+  EXPECT_TRUE(Metrics::Get().enabled());
+  ASSERT_GT(exporter.port(), 0);
+  Metrics::Get().Set("b", 2);
+  const int connection = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(connection, 0);
+  sockaddr_in address = sockaddr_in();
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(exporter.port());
+  ASSERT_EQ(0, connect(connection, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)));
+  const string request = "GET /metrics HTTP/1.0\r\n\r\n";
+  ASSERT_EQ(request.size(), write(connection, request.data(), request.size()));
+  string response;
+  char buffer[1024];
+  ssize_t size;
+  while ((size = read(connection, buffer, sizeof(buffer))) > 0) {
+    response.append(buffer, size);
+  }
+  close(connection);
+  EXPECT_EQ(0u, response.find("HTTP/1.0 200 OK\r\n")) << response;
+  EXPECT_TRUE(Contains(response, "b 2")) << response;
+}
+
+TEST_F(MetricsTest, TestSolverMetrics) {
+  Caffe::set_mode(Caffe::CPU);
+  const string proto =
+      "base_lr: 0.01 "
+      "lr_policy: 'fixed' "
+      "net_param { "
+      "  name: 'TestNetwork' "
+      "  layer { "
+      "    name: 'data' "
+      "    type: 'DummyData' "
+      "    dummy_data_param { "
+      "      shape { dim: 5 dim: 3 } "
+      "      shape { dim: 5 dim: 1 } "
+      "    } "
+      "    top: 'data' "
+      "    top: 'targets' "
+      "  } "
+      "  layer { "
+      "    name: 'innerprod' "
+      "    type: 'InnerProduct' "
+      "    inner_product_param { num_output: 1 } "
+      "    bottom: 'data' "
+      "    top: 'innerprod' "
+      "  } "
+      "  layer { "
+      "    name: 'loss' "
+      "    type: 'EuclideanLoss' "
+      "    bottom: 'innerprod' "
+      "    bottom: 'targets' "
+      "  } "
+      "} ";
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_solver_mode(SolverParameter_SolverMode_CPU);
+  SGDSolver<float> solver(param);
+  // Nothing is recorded until the metrics are enabled.
+  solver.Step(2);
+  EXPECT_EQ(0, Metrics::Get().counter("caffe_iterations_total"));
+  Metrics::Get().set_enabled(true);
+  solver.Step(3);
+  Metrics& metrics = Metrics::Get();
+  EXPECT_EQ(3, metrics.counter("caffe_iterations_total"));
+  EXPECT_EQ(15, metrics.counter("caffe_images_total"));
+  EXPECT_EQ(5, metrics.gauge("caffe_iteration"));
+  EXPECT_FLOAT_EQ(0.01, metrics.gauge("caffe_learning_rate"));
+  EXPECT_EQ(3u, metrics.histogram_count("caffe_forward_seconds"));
+  EXPECT_EQ(3u, metrics.histogram_count("caffe_backward_seconds"));
+  EXPECT_EQ(3u, metrics.histogram_count("caffe_update_seconds"));
+  EXPECT_EQ(3u, metrics.histogram_count("caffe_iteration_seconds"));
+  EXPECT_GT(metrics.gauge("caffe_images_per_second"), 0);
+}
+
+}  // namespace caffe
@@ -8,7 +8,11 @@
 
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/net.hpp"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -16,6 +20,34 @@
 
 namespace caffe {
 
+// A source of an empty sparse top, like SparseHDF5Data without its files.
+template <typename Dtype>
+class SparseSourceLayer : public Layer<Dtype> {
+ public:
+  explicit SparseSourceLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    top[0]->Reshape(vector<int>(2, 1));
+  }
+
+  virtual inline const char* type() const { return "SparseSource"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool SparseTopBlob(const int top_index) const {
+    return true;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {}
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {}
+};
+
+REGISTER_LAYER_CLASS(SparseSource);
+
 template <typename TypeParam>
 class NetTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -614,6 +646,233 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitConcatNet(const bool in_place) {
+    string proto =
+        "name: 'ConcatNetwork' "
+        "input: 'data' "
+        "input_shape { "
+        "  dim: 2 "
+        "  dim: 5 "
+        "} "
+        "force_backward: true "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip1' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip2' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'ip1' "
+        "  bottom: 'ip2' "
+        "  top: 'concat' "
+        "  concat_param { "
+        "    axis: 0 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'concat' ";
+    proto += in_place ? "top: 'concat' } " : "top: 'relu' } ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitConcatAliasNet(const bool in_place) {
+    string proto =
+        "name: 'ConcatAliasNetwork' "
+        "input: 'data' "
+        "input_shape { "
+        "  dim: 2 "
+        "  dim: 5 "
+        "} "
+        "force_backward: true "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip1' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip2' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'ip1' "
+        "  bottom: 'ip2' "
+        "  top: 'concat' "
+        "  concat_param { "
+        "    axis: 0 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'flatten' "
+        "  type: 'Flatten' "
+        "  bottom: 'concat' "
+        "  top: 'flat' "
+        "} "
+        "layer { "
+        "  name: 'sigmoid' "
+        "  type: 'Sigmoid' "
+        "  bottom: 'concat' "
+        "  top: 'sigmoid' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'flat' ";
+    proto += in_place ? "top: 'flat' } " : "top: 'relu' } ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitBlockedNet(const bool blocked_layout) {
+    string proto =
+        "name: 'BlockedNetwork' "
+        "input: 'data' "
+        "input_shape { "
+        "  dim: 2 "
+        "  dim: 3 "
+        "  dim: 9 "
+        "  dim: 9 "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "    bias_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 3 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 16 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv3' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv3' "
+        "  convolution_param { "
+        "    num_output: 16 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2' "
+        "  bottom: 'conv3' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'sum' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'pool2' "
+        "  type: 'Pooling' "
+        "  bottom: 'sum' "
+        "  top: 'pool2' "
+        "  pooling_param { "
+        "    pool: AVE "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'pool2' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "    } "
+        "  } "
+        "} ";
+    if (blocked_layout) {
+      proto += "blocked_layout: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
   virtual void InitSkipPropNet(bool test_skip_true) {
     string proto =
       "name: 'SkipPropTestNetwork' "
@@ -1226,6 +1485,55 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestMappedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+
+  // Create a net with weight sharing; Update it once.
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  vector<Blob<Dtype>*> bottom;
+  this->net_->ForwardBackward(bottom);
+  this->net_->Update();
+  vector<shared_ptr<Blob<Dtype> > > trained_params;
+  const bool kCopyDiff = false;
+  this->CopyNetParams(kCopyDiff, &trained_params);
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+
+  // Get the loss with the weights copied as usual.
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(net_param);
+  const Dtype trained_loss = this->net_->ForwardBackward(bottom);
+
+  // Write the weights in the mapped format.
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".caffemodel.mmap";
+  WriteMappedWeights(net_param, filename);
+
+  // Reinitialize the net and map the weights, twice so that the second net
+  // checks that updating the first one doesn't change the file.
+  for (int n = 0; n < 2; ++n) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitDiffDataSharedWeightsNet();
+    this->net_->CopyTrainedLayersFrom(filename);
+    Blob<Dtype>* ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+    Blob<Dtype>* ip2_weights = this->net_->layers()[2]->blobs()[0].get();
+    EXPECT_EQ(ip1_weights->cpu_data(), ip2_weights->cpu_data());
+    const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+    ASSERT_EQ(trained_params.size(), params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      ASSERT_EQ(trained_params[i]->count(), params[i]->count());
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_EQ(trained_params[i]->cpu_data()[j], params[i]->cpu_data()[j]);
+      }
+    }
+    EXPECT_EQ(trained_loss, this->net_->ForwardBackward(bottom));
+    this->net_->Update();
+  }
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   vector<Blob<Dtype>*> bottom;
@@ -2331,6 +2639,183 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestConcatViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The inner products write to their parts of the concatenation, unless the
+  // ReLU computes in place on it, and the results are the same either way.
+  Caffe::set_random_seed(this->seed_);
+  this->InitConcatNet(false);
+  shared_ptr<Net<Dtype> > views_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitConcatNet(true);
+  shared_ptr<Net<Dtype> > copies_net = this->net_;
+  const Blob<Dtype>* concat = views_net->blob_by_name("concat").get();
+  const Blob<Dtype>* ip2 = views_net->blob_by_name("ip2").get();
+  EXPECT_EQ(concat->cpu_data() + concat->count() / 2, ip2->cpu_data());
+  EXPECT_NE(copies_net->blob_by_name("concat")->cpu_data() +
+      concat->count() / 2, copies_net->blob_by_name("ip2")->cpu_data());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(views_net->input_blobs()[0]);
+  copies_net->input_blobs()[0]->CopyFrom(*views_net->input_blobs()[0]);
+  views_net->ForwardPrefilled();
+  copies_net->ForwardPrefilled();
+  const Blob<Dtype>* output = views_net->output_blobs()[0];
+  caffe_set(output->count(), Dtype(1),
+      views_net->output_blobs()[0]->mutable_cpu_diff());
+  caffe_set(output->count(), Dtype(1),
+      copies_net->output_blobs()[0]->mutable_cpu_diff());
+  views_net->Backward();
+  copies_net->Backward();
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(output->cpu_data()[i],
+        copies_net->output_blobs()[0]->cpu_data()[i]);
+  }
+  const Blob<Dtype>* data = views_net->input_blobs()[0];
+  for (int i = 0; i < data->count(); ++i) {
+    EXPECT_EQ(data->cpu_diff()[i],
+        copies_net->input_blobs()[0]->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestConcatViewsAliased) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The concatenation reaches the ReLU through a split and a flatten, which
+  // share its data, so the ReLU computing in place on it must not write to
+  // the inner products' tops.
+  Caffe::set_random_seed(this->seed_);
+  this->InitConcatAliasNet(false);
+  shared_ptr<Net<Dtype> > views_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitConcatAliasNet(true);
+  shared_ptr<Net<Dtype> > copies_net = this->net_;
+  const Blob<Dtype>* concat = views_net->blob_by_name("concat").get();
+  const Blob<Dtype>* ip2 = views_net->blob_by_name("ip2").get();
+  EXPECT_EQ(concat->cpu_data() + concat->count() / 2, ip2->cpu_data());
+  EXPECT_NE(copies_net->blob_by_name("concat")->cpu_data() +
+      concat->count() / 2, copies_net->blob_by_name("ip2")->cpu_data());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(views_net->input_blobs()[0]);
+  copies_net->input_blobs()[0]->CopyFrom(*views_net->input_blobs()[0]);
+  views_net->ForwardPrefilled();
+  copies_net->ForwardPrefilled();
+  ASSERT_EQ(2, views_net->num_outputs());
+  for (int i = 0; i < 2; ++i) {
+    Blob<Dtype>* output = views_net->output_blobs()[i];
+    caffe_set(output->count(), Dtype(1), output->mutable_cpu_diff());
+    output = copies_net->output_blobs()[i];
+    caffe_set(output->count(), Dtype(1), output->mutable_cpu_diff());
+  }
+  views_net->Backward();
+  copies_net->Backward();
+  const char* kBlobs[3] = {"ip1", "ip2", "sigmoid"};
+  for (int j = 0; j < 3; ++j) {
+    const Blob<Dtype>* blob = views_net->blob_by_name(kBlobs[j]).get();
+    const Blob<Dtype>* copy = copies_net->blob_by_name(kBlobs[j]).get();
+    for (int i = 0; i < blob->count(); ++i) {
+      EXPECT_EQ(blob->cpu_data()[i], copy->cpu_data()[i]);
+    }
+  }
+  const Blob<Dtype>* data = views_net->input_blobs()[0];
+  for (int i = 0; i < data->count(); ++i) {
+    EXPECT_EQ(data->cpu_diff()[i],
+        copies_net->input_blobs()[0]->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestSliceConcatViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The Slice's tops stay views of its bottom, which the Concat copies, so
+  // the two don't redo each other's views on every Forward.
+  const string proto =
+      "name: 'SliceConcatNetwork' "
+      "input: 'data' "
+      "input_shape { "
+      "  dim: 4 "
+      "  dim: 3 "
+      "} "
+      "layer { "
+      "  name: 'slice' "
+      "  type: 'Slice' "
+      "  bottom: 'data' "
+      "  top: 'a' "
+      "  top: 'b' "
+      "  slice_param { "
+      "    axis: 0 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'b' "
+      "  bottom: 'a' "
+      "  top: 'concat' "
+      "  concat_param { "
+      "    axis: 0 "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(data);
+  for (int iter = 0; iter < 2; ++iter) {
+    this->net_->ForwardPrefilled();
+    EXPECT_EQ(data->cpu_data(), this->net_->blob_by_name("a")->cpu_data());
+    EXPECT_EQ(data->cpu_data() + 6, this->net_->blob_by_name("b")->cpu_data());
+    const Blob<Dtype>* concat = this->net_->output_blobs()[0];
+    for (int i = 0; i < 6; ++i) {
+      EXPECT_EQ(data->cpu_data()[6 + i], concat->cpu_data()[i]);
+      EXPECT_EQ(data->cpu_data()[i], concat->cpu_data()[6 + i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestBlockedLayout) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // The blobs from conv1 to the sum are blocked, and the outputs are the
+  // same as with none blocked.
+  Caffe::set_random_seed(this->seed_);
+  this->InitBlockedNet(true);
+  shared_ptr<Net<Dtype> > blocked_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitBlockedNet(false);
+  shared_ptr<Net<Dtype> > net = this->net_;
+  const vector<string>& blob_names = blocked_net->blob_names();
+  for (int i = 0; i < blob_names.size(); ++i) {
+    const bool expected = blob_names[i] != "data" &&
+        blob_names[i] != "pool2" && blob_names[i] != "ip";
+    EXPECT_EQ(expected, blocked_net->blob_blocked_layout()[i])
+        << blob_names[i];
+    EXPECT_FALSE(net->blob_blocked_layout()[i]);
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(blocked_net->input_blobs()[0]);
+  net->input_blobs()[0]->CopyFrom(*blocked_net->input_blobs()[0]);
+  blocked_net->ForwardPrefilled();
+  net->ForwardPrefilled();
+  const Blob<Dtype>* output = blocked_net->output_blobs()[0];
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_NEAR(net->output_blobs()[0]->cpu_data()[i], output->cpu_data()[i],
+        1e-3);
+  }
+  // The blocked blobs hold the channels of each pixel together.
+  const Blob<Dtype>& conv3 = *blocked_net->blob_by_name("conv3");
+  Blob<Dtype> conv3_data(conv3.shape());
+  caffe_cpu_from_blocked(conv3.num(), conv3.channels(),
+      conv3.height() * conv3.width(), conv3.cpu_data(),
+      conv3_data.mutable_cpu_data());
+  for (int i = 0; i < conv3.count(); ++i) {
+    EXPECT_NEAR(net->blob_by_name("conv3")->cpu_data()[i],
+        conv3_data.cpu_data()[i], 1e-3);
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -2379,4 +2864,28 @@ TYPED_TEST(NetTest, TestSkipPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestSparseBlob) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A layer with a sparse top gets a SparseBlob, which may feed one layer.
+  const string proto =
+      "name: 'SparseNet' "
+      "layer { name: 'data' type: 'SparseSource' top: 'data' } "
+      "layer { name: 'silence' type: 'Silence' bottom: 'data' } ";
+  this->InitNetFromProtoString(proto);
+  EXPECT_TRUE(dynamic_cast<SparseBlob<Dtype>*>(
+      this->net_->blob_by_name("data").get()));
+}
+
+TYPED_TEST(NetTest, TestSparseBlobSplitDeath) {
+  // Net can't split a sparse blob between several layers.
+  const string proto =
+      "name: 'SparseSplitNet' "
+      "layer { name: 'data' type: 'SparseSource' top: 'data' } "
+      "layer { name: 'silence1' type: 'Silence' bottom: 'data' } "
+      "layer { name: 'silence2' type: 'Silence' bottom: 'data' } ";
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_DEATH(this->InitNetFromProtoString(proto),
+      "a sparse blob can feed only one layer");
+}
+
 }  // namespace caffe
@@ -0,0 +1,196 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetProfilerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  NetProfilerTest() {
+    const string proto =
+        "name: 'ProfiledNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "    shape { dim: 2 } "
+        "    data_filler { type: 'constant' value: 1 } "
+        "    data_filler { type: 'constant' value: 0 } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'label' "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { num_output: 4 kernel_size: 3 } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { num_output: 5 } "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'ip' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  static vector<string> ReadLines(const string& filename) {
+    std::ifstream input(filename.c_str());
+    vector<string> lines;
+    string line;
+    while (std::getline(input, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  const typename NetProfiler<Dtype>::LayerStats& Stats(
+      const NetProfiler<Dtype>& profiler, const string& name) {
+    const vector<typename NetProfiler<Dtype>::LayerStats>& stats =
+        profiler.layer_stats();
+    for (int i = 0; i < stats.size(); ++i) {
+      if (stats[i].name == name) {
+        return stats[i];
+      }
+    }
+    LOG(FATAL) << "No stats for layer " << name;
+    return stats[0];
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetProfilerTest, TestCounts) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  this->net_->set_profiler(&profiler);
+  for (int i = 0; i < 3; ++i) {
+    this->net_->ForwardPrefilled();
+  }
+  this->net_->Backward();
+  this->net_->set_profiler(NULL);
+  this->net_->ForwardPrefilled();
+  const vector<typename NetProfiler<Dtype>::LayerStats>& stats =
+      profiler.layer_stats();
+  ASSERT_EQ(6u, stats.size());
+  EXPECT_EQ("data", stats[0].name);
+  EXPECT_EQ("DummyData", stats[0].type);
+  EXPECT_EQ("loss", stats[5].name);
+  for (int i = 0; i < stats.size(); ++i) {
+    EXPECT_EQ(3, stats[i].forward.calls) << stats[i].name;
+    EXPECT_GE(stats[i].forward.microseconds, 0) << stats[i].name;
+    // The data layer doesn't need backward.
+    EXPECT_EQ(i > 0 ? 1 : 0, stats[i].backward.calls) << stats[i].name;
+  }
+}
+
+TYPED_TEST(NetProfilerTest, TestFlopsAndBytes) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  this->net_->set_profiler(&profiler);
+  this->net_->ForwardPrefilled();
+  this->net_->Backward();
+  // 2 x 4 x 4 x 4 outputs, each of 3 x 3 x 3 multiply-adds.
+  EXPECT_EQ(2 * 128 * 27, this->Stats(profiler, "conv").forward.flops);
+  EXPECT_EQ(2 * 2 * 128 * 27, this->Stats(profiler, "conv").backward.flops);
+  // 2 x 5 outputs, each of 4 x 2 x 2 multiply-adds.
+  EXPECT_EQ(2 * 10 * 16, this->Stats(profiler, "ip").forward.flops);
+  // 2 x 4 x 2 x 2 outputs of 2 x 2 windows.
+  EXPECT_EQ(32 * 4, this->Stats(profiler, "pool").forward.flops);
+  EXPECT_EQ(0, this->Stats(profiler, "data").forward.flops);
+  // In place, the top is the bottom.
+  EXPECT_EQ(128 * sizeof(Dtype), this->Stats(profiler, "relu").forward.bytes);
+  EXPECT_EQ(2 * 128 * sizeof(Dtype),
+      this->Stats(profiler, "relu").backward.bytes);
+  // Bottom, top, weights and bias.
+  EXPECT_EQ((16 * 2 + 5 * 2 + 5 * 16 + 5) * sizeof(Dtype),
+      this->Stats(profiler, "ip").forward.bytes);
+}
+
+TYPED_TEST(NetProfilerTest, TestAllocations) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  this->net_->set_profiler(&profiler);
+  // The first pass allocates the tops, the following ones reuse them.
+  this->net_->ForwardPrefilled();
+  EXPECT_GT(this->Stats(profiler, "conv").forward.allocations, 0u);
+  EXPECT_GE(this->Stats(profiler, "conv").forward.allocated_bytes,
+      128 * sizeof(Dtype));
+  profiler.Reset();
+  EXPECT_EQ(0u, profiler.layer_stats().size());
+  this->net_->ForwardPrefilled();
+  for (int i = 0; i < profiler.layer_stats().size(); ++i) {
+    EXPECT_EQ(0u, profiler.layer_stats()[i].forward.allocations);
+  }
+}
+
+TYPED_TEST(NetProfilerTest, TestWrite) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  this->net_->set_profiler(&profiler);
+  this->net_->ForwardPrefilled();
+  this->net_->Backward();
+  string filename;
+  MakeTempFilename(&filename);
+  profiler.WriteChromeTrace(filename);
+  vector<string> lines = this->ReadLines(filename);
+  // Opening and closing lines, and 6 forward and 5 backward passes.
+  ASSERT_EQ(13u, lines.size());
+  EXPECT_EQ("{\"traceEvents\": [", lines[0]);
+  EXPECT_EQ(0u, lines[2].find("{\"name\": \"conv\", \"cat\": \"forward\", "
+      "\"ph\": \"X\""));
+  EXPECT_NE(string::npos, lines[2].find("\"type\": \"Convolution\""));
+  EXPECT_NE(string::npos, lines[2].find("\"flops\": 6912"));
+  EXPECT_EQ(0u, lines[7].find("{\"name\": \"loss\", \"cat\": \"backward\""));
+  profiler.WriteCSV(filename);
+  lines = this->ReadLines(filename);
+  ASSERT_EQ(12u, lines.size());
+  EXPECT_EQ(0u, lines[0].find("layer,type,pass,calls,"));
+  EXPECT_EQ(0u, lines[1].find("data,DummyData,forward,1,"));
+  EXPECT_EQ(0u, lines[2].find("conv,Convolution,forward,1,"));
+  EXPECT_EQ(0u, lines[3].find("conv,Convolution,backward,1,"));
+}
+
+}  // namespace caffe
@@ -0,0 +1,108 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/pca.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PCATest : public ::testing::Test {
+ protected:
+  PCATest() : num_(200), dim_(30) {
+    Caffe::set_random_seed(1701);
+    // Rows with a standard deviation of 10 along direction 0, 5 along 1,
+    // and 0.1 along the others, around a mean of 3.
+    data_.resize(num_ * dim_);
+    vector<Dtype> noise(num_ * dim_);
+    caffe_rng_gaussian<Dtype>(num_ * dim_, Dtype(0), Dtype(0.1), &noise[0]);
+    vector<Dtype> scales(2 * num_);
+    caffe_rng_gaussian<Dtype>(2 * num_, Dtype(0), Dtype(1), &scales[0]);
+    directions_.resize(2 * dim_);
+    caffe_rng_gaussian<Dtype>(2 * dim_, Dtype(0), Dtype(1), &directions_[0]);
+    // Makes the directions orthonormal.
+    Normalize(&directions_[0]);
+    const Dtype dot = caffe_cpu_dot(dim_, &directions_[0],
+        &directions_[dim_]);
+    caffe_axpy(dim_, -dot, &directions_[0], &directions_[dim_]);
+    Normalize(&directions_[dim_]);
+    for (int i = 0; i < num_; ++i) {
+      for (int j = 0; j < dim_; ++j) {
+        data_[i * dim_ + j] = 3 + noise[i * dim_ + j] +
+            10 * scales[2 * i] * directions_[j] +
+            5 * scales[2 * i + 1] * directions_[dim_ + j];
+      }
+    }
+  }
+
+  void Normalize(Dtype* x) {
+    caffe_scal(dim_, Dtype(1) / std::sqrt(caffe_cpu_dot(dim_, x, x)), x);
+  }
+
+  const int num_;
+  const int dim_;
+  vector<Dtype> data_;
+  vector<Dtype> directions_;
+};
+
+TYPED_TEST_CASE(PCATest, TestDtypes);
+
+TYPED_TEST(PCATest, TestFit) {
+  const int dim = this->dim_;
+  PCA<TypeParam> pca;
+  pca.Fit(this->num_, dim, &this->data_[0], 3);
+  EXPECT_EQ(3, pca.num_components());
+  EXPECT_EQ(dim, pca.dim());
+  for (int j = 0; j < dim; ++j) {
+    EXPECT_NEAR(3, pca.mean().cpu_data()[j], 1.5);
+  }
+  const TypeParam* components = pca.components().cpu_data();
+  // The components are orthonormal, and the first two are the directions,
+  // up to their sign.
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      EXPECT_NEAR(i == k ? 1 : 0, caffe_cpu_dot(dim, components + i * dim,
+          components + k * dim), 1e-4);
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_NEAR(1, std::fabs(caffe_cpu_dot(dim, components + i * dim,
+        &this->directions_[i * dim])), 1e-3);
+  }
+  EXPECT_GT(pca.variances()[0], pca.variances()[1]);
+  EXPECT_GT(pca.variances()[1], pca.variances()[2]);
+  EXPECT_NEAR(0.01, pca.variances()[2], 0.01);
+}
+
+TYPED_TEST(PCATest, TestProject) {
+  const int dim = this->dim_;
+  PCA<TypeParam> pca;
+  pca.Fit(this->num_, dim, &this->data_[0], 2);
+  vector<TypeParam> projection(this->num_ * 2);
+  pca.Project(this->num_, &this->data_[0], &projection[0]);
+  // Each projection is the dot product of the centered row and a component.
+  const TypeParam* mean = pca.mean().cpu_data();
+  const TypeParam* components = pca.components().cpu_data();
+  TypeParam variances[2] = {0, 0};
+  for (int n = 0; n < this->num_; ++n) {
+    for (int i = 0; i < 2; ++i) {
+      TypeParam expected = 0;
+      for (int j = 0; j < dim; ++j) {
+        expected += (this->data_[n * dim + j] - mean[j]) *
+            components[i * dim + j];
+      }
+      EXPECT_NEAR(expected, projection[n * 2 + i], 1e-3);
+      variances[i] += expected * expected / (this->num_ - 1);
+    }
+  }
+  EXPECT_NEAR(variances[0], pca.variances()[0], 1e-3 * variances[0]);
+  EXPECT_NEAR(variances[1], pca.variances()[1], 1e-3 * variances[1]);
+}
+
+}  // namespace caffe
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +9,8 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/blocked_layout.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -45,6 +50,65 @@ class PoolingLayerTest : public MultiDeviceTest<TypeParam> {
   Blob<Dtype>* const blob_top_mask_;
   vector<Blob<Dtype>*> blob_bottom_vec_;
   vector<Blob<Dtype>*> blob_top_vec_;
+  // Pools blob_bottom_ with the loops of the general case into top and mask,
+  // to check the specialized cases against.
+  void ReferencePool(const PoolingParameter& pooling_param, Blob<Dtype>* top,
+      Blob<Dtype>* mask) {
+    const Blob<Dtype>& bottom = *this->blob_bottom_;
+    const int height = bottom.height();
+    const int width = bottom.width();
+    const bool global = pooling_param.global_pooling();
+    const int kernel = global ? height : pooling_param.kernel_size();
+    const int stride = global ? 1 : pooling_param.stride();
+    const int pad = pooling_param.pad();
+    const bool max_pool =
+        pooling_param.pool() == PoolingParameter_PoolMethod_MAX;
+    const int pooled_height = global ? 1 : static_cast<int>(ceil(
+        static_cast<float>(height + 2 * pad - kernel) / stride)) + 1;
+    const int pooled_width = global ? 1 : static_cast<int>(ceil(
+        static_cast<float>(width + 2 * pad - kernel) / stride)) + 1;
+    top->Reshape(bottom.num(), bottom.channels(), pooled_height, pooled_width);
+    mask->ReshapeLike(*top);
+    for (int n = 0; n < bottom.num(); ++n) {
+      for (int c = 0; c < bottom.channels(); ++c) {
+        const Dtype* bottom_data = bottom.cpu_data() + bottom.offset(n, c);
+        Dtype* top_data = top->mutable_cpu_data() + top->offset(n, c);
+        Dtype* mask_data = mask->mutable_cpu_data() + mask->offset(n, c);
+        for (int ph = 0; ph < pooled_height; ++ph) {
+          for (int pw = 0; pw < pooled_width; ++pw) {
+            int hstart = ph * stride - pad;
+            int wstart = pw * stride - pad;
+            int hend = std::min(hstart + (global ? height : kernel),
+                                height + pad);
+            int wend = std::min(wstart + (global ? width : kernel),
+                                width + pad);
+            const int pool_size = (hend - hstart) * (wend - wstart);
+            hstart = std::max(hstart, 0);
+            wstart = std::max(wstart, 0);
+            hend = std::min(hend, height);
+            wend = std::min(wend, width);
+            const int index = ph * pooled_width + pw;
+            top_data[index] = max_pool ? -FLT_MAX : 0;
+            mask_data[index] = -1;
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                const Dtype value = bottom_data[h * width + w];
+                if (!max_pool) {
+                  top_data[index] += value;
+                } else if (value > top_data[index]) {
+                  top_data[index] = value;
+                  mask_data[index] = h * width + w;
+                }
+              }
+            }
+            if (!max_pool) {
+              top_data[index] /= pool_size;
+            }
+          }
+        }
+      }
+    }
+  }
   // Test for 2x 2 square pooling layer
   void TestForwardSquare() {
     LayerParameter layer_param;
@@ -609,6 +673,149 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardSpecializedKernels) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The 2x2 and 3x3 stride 2 and global cases have their own kernels, which
+  // must give exactly the results of the general case, ties included.
+  const int kKernels[] = {2, 3, 3, 0};
+  const int kPads[] = {0, 0, 1, 0};
+  const int kHeights[] = {8, 7};
+  const int kWidths[] = {8, 9};
+  Blob<Dtype> top_ref, mask_ref;
+  for (int pool = 0; pool < 2; ++pool) {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        LayerParameter layer_param;
+        PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+        if (kKernels[i] == 0) {
+          pooling_param->set_global_pooling(true);
+        } else {
+          pooling_param->set_kernel_size(kKernels[i]);
+          pooling_param->set_stride(2);
+          pooling_param->set_pad(kPads[i]);
+        }
+        pooling_param->set_pool(pool == 0 ? PoolingParameter_PoolMethod_MAX :
+                                PoolingParameter_PoolMethod_AVE);
+        this->blob_bottom_->Reshape(2, 3, kHeights[j], kWidths[j]);
+        Dtype* bottom_data = this->blob_bottom_->mutable_cpu_data();
+        for (int k = 0; k < this->blob_bottom_->count(); ++k) {
+          bottom_data[k] = (k * 7 + k / 5) % 4 - Dtype(1.5);
+        }
+        if (pool == 0) {
+          this->blob_top_vec_.push_back(this->blob_top_mask_);
+        }
+        PoolingLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        this->ReferencePool(*pooling_param, &top_ref, &mask_ref);
+        ASSERT_EQ(top_ref.shape(), this->blob_top_->shape());
+        for (int k = 0; k < top_ref.count(); ++k) {
+          EXPECT_EQ(top_ref.cpu_data()[k], this->blob_top_->cpu_data()[k]);
+          if (pool == 0) {
+            EXPECT_EQ(mask_ref.cpu_data()[k],
+                      this->blob_top_mask_->cpu_data()[k]);
+          }
+        }
+        if (pool == 0) {
+          this->blob_top_vec_.pop_back();
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestForwardBlocked) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // 11 channels, converted to and from the blocked layout by the layer, and
+  // 16, given and taken in it, pool as in the usual layout.
+  const int kChannels[2] = {11, 16};
+  for (int pool = 0; pool < 2; ++pool) {
+    for (int pad = 0; pad < 2; ++pad) {
+      for (int i = 0; i < 2; ++i) {
+        LayerParameter layer_param;
+        PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+        pooling_param->set_kernel_size(3);
+        pooling_param->set_stride(2);
+        pooling_param->set_pad(pad);
+        pooling_param->set_pool(pool == 0 ?
+            PoolingParameter_PoolMethod_MAX : PoolingParameter_PoolMethod_AVE);
+        this->blob_bottom_->Reshape(2, kChannels[i], 7, 6);
+        FillerParameter filler_param;
+        GaussianFiller<Dtype> filler(filler_param);
+        filler.Fill(this->blob_bottom_);
+        PoolingLayer<Dtype> layer(layer_param);
+        EXPECT_TRUE(layer.HandlesBlockedLayout());
+        const bool blocked = kChannels[i] % kChannelBlock == 0;
+        Blob<Dtype> blocked_bottom(this->blob_bottom_->shape());
+        vector<Blob<Dtype>*> bottom_vec(1, blocked ? &blocked_bottom :
+            this->blob_bottom_);
+        layer.SetUp(bottom_vec, this->blob_top_vec_);
+        layer.set_blocked_layout(vector<bool>(1, blocked),
+            vector<bool>(1, blocked));
+        if (blocked) {
+          caffe_cpu_to_blocked(2, kChannels[i], this->blob_bottom_->count(2),
+              this->blob_bottom_->cpu_data(),
+              blocked_bottom.mutable_cpu_data());
+        }
+        layer.Forward(bottom_vec, this->blob_top_vec_);
+        Blob<Dtype> top(this->blob_top_->shape());
+        if (blocked) {
+          caffe_cpu_from_blocked(2, kChannels[i], this->blob_top_->count(2),
+              this->blob_top_->cpu_data(), top.mutable_cpu_data());
+        } else {
+          top.CopyFrom(*this->blob_top_);
+        }
+        Blob<Dtype> top_ref, mask_ref;
+        this->ReferencePool(*pooling_param, &top_ref, &mask_ref);
+        ASSERT_EQ(top_ref.shape(), top.shape());
+        for (int k = 0; k < top_ref.count(); ++k) {
+          EXPECT_EQ(top_ref.cpu_data()[k], top.cpu_data()[k]);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestBackwardMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // In the TEST phase, the mask is not kept, but Backward still works.
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  PoolingLayer<Dtype> train_layer(layer_param);
+  train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> top_diff(this->blob_top_->shape());
+  filler.Fill(&top_diff);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+             this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  train_layer.Backward(this->blob_top_vec_, propagate_down,
+                       this->blob_bottom_vec_);
+  vector<Dtype> expected(this->blob_bottom_->cpu_diff(),
+      this->blob_bottom_->cpu_diff() + this->blob_bottom_->count());
+  layer_param.set_phase(TEST);
+  PoolingLayer<Dtype> test_layer(layer_param);
+  test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+             this->blob_top_->mutable_cpu_diff());
+  caffe_set(this->blob_bottom_->count(), Dtype(0),
+            this->blob_bottom_->mutable_cpu_diff());
+  test_layer.Backward(this->blob_top_vec_, propagate_down,
+                      this->blob_bottom_vec_);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(expected[i], this->blob_bottom_->cpu_diff()[i]);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -5,6 +5,7 @@
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -395,6 +396,71 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliTimesBernoulli) {
   EXPECT_NEAR(true_mean, sample_p, bound);
 }
 
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxKnownAnswer) {
+  // The Philox4x32-10 test vector of counter 0 and key 0.
+  uint32_t words[4];
+  Philox(0).Random(0, 4, words);
+  EXPECT_EQ(0x6627e8d5u, words[0]);
+  EXPECT_EQ(0xe169c58du, words[1]);
+  EXPECT_EQ(0xbc57ac4cu, words[2]);
+  EXPECT_EQ(0x9b00dbd8u, words[3]);
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxOffsets) {
+  // Any range of the stream is the same whether filled alone or not.
+  Philox philox(Philox::RandomKey());
+  const int kSize = 100;
+  uint32_t words[kSize];
+  TypeParam gaussian[kSize];
+  philox.Random(0, kSize, words);
+  philox.Gaussian<TypeParam>(0, kSize, 0, 1, gaussian);
+  for (int begin = 0; begin < 8; ++begin) {
+    for (int end = begin; end < kSize; end += 13) {
+      uint32_t range[kSize];
+      TypeParam gaussian_range[kSize];
+      philox.Random(begin, end - begin, range);
+      philox.Gaussian<TypeParam>(begin, end - begin, 0, 1, gaussian_range);
+      for (int i = begin; i < end; ++i) {
+        EXPECT_EQ(words[i], range[i - begin]);
+        EXPECT_EQ(gaussian[i], gaussian_range[i - begin]);
+      }
+    }
+  }
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxGaussian) {
+  const TypeParam mu = -2;
+  const TypeParam sigma = 3;
+  TypeParam* gaussian_data =
+      static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  Philox(Philox::RandomKey()).Gaussian(3, this->sample_size_, mu, sigma,
+      gaussian_data);
+  this->RngGaussianChecks(mu, sigma, gaussian_data);
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxUniform) {
+  const TypeParam lower = -7.3;
+  const TypeParam upper = -2.3;
+  TypeParam* uniform_data =
+      static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  Philox(Philox::RandomKey()).Uniform(3, this->sample_size_, lower, upper,
+      uniform_data);
+  this->RngUniformChecks(lower, upper, uniform_data);
+}
+
+
+TYPED_TEST(RandomNumberGeneratorTest, TestPhiloxBernoulli) {
+  const TypeParam p = 0.3;
+  unsigned int* bernoulli_data =
+      static_cast<unsigned int*>(this->int_data_->mutable_cpu_data());
+  Philox(Philox::RandomKey()).Bernoulli(3, this->sample_size_, p,
+      bernoulli_data);
+  this->RngBernoulliChecks(p, bernoulli_data);
+}
+
 #ifndef CPU_ONLY
 
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianGPU) {
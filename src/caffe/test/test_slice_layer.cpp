@@ -132,6 +132,37 @@ TYPED_TEST(SliceLayerTest, TestSliceAcrossNum) {
   }
 }
 
+TYPED_TEST(SliceLayerTest, TestSliceAcrossNumViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  SliceLayer<Dtype> layer(layer_param);
+  layer.set_share_views(true);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_0_);
+  // The tops are views of the bottom.
+  const int top_count = this->blob_bottom_->count() / 2;
+  EXPECT_EQ(this->blob_bottom_->cpu_data(), this->blob_top_0_->cpu_data());
+  EXPECT_EQ(this->blob_bottom_->cpu_data() + top_count,
+      this->blob_top_1_->cpu_data());
+  EXPECT_EQ(this->blob_bottom_->cpu_diff() + top_count,
+      this->blob_top_1_->cpu_diff());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_0_);
+  for (int i = 0; i < top_count; ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+        this->blob_top_0_->cpu_data()[i]);
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i + top_count],
+        this->blob_top_1_->cpu_data()[i]);
+  }
+  // A larger bottom gets new memory, which the tops are then views of.
+  this->blob_bottom_->Reshape(8, 12, 2, 3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_0_);
+  EXPECT_EQ(this->blob_bottom_->cpu_data() + this->blob_bottom_->count() / 2,
+      this->blob_top_1_->cpu_data());
+}
+
 TYPED_TEST(SliceLayerTest, TestSliceAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -199,6 +230,19 @@ TYPED_TEST(SliceLayerTest, TestGradientAcrossNum) {
     this->blob_top_vec_0_);
 }
 
+TYPED_TEST(SliceLayerTest, TestGradientAcrossNumViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Gradient checks are slow; reduce blob size.
+  this->ReduceBottomBlobSize();
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  SliceLayer<Dtype> layer(layer_param);
+  layer.set_share_views(true);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+    this->blob_top_vec_0_);
+}
+
 TYPED_TEST(SliceLayerTest, TestGradientAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   // Gradient checks are slow; reduce blob size.
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -83,6 +84,55 @@ TYPED_TEST(SoftmaxLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardRows) {
+  typedef typename TypeParam::Dtype Dtype;
+  // With nothing after the softmax axis, each row is a softmax.
+  this->blob_bottom_->Reshape(3, 1000, 1, 1);
+  FillerParameter filler_param;
+  filler_param.set_std(10);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int channels = this->blob_bottom_->channels();
+  for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+    const Dtype* bottom_data =
+        this->blob_bottom_->cpu_data() + this->blob_bottom_->offset(i);
+    const Dtype* top_data =
+        this->blob_top_->cpu_data() + this->blob_top_->offset(i);
+    Dtype max_value = bottom_data[0];
+    for (int j = 1; j < channels; ++j) {
+      max_value = std::max(max_value, bottom_data[j]);
+    }
+    Dtype scale = 0;
+    for (int j = 0; j < channels; ++j) {
+      scale += exp(bottom_data[j] - max_value);
+    }
+    Dtype sum = 0;
+    for (int j = 0; j < channels; ++j) {
+      sum += top_data[j];
+      EXPECT_NEAR(top_data[j], exp(bottom_data[j] - max_value) / scale, 1e-4)
+          << "debug: " << i << " " << j;
+    }
+    EXPECT_NEAR(sum, 1, 1e-3);
+  }
+}
+
+TYPED_TEST(SoftmaxLayerTest, TestGradientRows) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(3, 10, 1, 1);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNSoftmaxLayerTest : public GPUDeviceTest<Dtype> {
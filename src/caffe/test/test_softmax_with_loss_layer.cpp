@@ -1,3 +1,4 @@
+#include <cfloat>
 #include <cmath>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/softmax_loss_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -37,6 +39,49 @@ class SoftmaxWithLossLayerTest : public MultiDeviceTest<TypeParam> {
     blob_bottom_vec_.push_back(blob_bottom_label_);
     blob_top_vec_.push_back(blob_top_loss_);
   }
+
+  // Checks that the probabilities and the loss are those of a SoftmaxLayer
+  // followed by the negative log-likelihood.
+  void TestForward() {
+    LayerParameter layer_param;
+    layer_param.mutable_loss_param()->set_ignore_label(0);
+    layer_param.add_loss_weight(1);
+    layer_param.add_loss_weight(0);
+    SoftmaxWithLossLayer<Dtype> layer(layer_param);
+    Blob<Dtype> prob;
+    blob_top_vec_.push_back(&prob);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    blob_top_vec_.pop_back();
+    SoftmaxLayer<Dtype> softmax_layer((LayerParameter()));
+    Blob<Dtype> ref_prob;
+    vector<Blob<Dtype>*> softmax_bottom_vec(1, blob_bottom_data_);
+    vector<Blob<Dtype>*> softmax_top_vec(1, &ref_prob);
+    softmax_layer.SetUp(softmax_bottom_vec, softmax_top_vec);
+    softmax_layer.Forward(softmax_bottom_vec, softmax_top_vec);
+    ASSERT_EQ(ref_prob.shape(), prob.shape());
+    for (int i = 0; i < prob.count(); ++i) {
+      EXPECT_NEAR(ref_prob.cpu_data()[i], prob.cpu_data()[i], 1e-6);
+    }
+    const int channels = blob_bottom_data_->channels();
+    const int inner_num = blob_bottom_data_->count(2);
+    const Dtype* label = blob_bottom_label_->cpu_data();
+    Dtype loss = 0;
+    int count = 0;
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      const int label_value = static_cast<int>(label[i]);
+      if (label_value == 0) {
+        continue;
+      }
+      const int n = i / inner_num, j = i % inner_num;
+      loss -= log(std::max(ref_prob.cpu_data()[(n * channels + label_value) *
+          inner_num + j], Dtype(FLT_MIN)));
+      ++count;
+    }
+    loss /= count;
+    EXPECT_NEAR(loss, blob_top_loss_->cpu_data()[0], 1e-4 * loss);
+  }
+
   virtual ~SoftmaxWithLossLayerTest() {
     delete blob_bottom_data_;
     delete blob_bottom_label_;
@@ -61,6 +106,18 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForward) {
+  this->TestForward();
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardRows) {
+  // With nothing after the softmax axis, as in large classifiers, each row
+  // is one contiguous softmax.
+  this->blob_bottom_data_->Reshape(10, 5, 1, 1);
+  this->blob_bottom_label_->Reshape(10, 1, 1, 1);
+  this->TestForward();
+}
+
 TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardIgnoreLabel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -105,4 +162,18 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientUnnormalized) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestGradientIgnoreLabelRows) {
+  typedef typename TypeParam::Dtype Dtype;
+  // With nothing after the softmax axis, each row is a prediction.
+  this->blob_bottom_data_->Reshape(10, 5, 1, 1);
+  this->blob_bottom_label_->Reshape(10, 1, 1, 1);
+  LayerParameter layer_param;
+  layer_param.add_loss_weight(3);
+  layer_param.mutable_loss_param()->set_ignore_label(0);
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
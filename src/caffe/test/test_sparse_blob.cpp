@@ -0,0 +1,81 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseBlobSimpleTest : public ::testing::Test {
+ protected:
+  SparseBlobSimpleTest()
+      : blob_(new SparseBlob<Dtype>()),
+        blob_preshaped_(new SparseBlob<Dtype>(vector<int>(2, 3), 4)) {}
+  virtual ~SparseBlobSimpleTest() { delete blob_; delete blob_preshaped_; }
+  SparseBlob<Dtype>* const blob_;
+  SparseBlob<Dtype>* const blob_preshaped_;
+};
+
+TYPED_TEST_CASE(SparseBlobSimpleTest, TestDtypes);
+
+TYPED_TEST(SparseBlobSimpleTest, TestInitialization) {
+  EXPECT_TRUE(this->blob_);
+  EXPECT_TRUE(this->blob_preshaped_);
+  EXPECT_EQ(this->blob_->nnz(), 0);
+  EXPECT_EQ(this->blob_->count(), 0);
+  EXPECT_EQ(this->blob_preshaped_->num_axes(), 2);
+  EXPECT_EQ(this->blob_preshaped_->shape(0), 3);
+  EXPECT_EQ(this->blob_preshaped_->shape(1), 3);
+  EXPECT_EQ(this->blob_preshaped_->nnz(), 4);
+  EXPECT_EQ(this->blob_preshaped_->count(), 4);
+}
+
+TYPED_TEST(SparseBlobSimpleTest, TestReshape) {
+  vector<int> shape(2);
+  shape[0] = 5;
+  shape[1] = 1000;
+  this->blob_->Reshape(shape, 7);
+  EXPECT_EQ(this->blob_->shape(0), 5);
+  EXPECT_EQ(this->blob_->shape(1), 1000);
+  EXPECT_EQ(this->blob_->nnz(), 7);
+  EXPECT_EQ(this->blob_->count(), 7);
+  EXPECT_TRUE(this->blob_->cpu_data());
+  EXPECT_TRUE(this->blob_->cpu_indices());
+  EXPECT_TRUE(this->blob_->cpu_ptr());
+  // Reshaping without nnz keeps the values.
+  shape[0] = 2;
+  this->blob_->Reshape(shape);
+  EXPECT_EQ(this->blob_->shape(0), 2);
+  EXPECT_EQ(this->blob_->nnz(), 7);
+  // Reshaping to fewer values keeps the memory.
+  const TypeParam* data = this->blob_->cpu_data();
+  this->blob_->Reshape(shape, 3);
+  EXPECT_EQ(this->blob_->nnz(), 3);
+  EXPECT_EQ(data, this->blob_->cpu_data());
+}
+
+TYPED_TEST(SparseBlobSimpleTest, TestToDense) {
+  // [[1 0 2]
+  //  [0 0 0]
+  //  [0 3 4]]
+  const TypeParam data[] = {1, 2, 3, 4};
+  const int indices[] = {0, 2, 1, 2};
+  const int ptr[] = {0, 2, 2, 4};
+  SparseBlob<TypeParam>* blob = this->blob_preshaped_;
+  caffe_copy(4, data, blob->mutable_cpu_data());
+  caffe_copy(4, indices, blob->mutable_cpu_indices());
+  caffe_copy(4, ptr, blob->mutable_cpu_ptr());
+  const TypeParam expected[] = {1, 0, 2, 0, 0, 0, 0, 3, 4};
+  TypeParam dense[9];
+  blob->ToDense(dense);
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_EQ(expected[i], dense[i]);
+  }
+}
+
+}  // namespace caffe
@@ -85,6 +85,18 @@ TYPED_TEST(SplitLayerTest, TestGradient) {
 }
 
 
+TYPED_TEST(SplitLayerTest, TestGradientThreeTops) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> blob_top_c;
+  this->blob_top_vec_.push_back(&blob_top_c);
+  LayerParameter layer_param;
+  SplitLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientEltwise(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+
 class SplitLayerInsertionTest : public ::testing::Test {
  protected:
   void RunInsertionTest(
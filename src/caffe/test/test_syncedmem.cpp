@@ -67,6 +67,59 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestView) {
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(10));
+  caffe_memset(mem->size(), 1, mem->mutable_cpu_data());
+  SyncedMemory view(mem, 4, 4);
+  EXPECT_EQ(view.size(), 4);
+  EXPECT_EQ(view.head(), SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(view.cpu_data(), static_cast<const char*>(mem->cpu_data()) + 4);
+  EXPECT_TRUE(view.is_view_of(*mem, 4));
+  EXPECT_FALSE(view.is_view_of(*mem, 2));
+  // Writes through the view reach the memory, and only its part of it.
+  caffe_memset(view.size(), 2, view.mutable_cpu_data());
+  for (int i = 0; i < mem->size(); ++i) {
+    EXPECT_EQ((static_cast<const char*>(mem->cpu_data()))[i],
+        i >= 4 && i < 8 ? 2 : 1);
+  }
+  // A view of the view is of the memory.
+  shared_ptr<SyncedMemory> view_ptr(new SyncedMemory(mem, 2, 6));
+  SyncedMemory nested_view(view_ptr, 2, 4);
+  EXPECT_TRUE(nested_view.is_view_of(*mem, 4));
+  EXPECT_TRUE(nested_view.is_view_of(*view_ptr, 2));
+  // Setting the data makes it memory of its own.
+  char data[4] = {3, 3, 3, 3};
+  view.set_cpu_data(data);
+  EXPECT_FALSE(view.is_view_of(*mem, 4));
+  EXPECT_EQ(view.cpu_data(), data);
+  EXPECT_EQ((static_cast<const char*>(mem->cpu_data()))[4], 2);
+}
+
+TEST_F(SyncedMemoryTest, TestVersion) {
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(10));
+  const uint64_t initial = mem->version();
+  mem->cpu_data();
+  EXPECT_EQ(initial, mem->version());
+  mem->mutable_cpu_data();
+  const uint64_t written = mem->version();
+  EXPECT_GT(written, initial);
+  // Writes through a view are writes to the memory.
+  SyncedMemory view(mem, 4, 4);
+  EXPECT_EQ(written, view.version());
+  view.mutable_cpu_data();
+  EXPECT_GT(mem->version(), written);
+  EXPECT_EQ(mem->version(), view.version());
+  char data[10];
+  const uint64_t before_set = mem->version();
+  mem->set_cpu_data(data);
+  EXPECT_GT(mem->version(), before_set);
+  // A view given memory of its own goes on from the version of the memory.
+  SyncedMemory detached(mem, 0, 4);
+  const uint64_t before_detach = detached.version();
+  detached.set_cpu_data(data);
+  EXPECT_GT(detached.version(), before_detach);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,185 @@
+#ifdef USE_OPENCV
+#include <stdint.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/window_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/decoded_image_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static const int kWidth = 12;
+static const int kHeight = 10;
+static const int kBatchSize = 6;
+static const int kBlue[2] = {10, 200};
+
+template <typename TypeParam>
+class WindowDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  WindowDataLayerTest()
+      : seed_(1701),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    // Two 12x10 images, whose pixels are (b, g, r) = (kBlue[i], 20 * x,
+    // 20 * y), with windows of label i + 1 in image i.
+    string dirname;
+    MakeTempDir(&dirname);
+    MakeTempFilename(&filename_);
+    std::ofstream window_file(filename_.c_str(), std::ofstream::out);
+    for (int i = 0; i < 2; ++i) {
+      const string image = dirname + "/" + format_int(i) + ".ppm";
+      std::ofstream image_file(image.c_str(),
+          std::ofstream::out | std::ofstream::binary);
+      image_file << "P6\n" << kWidth << " " << kHeight << "\n255\n";
+      for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+          image_file << static_cast<char>(20 * y) << static_cast<char>(20 * x)
+              << static_cast<char>(kBlue[i]);
+        }
+      }
+      window_file << "# " << i << "\n" << image << "\n3 " << kHeight << " "
+          << kWidth << "\n3\n";
+      window_file << i + 1 << " 1.0 0 0 " << kWidth - 1 << " " << kHeight - 1
+          << "\n";
+      window_file << i + 1 << " 0.9 2 1 8 7\n";
+      window_file << i + 1 << " 0.8 " << 3 + i << " 2 10 9\n";
+    }
+  }
+
+  virtual ~WindowDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Foreground windows only, warped to 4x4.
+  LayerParameter WindowParam() {
+    LayerParameter param;
+    param.mutable_transform_param()->set_crop_size(4);
+    WindowDataParameter* window_data_param =
+        param.mutable_window_data_param();
+    window_data_param->set_source(this->filename_.c_str());
+    window_data_param->set_batch_size(kBatchSize);
+    window_data_param->set_fg_fraction(1);
+    return param;
+  }
+
+  // Reads num_batches batches with the layer of param into data and labels.
+  void ReadBatches(const LayerParameter& param, int num_batches,
+      vector<Dtype>* data, vector<Dtype>* labels) {
+    Caffe::set_random_seed(seed_);
+    WindowDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    data->clear();
+    labels->clear();
+    for (int iter = 0; iter < num_batches; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      data->insert(data->end(), blob_top_data_->cpu_data(),
+          blob_top_data_->cpu_data() + blob_top_data_->count());
+      labels->insert(labels->end(), blob_top_label_->cpu_data(),
+          blob_top_label_->cpu_data() + blob_top_label_->count());
+    }
+  }
+
+  int seed_;
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(WindowDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(WindowDataLayerTest, TestRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param = this->WindowParam();
+  WindowDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(kBatchSize, this->blob_top_data_->num());
+  EXPECT_EQ(3, this->blob_top_data_->channels());
+  EXPECT_EQ(4, this->blob_top_data_->height());
+  EXPECT_EQ(4, this->blob_top_data_->width());
+  EXPECT_EQ(kBatchSize, this->blob_top_label_->num());
+  for (int iter = 0; iter < 2; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < kBatchSize; ++i) {
+      // The blue channel comes first and tells the image of the window.
+      const int label = this->blob_top_label_->cpu_data()[i];
+      ASSERT_TRUE(label == 1 || label == 2);
+      const Dtype* blue = this->blob_top_data_->cpu_data() +
+          this->blob_top_data_->offset(i, 0);
+      for (int j = 0; j < 16; ++j) {
+        EXPECT_EQ(kBlue[label - 1], blue[j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(WindowDataLayerTest, TestReadImageCache) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The batches read through the cache, which misses on the first reads of
+  // the images and hits afterwards, are those read without it.
+  LayerParameter param = this->WindowParam();
+  param.mutable_window_data_param()->set_context_pad(1);
+  param.mutable_transform_param()->set_mirror(true);
+  vector<Dtype> data, labels;
+  this->ReadBatches(param, 4, &data, &labels);
+  string cache_filename;
+  MakeTempFilename(&cache_filename);
+  param.mutable_window_data_param()->set_image_cache_file(cache_filename);
+  param.mutable_window_data_param()->set_image_cache_size_mb(1);
+  vector<Dtype> cached_data, cached_labels;
+  this->ReadBatches(param, 4, &cached_data, &cached_labels);
+  EXPECT_EQ(labels, cached_labels);
+  EXPECT_EQ(data, cached_data);
+  // A later run reuses the images cached in the file.
+  DecodedImageCache cache(cache_filename, 1 << 20);
+  EXPECT_EQ(2, cache.num_images());
+  const uint64_t misses = cache.misses();
+  this->ReadBatches(param, 4, &cached_data, &cached_labels);
+  EXPECT_EQ(data, cached_data);
+  EXPECT_EQ(misses, cache.misses());
+}
+
+TYPED_TEST(WindowDataLayerTest, TestThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Windows loaded in parallel, with or without the cache, land in the same
+  // slots of the batch as windows loaded on one thread.
+  LayerParameter param = this->WindowParam();
+  param.mutable_window_data_param()->set_context_pad(1);
+  param.mutable_window_data_param()->set_crop_mode("square");
+  param.mutable_transform_param()->set_mirror(true);
+  param.mutable_window_data_param()->set_num_threads(1);
+  vector<Dtype> data, labels;
+  this->ReadBatches(param, 4, &data, &labels);
+  param.mutable_window_data_param()->set_num_threads(3);
+  vector<Dtype> parallel_data, parallel_labels;
+  this->ReadBatches(param, 4, &parallel_data, &parallel_labels);
+  EXPECT_EQ(labels, parallel_labels);
+  EXPECT_EQ(data, parallel_data);
+  string cache_filename;
+  MakeTempFilename(&cache_filename);
+  param.mutable_window_data_param()->set_image_cache_file(cache_filename);
+  param.mutable_window_data_param()->set_image_cache_size_mb(1);
+  this->ReadBatches(param, 4, &parallel_data, &parallel_labels);
+  EXPECT_EQ(labels, parallel_labels);
+  EXPECT_EQ(data, parallel_data);
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -0,0 +1,54 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/worker_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class WorkerPoolTest : public ::testing::Test {
+ protected:
+  static void Square(vector<int>* values, int i) {
+    (*values)[i] = i * i;
+  }
+
+  static void RecordThread(boost::mutex* mutex,
+      std::set<boost::thread::id>* ids, int i) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+    boost::mutex::scoped_lock lock(*mutex);
+    ids->insert(boost::this_thread::get_id());
+  }
+};
+
+TEST_F(WorkerPoolTest, TestRun) {
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    WorkerPool pool(num_threads);
+    EXPECT_EQ(num_threads, pool.num_threads());
+    // Several loops in a row, including empty ones.
+    for (int n = 0; n < 50; n += 7) {
+      vector<int> values(n, -1);
+      pool.Run(n, boost::bind(&WorkerPoolTest::Square, &values, _1));
+      for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(i * i, values[i]);
+      }
+    }
+  }
+}
+
+TEST_F(WorkerPoolTest, TestUsesWorkers) {
+  WorkerPool pool(3);
+  boost::mutex mutex;
+  std::set<boost::thread::id> ids;
+  pool.Run(30, boost::bind(&WorkerPoolTest::RecordThread, &mutex, &ids, _1));
+  EXPECT_GT(ids.size(), 1u);
+  EXPECT_LE(ids.size(), 3u);
+}
+
+}  // namespace caffe
@@ -1,5 +1,9 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "caffe/common.hpp"
 #include "caffe/util/benchmark.hpp"
 
@@ -165,4 +169,54 @@ float CPUTimer::MicroSeconds() {
   return this->elapsed_microseconds_;
 }
 
+double Percentile(vector<double> values, double p) {
+  CHECK(!values.empty());
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 100);
+  std::sort(values.begin(), values.end());
+  const double rank = p / 100 * (values.size() - 1);
+  const int below = static_cast<int>(rank);
+  if (below + 1 == values.size()) {
+    return values[below];
+  }
+  return values[below] + (rank - below) * (values[below + 1] - values[below]);
+}
+
+BenchmarkStats SummarizeTimes(const vector<double>& microseconds) {
+  CHECK(!microseconds.empty());
+  BenchmarkStats stats;
+  stats.repetitions = microseconds.size();
+  stats.min = *std::min_element(microseconds.begin(), microseconds.end());
+  stats.max = *std::max_element(microseconds.begin(), microseconds.end());
+  for (int i = 0; i < microseconds.size(); ++i) {
+    stats.mean += microseconds[i] / microseconds.size();
+  }
+  for (int i = 0; i < microseconds.size(); ++i) {
+    const double deviation = microseconds[i] - stats.mean;
+    stats.stddev += deviation * deviation / microseconds.size();
+  }
+  stats.stddev = std::sqrt(stats.stddev);
+  stats.median = Percentile(microseconds, 50);
+  stats.p90 = Percentile(microseconds, 90);
+  stats.p99 = Percentile(microseconds, 99);
+  return stats;
+}
+
+BenchmarkStats RunBenchmark(const boost::function<void()>& run, int warmup,
+    int repetitions) {
+  CHECK_GE(warmup, 0);
+  CHECK_GT(repetitions, 0);
+  for (int i = 0; i < warmup; ++i) {
+    run();
+  }
+  vector<double> microseconds(repetitions);
+  Timer timer;
+  for (int i = 0; i < repetitions; ++i) {
+    timer.Start();
+    run();
+    microseconds[i] = timer.MicroSeconds();
+  }
+  return SummarizeTimes(microseconds);
+}
+
 }  // namespace caffe
@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include "caffe/util/blocked_layout.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void caffe_cpu_to_blocked(const int num, const int channels,
+    const int spatial_dim, const Dtype* x, Dtype* y) {
+  const int blocks = channel_blocks(channels);
+  for (int n = 0; n < num; ++n) {
+    for (int b = 0; b < blocks; ++b) {
+      const int block_channels =
+          std::min(kChannelBlock, channels - b * kChannelBlock);
+      const Dtype* x_block = x + (n * channels + b * kChannelBlock) *
+          spatial_dim;
+      Dtype* y_block = y + (n * blocks + b) * spatial_dim * kChannelBlock;
+      for (int i = 0; i < spatial_dim; ++i) {
+        for (int c = 0; c < block_channels; ++c) {
+          y_block[i * kChannelBlock + c] = x_block[c * spatial_dim + i];
+        }
+        for (int c = block_channels; c < kChannelBlock; ++c) {
+          y_block[i * kChannelBlock + c] = 0;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_from_blocked(const int num, const int channels,
+    const int spatial_dim, const Dtype* x, Dtype* y) {
+  const int blocks = channel_blocks(channels);
+  for (int n = 0; n < num; ++n) {
+    for (int b = 0; b < blocks; ++b) {
+      const int block_channels =
+          std::min(kChannelBlock, channels - b * kChannelBlock);
+      const Dtype* x_block = x + (n * blocks + b) * spatial_dim *
+          kChannelBlock;
+      Dtype* y_block = y + (n * channels + b * kChannelBlock) * spatial_dim;
+      for (int c = 0; c < block_channels; ++c) {
+        for (int i = 0; i < spatial_dim; ++i) {
+          y_block[c * spatial_dim + i] = x_block[i * kChannelBlock + c];
+        }
+      }
+    }
+  }
+}
+
+template void caffe_cpu_to_blocked<float>(const int num, const int channels,
+    const int spatial_dim, const float* x, float* y);
+template void caffe_cpu_to_blocked<double>(const int num, const int channels,
+    const int spatial_dim, const double* x, double* y);
+template void caffe_cpu_from_blocked<float>(const int num, const int channels,
+    const int spatial_dim, const float* x, float* y);
+template void caffe_cpu_from_blocked<double>(const int num,
+    const int channels, const int spatial_dim, const double* x, double* y);
+
+}  // namespace caffe
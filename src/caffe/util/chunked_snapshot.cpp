@@ -0,0 +1,174 @@
+#include <boost/filesystem.hpp>
+#include <google/protobuf/repeated_field.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/chunked_snapshot.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+using ::boost::filesystem::path;
+using ::google::protobuf::RepeatedField;
+using ::google::protobuf::RepeatedPtrField;
+
+// Returns the blobs of a NetParameter or SolverState.
+static vector<BlobProto*> SnapshotBlobs(Message* proto) {
+  vector<BlobProto*> blobs;
+  if (NetParameter* net_param = dynamic_cast<NetParameter*>(proto)) {
+    for (int i = 0; i < net_param->layer_size(); ++i) {
+      LayerParameter* layer_param = net_param->mutable_layer(i);
+      for (int j = 0; j < layer_param->blobs_size(); ++j) {
+        blobs.push_back(layer_param->mutable_blobs(j));
+      }
+    }
+  } else if (SolverState* state = dynamic_cast<SolverState*>(proto)) {
+    for (int i = 0; i < state->history_size(); ++i) {
+      blobs.push_back(state->mutable_history(i));
+    }
+  } else {
+    LOG(FATAL) << "Chunked snapshots of " << proto->GetTypeName()
+        << " are not supported.";
+  }
+  return blobs;
+}
+
+template <typename Dtype> RepeatedField<Dtype>* ChunkValues(BlobProto* chunk);
+template <> RepeatedField<float>* ChunkValues(BlobProto* chunk) {
+  return chunk->mutable_data();
+}
+template <> RepeatedField<double>* ChunkValues(BlobProto* chunk) {
+  return chunk->mutable_double_data();
+}
+
+// Chunk files are named after the 64-bit FNV-1a hash of their values, their
+// count and their type, e.g. 6c62272e07bb0142_1024.f32.
+template <typename Dtype>
+static string ChunkName(const Dtype* values, int count) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+  const size_t num_bytes = count * sizeof(Dtype);
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < num_bytes; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << hash
+      << std::dec << "_" << count << ".f" << 8 * sizeof(Dtype);
+  return name.str();
+}
+
+class ChunkWriter {
+ public:
+  ChunkWriter(const string& manifest_filename, const string& chunk_dir)
+      : root_(path(manifest_filename).parent_path()), chunk_dir_(chunk_dir),
+        num_chunks_(0), num_written_(0), bytes_(0) {
+    boost::filesystem::create_directories(root_ / chunk_dir_);
+  }
+
+  // Moves values into chunk files, appending their names to chunks.
+  template <typename Dtype>
+  void Write(RepeatedField<Dtype>* values, RepeatedPtrField<string>* chunks) {
+    for (int offset = 0; offset < values->size();
+         offset += kSnapshotChunkSize) {
+      const int count = std::min(kSnapshotChunkSize, values->size() - offset);
+      const Dtype* chunk_values = values->data() + offset;
+      const string name = (path(chunk_dir_) /
+          ChunkName(chunk_values, count)).string();
+      *chunks->Add() = name;
+      ++num_chunks_;
+      const string filename = (root_ / name).string();
+      if (boost::filesystem::exists(filename)) {
+        continue;
+      }
+      BlobProto chunk;
+      ChunkValues<Dtype>(&chunk)->Resize(count, Dtype(0));
+      caffe_copy(count, chunk_values,
+          ChunkValues<Dtype>(&chunk)->mutable_data());
+      bytes_ += WriteProtoToBinaryFileAtomically(chunk, filename);
+      ++num_written_;
+    }
+    values->Clear();
+  }
+
+  inline int num_chunks() const { return num_chunks_; }
+  inline int num_written() const { return num_written_; }
+  inline int64_t bytes() const { return bytes_; }
+
+ private:
+  const path root_;
+  const string chunk_dir_;
+  int num_chunks_;
+  int num_written_;
+  int64_t bytes_;
+};
+
+int64_t WriteChunkedProto(Message* proto, const string& manifest_filename,
+    const string& chunk_dir) {
+  ChunkWriter writer(manifest_filename, chunk_dir);
+  vector<BlobProto*> blobs = SnapshotBlobs(proto);
+  for (int i = 0; i < blobs.size(); ++i) {
+    BlobProto* blob = blobs[i];
+    writer.Write(blob->mutable_data(), blob->mutable_data_chunk());
+    writer.Write(blob->mutable_double_data(), blob->mutable_data_chunk());
+    writer.Write(blob->mutable_diff(), blob->mutable_diff_chunk());
+    writer.Write(blob->mutable_double_diff(), blob->mutable_diff_chunk());
+  }
+  LOG(INFO) << "Wrote " << writer.num_written() << " of "
+      << writer.num_chunks() << " chunks for " << manifest_filename
+      << ", the others are unchanged";
+  return writer.bytes() +
+      WriteProtoToBinaryFileAtomically(*proto, manifest_filename);
+}
+
+// Loads chunks back into values or double_values, depending on their type.
+static void ReadChunks(const path& root,
+    const RepeatedPtrField<string>& chunks, RepeatedField<float>* values,
+    RepeatedField<double>* double_values) {
+  for (int i = 0; i < chunks.size(); ++i) {
+    const path filename = root / chunks.Get(i);
+    BlobProto chunk;
+    CHECK(ReadProtoFromBinaryFile(filename.string(), &chunk))
+        << "Couldn't read snapshot chunk " << filename.string();
+    const string name = chunk.data_size() > 0 ?
+        ChunkName(chunk.data().data(), chunk.data_size()) :
+        ChunkName(chunk.double_data().data(), chunk.double_data_size());
+    CHECK_EQ(name, filename.filename().string())
+        << "Snapshot chunk " << filename.string() << " is corrupted.";
+    values->MergeFrom(chunk.data());
+    double_values->MergeFrom(chunk.double_data());
+  }
+}
+
+void ReadChunkedProtoOrDie(const string& manifest_filename, Message* proto) {
+  ReadProtoFromBinaryFileOrDie(manifest_filename, proto);
+  const path root = path(manifest_filename).parent_path();
+  vector<BlobProto*> blobs = SnapshotBlobs(proto);
+  for (int i = 0; i < blobs.size(); ++i) {
+    BlobProto* blob = blobs[i];
+    ReadChunks(root, blob->data_chunk(), blob->mutable_data(),
+        blob->mutable_double_data());
+    ReadChunks(root, blob->diff_chunk(), blob->mutable_diff(),
+        blob->mutable_double_diff());
+    blob->clear_data_chunk();
+    blob->clear_diff_chunk();
+  }
+}
+
+void GetSnapshotChunks(const Message& manifest, vector<string>* chunks) {
+  vector<BlobProto*> blobs = SnapshotBlobs(const_cast<Message*>(&manifest));
+  for (int i = 0; i < blobs.size(); ++i) {
+    chunks->insert(chunks->end(), blobs[i]->data_chunk().begin(),
+        blobs[i]->data_chunk().end());
+    chunks->insert(chunks->end(), blobs[i]->diff_chunk().begin(),
+        blobs[i]->diff_chunk().end());
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,249 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/util/decoded_image_cache.hpp"
+
+namespace caffe {
+
+static const char kDecodedImageCacheMagic[8] = {'C', 'A', 'F', 'F', 'E', 'I',
+    'M', 'G'};
+static const uint32_t kDecodedImageCacheVersion = 1;
+
+const int DecodedImageCache::kAssociativity;
+const uint64_t DecodedImageCache::kDefaultMinImageSize;
+
+struct DecodedImageCache::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_slots;
+  uint64_t data_size;
+  // Offset in the data region where the next image is written.
+  uint64_t head;
+  // Number of images inserted so far, which orders the entries by age.
+  uint64_t clock;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+// An image of the cache, stored in the data region as its key followed by its
+// pixels. Free entries have a stamp of 0.
+struct DecodedImageCache::Entry {
+  uint64_t hash;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t stamp;
+  uint32_t key_size;
+  int32_t height;
+  int32_t width;
+  int32_t channels;
+};
+
+static uint64_t Align(uint64_t offset) {
+  return (offset + 63) / 64 * 64;
+}
+
+// FNV-1a hash of key.
+static uint64_t Hash(const string& key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < key.size(); ++i) {
+    hash = (hash ^ static_cast<uint8_t>(key[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Holds a flock on a file for its lifetime.
+class FileLock {
+ public:
+  FileLock(int fd, int operation) : fd_(fd) {
+    CHECK_EQ(flock(fd_, operation), 0) << "Couldn't lock the image cache.";
+  }
+  ~FileLock() { flock(fd_, LOCK_UN); }
+
+ private:
+  int fd_;
+};
+
+DecodedImageCache::DecodedImageCache(const string& filename, uint64_t size,
+    uint64_t min_image_size)
+    : filename_(filename), fd_(-1), map_(NULL), map_size_(0), header_(NULL),
+      mutex_(new boost::mutex()) {
+  CHECK_GT(size, 0);
+  CHECK_GT(min_image_size, 0);
+  const uint32_t num_slots = std::max<uint64_t>(kAssociativity,
+      (size + min_image_size - 1) / min_image_size);
+  const uint64_t data_offset =
+      Align(Align(sizeof(Header)) + num_slots * sizeof(Entry));
+  map_size_ = data_offset + size;
+  fd_ = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+  CHECK_NE(fd_, -1) << "Couldn't open the image cache " << filename;
+  FileLock lock(fd_, LOCK_EX);
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd_, &file_stat), 0) << "Couldn't stat " << filename;
+  // A new file is sized, which fills it with zeros, i.e. free entries.
+  if (file_stat.st_size == 0) {
+    CHECK_EQ(ftruncate(fd_, map_size_), 0) << "Couldn't resize " << filename;
+  } else {
+    CHECK_EQ(file_stat.st_size, map_size_) << "The image cache " << filename
+        << " was made with another size; delete it or use another file.";
+  }
+  map_ = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  CHECK(map_ != MAP_FAILED) << "Couldn't map " << filename;
+  header_ = static_cast<Header*>(map_);
+  const string magic(kDecodedImageCacheMagic,
+      sizeof(kDecodedImageCacheMagic));
+  if (string(header_->magic, sizeof(header_->magic)) != magic) {
+    // The magic is written last, so a file whose creator died before
+    // finishing it is initialized again.
+    std::fill(static_cast<char*>(map_),
+        static_cast<char*>(map_) + data_offset, 0);
+    header_->version = kDecodedImageCacheVersion;
+    header_->num_slots = num_slots;
+    header_->data_size = size;
+    std::copy(magic.begin(), magic.end(), header_->magic);
+  }
+  CHECK_EQ(header_->version, kDecodedImageCacheVersion)
+      << "Unsupported image cache version in " << filename;
+  CHECK(header_->num_slots == num_slots && header_->data_size == size)
+      << "The image cache " << filename << " was made with another size; "
+      << "delete it or use another file.";
+}
+
+DecodedImageCache::~DecodedImageCache() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+DecodedImageCache::Entry* DecodedImageCache::entries() const {
+  return reinterpret_cast<Entry*>(static_cast<char*>(map_) +
+      Align(sizeof(Header)));
+}
+
+uint8_t* DecodedImageCache::data() const {
+  return static_cast<uint8_t*>(map_) + map_size_ - header_->data_size;
+}
+
+bool DecodedImageCache::Get(const string& key, int* height, int* width,
+    int* channels, vector<uint8_t>* pixels) {
+  const uint64_t hash = Hash(key);
+  boost::mutex::scoped_lock lock(*mutex_);
+  FileLock file_lock(fd_, LOCK_SH);
+  for (int i = 0; i < kAssociativity; ++i) {
+    const Entry& entry = entries()[(hash + i) % header_->num_slots];
+    if (entry.stamp == 0 || entry.hash != hash ||
+        entry.key_size != key.size()) {
+      continue;
+    }
+    const uint8_t* image = data() + entry.offset;
+    if (!std::equal(key.begin(), key.end(), image)) {
+      continue;
+    }
+    *height = entry.height;
+    *width = entry.width;
+    *channels = entry.channels;
+    pixels->assign(image + entry.key_size, image + entry.size);
+    // Readers share the file lock, so the statistics are updated atomically.
+    __sync_fetch_and_add(&header_->hits, 1);
+    return true;
+  }
+  __sync_fetch_and_add(&header_->misses, 1);
+  return false;
+}
+
+void DecodedImageCache::Evict(uint64_t begin, uint64_t end) {
+  Entry* entry = entries();
+  for (int i = 0; i < header_->num_slots; ++i, ++entry) {
+    if (entry->stamp != 0 && entry->offset < end &&
+        entry->offset + entry->size > begin) {
+      entry->stamp = 0;
+      __sync_fetch_and_add(&header_->evictions, 1);
+    }
+  }
+}
+
+void DecodedImageCache::Put(const string& key, int height, int width,
+    int channels, const uint8_t* pixels) {
+  const uint64_t num_pixels =
+      static_cast<uint64_t>(height) * width * channels;
+  const uint64_t size = key.size() + num_pixels;
+  if (size > header_->data_size) {
+    return;
+  }
+  const uint64_t hash = Hash(key);
+  boost::mutex::scoped_lock lock(*mutex_);
+  FileLock file_lock(fd_, LOCK_EX);
+  // Pick the free slot, or else the oldest one, among those of the key; and
+  // keep the image if another process already added it.
+  Entry* slot = NULL;
+  for (int i = 0; i < kAssociativity; ++i) {
+    Entry* entry = entries() + (hash + i) % header_->num_slots;
+    if (entry->stamp != 0 && entry->hash == hash &&
+        entry->key_size == key.size() &&
+        std::equal(key.begin(), key.end(), data() + entry->offset)) {
+      return;
+    }
+    if (!slot || (slot->stamp != 0 && entry->stamp < slot->stamp)) {
+      slot = entry;
+    }
+  }
+  if (slot->stamp != 0) {
+    slot->stamp = 0;
+    __sync_fetch_and_add(&header_->evictions, 1);
+  }
+  if (header_->head + size > header_->data_size) {
+    header_->head = 0;
+  }
+  const uint64_t offset = header_->head;
+  Evict(offset, offset + size);
+  uint8_t* image = data() + offset;
+  std::copy(key.begin(), key.end(), image);
+  std::copy(pixels, pixels + num_pixels, image + key.size());
+  header_->head = Align(offset + size);
+  slot->hash = hash;
+  slot->offset = offset;
+  slot->size = size;
+  slot->key_size = key.size();
+  slot->height = height;
+  slot->width = width;
+  slot->channels = channels;
+  // The stamp makes the entry visible, so it is written last.
+  slot->stamp = ++header_->clock;
+}
+
+uint64_t DecodedImageCache::hits() const {
+  return header_->hits;
+}
+
+uint64_t DecodedImageCache::misses() const {
+  return header_->misses;
+}
+
+uint64_t DecodedImageCache::evictions() const {
+  return header_->evictions;
+}
+
+int DecodedImageCache::num_images() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  FileLock file_lock(fd_, LOCK_SH);
+  int num_images = 0;
+  for (int i = 0; i < header_->num_slots; ++i) {
+    num_images += entries()[i].stamp != 0;
+  }
+  return num_images;
+}
+
+}  // namespace caffe
@@ -0,0 +1,121 @@
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+union FloatBits {
+  float value;
+  uint32_t bits;
+};
+
+static inline uint32_t float_bits(float value) {
+  FloatBits cast;
+  cast.value = value;
+  return cast.bits;
+}
+
+static inline float bits_float(uint32_t bits) {
+  FloatBits cast;
+  cast.bits = bits;
+  return cast.value;
+}
+
+uint16_t float_to_half(float value) {
+  const uint32_t bits = float_bits(value);
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  const uint32_t magnitude = bits & 0x7fffffff;
+  if (magnitude >= 0x7f800000) {
+    // Infinity, or NaN keeping the top bits of its payload and staying NaN.
+    return sign | 0x7c00 | (magnitude > 0x7f800000 ?
+        0x200 | ((magnitude >> 13) & 0x3ff) : 0);
+  }
+  if (magnitude >= 0x477ff000) {
+    // At least 65520, which rounds to beyond the largest half, 65504.
+    return sign | 0x7c00;
+  }
+  if (magnitude < 0x38800000) {
+    // Below the smallest normal half, 2^-14: a subnormal in units of 2^-24.
+    // Adding 0.5 makes the float unit 2^-24, so that its rounding to nearest
+    // even is that of the half.
+    const float shifted = bits_float(magnitude) + 0.5f;
+    return sign | static_cast<uint16_t>(float_bits(shifted) - 0x3f000000);
+  }
+  // Rebias the exponent from 127 to 15 and round the mantissa from 23 to 10
+  // bits to nearest even. A carry into the exponent is still right.
+  const uint32_t odd = (magnitude >> 13) & 1;
+  return sign | static_cast<uint16_t>(
+      (magnitude - 0x38000000 + 0xfff + odd) >> 13);
+}
+
+float half_to_float(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1f;
+  const uint32_t mantissa = value & 0x3ff;
+  if (exponent == 0x1f) {
+    return bits_float(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    // Zero or subnormal: mantissa units of 2^-24.
+    const float magnitude = mantissa * (1.f / (1 << 24));
+    return bits_float(sign | float_bits(magnitude));
+  }
+  return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16_t float_to_bfloat16(float value) {
+  const uint32_t bits = float_bits(value);
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    // Keep a NaN whose payload is all in the dropped bits a quiet NaN.
+    return (bits >> 16) | 0x40;
+  }
+  // Round the dropped 16 bits to nearest even. A carry is still right, up
+  // to infinity.
+  return (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+}
+
+float bfloat16_to_float(uint16_t value) {
+  return bits_float(static_cast<uint32_t>(value) << 16);
+}
+
+void caffe_cpu_float_to_half(const int n, const float* x, uint16_t* y) {
+  int i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm256_cvtps_ph(
+        _mm256_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = float_to_half(x[i]);
+  }
+}
+
+void caffe_cpu_half_to_float(const int n, const uint16_t* x, float* y) {
+  int i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = half_to_float(x[i]);
+  }
+}
+
+void caffe_cpu_float_to_bfloat16(const int n, const float* x, uint16_t* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = float_to_bfloat16(x[i]);
+  }
+}
+
+void caffe_cpu_bfloat16_to_float(const int n, const uint16_t* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = bfloat16_to_float(x[i]);
+  }
+}
+
+}  // namespace caffe
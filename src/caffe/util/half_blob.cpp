@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/half.hpp"
+#include "caffe/util/half_blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// The number of values of a converted tile that stays in L2 cache.
+static const int kTileSize = 16384;
+
+template <typename Dtype>
+static void dtype_to_half(const Precision precision, const int n,
+    const Dtype* x, uint16_t* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = precision == FP16 ? float_to_half(x[i]) : float_to_bfloat16(x[i]);
+  }
+}
+
+template <>
+void dtype_to_half<float>(const Precision precision, const int n,
+    const float* x, uint16_t* y) {
+  if (precision == FP16) {
+    caffe_cpu_float_to_half(n, x, y);
+  } else {
+    caffe_cpu_float_to_bfloat16(n, x, y);
+  }
+}
+
+template <typename Dtype>
+static void half_to_dtype(const Precision precision, const int n,
+    const uint16_t* x, Dtype* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = precision == FP16 ? half_to_float(x[i]) : bfloat16_to_float(x[i]);
+  }
+}
+
+template <>
+void half_to_dtype<float>(const Precision precision, const int n,
+    const uint16_t* x, float* y) {
+  if (precision == FP16) {
+    caffe_cpu_half_to_float(n, x, y);
+  } else {
+    caffe_cpu_bfloat16_to_float(n, x, y);
+  }
+}
+
+// C = A * B^T, where C is a block of columns of a matrix with ldc columns.
+template <typename Dtype>
+static void gemm_trans_strided(const int M, const int N, const int K,
+    const Dtype* A, const Dtype* B, Dtype* C, const int ldc);
+
+template <>
+void gemm_trans_strided<float>(const int M, const int N, const int K,
+    const float* A, const float* B, float* C, const int ldc) {
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, M, N, K, 1.f, A, K,
+      B, K, 0.f, C, ldc);
+}
+
+template <>
+void gemm_trans_strided<double>(const int M, const int N, const int K,
+    const double* A, const double* B, double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, M, N, K, 1., A, K,
+      B, K, 0., C, ldc);
+}
+
+template <typename Dtype>
+HalfBlob<Dtype>::HalfBlob(Precision precision)
+    : precision_(precision), version_(0) {
+  CHECK(precision == FP16 || precision == BF16)
+      << "Unsupported precision " << Precision_Name(precision);
+}
+
+template <typename Dtype>
+void HalfBlob<Dtype>::Update(const Blob<Dtype>& source) {
+  if (source.count() == 0) {
+    data_.clear();
+    source_.reset();
+    return;
+  }
+  if (source.data() == source_ && source_->version() == version_ &&
+      source.count() == data_.size()) {
+    return;
+  }
+  source_ = source.data();
+  version_ = source_->version();
+  data_.resize(source.count());
+  dtype_to_half(precision_, source.count(), source.cpu_data(), &data_[0]);
+}
+
+template <typename Dtype>
+void HalfBlob<Dtype>::ToDtype(const int offset, const int n, Dtype* y)
+    const {
+  CHECK_LE(offset + n, count());
+  half_to_dtype(precision_, n, cpu_data() + offset, y);
+}
+
+template <typename Dtype>
+int HalfBlob<Dtype>::TileRows(const int row_size, const int min_rows) const {
+  return std::max(std::max(1, min_rows), kTileSize / std::max(1, row_size));
+}
+
+template <typename Dtype>
+void HalfBlob<Dtype>::cpu_gemm(const int offset, const int M, const int N,
+    const int K, const Dtype* B, Dtype* C) {
+  CHECK_LE(offset + M * K, count());
+  // Row tiles of W give row tiles of C. Each tile reads all of B again.
+  const int rows = TileRows(K, N);
+  tile_.resize(std::min(rows, M) * K);
+  for (int m = 0; m < M; m += rows) {
+    const int tile_rows = std::min(rows, M - m);
+    ToDtype(offset + m * K, tile_rows * K, &tile_[0]);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, tile_rows, N, K,
+        (Dtype)1., &tile_[0], B, (Dtype)0., C + m * N);
+  }
+}
+
+template <typename Dtype>
+void HalfBlob<Dtype>::cpu_gemm_trans(const int M, const int N, const int K,
+    const Dtype* A, Dtype* C) {
+  CHECK_LE(N * K, count());
+  // Row tiles of W give column tiles of C. Each tile reads all of A again.
+  const int rows = TileRows(K, M);
+  tile_.resize(std::min(rows, N) * K);
+  for (int n = 0; n < N; n += rows) {
+    const int tile_rows = std::min(rows, N - n);
+    ToDtype(n * K, tile_rows * K, &tile_[0]);
+    gemm_trans_strided<Dtype>(M, tile_rows, K, A, &tile_[0], C + n, N);
+  }
+}
+
+INSTANTIATE_CLASS(HalfBlob);
+
+}  // namespace caffe
@@ -155,6 +155,39 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
   return val;
 }
 
+void hdf5_load_int_vector(hid_t loc_id, const string& dataset_name,
+    vector<int>* values) {
+  CHECK(H5LTfind_dataset(loc_id, dataset_name.c_str()))
+      << "Failed to find HDF5 dataset " << dataset_name;
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(loc_id, dataset_name.c_str(), &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name;
+  CHECK_EQ(ndims, 1) << "Dataset " << dataset_name << " must have 1 axis.";
+  hsize_t size;
+  H5T_class_t class_;
+  status = H5LTget_dataset_info(loc_id, dataset_name.c_str(), &size, &class_,
+      NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name;
+  CHECK_EQ(class_, H5T_INTEGER) << "Dataset " << dataset_name
+      << " must hold integers.";
+  values->resize(size);
+  if (size > 0) {
+    status = H5LTread_dataset_int(loc_id, dataset_name.c_str(),
+        &values->front());
+    CHECK_GE(status, 0)
+      << "Failed to load int dataset with name " << dataset_name;
+  }
+}
+
+void hdf5_save_int_vector(hid_t loc_id, const string& dataset_name,
+    const vector<int>& values) {
+  hsize_t size = values.size();
+  herr_t status = H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &size,
+      values.empty() ? NULL : &values.front());
+  CHECK_GE(status, 0)
+    << "Failed to save int dataset with name " << dataset_name;
+}
+
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
   hsize_t one = 1;
   herr_t status = \
@@ -9,8 +9,10 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
 #include <stdint.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -69,6 +71,26 @@ void WriteProtoToBinaryFile(const Message& proto, const char* filename) {
   CHECK(proto.SerializeToOstream(&output));
 }
 
+int64_t WriteProtoToBinaryFileAtomically(const Message& proto,
+    const string& filename) {
+  const string temp_filename = filename + ".tmp";
+  int fd = open(temp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK_NE(fd, -1) << "Couldn't open " << temp_filename;
+  int64_t bytes;
+  {
+    FileOutputStream output(fd);
+    CHECK(proto.SerializeToZeroCopyStream(&output))
+        << "Couldn't serialize to " << temp_filename;
+    CHECK(output.Flush()) << "Couldn't write " << temp_filename;
+    bytes = output.ByteCount();
+  }
+  CHECK_EQ(fsync(fd), 0) << "Couldn't sync " << temp_filename;
+  CHECK_EQ(close(fd), 0) << "Couldn't close " << temp_filename;
+  CHECK_EQ(std::rename(temp_filename.c_str(), filename.c_str()), 0)
+      << "Couldn't rename " << temp_filename << " to " << filename;
+  return bytes;
+}
+
 #ifdef USE_OPENCV
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width, const bool is_color) {
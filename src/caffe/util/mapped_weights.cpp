@@ -0,0 +1,170 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+static const char kMappedWeightsMagic[8] = {'C', 'A', 'F', 'F', 'E', 'M',
+    'A', 'P'};
+static const uint32_t kMappedWeightsVersion = 1;
+
+struct MappedWeightsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_size;
+  uint64_t index_size;
+};
+
+static uint64_t Align(uint64_t offset) {
+  return (offset + kMappedWeightsAlignment - 1) / kMappedWeightsAlignment
+      * kMappedWeightsAlignment;
+}
+
+// Number of values of a blob, from its shape or legacy 4D dimensions.
+static uint64_t BlobCount(const BlobProto& blob) {
+  if (blob.has_num() || blob.has_channels() ||
+      blob.has_height() || blob.has_width()) {
+    return static_cast<uint64_t>(blob.num()) * blob.channels()
+        * blob.height() * blob.width();
+  }
+  uint64_t count = 1;
+  for (int i = 0; i < blob.shape().dim_size(); ++i) {
+    count *= blob.shape().dim(i);
+  }
+  return count;
+}
+
+// Computes where the values of each blob of index start, the first one being
+// at offset, and returns the end of the last one.
+static uint64_t BlobOffsets(const NetParameter& index, int value_size,
+    uint64_t offset, vector<vector<uint64_t> >* offsets) {
+  offsets->resize(index.layer_size());
+  for (int i = 0; i < index.layer_size(); ++i) {
+    const LayerParameter& layer_param = index.layer(i);
+    (*offsets)[i].resize(layer_param.blobs_size());
+    for (int j = 0; j < layer_param.blobs_size(); ++j) {
+      offset = Align(offset);
+      (*offsets)[i][j] = offset;
+      offset += BlobCount(layer_param.blobs(j)) * value_size;
+    }
+  }
+  return offset;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : data_(NULL), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Couldn't stat " << filename;
+  size_ = file_stat.st_size;
+  CHECK_GE(size_, sizeof(MappedWeightsHeader))
+      << filename << " is not a mapped weights file.";
+  // Private and writable: pages are shared until a process modifies them.
+  data_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  CHECK(data_ != MAP_FAILED) << "Couldn't map " << filename;
+  close(fd);
+  const MappedWeightsHeader& header =
+      *static_cast<MappedWeightsHeader*>(data_);
+  CHECK_EQ(string(header.magic, sizeof(header.magic)),
+      string(kMappedWeightsMagic, sizeof(kMappedWeightsMagic)))
+      << filename << " is not a mapped weights file.";
+  CHECK_EQ(header.version, kMappedWeightsVersion)
+      << "Unsupported mapped weights version in " << filename;
+  CHECK(header.value_size == sizeof(float) ||
+      header.value_size == sizeof(double))
+      << "Unsupported value size in " << filename;
+  value_size_ = header.value_size;
+  CHECK_LE(sizeof(header) + header.index_size, size_)
+      << filename << " is truncated.";
+  CHECK(index_.ParseFromArray(static_cast<char*>(data_) + sizeof(header),
+      header.index_size)) << "Couldn't parse the index of " << filename;
+  const uint64_t end = BlobOffsets(index_, value_size_,
+      sizeof(header) + header.index_size, &offsets_);
+  CHECK_LE(end, size_) << filename << " is truncated.";
+}
+
+MappedWeights::~MappedWeights() {
+  munmap(data_, size_);
+}
+
+template <typename Dtype>
+static void WriteValues(const BlobProto& blob, std::ofstream* output) {
+  vector<Dtype> values;
+  if (blob.double_data_size() > 0) {
+    values.assign(blob.double_data().begin(), blob.double_data().end());
+  } else {
+    values.assign(blob.data().begin(), blob.data().end());
+  }
+  output->write(reinterpret_cast<const char*>(values.data()),
+      values.size() * sizeof(Dtype));
+}
+
+void WriteMappedWeights(const NetParameter& param, const string& filename) {
+  NetParameter index;
+  index.set_name(param.name());
+  int value_size = sizeof(float);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    LayerParameter* index_layer_param = index.add_layer();
+    index_layer_param->set_name(layer_param.name());
+    index_layer_param->set_type(layer_param.type());
+    for (int j = 0; j < layer_param.blobs_size(); ++j) {
+      const BlobProto& blob = layer_param.blobs(j);
+      const int num_values = blob.double_data_size() > 0 ?
+          blob.double_data_size() : blob.data_size();
+      CHECK_EQ(static_cast<uint64_t>(num_values), BlobCount(blob))
+          << "Param " << j << " of layer " << layer_param.name()
+          << " has a wrong number of values.";
+      if (blob.double_data_size() > 0) {
+        value_size = sizeof(double);
+      }
+      BlobProto* index_blob = index_layer_param->add_blobs();
+      *index_blob = blob;
+      index_blob->clear_data();
+      index_blob->clear_diff();
+      index_blob->clear_double_data();
+      index_blob->clear_double_diff();
+    }
+  }
+  MappedWeightsHeader header;
+  std::copy(kMappedWeightsMagic, kMappedWeightsMagic + sizeof(header.magic),
+      header.magic);
+  header.version = kMappedWeightsVersion;
+  header.value_size = value_size;
+  const string index_string = index.SerializeAsString();
+  header.index_size = index_string.size();
+  vector<vector<uint64_t> > offsets;
+  BlobOffsets(index, value_size, sizeof(header) + header.index_size,
+      &offsets);
+
+  std::ofstream output(filename.c_str(), std::ios::out | std::ios::trunc |
+      std::ios::binary);
+  CHECK(output.is_open()) << "Couldn't open " << filename;
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output << index_string;
+  const string padding(kMappedWeightsAlignment, '\0');
+  for (int i = 0; i < param.layer_size(); ++i) {
+    for (int j = 0; j < param.layer(i).blobs_size(); ++j) {
+      output.write(padding.data(),
+          offsets[i][j] - static_cast<uint64_t>(output.tellp()));
+      if (value_size == sizeof(double)) {
+        WriteValues<double>(param.layer(i).blobs(j), &output);
+      } else {
+        WriteValues<float>(param.layer(i).blobs(j), &output);
+      }
+    }
+  }
+  CHECK(output.good()) << "Couldn't write " << filename;
+}
+
+}  // namespace caffe
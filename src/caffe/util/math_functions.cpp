@@ -1,6 +1,8 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include "caffe/common.hpp"
@@ -53,6 +55,80 @@ template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
     double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
 
+template <typename Dtype>
+void caffe_cpu_csrmm(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const Dtype alpha, const Dtype* A, const int* A_indices,
+    const int* A_ptr, const Dtype* B, const Dtype beta, Dtype* C) {
+  if (beta == Dtype(0)) {
+    caffe_set(M * N, Dtype(0), C);
+  } else if (beta != Dtype(1)) {
+    caffe_scal(M * N, beta, C);
+  }
+  if (TransB == CblasNoTrans) {
+    // Add the rows of B selected by the nonzeros of row m.
+    for (int m = 0; m < M; ++m) {
+      for (int j = A_ptr[m]; j < A_ptr[m + 1]; ++j) {
+        caffe_axpy(N, alpha * A[j], B + A_indices[j] * N, C + m * N);
+      }
+    }
+    return;
+  }
+  // B is N x K: gather from one row of B for all the rows of A, so that the
+  // row stays in cache.
+  for (int n = 0; n < N; ++n) {
+    const Dtype* b = B + n * K;
+    for (int m = 0; m < M; ++m) {
+      Dtype sum = 0;
+      for (int j = A_ptr[m]; j < A_ptr[m + 1]; ++j) {
+        sum += A[j] * b[A_indices[j]];
+      }
+      C[m * N + n] += alpha * sum;
+    }
+  }
+}
+
+template void caffe_cpu_csrmm<float>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const float alpha, const float* A,
+    const int* A_indices, const int* A_ptr, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_csrmm<double>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const double alpha,
+    const double* A, const int* A_indices, const int* A_ptr, const double* B,
+    const double beta, double* C);
+
+template <typename Dtype>
+void caffe_cpu_gemm_csr(const CBLAS_TRANSPOSE TransB, const int M,
+    const int N, const int K, const Dtype alpha, const Dtype* A,
+    const int* A_indices, const int* A_ptr, const Dtype* B, const Dtype beta,
+    Dtype* C) {
+  if (beta == Dtype(0)) {
+    caffe_set(N * K, Dtype(0), C);
+  } else if (beta != Dtype(1)) {
+    caffe_scal(N * K, beta, C);
+  }
+  // Scatter op(B)(n, m) times row m of A into row n of C, for all the rows of
+  // A before moving to the next row of C, so that the row stays in cache.
+  for (int n = 0; n < N; ++n) {
+    Dtype* c = C + n * K;
+    for (int m = 0; m < M; ++m) {
+      const Dtype b = alpha *
+          (TransB == CblasNoTrans ? B[n * M + m] : B[m * N + n]);
+      for (int j = A_ptr[m]; j < A_ptr[m + 1]; ++j) {
+        c[A_indices[j]] += b * A[j];
+      }
+    }
+  }
+}
+
+template void caffe_cpu_gemm_csr<float>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const float alpha, const float* A,
+    const int* A_indices, const int* A_ptr, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_gemm_csr<double>(const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const double alpha,
+    const double* A, const int* A_indices, const int* A_ptr, const double* B,
+    const double beta, double* C);
+
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
   if (alpha == 0) {
@@ -358,6 +434,27 @@ double caffe_cpu_asum<double>(const int n, const double* x) {
   return cblas_dasum(n, x, 1);
 }
 
+template <typename Dtype>
+Dtype caffe_cpu_softmax(const int n, const Dtype* x, Dtype* y) {
+  Dtype max_value = x[0];
+  for (int i = 1; i < n; ++i) {
+    max_value = std::max(max_value, x[i]);
+  }
+  Dtype sum = 0;
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::exp(x[i] - max_value);
+    sum += y[i];
+  }
+  caffe_scal(n, Dtype(1) / sum, y);
+  return max_value + std::log(sum);
+}
+
+template
+float caffe_cpu_softmax<float>(const int n, const float* x, float* y);
+
+template
+double caffe_cpu_softmax<double>(const int n, const double* x, double* y);
+
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
@@ -0,0 +1,306 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/metrics.hpp"
+
+namespace caffe {
+
+static Metrics* metrics_instance_ = NULL;
+static boost::once_flag metrics_once_ = BOOST_ONCE_INIT;
+
+void Metrics::Create() {
+  metrics_instance_ = new Metrics();
+}
+
+Metrics& Metrics::Get() {
+  boost::call_once(&Metrics::Create, metrics_once_);
+  return *metrics_instance_;
+}
+
+Metrics::Metrics() : enabled_(false), mutex_(new boost::mutex()) {}
+
+const vector<double>& Metrics::bucket_bounds() {
+  // From 1 ms to about 2 min, in steps of about 2.5x.
+  static const double kBounds[] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+      0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100};
+  static const vector<double> bounds(kBounds,
+      kBounds + sizeof(kBounds) / sizeof(kBounds[0]));
+  return bounds;
+}
+
+void Metrics::Increment(const string& name, double value) {
+  CHECK_GE(value, 0) << "Counters only increase: " << name;
+  boost::mutex::scoped_lock lock(*mutex_);
+  counters_[name] += value;
+}
+
+void Metrics::Set(const string& name, double value) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  gauges_[name] = value;
+}
+
+void Metrics::Observe(const string& name, double value) {
+  const vector<double>& bounds = bucket_bounds();
+  const int bucket =
+      std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+  boost::mutex::scoped_lock lock(*mutex_);
+  Histogram& histogram = histograms_[name];
+  if (histogram.buckets.empty()) {
+    // The last bucket holds the values above the bounds.
+    histogram.buckets.resize(bounds.size() + 1);
+  }
+  ++histogram.buckets[bucket];
+  ++histogram.count;
+  histogram.sum += value;
+}
+
+double Metrics::counter(const string& name) const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  map<string, double>::const_iterator it = counters_.find(name);
+  return it == counters_.end() ? 0 : it->second;
+}
+
+double Metrics::gauge(const string& name) const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  map<string, double>::const_iterator it = gauges_.find(name);
+  return it == gauges_.end() ? 0 : it->second;
+}
+
+uint64_t Metrics::histogram_count(const string& name) const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  map<string, Histogram>::const_iterator it = histograms_.find(name);
+  return it == histograms_.end() ? 0 : it->second.count;
+}
+
+double Metrics::histogram_sum(const string& name) const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  map<string, Histogram>::const_iterator it = histograms_.find(name);
+  return it == histograms_.end() ? 0 : it->second.sum;
+}
+
+void Metrics::Clear() {
+  boost::mutex::scoped_lock lock(*mutex_);
+  counters_.clear();
+  gauges_.clear();
+  histograms_.clear();
+}
+
+// Splits a metric name into its base name and its labels, without braces.
+static void SplitName(const string& name, string* base, string* labels) {
+  const size_t brace = name.find('{');
+  if (brace == string::npos) {
+    *base = name;
+    labels->clear();
+  } else {
+    *base = name.substr(0, brace);
+    *labels = name.substr(brace + 1, name.size() - brace - 2);
+  }
+}
+
+// Writes the values of a map, with a TYPE line per base name. Names sharing a
+// base name are next to each other, as the map is sorted.
+static void WriteValues(const map<string, double>& values, const string& type,
+    std::ostream* output) {
+  string last_base;
+  for (map<string, double>::const_iterator it = values.begin();
+       it != values.end(); ++it) {
+    string base, labels;
+    SplitName(it->first, &base, &labels);
+    if (base != last_base) {
+      *output << "# TYPE " << base << " " << type << "\n";
+      last_base = base;
+    }
+    *output << it->first << " " << it->second << "\n";
+  }
+}
+
+string Metrics::ToText() const {
+  std::ostringstream output;
+  output << std::setprecision(12);
+  boost::mutex::scoped_lock lock(*mutex_);
+  WriteValues(counters_, "counter", &output);
+  WriteValues(gauges_, "gauge", &output);
+  const vector<double>& bounds = bucket_bounds();
+  string last_base;
+  for (map<string, Histogram>::const_iterator it = histograms_.begin();
+       it != histograms_.end(); ++it) {
+    string base, labels;
+    SplitName(it->first, &base, &labels);
+    if (base != last_base) {
+      output << "# TYPE " << base << " histogram\n";
+      last_base = base;
+    }
+    const string prefix = labels.empty() ? "" : labels + ",";
+    const string suffix = labels.empty() ? "" : "{" + labels + "}";
+    const Histogram& histogram = it->second;
+    uint64_t cumulated = 0;
+    for (int i = 0; i <= bounds.size(); ++i) {
+      cumulated += histogram.buckets[i];
+      output << base << "_bucket{" << prefix << "le=\"";
+      if (i < bounds.size()) {
+        output << bounds[i];
+      } else {
+        output << "+Inf";
+      }
+      output << "\"} " << cumulated << "\n";
+    }
+    output << base << "_sum" << suffix << " " << histogram.sum << "\n";
+    output << base << "_count" << suffix << " " << histogram.count << "\n";
+  }
+  return output.str();
+}
+
+// Sets the gauges of the memory used by the process.
+static void UpdateMemoryGauges() {
+  Metrics& metrics = Metrics::Get();
+  metrics.Set("caffe_syncedmem_allocations",
+      SyncedMemory::num_allocations());
+  metrics.Set("caffe_syncedmem_allocated_bytes",
+      SyncedMemory::allocated_bytes());
+  // The second field is the resident set size in pages, on Linux.
+  std::ifstream statm("/proc/self/statm");
+  double size, resident;
+  if (statm >> size >> resident) {
+    metrics.Set("caffe_resident_memory_bytes",
+        resident * sysconf(_SC_PAGESIZE));
+  }
+}
+
+MetricsExporter::MetricsExporter(int port, const string& filename,
+    double interval_seconds)
+    : socket_(-1), port_(-1), filename_(filename),
+      interval_seconds_(interval_seconds) {
+  CHECK(port >= 0 || !filename.empty()) << "Nothing to export to";
+  CHECK_GT(interval_seconds, 0);
+  if (port >= 0) {
+    socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_GE(socket_, 0) << "Failed to create the metrics socket";
+    const int reuse = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    CHECK_EQ(bind(socket_, reinterpret_cast<sockaddr*>(&address),
+        sizeof(address)), 0) << "Failed to bind the metrics port " << port;
+    CHECK_EQ(listen(socket_, 16), 0);
+    socklen_t length = sizeof(address);
+    CHECK_EQ(getsockname(socket_, reinterpret_cast<sockaddr*>(&address),
+        &length), 0);
+    port_ = ntohs(address.sin_port);
+    LOG(INFO) << "Serving the metrics on http://localhost:" << port_;
+  }
+  Metrics::Get().set_enabled(true);
+  StartInternalThread();
+}
+
+MetricsExporter::~MetricsExporter() {
+  StopInternalThread();
+  if (!filename_.empty()) {
+    WriteFile(filename_);
+  }
+  if (socket_ >= 0) {
+    close(socket_);
+  }
+}
+
+void MetricsExporter::WriteFile(const string& filename) {
+  UpdateMemoryGauges();
+  const string temp_filename = filename + ".tmp";
+  {
+    std::ofstream output(temp_filename.c_str());
+    output << Metrics::Get().ToText();
+    if (!output.good()) {
+      LOG(WARNING) << "Failed to write the metrics to " << temp_filename;
+      return;
+    }
+  }
+  if (rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    LOG(WARNING) << "Failed to write the metrics to " << filename;
+  }
+}
+
+void MetricsExporter::InternalThreadEntry() {
+  // Checks must_stop every 100 ms.
+  const int kPollMilliseconds = 100;
+  boost::posix_time::ptime next_write =
+      boost::posix_time::microsec_clock::local_time();
+  while (!must_stop()) {
+    if (!filename_.empty() &&
+        boost::posix_time::microsec_clock::local_time() >= next_write) {
+      WriteFile(filename_);
+      next_write += boost::posix_time::microseconds(
+          static_cast<int64_t>(interval_seconds_ * 1e6));
+    }
+    if (socket_ < 0) {
+      boost::this_thread::sleep(
+          boost::posix_time::milliseconds(kPollMilliseconds));
+      continue;
+    }
+    pollfd request;
+    request.fd = socket_;
+    request.events = POLLIN;
+    if (poll(&request, 1, kPollMilliseconds) > 0) {
+      const int connection = accept(socket_, NULL, NULL);
+      if (connection >= 0) {
+        Serve(connection);
+        close(connection);
+      }
+    }
+  }
+}
+
+void MetricsExporter::Serve(int connection) {
+  // Reads the request headers, without parsing them: every request gets the
+  // metrics. Slow clients are given up on after a second.
+  string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == string::npos &&
+         request.find("\n\n") == string::npos && request.size() < 65536) {
+    pollfd readable;
+    readable.fd = connection;
+    readable.events = POLLIN;
+    if (poll(&readable, 1, 1000) <= 0) {
+      return;
+    }
+    const ssize_t size = read(connection, buffer, sizeof(buffer));
+    if (size <= 0) {
+      return;
+    }
+    request.append(buffer, size);
+  }
+  UpdateMemoryGauges();
+  const string body = Metrics::Get().ToText();
+  std::ostringstream response;
+  response << "HTTP/1.0 200 OK\r\n"
+      << "Content-Type: text/plain; version=0.0.4\r\n"
+      << "Content-Length: " << body.size() << "\r\n"
+      << "Connection: close\r\n\r\n" << body;
+  const string data = response.str();
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t size = send(connection, data.data() + written,
+        data.size() - written, MSG_NOSIGNAL);
+    if (size <= 0) {
+      return;
+    }
+    written += size;
+  }
+}
+
+}  // namespace caffe
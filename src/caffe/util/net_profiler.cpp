@@ -0,0 +1,245 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(int max_trace_events)
+    : max_trace_events_(max_trace_events), start_allocations_(0),
+      start_allocated_bytes_(0) {
+  CHECK_GE(max_trace_events, 0);
+  Reset();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Reset() {
+  stats_.clear();
+  layer_indices_.clear();
+  events_.clear();
+  origin_ = boost::posix_time::microsec_clock::local_time();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LayerStart() {
+  start_allocations_ = SyncedMemory::num_allocations();
+  start_allocated_bytes_ = SyncedMemory::allocated_bytes();
+  start_ = boost::posix_time::microsec_clock::local_time();
+  timer_.Start();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LayerEnd(const string& name, Pass pass,
+    Layer<Dtype>* layer, const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const double duration = timer_.MicroSeconds();
+  map<string, int>::const_iterator it = layer_indices_.find(name);
+  int index;
+  if (it == layer_indices_.end()) {
+    index = stats_.size();
+    layer_indices_[name] = index;
+    stats_.push_back(LayerStats());
+    stats_.back().name = name;
+    stats_.back().type = layer->type();
+  } else {
+    index = it->second;
+  }
+  Event event;
+  event.layer = index;
+  event.pass = pass;
+  event.start = (start_ - origin_).total_microseconds();
+  event.duration = duration;
+  event.flops = EstimateFlops(layer, pass, bottom, top);
+  event.bytes = EstimateBytes(layer, pass, bottom, top);
+  Totals& totals = pass == FORWARD ? stats_[index].forward :
+      stats_[index].backward;
+  ++totals.calls;
+  totals.microseconds += duration;
+  totals.flops += event.flops;
+  totals.bytes += event.bytes;
+  totals.allocations += SyncedMemory::num_allocations() - start_allocations_;
+  totals.allocated_bytes +=
+      SyncedMemory::allocated_bytes() - start_allocated_bytes_;
+  if (events_.size() < max_trace_events_) {
+    events_.push_back(event);
+  }
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::EstimateFlops(Layer<Dtype>* layer,
+    Pass pass, const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const LayerParameter& param = layer->layer_param();
+  const string type = layer->type();
+  double flops = 0;
+  if (type == "Convolution") {
+    // A multiply-add per output value and weight of its group.
+    for (int i = 0; i < top.size(); ++i) {
+      flops += 2. * top[i]->count() * layer->blobs()[0]->count(1);
+    }
+  } else if (type == "Deconvolution") {
+    // The backward convolution, from the bottom values.
+    for (int i = 0; i < bottom.size(); ++i) {
+      flops += 2. * bottom[i]->count() * layer->blobs()[0]->count(1);
+    }
+  } else if (type == "InnerProduct") {
+    const int num_output = param.inner_product_param().num_output();
+    flops = 2. * top[0]->count() * (layer->blobs()[0]->count() / num_output);
+  } else if (type == "Pooling") {
+    const PoolingParameter& pool_param = param.pooling_param();
+    double kernel_size;
+    if (pool_param.global_pooling()) {
+      kernel_size = bottom[0]->count(2);
+    } else if (pool_param.has_kernel_size()) {
+      kernel_size = pool_param.kernel_size() * pool_param.kernel_size();
+    } else {
+      kernel_size = pool_param.kernel_h() * pool_param.kernel_w();
+    }
+    flops = top[0]->count() * kernel_size;
+  } else if (type == "LRN") {
+    // A square and add per value of the window, then the scale and power.
+    flops = bottom[0]->count() * (2. * param.lrn_param().local_size() + 3);
+  } else if (type == "Softmax" || type == "SoftmaxWithLoss") {
+    // Max, subtraction and exponential, sum, division.
+    flops = 4. * bottom[0]->count();
+  } else if (type == "Eltwise") {
+    flops = (bottom.size() - 1.) * top[0]->count();
+  } else if (bottom.size() == 0 || type == "Split" || type == "Concat" ||
+      type == "Slice" || type == "Flatten" || type == "Reshape" ||
+      type == "Silence") {
+    // Data layers and layers only moving or sharing data.
+    flops = 0;
+  } else {
+    // Elementwise layers, e.g. activations, and reductions, e.g. losses: an
+    // operation per top or bottom value, whichever are more.
+    for (int i = 0; i < top.size(); ++i) {
+      flops += top[i]->count();
+    }
+    flops = std::max(flops, static_cast<double>(bottom[0]->count()));
+  }
+  // Layers with weights compute both the bottom and the weight gradients
+  // backward, each as costly as the forward pass.
+  if (pass == BACKWARD && (type == "Convolution" ||
+      type == "Deconvolution" || type == "InnerProduct")) {
+    flops *= 2;
+  }
+  return flops;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::EstimateBytes(Layer<Dtype>* layer,
+    Pass pass, const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  double count = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    count += bottom[i]->count();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    // In-place tops are the bottoms.
+    if (std::find(bottom.begin(), bottom.end(), top[i]) == bottom.end()) {
+      count += top[i]->count();
+    }
+  }
+  for (int i = 0; i < layer->blobs().size(); ++i) {
+    count += layer->blobs()[i]->count();
+  }
+  if (pass == BACKWARD) {
+    count *= 2;
+  }
+  return count * sizeof(Dtype);
+}
+
+static string JsonEscape(const string& value) {
+  string escaped;
+  for (int i = 0; i < value.size(); ++i) {
+    if (value[i] == '"' || value[i] == '\\') {
+      escaped += '\\';
+    }
+    escaped += value[i];
+  }
+  return escaped;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteChromeTrace(const string& filename) const {
+  std::ofstream output(filename.c_str());
+  CHECK(output.is_open()) << "Failed to open " << filename;
+  output << std::fixed << std::setprecision(0);
+  output << "{\"traceEvents\": [";
+  for (int i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    const LayerStats& stats = stats_[event.layer];
+    output << (i > 0 ? ",\n" : "\n")
+        << "{\"name\": \"" << JsonEscape(stats.name) << "\", "
+        << "\"cat\": \"" << (event.pass == FORWARD ? "forward" : "backward")
+        << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, "
+        << "\"ts\": " << event.start << ", \"dur\": " << event.duration
+        << ", \"args\": {\"type\": \"" << JsonEscape(stats.type) << "\", "
+        << "\"flops\": " << event.flops << ", \"bytes\": " << event.bytes
+        << "}}";
+  }
+  output << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  CHECK(output.good()) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteCSV(const string& filename) const {
+  std::ofstream output(filename.c_str());
+  CHECK(output.is_open()) << "Failed to open " << filename;
+  output << std::setprecision(10);
+  output << "layer,type,pass,calls,total_us,mean_us,flops,bytes,"
+      << "gflops_per_s,gbytes_per_s,flops_per_byte,allocations,"
+      << "allocated_bytes\n";
+  for (int i = 0; i < stats_.size(); ++i) {
+    for (int pass = FORWARD; pass <= BACKWARD; ++pass) {
+      const Totals& totals = pass == FORWARD ? stats_[i].forward :
+          stats_[i].backward;
+      if (totals.calls == 0) {
+        continue;
+      }
+      const double seconds = totals.microseconds / 1e6;
+      output << stats_[i].name << "," << stats_[i].type << ","
+          << (pass == FORWARD ? "forward" : "backward") << ","
+          << totals.calls << "," << totals.microseconds << ","
+          << totals.microseconds / totals.calls << ","
+          << totals.flops / totals.calls << ","
+          << totals.bytes / totals.calls << ","
+          << (seconds > 0 ? totals.flops / seconds / 1e9 : 0) << ","
+          << (seconds > 0 ? totals.bytes / seconds / 1e9 : 0) << ","
+          << (totals.bytes > 0 ? totals.flops / totals.bytes : 0) << ","
+          << totals.allocations << "," << totals.allocated_bytes << "\n";
+    }
+  }
+  CHECK(output.good()) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LogSummary() const {
+  for (int i = 0; i < stats_.size(); ++i) {
+    for (int pass = FORWARD; pass <= BACKWARD; ++pass) {
+      const Totals& totals = pass == FORWARD ? stats_[i].forward :
+          stats_[i].backward;
+      if (totals.calls == 0) {
+        continue;
+      }
+      const double seconds = totals.microseconds / 1e6;
+      LOG(INFO) << std::setfill(' ') << std::setw(10) << stats_[i].name
+          << (pass == FORWARD ? "\tforward: " : "\tbackward: ")
+          << totals.microseconds / 1000 / totals.calls << " ms, "
+          << (seconds > 0 ? totals.flops / seconds / 1e9 : 0) << " GFLOP/s, "
+          << (seconds > 0 ? totals.bytes / seconds / 1e9 : 0) << " GB/s, "
+          << totals.allocations << " allocations in total.";
+    }
+  }
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
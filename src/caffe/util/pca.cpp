@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/pca.hpp"
+
+namespace caffe {
+
+// Orthonormalizes the rows of the rows x dim matrix q, by modified
+// Gram-Schmidt.
+template <typename Dtype>
+static void Orthonormalize(int rows, int dim, Dtype* q) {
+  for (int j = 0; j < rows; ++j) {
+    Dtype* row = q + j * dim;
+    for (int k = 0; k < j; ++k) {
+      const Dtype dot = caffe_cpu_dot(dim, row, q + k * dim);
+      caffe_axpy(dim, -dot, q + k * dim, row);
+    }
+    const Dtype norm = std::sqrt(caffe_cpu_dot(dim, row, row));
+    // A row in the span of the previous ones has nothing left to keep.
+    caffe_scal(dim, norm > 0 ? Dtype(1) / norm : Dtype(0), row);
+  }
+}
+
+// Diagonalizes the symmetric n x n matrix a by cyclic Jacobi rotations,
+// leaving the eigenvalues on its diagonal and the eigenvectors in the columns
+// of v.
+static void Jacobi(int n, vector<double>* a, vector<double>* v) {
+  vector<double>& A = *a;
+  vector<double>& V = *v;
+  V.assign(n * n, 0);
+  for (int i = 0; i < n; ++i) {
+    V[i * n + i] = 1;
+  }
+  for (int sweep = 0; sweep < 100; ++sweep) {
+    double off = 0, total = 0;
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        total += A[i * n + j] * A[i * n + j];
+        if (i != j) {
+          off += A[i * n + j] * A[i * n + j];
+        }
+      }
+    }
+    if (off <= 1e-24 * total) {
+      break;
+    }
+    for (int p = 0; p < n; ++p) {
+      for (int q = p + 1; q < n; ++q) {
+        const double apq = A[p * n + q];
+        if (apq == 0) {
+          continue;
+        }
+        const double theta = (A[q * n + q] - A[p * n + p]) / (2 * apq);
+        const double t = (theta >= 0 ? 1 : -1) /
+            (std::fabs(theta) + std::sqrt(theta * theta + 1));
+        const double c = 1 / std::sqrt(t * t + 1);
+        const double s = t * c;
+        for (int k = 0; k < n; ++k) {
+          const double akp = A[k * n + p];
+          const double akq = A[k * n + q];
+          A[k * n + p] = c * akp - s * akq;
+          A[k * n + q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < n; ++k) {
+          const double apk = A[p * n + k];
+          const double aqk = A[q * n + k];
+          A[p * n + k] = c * apk - s * aqk;
+          A[q * n + k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < n; ++k) {
+          const double vkp = V[k * n + p];
+          const double vkq = V[k * n + q];
+          V[k * n + p] = c * vkp - s * vkq;
+          V[k * n + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PCA<Dtype>::Fit(int num, int dim, const Dtype* data,
+    int num_components, int num_iterations) {
+  CHECK_GT(num, 1) << "Need at least 2 rows to fit.";
+  CHECK_GT(num_components, 0);
+  CHECK_LE(num_components, dim);
+  // Oversampling the subspace makes the leading components converge faster.
+  const int cols = std::min(dim, num_components + 10);
+  mean_.Reshape(vector<int>(1, dim));
+  Dtype* mean = mean_.mutable_cpu_data();
+  vector<Dtype> ones(num, Dtype(1));
+  caffe_cpu_gemv<Dtype>(CblasTrans, num, dim, Dtype(1) / num, data,
+      &ones[0], Dtype(0), mean);
+  vector<Dtype> centered(data, data + num * dim);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, Dtype(-1),
+      &ones[0], mean, Dtype(1), &centered[0]);
+
+  // The rows of q span the subspace, as cols x dim, and z = centered * q'.
+  vector<Dtype> q(cols * dim);
+  vector<Dtype> z(num * cols);
+  caffe_rng_gaussian<Dtype>(cols * dim, Dtype(0), Dtype(1), &q[0]);
+  Orthonormalize(cols, dim, &q[0]);
+  for (int i = 0; i < num_iterations; ++i) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, cols, dim,
+        Dtype(1), &centered[0], &q[0], Dtype(0), &z[0]);
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, cols, dim, num,
+        Dtype(1), &z[0], &centered[0], Dtype(0), &q[0]);
+    Orthonormalize(cols, dim, &q[0]);
+  }
+  // The covariance within the subspace, z' * z / (num - 1).
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, cols, dim, Dtype(1),
+      &centered[0], &q[0], Dtype(0), &z[0]);
+  vector<Dtype> covariance(cols * cols);
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, cols, cols, num,
+      Dtype(1) / (num - 1), &z[0], &z[0], Dtype(0), &covariance[0]);
+  vector<double> a(covariance.begin(), covariance.end());
+  vector<double> v;
+  Jacobi(cols, &a, &v);
+  vector<std::pair<double, int> > order(cols);
+  for (int j = 0; j < cols; ++j) {
+    order[j] = std::make_pair(-a[j * cols + j], j);
+  }
+  std::sort(order.begin(), order.end());
+
+  // Component i is eigenvector order[i] in the basis of the rows of q.
+  vector<int> shape(2);
+  shape[0] = num_components;
+  shape[1] = dim;
+  components_.Reshape(shape);
+  variances_.resize(num_components);
+  vector<Dtype> eigenvectors(cols * num_components);
+  for (int i = 0; i < num_components; ++i) {
+    const int j = order[i].second;
+    variances_[i] = -order[i].first;
+    for (int k = 0; k < cols; ++k) {
+      eigenvectors[i * cols + k] = v[k * cols + j];
+    }
+  }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_components, dim,
+      cols, Dtype(1), &eigenvectors[0], &q[0], Dtype(0),
+      components_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void PCA<Dtype>::Project(int num, const Dtype* data,
+    Dtype* projection) const {
+  CHECK_GT(components_.count(), 0) << "Fit the PCA first.";
+  const int k = num_components();
+  // projection = data * components' - mean * components', for each row.
+  vector<Dtype> offset(k);
+  caffe_cpu_gemv<Dtype>(CblasNoTrans, k, dim(), Dtype(1),
+      components_.cpu_data(), mean_.cpu_data(), Dtype(0), &offset[0]);
+  vector<Dtype> ones(num, Dtype(1));
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, k, dim(), Dtype(1),
+      data, components_.cpu_data(), Dtype(0), projection);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, k, 1, Dtype(-1),
+      &ones[0], &offset[0], Dtype(1), projection);
+}
+
+INSTANTIATE_CLASS(PCA);
+
+}  // namespace caffe
@@ -0,0 +1,183 @@
+#include <cmath>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+// The multipliers and key increments of Philox4x32.
+static const uint32_t kPhiloxM0 = 0xD2511F53;
+static const uint32_t kPhiloxM1 = 0xCD9E8D57;
+static const uint32_t kPhiloxW0 = 0x9E3779B9;
+static const uint32_t kPhiloxW1 = 0xBB67AE85;
+// The number of blocks hashed together, as SIMD lanes.
+static const int kPhiloxLanes = 8;
+// The number of words generated on the stack before being converted.
+static const int kPhiloxChunk = 1024;
+
+Philox::Philox(uint64_t key) {
+  key_[0] = static_cast<uint32_t>(key);
+  key_[1] = static_cast<uint32_t>(key >> 32);
+}
+
+uint64_t Philox::RandomKey() {
+  return (static_cast<uint64_t>(caffe_rng_rand()) << 32) | caffe_rng_rand();
+}
+
+void Philox::Blocks(uint64_t first, int num_blocks, uint32_t* r) const {
+  // The counter of a block is its index, in its two low words.
+  for (int b = 0; b < num_blocks; b += kPhiloxLanes) {
+    const int lanes = std::min(kPhiloxLanes, num_blocks - b);
+    uint32_t c0[kPhiloxLanes], c1[kPhiloxLanes];
+    uint32_t c2[kPhiloxLanes], c3[kPhiloxLanes];
+    for (int l = 0; l < kPhiloxLanes; ++l) {
+      const uint64_t counter = first + b + l;
+      c0[l] = static_cast<uint32_t>(counter);
+      c1[l] = static_cast<uint32_t>(counter >> 32);
+      c2[l] = 0;
+      c3[l] = 0;
+    }
+    uint32_t k0 = key_[0];
+    uint32_t k1 = key_[1];
+    for (int round = 0; round < 10; ++round) {
+      for (int l = 0; l < kPhiloxLanes; ++l) {
+        const uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * c0[l];
+        const uint64_t p1 = static_cast<uint64_t>(kPhiloxM1) * c2[l];
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+        c1[l] = static_cast<uint32_t>(p1);
+        c3[l] = static_cast<uint32_t>(p0);
+        c0[l] = n0;
+        c2[l] = n2;
+      }
+      k0 += kPhiloxW0;
+      k1 += kPhiloxW1;
+    }
+    for (int l = 0; l < lanes; ++l) {
+      uint32_t* block = r + 4 * (b + l);
+      block[0] = c0[l];
+      block[1] = c1[l];
+      block[2] = c2[l];
+      block[3] = c3[l];
+    }
+  }
+}
+
+void Philox::Random(uint64_t offset, int n, uint32_t* r) const {
+  CHECK_GE(n, 0);
+  uint32_t block[4];
+  // The words before the first whole block.
+  int i = 0;
+  if (offset % 4) {
+    Blocks(offset / 4, 1, block);
+    for (; i < n && (offset + i) % 4; ++i) {
+      r[i] = block[(offset + i) % 4];
+    }
+  }
+  const int num_blocks = (n - i) / 4;
+  Blocks((offset + i) / 4, num_blocks, r + i);
+  i += 4 * num_blocks;
+  // The words after the last whole block.
+  if (i < n) {
+    Blocks((offset + i) / 4, 1, block);
+    for (int j = 0; i < n; ++i, ++j) {
+      r[i] = block[j];
+    }
+  }
+}
+
+// Maps a word to (0, 1), never reaching either end: Gaussian takes its log.
+// The value is exact in Dtype, so rounding cannot reach 1 either, which for
+// float limits it to the top 23 bits of the word.
+template <typename Dtype>
+static inline Dtype WordToUnit(uint32_t word);
+
+template <>
+inline float WordToUnit<float>(uint32_t word) {
+  return (static_cast<float>(word >> 9) + 0.5f) * (1.f / 8388608.f);
+}
+
+template <>
+inline double WordToUnit<double>(uint32_t word) {
+  return (static_cast<double>(word) + 0.5) * (1. / 4294967296.);
+}
+
+template <typename Dtype>
+void Philox::Uniform(uint64_t offset, int n, Dtype a, Dtype b,
+    Dtype* r) const {
+  CHECK_GE(n, 0);
+  CHECK_LE(a, b);
+  uint32_t words[kPhiloxChunk];
+  for (int i = 0; i < n; i += kPhiloxChunk) {
+    const int size = std::min(kPhiloxChunk, n - i);
+    Random(offset + i, size, words);
+    for (int j = 0; j < size; ++j) {
+      r[i + j] = a + (b - a) * WordToUnit<Dtype>(words[j]);
+    }
+  }
+}
+
+template <typename Dtype>
+void Philox::Gaussian(uint64_t offset, int n, Dtype mu, Dtype sigma,
+    Dtype* r) const {
+  CHECK_GE(n, 0);
+  CHECK_GT(sigma, 0);
+  // Pair k of values comes from words 2k and 2k + 1, which give the radius
+  // and the angle of both: the even value is its cosine, the odd its sine.
+  const Dtype two_pi = 2 * M_PI;
+  uint32_t words[kPhiloxChunk];
+  uint64_t index = offset;
+  const uint64_t end = offset + n;
+  while (index < end) {
+    const uint64_t first_pair = index / 2;
+    const int num_pairs = std::min<uint64_t>(kPhiloxChunk / 2,
+        (end + 1) / 2 - first_pair);
+    Random(2 * first_pair, 2 * num_pairs, words);
+    for (int k = 0; k < num_pairs; ++k) {
+      const Dtype radius =
+          sigma * std::sqrt(-2 * std::log(WordToUnit<Dtype>(words[2 * k])));
+      const Dtype angle = two_pi * WordToUnit<Dtype>(words[2 * k + 1]);
+      const uint64_t even = 2 * (first_pair + k);
+      if (even >= index && even < end) {
+        r[even - offset] = mu + radius * std::cos(angle);
+      }
+      if (even + 1 >= index && even + 1 < end) {
+        r[even + 1 - offset] = mu + radius * std::sin(angle);
+      }
+    }
+    index = 2 * (first_pair + num_pairs);
+  }
+}
+
+template <typename Dtype>
+void Philox::Bernoulli(uint64_t offset, int n, Dtype p,
+    unsigned int* r) const {
+  CHECK_GE(n, 0);
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 1);
+  // A word is below the threshold with probability p, which may be 1.
+  const uint64_t threshold = static_cast<uint64_t>(p * 4294967296.);
+  uint32_t words[kPhiloxChunk];
+  for (int i = 0; i < n; i += kPhiloxChunk) {
+    const int size = std::min(kPhiloxChunk, n - i);
+    Random(offset + i, size, words);
+    for (int j = 0; j < size; ++j) {
+      r[i + j] = words[j] < threshold;
+    }
+  }
+}
+
+template void Philox::Uniform<float>(uint64_t offset, int n, float a,
+    float b, float* r) const;
+template void Philox::Uniform<double>(uint64_t offset, int n, double a,
+    double b, double* r) const;
+template void Philox::Gaussian<float>(uint64_t offset, int n, float mu,
+    float sigma, float* r) const;
+template void Philox::Gaussian<double>(uint64_t offset, int n, double mu,
+    double sigma, double* r) const;
+template void Philox::Bernoulli<float>(uint64_t offset, int n, float p,
+    unsigned int* r) const;
+template void Philox::Bernoulli<double>(uint64_t offset, int n, double p,
+    unsigned int* r) const;
+
+}  // namespace caffe
@@ -0,0 +1,85 @@
+#include <boost/thread.hpp>
+#include <string>
+
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/snapshot_writer.hpp"
+
+namespace caffe {
+
+void SnapshotWriter::Snapshot::Add(const string& filename, Message* proto,
+    const string& chunk_dir) {
+  shared_ptr<Message> owned(proto->New());
+  owned->GetReflection()->Swap(owned.get(), proto);
+  filenames_.push_back(filename);
+  chunk_dirs_.push_back(chunk_dir);
+  protos_.push_back(owned);
+}
+
+SnapshotWriter::SnapshotWriter(int max_pending)
+    : max_pending_(max_pending) {
+  CHECK_GT(max_pending_, 0);
+  for (int i = 0; i < max_pending_; ++i) {
+    free_.push(i);
+  }
+  StartInternalThread();
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  Wait();
+  StopInternalThread();
+}
+
+void SnapshotWriter::Write(const shared_ptr<Snapshot>& snapshot) {
+  CPUTimer timer;
+  timer.Start();
+  free_.pop("Waiting for the previous snapshots to be written");
+  snapshot->set_stall_ms(snapshot->stall_ms() + timer.MilliSeconds());
+  pending_.push(snapshot);
+}
+
+void SnapshotWriter::Wait() {
+  // Every token is back once all queued snapshots have been written.
+  for (int i = 0; i < max_pending_; ++i) {
+    free_.pop();
+  }
+  for (int i = 0; i < max_pending_; ++i) {
+    free_.push(i);
+  }
+}
+
+void SnapshotWriter::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      shared_ptr<Snapshot> snapshot = pending_.pop();
+      WriteSnapshot(*snapshot);
+      free_.push(0);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+void SnapshotWriter::WriteSnapshot(const Snapshot& snapshot) {
+  CPUTimer timer;
+  timer.Start();
+  int64_t bytes = 0;
+  for (int i = 0; i < snapshot.protos_.size(); ++i) {
+    if (snapshot.chunk_dirs_[i].empty()) {
+      bytes += WriteProtoToBinaryFileAtomically(*snapshot.protos_[i],
+          snapshot.filenames_[i]);
+    } else {
+      bytes += WriteChunkedProto(snapshot.protos_[i].get(),
+          snapshot.filenames_[i], snapshot.chunk_dirs_[i]);
+    }
+    LOG(INFO) << "Snapshot written to " << snapshot.filenames_[i];
+  }
+  const float write_ms = timer.MilliSeconds();
+  LOG(INFO) << "Snapshot of iteration " << snapshot.iter() << ": "
+      << bytes / 1048576.0 << " MB in " << write_ms << " ms ("
+      << (write_ms > 0 ? bytes / 1048.576 / write_ms : 0) << " MB/s), "
+      << "training stalled " << snapshot.stall_ms() << " ms";
+}
+
+}  // namespace caffe
@@ -0,0 +1,88 @@
+#include <boost/thread.hpp>
+
+#include "caffe/util/worker_pool.hpp"
+
+namespace caffe {
+
+class WorkerPool::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  boost::thread_group threads_;
+};
+
+WorkerPool::WorkerPool(int num_threads)
+    : num_threads_(num_threads), sync_(new sync()), task_(NULL),
+      num_iterations_(0), next_iteration_(0), num_running_(0),
+      generation_(0), stop_(false) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    sync_->threads_.create_thread(
+        boost::bind(&WorkerPool::WorkerEntry, this));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->start_.notify_all();
+  sync_->threads_.join_all();
+}
+
+template <typename Lock>
+void WorkerPool::RunIterations(Lock* lock) {
+  while (next_iteration_ < num_iterations_) {
+    const int i = next_iteration_++;
+    lock->unlock();
+    (*task_)(i);
+    lock->lock();
+  }
+}
+
+void WorkerPool::WorkerEntry() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  // Workers start with the pool, before any loop, even if they only get to
+  // run after the first one started.
+  int generation = 0;
+  while (true) {
+    while (!stop_ && generation_ == generation) {
+      sync_->start_.wait(lock);
+    }
+    if (stop_) {
+      return;
+    }
+    generation = generation_;
+    RunIterations(&lock);
+    if (--num_running_ == 0) {
+      sync_->done_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::Run(int n, const boost::function<void(int)>& task) {
+  if (num_threads_ == 1) {
+    for (int i = 0; i < n; ++i) {
+      task(i);
+    }
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  task_ = &task;
+  num_iterations_ = n;
+  next_iteration_ = 0;
+  num_running_ = num_threads_ - 1;
+  ++generation_;
+  sync_->start_.notify_all();
+  RunIterations(&lock);
+  // Wait for the workers to finish their last iterations, and to see the loop
+  // before the next one starts.
+  while (num_running_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  task_ = NULL;
+}
+
+}  // namespace caffe
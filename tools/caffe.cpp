@@ -6,19 +6,26 @@ namespace bp = boost::python;
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <cstring>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/metrics.hpp"
+#include "caffe/util/net_profiler.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
 using caffe::Caffe;
+using caffe::CPUTimer;
 using caffe::Net;
 using caffe::Layer;
+using caffe::NetProfiler;
 using caffe::Solver;
 using caffe::shared_ptr;
 using caffe::string;
@@ -41,6 +48,33 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_bool(profile, false,
+    "Optional; for time, also profile the layer passes after the benchmark, "
+    "and log their achieved GFLOP/s and GB/s.");
+DEFINE_string(profile_trace, "",
+    "Optional; for time, profile as with -profile, and write the layer "
+    "passes to this file in the Chrome trace format (chrome://tracing).");
+DEFINE_string(profile_csv, "",
+    "Optional; for time, profile as with -profile, and write the per-layer "
+    "times, FLOPs and bytes to this CSV file.");
+DEFINE_string(threads, "",
+    "Optional; for time, a comma-separated list of thread counts: runs that "
+    "many copies of the model forward concurrently in the TEST phase, sharing "
+    "weights, and reports the throughput and latency percentiles.");
+DEFINE_string(batch_sizes, "",
+    "Optional; for time with threads, a comma-separated list of batch sizes "
+    "to set on the model inputs, all of them run for each thread count.");
+DEFINE_double(max_latency_ms, 0,
+    "Optional; for time with threads, the p99 latency the optimal batch size "
+    "of each thread count must stay within.");
+DEFINE_int32(metrics_port, -1,
+    "Optional; for train, serve the training metrics (throughput, timings, "
+    "queue occupancy, memory) over HTTP on this local port.");
+DEFINE_string(metrics_file, "",
+    "Optional; for train, write the training metrics to this file every "
+    "metrics_interval seconds.");
+DEFINE_double(metrics_interval, 10,
+    "The interval in seconds between writes of metrics_file.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -101,6 +135,20 @@ static void get_gpus(vector<int>* gpus) {
   }
 }
 
+// Parse a comma-separated list of positive integers, e.g. batch sizes.
+static vector<int> get_int_list(const string& list) {
+  vector<int> values;
+  if (list.size()) {
+    vector<string> strings;
+    boost::split(strings, list, boost::is_any_of(","));
+    for (int i = 0; i < strings.size(); ++i) {
+      values.push_back(boost::lexical_cast<int>(strings[i]));
+      CHECK_GT(values.back(), 0) << "Invalid list: " << list;
+    }
+  }
+  return values;
+}
+
 // caffe commands to call by
 //     caffe <command> <args>
 //
@@ -205,6 +253,13 @@ int train() {
 
   solver->SetActionFunction(signal_handler.GetActionFunction());
 
+  // Exports the metrics until training ends.
+  shared_ptr<caffe::MetricsExporter> metrics_exporter;
+  if (FLAGS_metrics_port >= 0 || FLAGS_metrics_file.size()) {
+    metrics_exporter.reset(new caffe::MetricsExporter(FLAGS_metrics_port,
+        FLAGS_metrics_file, FLAGS_metrics_interval));
+  }
+
   if (FLAGS_snapshot.size()) {
     LOG(INFO) << "Resuming from " << FLAGS_snapshot;
     solver->Restore(FLAGS_snapshot.c_str());
@@ -298,6 +353,132 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// Runs iterations forward passes of net on its own thread, once all the
+// workers are ready at barrier, and appends their latencies in milliseconds.
+static void time_worker(Net<float>* net, Caffe::Brew mode, int device,
+    int iterations, boost::barrier* barrier, vector<double>* latencies) {
+  // The Caffe state is per thread.
+  Caffe::set_mode(mode);
+  if (mode == Caffe::GPU) {
+    Caffe::SetDevice(device);
+  }
+  // A first pass creates the per-thread state, e.g. the cuBLAS handle.
+  net->ForwardPrefilled();
+  barrier->wait();
+  CPUTimer timer;
+  for (int i = 0; i < iterations; ++i) {
+    timer.Start();
+    net->ForwardPrefilled();
+    // Reads the outputs back, as a server would, which also waits for the GPU.
+    for (int j = 0; j < net->output_blobs().size(); ++j) {
+      net->output_blobs()[j]->cpu_data();
+    }
+    latencies->push_back(timer.MicroSeconds() / 1000);
+  }
+}
+
+// The number of items in a forward pass of net: the batch size of its first
+// input, or else of its first layer, e.g. a data layer.
+static int get_batch_size(const Net<float>& net) {
+  if (net.num_inputs()) {
+    return net.input_blobs()[0]->shape(0);
+  }
+  return net.top_vecs()[0][0]->shape(0);
+}
+
+// Time with threads: benchmark the inference throughput and latency of a
+// model under concurrent load, for each thread count and batch size.
+int time_concurrent(Caffe::Brew mode, int device) {
+  const vector<int> threads = get_int_list(FLAGS_threads);
+  const int max_threads = *std::max_element(threads.begin(), threads.end());
+  // One net per thread, all sharing the weights of the first.
+  vector<shared_ptr<Net<float> > > nets;
+  for (int i = 0; i < max_threads; ++i) {
+    nets.push_back(shared_ptr<Net<float> >(
+        new Net<float>(FLAGS_model, caffe::TEST)));
+    if (i == 0 && FLAGS_weights.size()) {
+      nets[0]->CopyTrainedLayersFrom(FLAGS_weights);
+    } else if (i > 0) {
+      nets[i]->ShareTrainedLayersWith(nets[0].get());
+    }
+  }
+  vector<int> batch_sizes = get_int_list(FLAGS_batch_sizes);
+  if (batch_sizes.size()) {
+    CHECK_GT(nets[0]->num_inputs(), 0)
+        << "Setting batch sizes needs a deploy model with input blobs.";
+  } else {
+    batch_sizes.push_back(get_batch_size(*nets[0]));
+  }
+
+  LOG(INFO) << "*** Concurrent benchmark begins ***";
+  LOG(INFO) << "Testing for " << FLAGS_iterations
+            << " iterations per thread.";
+  vector<string> optima;
+  for (int t = 0; t < threads.size(); ++t) {
+    const int num_threads = threads[t];
+    int best_batch_size = 0;
+    double best_throughput = 0;
+    for (int b = 0; b < batch_sizes.size(); ++b) {
+      for (int i = 0; i < num_threads; ++i) {
+        for (int j = 0; j < nets[i]->num_inputs(); ++j) {
+          Blob<float>* input = nets[i]->input_blobs()[j];
+          vector<int> shape = input->shape();
+          shape[0] = batch_sizes[b];
+          input->Reshape(shape);
+        }
+        nets[i]->Reshape();
+      }
+      // Brings the shared weights to the device before the threads use them.
+      nets[0]->ForwardPrefilled();
+      vector<vector<double> > latencies(num_threads);
+      boost::barrier barrier(num_threads + 1);
+      boost::thread_group workers;
+      for (int i = 0; i < num_threads; ++i) {
+        workers.create_thread(boost::bind(&time_worker, nets[i].get(), mode,
+            device, FLAGS_iterations, &barrier, &latencies[i]));
+      }
+      barrier.wait();
+      CPUTimer total_timer;
+      total_timer.Start();
+      workers.join_all();
+      const double seconds = total_timer.MicroSeconds() / 1e6;
+      vector<double> all_latencies;
+      for (int i = 0; i < num_threads; ++i) {
+        all_latencies.insert(all_latencies.end(), latencies[i].begin(),
+            latencies[i].end());
+      }
+      const double throughput = seconds > 0 ? static_cast<double>(
+          num_threads) * FLAGS_iterations * batch_sizes[b] / seconds : 0;
+      const double p99 = caffe::Percentile(all_latencies, 99);
+      LOG(INFO) << "Threads: " << num_threads << ", batch size: "
+                << batch_sizes[b] << ", throughput: " << throughput
+                << " items/s, latency p50: "
+                << caffe::Percentile(all_latencies, 50) << " ms, p95: "
+                << caffe::Percentile(all_latencies, 95) << " ms, p99: "
+                << p99 << " ms.";
+      if (throughput > best_throughput &&
+          (FLAGS_max_latency_ms <= 0 || p99 <= FLAGS_max_latency_ms)) {
+        best_batch_size = batch_sizes[b];
+        best_throughput = throughput;
+      }
+    }
+    ostringstream optimum;
+    optimum << "Optimal batch size for " << num_threads << " threads: ";
+    if (best_batch_size) {
+      optimum << best_batch_size << " (" << best_throughput << " items/s).";
+    } else {
+      optimum << "none within a p99 latency of " << FLAGS_max_latency_ms
+              << " ms.";
+    }
+    optima.push_back(optimum.str());
+  }
+  for (int i = 0; i < optima.size(); ++i) {
+    LOG(INFO) << optima[i];
+  }
+  LOG(INFO) << "*** Concurrent benchmark ends ***";
+  return 0;
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -313,6 +494,9 @@ int time() {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
   }
+  if (FLAGS_threads.size()) {
+    return time_concurrent(Caffe::mode(), gpus.size() ? gpus[0] : 0);
+  }
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, caffe::TRAIN);
 
@@ -383,6 +567,27 @@ int time() {
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_profile || FLAGS_profile_trace.size() || FLAGS_profile_csv.size()) {
+    // Profile separate passes through the net, so the profiler does not
+    // weigh on the benchmark above.
+    LOG(INFO) << "Profiling for " << FLAGS_iterations << " iterations.";
+    NetProfiler<float> profiler;
+    caffe_net.set_profiler(&profiler);
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      caffe_net.ForwardPrefilled();
+      caffe_net.Backward();
+    }
+    caffe_net.set_profiler(NULL);
+    profiler.LogSummary();
+    if (FLAGS_profile_trace.size()) {
+      profiler.WriteChromeTrace(FLAGS_profile_trace);
+      LOG(INFO) << "Wrote the trace to " << FLAGS_profile_trace;
+    }
+    if (FLAGS_profile_csv.size()) {
+      profiler.WriteCSV(FLAGS_profile_csv);
+      LOG(INFO) << "Wrote the layer stats to " << FLAGS_profile_csv;
+    }
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -0,0 +1,40 @@
+// This program converts trained weights to the mapped format, which nets can
+// use in place from a memory mapping instead of copying them (see
+// MappedWeights). The input is a binary proto .caffemodel or a chunked
+// snapshot manifest.
+// Usage:
+//    caffemodel_to_mmap INPUT_WEIGHTS OUTPUT.caffemodel.mmap
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: "
+        << "caffemodel_to_mmap INPUT_WEIGHTS OUTPUT.caffemodel.mmap";
+    return 1;
+  }
+  const string input_filename(argv[1]);
+  const string output_filename(argv[2]);
+  if (!IsMappedWeights(output_filename)) {
+    LOG(WARNING) << "Nets only map weights files ending in .mmap; "
+        << "others are read as binary protos.";
+  }
+  NetParameter net_param;
+  if (IsChunkedManifest(input_filename)) {
+    ReadChunkedProtoOrDie(input_filename, &net_param);
+  } else {
+    ReadNetParamsFromBinaryFileOrDie(input_filename, &net_param);
+  }
+  WriteMappedWeights(net_param, output_filename);
+  LOG(INFO) << "Wrote mapped weights to " << output_filename;
+  return 0;
+}
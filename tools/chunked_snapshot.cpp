@@ -0,0 +1,102 @@
+// This program exports and compacts chunked solver snapshots, written with
+// snapshot_format: CHUNKED.
+// Usage:
+//    chunked_snapshot export MANIFEST OUTPUT_FILE
+//    chunked_snapshot compact CHUNK_DIR MANIFEST [MANIFEST...]
+//
+// export writes the snapshot as a plain binary proto, i.e. a .caffemodel for a
+// .caffemodel.manifest and a .solverstate for a .solverstate.manifest.
+// compact deletes the chunks of CHUNK_DIR that are not referenced by any of
+// the given manifests. It must not run while a solver snapshots to CHUNK_DIR.
+
+#include <boost/filesystem.hpp>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/chunked_snapshot.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+namespace fs = boost::filesystem;
+
+static bool IsSolverStateManifest(const string& filename) {
+  const string suffix = ".solverstate.manifest";
+  return filename.size() >= suffix.size() && filename.compare(
+      filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static int Export(const string& manifest_filename,
+    const string& output_filename) {
+  CHECK(IsChunkedManifest(manifest_filename))
+      << manifest_filename << " is not a chunked snapshot manifest.";
+  if (IsSolverStateManifest(manifest_filename)) {
+    SolverState state;
+    ReadChunkedProtoOrDie(manifest_filename, &state);
+    WriteProtoToBinaryFile(state, output_filename);
+  } else {
+    NetParameter net_param;
+    ReadChunkedProtoOrDie(manifest_filename, &net_param);
+    WriteProtoToBinaryFile(net_param, output_filename);
+  }
+  LOG(INFO) << "Exported " << manifest_filename << " to " << output_filename;
+  return 0;
+}
+
+static int Compact(const string& chunk_dir,
+    const vector<string>& manifest_filenames) {
+  std::set<string> referenced;
+  for (int i = 0; i < manifest_filenames.size(); ++i) {
+    CHECK(IsChunkedManifest(manifest_filenames[i]))
+        << manifest_filenames[i] << " is not a chunked snapshot manifest.";
+    vector<string> chunks;
+    if (IsSolverStateManifest(manifest_filenames[i])) {
+      SolverState state;
+      ReadProtoFromBinaryFileOrDie(manifest_filenames[i], &state);
+      GetSnapshotChunks(state, &chunks);
+    } else {
+      NetParameter net_param;
+      ReadProtoFromBinaryFileOrDie(manifest_filenames[i], &net_param);
+      GetSnapshotChunks(net_param, &chunks);
+    }
+    // Chunk names are content hashes, so their file name identifies them.
+    for (int j = 0; j < chunks.size(); ++j) {
+      referenced.insert(fs::path(chunks[j]).filename().string());
+    }
+  }
+  int num_kept = 0;
+  int num_removed = 0;
+  uintmax_t bytes_removed = 0;
+  for (fs::directory_iterator it(chunk_dir), end; it != end; ++it) {
+    if (!fs::is_regular_file(it->status())) {
+      continue;
+    }
+    if (referenced.count(it->path().filename().string())) {
+      ++num_kept;
+    } else {
+      bytes_removed += fs::file_size(it->path());
+      fs::remove(it->path());
+      ++num_removed;
+    }
+  }
+  LOG(INFO) << "Kept " << num_kept << " chunks, removed " << num_removed
+      << " (" << bytes_removed / 1048576.0 << " MB)";
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+  if (argc == 4 && string(argv[1]) == "export") {
+    return Export(argv[2], argv[3]);
+  } else if (argc >= 4 && string(argv[1]) == "compact") {
+    return Compact(argv[2], vector<string>(argv + 3, argv + argc));
+  }
+  LOG(ERROR) << "Usage:\n"
+      << "    chunked_snapshot export MANIFEST OUTPUT_FILE\n"
+      << "    chunked_snapshot compact CHUNK_DIR MANIFEST [MANIFEST...]";
+  return 1;
+}
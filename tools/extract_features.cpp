@@ -1,24 +1,342 @@
+#include <stdint.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "google/protobuf/text_format.h"
+#include "hdf5.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/pca.hpp"
 
 using caffe::Blob;
+using caffe::BlockingQueue;
 using caffe::Caffe;
 using caffe::Datum;
 using caffe::Net;
+using caffe::PCA;
 using std::string;
 namespace db = caffe::db;
 
+DEFINE_bool(fp16, false,
+    "Optional; store the features as half floats, for the npy and hdf5 "
+    "formats.");
+DEFINE_int32(pca_dims, 0,
+    "Optional; reduce the features to this many principal components, "
+    "fitted on the first pca_samples items. The mean and components are "
+    "saved to DATASET.pca.h5.");
+DEFINE_int32(pca_samples, 10000,
+    "The number of items the principal components are fitted on.");
+
+// Stores the features of a blob, in the order they are extracted.
+class FeatureWriter {
+ public:
+  virtual ~FeatureWriter() {}
+  // Writes num items, each with the item shape the writer was created with.
+  virtual void Write(const float* data, int num) = 0;
+  virtual void Close() = 0;
+};
+
+// Writes each item as a Datum of float_data to a LevelDB or LMDB.
+class DBWriter : public FeatureWriter {
+ public:
+  DBWriter(const string& db_type, const string& name,
+      const std::vector<int>& item_shape) : count_(0), num_items_(0) {
+    db_.reset(db::GetDB(db_type));
+    db_->Open(name, db::NEW);
+    txn_.reset(db_->NewTransaction());
+    // The legacy channels, height and width of the item. Items with more
+    // than 3 axes fold the leading ones into channels, which keeps the
+    // row-major layout of the data.
+    std::vector<int> shape(item_shape);
+    while (shape.size() > 3) {
+      shape[1] *= shape[0];
+      shape.erase(shape.begin());
+    }
+    shape.resize(3, 1);
+    datum_.set_channels(shape[0]);
+    datum_.set_height(shape[1]);
+    datum_.set_width(shape[2]);
+    count_ = shape[0] * shape[1] * shape[2];
+    datum_.mutable_float_data()->Resize(count_, 0);
+  }
+
+  virtual void Write(const float* data, int num) {
+    float* float_data = datum_.mutable_float_data()->mutable_data();
+    string out;
+    for (int n = 0; n < num; ++n) {
+      std::copy(data + n * count_, data + (n + 1) * count_, float_data);
+      CHECK(datum_.SerializeToString(&out));
+      txn_->Put(caffe::format_int(num_items_, 10), out);
+      if (++num_items_ % 1000 == 0) {
+        txn_->Commit();
+        txn_.reset(db_->NewTransaction());
+      }
+    }
+  }
+
+  virtual void Close() {
+    if (num_items_ % 1000 != 0) {
+      txn_->Commit();
+    }
+    db_->Close();
+  }
+
+ private:
+  boost::shared_ptr<db::DB> db_;
+  boost::shared_ptr<db::Transaction> txn_;
+  Datum datum_;
+  int count_;
+  int num_items_;
+};
+
+// Writes the items as one array in the NumPy .npy format, which
+// numpy.load(name, mmap_mode='r') maps without reading it.
+class NpyWriter : public FeatureWriter {
+ public:
+  NpyWriter(const string& name, const std::vector<int>& item_shape,
+      bool fp16) : item_shape_(item_shape), fp16_(fp16), num_items_(0) {
+    count_ = 1;
+    for (int i = 0; i < item_shape.size(); ++i) {
+      count_ *= item_shape[i];
+    }
+    file_.open(name.c_str(), std::ios::binary);
+    CHECK(file_.good()) << "Failed to open " << name;
+    // The header is rewritten with the number of items at the end.
+    file_ << Header();
+  }
+
+  virtual void Write(const float* data, int num) {
+    if (fp16_) {
+      halves_.resize(num * count_);
+      caffe::caffe_cpu_float_to_half(num * count_, data, &halves_[0]);
+      file_.write(reinterpret_cast<const char*>(&halves_[0]),
+          halves_.size() * sizeof(uint16_t));
+    } else {
+      file_.write(reinterpret_cast<const char*>(data),
+          num * count_ * sizeof(float));
+    }
+    num_items_ += num;
+  }
+
+  virtual void Close() {
+    file_.seekp(0);
+    file_ << Header();
+    file_.close();
+    CHECK(!file_.fail()) << "Failed to write the features";
+  }
+
+ private:
+  // The version 1.0 header. Padding the number of items to 19 characters
+  // keeps its length the same whatever the number.
+  string Header() const {
+    const uint16_t one = 1;
+    const bool little_endian = *reinterpret_cast<const char*>(&one);
+    std::ostringstream dict;
+    dict << "{'descr': '" << (little_endian ? '<' : '>')
+        << (fp16_ ? "f2" : "f4") << "', 'fortran_order': False, 'shape': ("
+        << std::setw(19) << num_items_ << ",";
+    for (int i = 0; i < item_shape_.size(); ++i) {
+      dict << " " << item_shape_[i] << ",";
+    }
+    dict << "), }";
+    // The magic string, version and header length take 10 bytes, and the
+    // data starts at a multiple of 64 bytes.
+    string text = dict.str();
+    text.append(63 - (10 + text.size()) % 64, ' ');
+    text += '\n';
+    const uint16_t length = text.size();
+    return string("\x93NUMPY\x01\x00", 8) +
+        static_cast<char>(length & 0xff) + static_cast<char>(length >> 8) +
+        text;
+  }
+
+  std::ofstream file_;
+  const std::vector<int> item_shape_;
+  const bool fp16_;
+  int count_;
+  int64_t num_items_;
+  std::vector<uint16_t> halves_;
+};
+
+// Appends the items to a chunked dataset of an HDF5 file, named after the
+// blob so that an HDF5Data layer can read them back.
+class HDF5Writer : public FeatureWriter {
+ public:
+  HDF5Writer(const string& name, const string& dataset,
+      const std::vector<int>& item_shape, bool fp16)
+      : dims_(1, 0), num_items_(0) {
+    dims_.insert(dims_.end(), item_shape.begin(), item_shape.end());
+    hsize_t count = 1;
+    for (int i = 0; i < item_shape.size(); ++i) {
+      count *= item_shape[i];
+    }
+    std::vector<hsize_t> max_dims(dims_);
+    max_dims[0] = H5S_UNLIMITED;
+    // Chunks of about 1 MB.
+    std::vector<hsize_t> chunk(dims_);
+    chunk[0] = std::max<hsize_t>(1, (1 << 20) / (count * sizeof(float)));
+    file_ = H5Fcreate(name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    CHECK_GE(file_, 0) << "Failed to open " << name;
+    hid_t space = H5Screate_simple(dims_.size(), &dims_[0], &max_dims[0]);
+    hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, chunk.size(), &chunk[0]);
+    hid_t type = H5Tcopy(H5T_IEEE_F32LE);
+    if (fp16) {
+      // IEEE half precision, as numpy.float16 reads it: 1 sign bit at 15, 5
+      // exponent bits at 10 with a bias of 15, and 10 mantissa bits.
+      H5Tset_fields(type, 15, 10, 5, 0, 10);
+      H5Tset_size(type, 2);
+      H5Tset_ebias(type, 15);
+    }
+    dataset_ = H5Dcreate2(file_, dataset.c_str(), type, space, H5P_DEFAULT,
+        properties, H5P_DEFAULT);
+    CHECK_GE(dataset_, 0) << "Failed to create the dataset " << dataset;
+    H5Tclose(type);
+    H5Pclose(properties);
+    H5Sclose(space);
+  }
+
+  virtual void Write(const float* data, int num) {
+    std::vector<hsize_t> offset(dims_.size(), 0);
+    offset[0] = num_items_;
+    std::vector<hsize_t> count(dims_);
+    count[0] = num;
+    num_items_ += num;
+    dims_[0] = num_items_;
+    CHECK_GE(H5Dset_extent(dataset_, &dims_[0]), 0);
+    hid_t file_space = H5Dget_space(dataset_);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &offset[0], NULL,
+        &count[0], NULL);
+    hid_t memory_space = H5Screate_simple(count.size(), &count[0], NULL);
+    // HDF5 converts to half floats if needed.
+    CHECK_GE(H5Dwrite(dataset_, H5T_NATIVE_FLOAT, memory_space, file_space,
+        H5P_DEFAULT, data), 0) << "Failed to write the features";
+    H5Sclose(memory_space);
+    H5Sclose(file_space);
+  }
+
+  virtual void Close() {
+    H5Dclose(dataset_);
+    CHECK_GE(H5Fclose(file_), 0) << "Failed to write the features";
+  }
+
+ private:
+  std::vector<hsize_t> dims_;
+  hsize_t num_items_;
+  hid_t file_;
+  hid_t dataset_;
+};
+
+// Extracts the features of one blob in a pipeline: the thread running the
+// net copies each batch to a free buffer, while a thread of its own reduces
+// the full buffers with PCA if needed and writes them.
+class FeatureSink {
+ public:
+  FeatureSink(FeatureWriter* writer, int dim, int max_batch_size,
+      const string& pca_filename)
+      : writer_(writer), dim_(dim), pca_filename_(pca_filename),
+        buffers_(kNumBuffers, std::vector<float>(dim * max_batch_size)),
+        nums_(kNumBuffers, 0) {
+    for (int i = 0; i < kNumBuffers; ++i) {
+      free_.push(i);
+    }
+    thread_.reset(new boost::thread(&FeatureSink::Entry, this));
+  }
+
+  // Copies a batch of num items to the next free buffer and queues it.
+  template <typename Dtype>
+  void Push(const Dtype* data, int num) {
+    const int i = free_.pop();
+    std::copy(data, data + num * dim_, buffers_[i].begin());
+    nums_[i] = num;
+    full_.push(i);
+  }
+
+  // Writes the queued batches and closes the writer.
+  void Finish() {
+    full_.push(-1);
+    thread_->join();
+  }
+
+ private:
+  // The buffers in flight, enough to absorb the jitter of either side.
+  static const int kNumBuffers = 4;
+
+  void Entry() {
+    for (int i = full_.pop(); i >= 0; i = full_.pop()) {
+      if (FLAGS_pca_dims == 0) {
+        writer_->Write(&buffers_[i][0], nums_[i]);
+      } else if (pca_.num_components()) {
+        Project(&buffers_[i][0], nums_[i]);
+      } else {
+        // Fits the principal components once enough items are held.
+        samples_.insert(samples_.end(), buffers_[i].begin(),
+            buffers_[i].begin() + nums_[i] * dim_);
+        if (samples_.size() >= FLAGS_pca_samples * dim_) {
+          FitPCA();
+        }
+      }
+      free_.push(i);
+    }
+    if (FLAGS_pca_dims && !pca_.num_components() && samples_.size()) {
+      FitPCA();
+    }
+    writer_->Close();
+  }
+
+  void FitPCA() {
+    const int num = samples_.size() / dim_;
+    LOG(ERROR) << "Fitting " << FLAGS_pca_dims << " principal components "
+        << "on " << num << " items";
+    pca_.Fit(num, dim_, &samples_[0], FLAGS_pca_dims);
+    hid_t file = H5Fcreate(pca_filename_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+        H5P_DEFAULT);
+    CHECK_GE(file, 0) << "Failed to open " << pca_filename_;
+    caffe::hdf5_save_nd_dataset(file, "mean", pca_.mean());
+    caffe::hdf5_save_nd_dataset(file, "components", pca_.components());
+    Blob<float> variances(std::vector<int>(1, FLAGS_pca_dims));
+    std::copy(pca_.variances().begin(), pca_.variances().end(),
+        variances.mutable_cpu_data());
+    caffe::hdf5_save_nd_dataset(file, "variances", variances);
+    H5Fclose(file);
+    Project(&samples_[0], num);
+    std::vector<float>().swap(samples_);
+  }
+
+  void Project(const float* data, int num) {
+    projection_.resize(num * FLAGS_pca_dims);
+    pca_.Project(num, data, &projection_[0]);
+    writer_->Write(&projection_[0], num);
+  }
+
+  boost::shared_ptr<FeatureWriter> writer_;
+  const int dim_;
+  const string pca_filename_;
+  std::vector<std::vector<float> > buffers_;
+  std::vector<int> nums_;
+  BlockingQueue<int> free_;
+  BlockingQueue<int> full_;
+  boost::shared_ptr<boost::thread> thread_;
+  PCA<float> pca_;
+  std::vector<float> samples_;
+  std::vector<float> projection_;
+};
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -29,7 +347,7 @@ int main(int argc, char** argv) {
 
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv) {
-  ::google::InitGoogleLogging(argv[0]);
+  caffe::GlobalInit(&argc, &argv);
   const int num_required_args = 7;
   if (argc < num_required_args) {
     LOG(ERROR)<<
@@ -42,7 +360,11 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "The db_type is lmdb or leveldb to store Datum protos, npy to store a"
+    " NumPy array per blob, which can be memory-mapped, or hdf5 to store a"
+    " dataset named after the blob. Features can be stored as half floats"
+    " with -fp16, and reduced with -pca_dims.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -118,65 +440,57 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   int num_mini_batches = atoi(argv[++arg_pos]);
 
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
+  const string db_type = argv[++arg_pos];
+  std::vector<boost::shared_ptr<FeatureSink> > sinks;
   for (size_t i = 0; i < num_features; ++i) {
     LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    const boost::shared_ptr<Blob<Dtype> > feature_blob =
+        feature_extraction_net->blob_by_name(blob_names[i]);
+    const int dim = feature_blob->count(1);
+    std::vector<int> item_shape(feature_blob->shape().begin() + 1,
+        feature_blob->shape().end());
+    if (FLAGS_pca_dims) {
+      CHECK_LE(FLAGS_pca_dims, dim) << "More components than features";
+      item_shape.assign(1, FLAGS_pca_dims);
+    }
+    FeatureWriter* writer;
+    if (db_type == "npy") {
+      writer = new NpyWriter(dataset_names[i], item_shape, FLAGS_fp16);
+    } else if (db_type == "hdf5") {
+      writer = new HDF5Writer(dataset_names[i], blob_names[i], item_shape,
+          FLAGS_fp16);
+    } else {
+      CHECK(!FLAGS_fp16) << "Half floats need the npy or hdf5 format";
+      writer = new DBWriter(db_type, dataset_names[i], item_shape);
+    }
+    sinks.push_back(boost::shared_ptr<FeatureSink>(new FeatureSink(writer,
+        dim, feature_blob->shape(0), dataset_names[i] + ".pca.h5")));
   }
 
   LOG(ERROR)<< "Extacting Features";
 
-  Datum datum;
+  // The sinks write the features of a batch while the net runs the next.
   std::vector<Blob<float>*> input_vec;
-  std::vector<int> image_indices(num_features, 0);
+  int num_images = 0;
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
     feature_extraction_net->Forward(input_vec);
+    int batch_size = 0;
     for (int i = 0; i < num_features; ++i) {
       const boost::shared_ptr<Blob<Dtype> > feature_blob =
         feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
+      batch_size = feature_blob->shape(0);
+      sinks[i]->Push(feature_blob->cpu_data(), batch_size);
+    }
+    num_images += batch_size;
+    if (num_images / 1000 != (num_images - batch_size) / 1000) {
+      LOG(ERROR)<< "Extracted features of " << num_images <<
+          " query images";
+    }
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
-  // write the last batch
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
-    }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
+    sinks[i]->Finish();
+    LOG(ERROR)<< "Extracted features of " << num_images <<
         " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,523 @@
+// This program serves the forward pass of a deployed model over a local
+// socket. Each worker thread runs an InferenceSession of the model, whose
+// input is a streaming MemoryData layer: concurrent requests are pushed to the
+// workers in turn, and a worker runs the oldest up to -max_batch_size of its
+// requests together, waiting at most -batch_timeout_ms after the first one
+// for more to arrive. The sessions share the weights of the model.
+// Usage:
+//    inference_server -model deploy.prototxt -weights model.caffemodel
+//                     (-socket /tmp/caffe.sock | -port 8500) [-workers N]
+//                     [-max_batch_size N] [-batch_timeout_ms MS]
+//                     [-connections N]
+//
+// The model must have a single input blob, of up to 4 axes. Up to
+// -connections connections are served at once, each carrying any number of
+// requests, one at a time. Integers are uint32 and values float32, in the
+// byte order of the server host:
+//   request:  n, then the n values of one item of the input, i.e. its values
+//             without the batch dimension.
+//   response: status (0 if OK, 1 if the request has the wrong size, which
+//             closes the connection), m, then the m values of the item in
+//             each output blob in order.
+// SIGINT or SIGTERM stops the server once the requests being read are
+// answered.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/layers/memory_data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/metrics.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "",
+    "The deploy model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights of the model.");
+DEFINE_int32(gpu, -1,
+    "Optional; run on this GPU instead of the CPU.");
+DEFINE_string(socket, "",
+    "The path of the Unix domain socket to listen on.");
+DEFINE_int32(port, -1,
+    "The TCP port to listen on, instead of a Unix domain socket.");
+DEFINE_string(address, "127.0.0.1",
+    "The address the TCP port is bound to.");
+DEFINE_int32(workers, 1,
+    "The number of threads running batches, each with a session of the "
+    "model.");
+DEFINE_int32(max_batch_size, 32,
+    "The maximum number of requests run in one batch.");
+DEFINE_int32(batch_timeout_ms, 5,
+    "How long a batch waits for more requests after its first one.");
+DEFINE_int32(connections, 64,
+    "The maximum number of connections served at once, each by a thread.");
+DEFINE_double(stats_interval, 10,
+    "The interval in seconds between logs of the throughput and latency.");
+DEFINE_int32(metrics_port, -1,
+    "Optional; serve the server metrics over HTTP on this local port.");
+
+// Set by SIGINT and SIGTERM.
+static volatile sig_atomic_t stop_requested = 0;
+
+static void RequestStop(int signum) {
+  stop_requested = 1;
+}
+
+// A request for one item, answered by a worker.
+struct Request {
+  Request() : done(false) {}
+
+  // Waits until a worker has answered the request.
+  void Wait() {
+    boost::mutex::scoped_lock lock(mutex);
+    while (!done) {
+      answered.wait(lock);
+    }
+  }
+
+  void Answer() {
+    boost::mutex::scoped_lock lock(mutex);
+    done = true;
+    answered.notify_one();
+  }
+
+  vector<float> input;
+  vector<float> output;
+  boost::posix_time::ptime arrival;
+  bool done;
+  boost::mutex mutex;
+  boost::condition_variable answered;
+};
+
+// A session of the model and the requests pushed to its input stream, by
+// their sample ids.
+struct Worker {
+  explicit Worker(const shared_ptr<Net<float> >& model)
+      : session(model), input(boost::static_pointer_cast<
+            MemoryDataLayer<float> >(
+                session.net()->layer_by_name("inference_server_input"))) {}
+
+  // Pushes request to the stream, or returns false if it is closed.
+  bool Push(Request* request) {
+    // The id is mapped before the worker can output the sample.
+    boost::mutex::scoped_lock lock(mutex);
+    uint64_t id;
+    if (!input->PushData(&request->input[0], 0, &id)) {
+      return false;
+    }
+    pending[id] = request;
+    return true;
+  }
+
+  int num_pending() {
+    boost::mutex::scoped_lock lock(mutex);
+    return pending.size();
+  }
+
+  InferenceSession<float> session;
+  shared_ptr<MemoryDataLayer<float> > input;
+  boost::mutex mutex;
+  std::map<uint64_t, Request*> pending;
+};
+
+// The requests and latencies since the last log.
+class Stats {
+ public:
+  Stats() : requests_(0), batches_(0),
+      start_(boost::posix_time::microsec_clock::universal_time()) {}
+
+  void Record(const vector<Request*>& batch) {
+    const boost::posix_time::ptime now =
+        boost::posix_time::microsec_clock::universal_time();
+    Metrics& metrics = Metrics::Get();
+    boost::mutex::scoped_lock lock(mutex_);
+    requests_ += batch.size();
+    ++batches_;
+    for (int i = 0; i < batch.size(); ++i) {
+      const double ms =
+          (now - batch[i]->arrival).total_microseconds() / 1000.;
+      latencies_.push_back(ms);
+      if (metrics.enabled()) {
+        metrics.Observe("caffe_server_request_seconds", ms / 1000);
+      }
+    }
+    if (metrics.enabled()) {
+      metrics.Increment("caffe_server_requests_total", batch.size());
+      metrics.Increment("caffe_server_batches_total");
+    }
+  }
+
+  void Log(int queue_size) {
+    const boost::posix_time::ptime now =
+        boost::posix_time::microsec_clock::universal_time();
+    boost::mutex::scoped_lock lock(mutex_);
+    const double seconds = (now - start_).total_microseconds() / 1e6;
+    if (requests_) {
+      LOG(INFO) << "Served " << requests_ << " requests in " << batches_
+          << " batches (" << static_cast<double>(requests_) / batches_
+          << " per batch), " << requests_ / seconds << " requests/s, "
+          << "latency p50: " << Percentile(latencies_, 50) << " ms, p95: "
+          << Percentile(latencies_, 95) << " ms, p99: "
+          << Percentile(latencies_, 99) << " ms. Queued: " << queue_size;
+    }
+    requests_ = 0;
+    batches_ = 0;
+    latencies_.clear();
+    start_ = now;
+  }
+
+ private:
+  boost::mutex mutex_;
+  int requests_;
+  int batches_;
+  vector<double> latencies_;
+  boost::posix_time::ptime start_;
+};
+
+// Runs the batches of worker's stream, from a thread of its own, until the
+// stream is closed.
+void Work(Worker* worker, Stats* stats) {
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  }
+  const Net<float>& net = *worker->session.net();
+  vector<Request*> batch;
+  while (true) {
+    worker->session.Forward();
+    const vector<uint64_t>& ids = worker->input->batch_ids();
+    if (ids.empty()) {
+      break;
+    }
+    const int size = ids.size();
+    batch.resize(size);
+    {
+      boost::mutex::scoped_lock lock(worker->mutex);
+      for (int i = 0; i < size; ++i) {
+        std::map<uint64_t, Request*>::iterator it =
+            worker->pending.find(ids[i]);
+        CHECK(it != worker->pending.end()) << "Unknown sample " << ids[i];
+        batch[i] = it->second;
+        worker->pending.erase(it);
+      }
+    }
+    for (int i = 0; i < size; ++i) {
+      batch[i]->output.clear();
+    }
+    for (int j = 0; j < net.num_outputs(); ++j) {
+      const Blob<float>* output = net.output_blobs()[j];
+      CHECK_EQ(output->shape(0), size) << "Outputs must have a batch axis.";
+      const int item_count = output->count(1);
+      const float* data = output->cpu_data();
+      for (int i = 0; i < size; ++i) {
+        batch[i]->output.insert(batch[i]->output.end(),
+            data + i * item_count, data + (i + 1) * item_count);
+      }
+    }
+    stats->Record(batch);
+    for (int i = 0; i < size; ++i) {
+      batch[i]->Answer();
+    }
+  }
+}
+
+// Waits until fd is readable, or returns false once the server stops.
+static bool WaitReadable(int fd) {
+  pollfd readable;
+  readable.fd = fd;
+  readable.events = POLLIN;
+  while (!stop_requested) {
+    if (poll(&readable, 1, 100) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ReadFully(int connection, void* data, size_t size) {
+  char* bytes = reinterpret_cast<char*>(data);
+  while (size) {
+    if (!WaitReadable(connection)) {
+      return false;
+    }
+    const ssize_t count = read(connection, bytes, size);
+    if (count <= 0) {
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+static bool WriteFully(int connection, const void* data, size_t size) {
+  const char* bytes = reinterpret_cast<const char*>(data);
+  while (size) {
+    const ssize_t count = send(connection, bytes, size, MSG_NOSIGNAL);
+    if (count <= 0) {
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+// The workers, which take the requests of the connections in turn.
+class Dispatcher {
+ public:
+  Dispatcher(const vector<shared_ptr<Worker> >& workers, int input_size)
+      : workers_(workers), input_size_(input_size), next_(0) {}
+
+  // Answers the requests of a connection until the client closes it or the
+  // server stops.
+  void Serve(int connection) {
+    Request request;
+    uint32_t size;
+    while (ReadFully(connection, &size, sizeof(size))) {
+      if (size != input_size_) {
+        LOG(WARNING) << "Closing a connection sending " << size
+            << " values instead of " << input_size_;
+        const uint32_t error[2] = {1, 0};
+        WriteFully(connection, error, sizeof(error));
+        break;
+      }
+      request.input.resize(size);
+      if (!ReadFully(connection, &request.input[0], size * sizeof(float))) {
+        break;
+      }
+      request.arrival = boost::posix_time::microsec_clock::universal_time();
+      request.done = false;
+      if (!NextWorker()->Push(&request)) {
+        break;
+      }
+      request.Wait();
+      const uint32_t header[2] = {0,
+          static_cast<uint32_t>(request.output.size())};
+      if (!WriteFully(connection, header, sizeof(header)) ||
+          (request.output.size() && !WriteFully(connection,
+              &request.output[0], request.output.size() * sizeof(float)))) {
+        break;
+      }
+    }
+    close(connection);
+  }
+
+  int num_pending() {
+    int num = 0;
+    for (int i = 0; i < workers_.size(); ++i) {
+      num += workers_[i]->num_pending();
+    }
+    return num;
+  }
+
+ private:
+  Worker* NextWorker() {
+    boost::mutex::scoped_lock lock(mutex_);
+    next_ = (next_ + 1) % workers_.size();
+    return workers_[next_].get();
+  }
+
+  const vector<shared_ptr<Worker> > workers_;
+  const uint32_t input_size_;
+  boost::mutex mutex_;
+  int next_;
+};
+
+// Accepts and serves connections, one at a time, until the server stops.
+// The listener is non-blocking, so the threads polling it don't block when
+// another one accepts the connection first.
+void Accept(int listener, Dispatcher* dispatcher) {
+  while (WaitReadable(listener)) {
+    const int connection = accept(listener, NULL, NULL);
+    if (connection >= 0) {
+      dispatcher->Serve(connection);
+    }
+  }
+}
+
+// Binds and listens on the socket or port of the flags.
+static int Listen() {
+  CHECK_NE(FLAGS_socket.empty(), FLAGS_port < 0)
+      << "Set exactly one of -socket and -port.";
+  int listener;
+  if (FLAGS_socket.size()) {
+    sockaddr_un address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+    CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+        << "Socket path too long: " << FLAGS_socket;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s",
+        FLAGS_socket.c_str());
+    // Replaces the socket of a previous run.
+    unlink(FLAGS_socket.c_str());
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK_GE(listener, 0) << "Failed to create the socket";
+    CHECK_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address),
+        sizeof(address)), 0) << "Failed to bind " << FLAGS_socket;
+    LOG(INFO) << "Listening on " << FLAGS_socket;
+  } else {
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(FLAGS_port);
+    CHECK_EQ(inet_pton(AF_INET, FLAGS_address.c_str(), &address.sin_addr), 1)
+        << "Invalid address: " << FLAGS_address;
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_GE(listener, 0) << "Failed to create the socket";
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    CHECK_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address),
+        sizeof(address)), 0) << "Failed to bind port " << FLAGS_port;
+    LOG(INFO) << "Listening on " << FLAGS_address << ":" << FLAGS_port;
+  }
+  CHECK_EQ(fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK),
+      0);
+  CHECK_EQ(listen(listener, 128), 0);
+  return listener;
+}
+
+// Replaces the input blob of the deploy model with a streaming MemoryData
+// layer of the same item shape, returning the number of values of an item.
+static int StreamInput(NetParameter* param) {
+  CHECK_EQ(param->input_size(), 1) << "The model must have one input blob.";
+  vector<int> shape;
+  if (param->input_shape_size()) {
+    const BlobShape& input_shape = param->input_shape(0);
+    shape.assign(input_shape.dim().begin(), input_shape.dim().end());
+  } else {
+    shape.assign(param->input_dim().begin(), param->input_dim().end());
+  }
+  CHECK_GE(shape.size(), 2) << "The input must have a batch axis.";
+  CHECK_LE(shape.size(), 4) << "The input can't have more than 4 axes.";
+  shape.resize(4, 1);
+  NetParameter streaming;
+  streaming.CopyFrom(*param);
+  streaming.clear_input();
+  streaming.clear_input_shape();
+  streaming.clear_input_dim();
+  streaming.clear_layer();
+  streaming.mutable_state()->set_phase(TEST);
+  LayerParameter* data = streaming.add_layer();
+  data->set_name("inference_server_input");
+  data->set_type("MemoryData");
+  data->add_top(param->input(0));
+  data->add_top("inference_server_label");
+  MemoryDataParameter* memory_data = data->mutable_memory_data_param();
+  memory_data->set_batch_size(FLAGS_max_batch_size);
+  memory_data->set_channels(shape[1]);
+  memory_data->set_height(shape[2]);
+  memory_data->set_width(shape[3]);
+  memory_data->set_streaming(true);
+  memory_data->set_batch_timeout_ms(FLAGS_batch_timeout_ms);
+  LayerParameter* silence = streaming.add_layer();
+  silence->set_name("inference_server_silence");
+  silence->set_type("Silence");
+  silence->add_bottom("inference_server_label");
+  for (int i = 0; i < param->layer_size(); ++i) {
+    streaming.add_layer()->CopyFrom(param->layer(i));
+  }
+  param->Swap(&streaming);
+  return shape[1] * shape[2] * shape[3];
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serves a model over a local socket, batching "
+      "concurrent requests.\n"
+      "Usage: inference_server -model deploy.prototxt -weights "
+      "model.caffemodel (-socket PATH | -port PORT)");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to serve.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to serve.";
+  CHECK_GT(FLAGS_workers, 0);
+  CHECK_GT(FLAGS_max_batch_size, 0);
+  CHECK_GE(FLAGS_batch_timeout_ms, 0);
+  CHECK_GT(FLAGS_connections, 0);
+  CHECK_GT(FLAGS_stats_interval, 0);
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  const int input_size = StreamInput(&param);
+  shared_ptr<Net<float> > model(new Net<float>(param));
+  model->CopyTrainedLayersFrom(FLAGS_weights);
+  // The sessions sync the model's params to the device as they are made.
+  vector<shared_ptr<Worker> > workers;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    workers.push_back(shared_ptr<Worker>(new Worker(model)));
+  }
+
+  shared_ptr<MetricsExporter> metrics_exporter;
+  if (FLAGS_metrics_port >= 0) {
+    metrics_exporter.reset(new MetricsExporter(FLAGS_metrics_port, "", 1));
+  }
+  const int listener = Listen();
+  signal(SIGINT, RequestStop);
+  signal(SIGTERM, RequestStop);
+  Stats stats;
+  Dispatcher dispatcher(workers, input_size);
+  boost::thread_group work_threads;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    work_threads.create_thread(boost::bind(&Work, workers[i].get(), &stats));
+  }
+  boost::thread_group connection_threads;
+  for (int i = 0; i < FLAGS_connections; ++i) {
+    connection_threads.create_thread(boost::bind(&Accept, listener,
+        &dispatcher));
+  }
+  LOG(INFO) << "Serving items of " << input_size << " values with "
+      << FLAGS_workers << " workers, in batches of up to "
+      << FLAGS_max_batch_size;
+
+  // Logs the stats until stopped.
+  const boost::posix_time::time_duration stats_interval =
+      boost::posix_time::microseconds(static_cast<int64_t>(
+          FLAGS_stats_interval * 1e6));
+  boost::posix_time::ptime next_stats =
+      boost::posix_time::microsec_clock::universal_time() + stats_interval;
+  while (!stop_requested) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    if (boost::posix_time::microsec_clock::universal_time() >= next_stats) {
+      const int queue_size = dispatcher.num_pending();
+      stats.Log(queue_size);
+      if (Metrics::Get().enabled()) {
+        Metrics::Get().Set("caffe_server_queue_size", queue_size);
+      }
+      next_stats += stats_interval;
+    }
+  }
+  LOG(INFO) << "Stopping";
+  // The connections finish their pending requests, then the workers stop.
+  connection_threads.join_all();
+  close(listener);
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    workers[i]->input->CloseStream();
+  }
+  work_threads.join_all();
+  stats.Log(0);
+  return 0;
+}
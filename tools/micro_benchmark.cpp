@@ -0,0 +1,523 @@
+// This program runs micro-benchmarks of the CPU code paths: GEMM shapes,
+// im2col, the Forward and Backward of the layers at representative shapes,
+// the DataTransformer and database reads. Each benchmark is run -warmup times
+// untimed, then timed -repetitions times, and reported with the median,
+// percentiles and derived throughput. Inputs come from fixed seeds, so runs on
+// different commits time the same work; pin the BLAS threads (e.g.
+// OPENBLAS_NUM_THREADS=1) for stable comparisons.
+// Usage:
+//    micro_benchmark [-filter=SUBSTRING] [-warmup=N] [-repetitions=N]
+//                    [-output=results.csv|results.json]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(filter, "",
+    "Optional; only run the benchmarks whose name contains this string.");
+DEFINE_int32(warmup, 3,
+    "The number of untimed runs of each benchmark.");
+DEFINE_int32(repetitions, 20,
+    "The number of timed runs of each benchmark.");
+DEFINE_string(output, "",
+    "Optional; write the results to this file, as JSON if its name ends "
+    "with .json, as CSV otherwise.");
+DEFINE_int32(seed, 1701,
+    "The random seed of the inputs.");
+DEFINE_string(backend, "",
+    "Optional; the database backend to benchmark, lmdb or leveldb. Defaults "
+    "to the first one built.");
+DEFINE_int32(db_items, 2000,
+    "The number of items of the database read benchmark.");
+
+struct Result {
+  string name;
+  BenchmarkStats stats;
+  // Per run, or 0 when not meaningful.
+  double flops;
+  double bytes;
+  double items;
+};
+
+static vector<Result> results;
+
+static bool Selected(const string& name) {
+  return name.find(FLAGS_filter) != string::npos;
+}
+
+// Runs and reports one benchmark, if selected.
+static void Benchmark(const string& name, const boost::function<void()>& run,
+    double flops, double bytes, double items) {
+  if (!Selected(name)) {
+    return;
+  }
+  Result result;
+  result.name = name;
+  result.stats = RunBenchmark(run, FLAGS_warmup, FLAGS_repetitions);
+  result.flops = flops;
+  result.bytes = bytes;
+  result.items = items;
+  // Throughputs are at the median time, if measurable.
+  const double seconds = result.stats.median / 1e6;
+  std::ostringstream throughput;
+  if (seconds == 0) {
+    throughput << ", too fast to measure";
+  } else if (flops > 0) {
+    throughput << ", " << flops / seconds / 1e9 << " GFLOP/s";
+  }
+  if (seconds > 0 && bytes > 0) {
+    throughput << ", " << bytes / seconds / 1e9 << " GB/s";
+  }
+  if (seconds > 0 && items > 0) {
+    throughput << ", " << items / seconds << " items/s";
+  }
+  LOG(INFO) << std::setfill(' ') << std::left << std::setw(40) << name
+      << std::right << " median " << std::setw(9) << result.stats.median
+      << " us, p90 " << std::setw(9) << result.stats.p90 << " us"
+      << throughput.str();
+  results.push_back(result);
+}
+
+static void FillGaussian(Blob<float>* blob) {
+  caffe_rng_gaussian(blob->count(), 0.f, 1.f, blob->mutable_cpu_data());
+}
+
+// caffe_cpu_gemm on M x K and K x N matrices, transposed as in the layers.
+static void Gemm(CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int m,
+    int n, int k, const Blob<float>* a, const Blob<float>* b, Blob<float>* c) {
+  caffe_cpu_gemm<float>(trans_a, trans_b, m, n, k, 1.f, a->cpu_data(),
+      b->cpu_data(), 0.f, c->mutable_cpu_data());
+}
+
+static void BenchmarkGemm() {
+  // M, N, K, transpose A, transpose B: the shapes of the benchmarked
+  // convolution and inner product layers, plus square and skinny ones.
+  const int shapes[][5] = {
+    {64, 784, 576, 0, 0},     // conv3x3 forward
+    {64, 576, 784, 0, 1},     // conv3x3 weight gradient
+    {576, 784, 64, 1, 0},     // conv3x3 bottom gradient
+    {64, 196, 256, 0, 0},     // conv1x1 forward
+    {64, 1024, 4096, 0, 1},   // ip forward
+    {1024, 4096, 64, 1, 0},   // ip weight gradient
+    {512, 512, 512, 0, 0},
+    {32, 32, 32, 0, 0},
+    {1024, 16, 1024, 0, 0},
+  };
+  for (int i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+    const int m = shapes[i][0], n = shapes[i][1], k = shapes[i][2];
+    const CBLAS_TRANSPOSE trans_a = shapes[i][3] ? CblasTrans : CblasNoTrans;
+    const CBLAS_TRANSPOSE trans_b = shapes[i][4] ? CblasTrans : CblasNoTrans;
+    const string name = "gemm/" + format_int(m) + "x" + format_int(n) + "x" +
+        format_int(k) + (shapes[i][3] ? "_tA" : "") +
+        (shapes[i][4] ? "_tB" : "");
+    if (!Selected(name)) {
+      continue;
+    }
+    Caffe::set_random_seed(FLAGS_seed);
+    vector<int> shape(2);
+    shape[0] = m;
+    shape[1] = k;
+    Blob<float> a(shape);
+    shape[0] = k;
+    shape[1] = n;
+    Blob<float> b(shape);
+    shape[0] = m;
+    shape[1] = n;
+    Blob<float> c(shape);
+    FillGaussian(&a);
+    FillGaussian(&b);
+    Benchmark(name, boost::bind(&Gemm, trans_a, trans_b, m, n, k, &a, &b, &c),
+        2. * m * n * k, (a.count() + b.count() + c.count()) * sizeof(float),
+        0);
+  }
+}
+
+static void Im2col(const Blob<float>* image, int kernel, int pad, int stride,
+    Blob<float>* col) {
+  im2col_cpu(image->cpu_data(), image->shape(0), image->shape(1),
+      image->shape(2), kernel, kernel, pad, pad, stride, stride, 1, 1,
+      col->mutable_cpu_data());
+}
+
+static void BenchmarkIm2col() {
+  // Channels, height, width, kernel, pad, stride.
+  const int shapes[][6] = {
+    {3, 227, 227, 11, 0, 4},
+    {64, 56, 56, 3, 1, 1},
+    {256, 14, 14, 3, 1, 1},
+    {64, 28, 28, 1, 0, 1},
+  };
+  for (int i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+    const int channels = shapes[i][0], height = shapes[i][1],
+        width = shapes[i][2], kernel = shapes[i][3], pad = shapes[i][4],
+        stride = shapes[i][5];
+    const string name = "im2col/" + format_int(channels) + "x" +
+        format_int(height) + "x" + format_int(width) + "_k" +
+        format_int(kernel) + "_s" + format_int(stride);
+    if (!Selected(name)) {
+      continue;
+    }
+    Caffe::set_random_seed(FLAGS_seed);
+    vector<int> shape(3);
+    shape[0] = channels;
+    shape[1] = height;
+    shape[2] = width;
+    Blob<float> image(shape);
+    FillGaussian(&image);
+    shape[0] = channels * kernel * kernel;
+    shape[1] = (height + 2 * pad - kernel) / stride + 1;
+    shape[2] = (width + 2 * pad - kernel) / stride + 1;
+    Blob<float> col(shape);
+    Benchmark(name, boost::bind(&Im2col, &image, kernel, pad, stride, &col),
+        0, (image.count() + col.count()) * sizeof(float), 0);
+  }
+}
+
+struct LayerCase {
+  const char* name;
+  // The LayerParameter, with as many tops as the layer needs (default 1).
+  const char* param;
+  // The bottom shapes, e.g. "16,64,28,28;16".
+  const char* shapes;
+  // If positive, the last bottom holds labels or indices in
+  // [0, num_labels), and doesn't get gradients.
+  int num_labels;
+  bool backward;
+};
+
+static const LayerCase kLayerCases[] = {
+  {"conv3x3", "type: 'Convolution' convolution_param { num_output: 64 "
+      "kernel_size: 3 pad: 1 weight_filler { type: 'gaussian' } }",
+      "16,64,28,28", 0, true},
+  {"conv1x1", "type: 'Convolution' convolution_param { num_output: 64 "
+      "kernel_size: 1 weight_filler { type: 'gaussian' } }",
+      "16,256,14,14", 0, true},
+  {"deconv4x4s2", "type: 'Deconvolution' convolution_param { num_output: 32 "
+      "kernel_size: 4 stride: 2 weight_filler { type: 'gaussian' } }",
+      "16,64,14,14", 0, true},
+  {"inner_product", "type: 'InnerProduct' inner_product_param { "
+      "num_output: 1024 weight_filler { type: 'gaussian' } }",
+      "64,4096", 0, true},
+  {"pool_max3x3s2", "type: 'Pooling' pooling_param { pool: MAX "
+      "kernel_size: 3 stride: 2 }", "16,64,56,56", 0, true},
+  {"pool_ave3x3s2", "type: 'Pooling' pooling_param { pool: AVE "
+      "kernel_size: 3 stride: 2 }", "16,64,56,56", 0, true},
+  {"pool_global", "type: 'Pooling' pooling_param { pool: AVE "
+      "global_pooling: true }", "16,256,14,14", 0, true},
+  {"spp", "type: 'SPP' spp_param { pyramid_height: 3 }",
+      "16,64,28,28", 0, true},
+  {"lrn_across", "type: 'LRN' lrn_param { local_size: 5 }",
+      "16,64,28,28", 0, true},
+  {"lrn_within", "type: 'LRN' lrn_param { local_size: 3 "
+      "norm_region: WITHIN_CHANNEL }", "16,64,28,28", 0, true},
+  {"relu", "type: 'ReLU'", "16,64,56,56", 0, true},
+  {"prelu", "type: 'PReLU'", "16,64,56,56", 0, true},
+  {"elu", "type: 'ELU'", "16,64,56,56", 0, true},
+  {"sigmoid", "type: 'Sigmoid'", "16,64,56,56", 0, true},
+  {"tanh", "type: 'TanH'", "16,64,56,56", 0, true},
+  {"absval", "type: 'AbsVal'", "16,64,56,56", 0, true},
+  {"bnll", "type: 'BNLL'", "16,64,56,56", 0, true},
+  {"power", "type: 'Power' power_param { power: 2 scale: 0.5 shift: 1 }",
+      "16,64,56,56", 0, true},
+  {"exp", "type: 'Exp'", "16,64,56,56", 0, true},
+  {"log", "type: 'Log' log_param { shift: 10 }", "16,64,56,56", 0, true},
+  {"threshold", "type: 'Threshold'", "16,64,56,56", 0, false},
+  {"dropout", "type: 'Dropout'", "16,64,56,56", 0, true},
+  {"batch_norm", "type: 'BatchNorm'", "16,64,28,28", 0, true},
+  {"scale", "type: 'Scale' scale_param { bias_term: true }",
+      "16,64,28,28", 0, true},
+  {"bias", "type: 'Bias'", "16,64,28,28", 0, true},
+  {"mvn", "type: 'MVN'", "16,64,28,28", 0, true},
+  {"eltwise_sum", "type: 'Eltwise'", "16,64,28,28;16,64,28,28", 0, true},
+  {"eltwise_prod", "type: 'Eltwise' eltwise_param { operation: PROD }",
+      "16,64,28,28;16,64,28,28", 0, true},
+  {"eltwise_max", "type: 'Eltwise' eltwise_param { operation: MAX }",
+      "16,64,28,28;16,64,28,28", 0, true},
+  {"concat", "type: 'Concat'", "16,64,28,28;16,64,28,28", 0, true},
+  {"slice", "type: 'Slice' top: 'a' top: 'b'", "16,128,28,28", 0, true},
+  {"split", "type: 'Split' top: 'a' top: 'b'", "16,64,28,28", 0, true},
+  {"flatten", "type: 'Flatten'", "16,64,28,28", 0, true},
+  {"reshape", "type: 'Reshape' reshape_param { shape { dim: 0 dim: -1 } }",
+      "16,64,28,28", 0, true},
+  {"tile", "type: 'Tile' tile_param { tiles: 4 }", "16,64,28,28", 0, true},
+  {"reduction", "type: 'Reduction' reduction_param { operation: SUMSQ "
+      "axis: 1 }", "16,64,28,28", 0, true},
+  {"im2col", "type: 'Im2col' convolution_param { kernel_size: 3 pad: 1 }",
+      "16,64,28,28", 0, true},
+  {"batch_reindex", "type: 'BatchReindex'", "16,64,28,28;16", 16, true},
+  {"embed", "type: 'Embed' embed_param { num_output: 256 input_dim: 10000 "
+      "weight_filler { type: 'gaussian' } }", "64,32", 10000, true},
+  {"softmax", "type: 'Softmax'", "64,1000", 0, true},
+  {"argmax", "type: 'ArgMax' argmax_param { top_k: 5 }", "64,1000", 0,
+      false},
+  {"accuracy", "type: 'Accuracy' accuracy_param { top_k: 5 }",
+      "64,1000;64", 1000, false},
+  {"softmax_loss", "type: 'SoftmaxWithLoss'", "64,1000;64", 1000, true},
+  {"multinomial_logistic_loss", "type: 'MultinomialLogisticLoss'",
+      "64,1000;64", 1000, true},
+  {"hinge_loss", "type: 'HingeLoss'", "64,1000;64", 1000, true},
+  {"sigmoid_cross_entropy_loss", "type: 'SigmoidCrossEntropyLoss'",
+      "64,1000;64,1000", 2, true},
+  {"euclidean_loss", "type: 'EuclideanLoss'", "64,1000;64,1000", 0, true},
+  {"contrastive_loss", "type: 'ContrastiveLoss'", "64,256;64,256;64", 2,
+      true},
+};
+
+static void BenchmarkLayer(const LayerCase& layer_case) {
+  const string forward_name = string("layer/") + layer_case.name + "/forward";
+  const string backward_name =
+      string("layer/") + layer_case.name + "/backward";
+  if (!Selected(forward_name) &&
+      !(layer_case.backward && Selected(backward_name))) {
+    return;
+  }
+  Caffe::set_random_seed(FLAGS_seed);
+  LayerParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(layer_case.param,
+      &param)) << layer_case.name;
+  param.set_name(layer_case.name);
+  shared_ptr<Layer<float> > layer = LayerRegistry<float>::CreateLayer(param);
+  vector<string> shapes;
+  boost::split(shapes, layer_case.shapes, boost::is_any_of(";"));
+  vector<shared_ptr<Blob<float> > > blobs;
+  vector<Blob<float>*> bottom, top;
+  for (int i = 0; i < shapes.size(); ++i) {
+    vector<string> dims;
+    boost::split(dims, shapes[i], boost::is_any_of(","));
+    vector<int> shape;
+    for (int j = 0; j < dims.size(); ++j) {
+      shape.push_back(atoi(dims[j].c_str()));
+    }
+    blobs.push_back(shared_ptr<Blob<float> >(new Blob<float>(shape)));
+    bottom.push_back(blobs.back().get());
+    const bool labels =
+        layer_case.num_labels > 0 && i + 1 == shapes.size();
+    if (labels) {
+      float* data = blobs.back()->mutable_cpu_data();
+      for (int j = 0; j < blobs.back()->count(); ++j) {
+        data[j] = caffe_rng_rand() % layer_case.num_labels;
+      }
+    } else {
+      FillGaussian(blobs.back().get());
+    }
+  }
+  for (int i = 0; i < std::max(param.top_size(), 1); ++i) {
+    blobs.push_back(shared_ptr<Blob<float> >(new Blob<float>()));
+    top.push_back(blobs.back().get());
+  }
+  layer->SetUp(bottom, top);
+  const double items = bottom[0]->shape(0);
+  // FLOPs and bytes as estimated for the profiles of nets.
+  typedef NetProfiler<float> Profiler;
+  Benchmark(forward_name, boost::bind(&Layer<float>::Forward, layer.get(),
+      bottom, top), Profiler::EstimateFlops(layer.get(), Profiler::FORWARD,
+      bottom, top), Profiler::EstimateBytes(layer.get(), Profiler::FORWARD,
+      bottom, top), items);
+  if (!layer_case.backward) {
+    return;
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    FillGaussian(top[i]);
+    caffe_copy(top[i]->count(), top[i]->cpu_data(), top[i]->mutable_cpu_diff());
+  }
+  vector<bool> propagate_down(bottom.size(), true);
+  if (layer_case.num_labels > 0) {
+    propagate_down.back() = false;
+  }
+  Benchmark(backward_name, boost::bind(&Layer<float>::Backward, layer.get(),
+      top, propagate_down, bottom), Profiler::EstimateFlops(layer.get(),
+      Profiler::BACKWARD, bottom, top), Profiler::EstimateBytes(layer.get(),
+      Profiler::BACKWARD, bottom, top), items);
+}
+
+static void TransformDatums(DataTransformer<float>* transformer,
+    const vector<Datum>* datums, Blob<float>* transformed) {
+  transformer->Transform(*datums, transformed);
+}
+
+static void BenchmarkTransformer() {
+  // Random 3 x 256 x 256 images, transformed as for the ImageNet models.
+  const int kBatchSize = 32;
+  for (int crop = 0; crop <= 1; ++crop) {
+    const string name = crop ? "transform/crop227_mirror_mean" :
+        "transform/scale_mean";
+    if (!Selected(name)) {
+      continue;
+    }
+    Caffe::set_random_seed(FLAGS_seed);
+    vector<Datum> datums(kBatchSize);
+    string pixels(3 * 256 * 256, 0);
+    for (int i = 0; i < datums.size(); ++i) {
+      for (int j = 0; j < pixels.size(); ++j) {
+        pixels[j] = caffe_rng_rand() % 256;
+      }
+      datums[i].set_channels(3);
+      datums[i].set_height(256);
+      datums[i].set_width(256);
+      datums[i].set_data(pixels);
+    }
+    TransformationParameter param;
+    param.add_mean_value(104);
+    param.add_mean_value(117);
+    param.add_mean_value(123);
+    if (crop) {
+      param.set_crop_size(227);
+      param.set_mirror(true);
+    } else {
+      param.set_scale(0.00390625);
+    }
+    DataTransformer<float> transformer(param, TRAIN);
+    transformer.InitRand();
+    Blob<float> transformed(transformer.InferBlobShape(datums));
+    Benchmark(name, boost::bind(&TransformDatums, &transformer, &datums,
+        &transformed), 0, kBatchSize * pixels.size(), kBatchSize);
+  }
+}
+
+// Reads all the items of source, parsing them as Datums like the data layers.
+static void ReadDB(db::DB* source) {
+  shared_ptr<db::Cursor> cursor(source->NewCursor());
+  Datum datum;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+    CHECK(datum.ParseFromString(cursor->value()));
+  }
+}
+
+static void BenchmarkDB() {
+  string backend = FLAGS_backend;
+#ifdef USE_LEVELDB
+  if (backend.empty()) {
+    backend = "leveldb";
+  }
+#endif  // USE_LEVELDB
+#ifdef USE_LMDB
+  if (backend.empty()) {
+    backend = "lmdb";
+  }
+#endif  // USE_LMDB
+  if (backend.empty()) {
+    LOG(INFO) << "No database backend built, skipping the db benchmarks.";
+    return;
+  }
+  const string name = "db/" + backend + "_read_3x64x64";
+  if (!Selected(name)) {
+    return;
+  }
+  Caffe::set_random_seed(FLAGS_seed);
+  string dirname;
+  MakeTempDir(&dirname);
+  const string filename = dirname + "/db";
+  shared_ptr<db::DB> source(db::GetDB(backend));
+  source->Open(filename, db::NEW);
+  shared_ptr<db::Transaction> transaction(source->NewTransaction());
+  Datum datum;
+  datum.set_channels(3);
+  datum.set_height(64);
+  datum.set_width(64);
+  string pixels(3 * 64 * 64, 0);
+  string value;
+  for (int i = 0; i < FLAGS_db_items; ++i) {
+    for (int j = 0; j < pixels.size(); ++j) {
+      pixels[j] = caffe_rng_rand() % 256;
+    }
+    datum.set_data(pixels);
+    datum.set_label(i % 1000);
+    CHECK(datum.SerializeToString(&value));
+    transaction->Put(format_int(i, 8), value);
+  }
+  transaction->Commit();
+  source->Close();
+  source->Open(filename, db::READ);
+  Benchmark(name, boost::bind(&ReadDB, source.get()), 0,
+      static_cast<double>(FLAGS_db_items) * value.size(), FLAGS_db_items);
+  source->Close();
+  boost::filesystem::remove_all(dirname);
+}
+
+static void WriteResults(const string& filename) {
+  std::ofstream output(filename.c_str());
+  CHECK(output.is_open()) << "Failed to open " << filename;
+  output << std::setprecision(10);
+  const bool json = boost::algorithm::ends_with(filename, ".json");
+  if (json) {
+    output << "{\"warmup\": " << FLAGS_warmup << ", \"repetitions\": "
+        << FLAGS_repetitions << ", \"seed\": " << FLAGS_seed
+        << ", \"benchmarks\": [";
+  } else {
+    output << "name,repetitions,min_us,median_us,mean_us,p90_us,p99_us,"
+        << "max_us,stddev_us,flops,bytes,items\n";
+  }
+  for (int i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    if (json) {
+      output << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << r.name
+          << "\", \"repetitions\": " << r.stats.repetitions
+          << ", \"min_us\": " << r.stats.min
+          << ", \"median_us\": " << r.stats.median
+          << ", \"mean_us\": " << r.stats.mean
+          << ", \"p90_us\": " << r.stats.p90
+          << ", \"p99_us\": " << r.stats.p99
+          << ", \"max_us\": " << r.stats.max
+          << ", \"stddev_us\": " << r.stats.stddev
+          << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes
+          << ", \"items\": " << r.items << "}";
+    } else {
+      output << r.name << "," << r.stats.repetitions << "," << r.stats.min
+          << "," << r.stats.median << "," << r.stats.mean << ","
+          << r.stats.p90 << "," << r.stats.p99 << "," << r.stats.max << ","
+          << r.stats.stddev << "," << r.flops << "," << r.bytes << ","
+          << r.items << "\n";
+    }
+  }
+  if (json) {
+    output << "\n]}\n";
+  }
+  CHECK(output.good()) << "Failed to write " << filename;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Runs the micro-benchmarks of the CPU code paths.\n"
+      "Usage: micro_benchmark [-filter=SUBSTRING] [-warmup=N] "
+      "[-repetitions=N] [-output=FILE]");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_repetitions, 0);
+  Caffe::set_mode(Caffe::CPU);
+
+  BenchmarkGemm();
+  BenchmarkIm2col();
+  for (int i = 0; i < sizeof(kLayerCases) / sizeof(kLayerCases[0]); ++i) {
+    BenchmarkLayer(kLayerCases[i]);
+  }
+  BenchmarkTransformer();
+  BenchmarkDB();
+
+  LOG(INFO) << "Ran " << results.size() << " benchmarks.";
+  if (FLAGS_output.size()) {
+    WriteResults(FLAGS_output);
+    LOG(INFO) << "Wrote the results to " << FLAGS_output;
+  }
+  return 0;
+}
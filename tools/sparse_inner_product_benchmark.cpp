@@ -0,0 +1,110 @@
+// This program compares an InnerProduct layer on sparse inputs with the same
+// layer on the equivalent dense inputs, reporting the memory of the inputs
+// and the time of Forward and Backward for both.
+// Usage:
+//    sparse_inner_product_benchmark [BATCH_SIZE DIM NNZ_PER_ROW NUM_OUTPUT
+//                                    ITERATIONS]
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/sparse_blob.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/rng.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+// Times iterations of Forward and Backward of a new layer on bottom, returning
+// the average milliseconds of each.
+static void TimeLayer(const LayerParameter& param, Blob<float>* bottom,
+    int iterations, double* forward_ms, double* backward_ms) {
+  InnerProductLayer<float> layer(param);
+  vector<Blob<float>*> bottom_vec(1, bottom);
+  Blob<float> top;
+  vector<Blob<float>*> top_vec(1, &top);
+  layer.SetUp(bottom_vec, top_vec);
+  caffe_set(top.count(), 1.f, top.mutable_cpu_diff());
+  const vector<bool> propagate_down(1, false);
+  CPUTimer timer;
+  *forward_ms = 0;
+  *backward_ms = 0;
+  for (int i = 0; i < iterations; ++i) {
+    timer.Start();
+    layer.Forward(bottom_vec, top_vec);
+    *forward_ms += timer.MicroSeconds() / 1000.;
+    timer.Start();
+    layer.Backward(top_vec, propagate_down, bottom_vec);
+    *backward_ms += timer.MicroSeconds() / 1000.;
+  }
+  *forward_ms /= iterations;
+  *backward_ms /= iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+  if (argc != 1 && argc != 6) {
+    LOG(ERROR) << "Usage: sparse_inner_product_benchmark "
+        << "[BATCH_SIZE DIM NNZ_PER_ROW NUM_OUTPUT ITERATIONS]";
+    return 1;
+  }
+  const int batch_size = argc == 6 ? atoi(argv[1]) : 64;
+  const int dim = argc == 6 ? atoi(argv[2]) : 100000;
+  const int nnz_per_row = argc == 6 ? atoi(argv[3]) : 100;
+  const int num_output = argc == 6 ? atoi(argv[4]) : 128;
+  const int iterations = argc == 6 ? atoi(argv[5]) : 10;
+  CHECK_LE(nnz_per_row, dim);
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(1701);
+
+  // Rows of nnz_per_row uniform values at random distinct columns.
+  vector<int> shape(2);
+  shape[0] = batch_size;
+  shape[1] = dim;
+  SparseBlob<float> sparse(shape, batch_size * nnz_per_row);
+  caffe_rng_uniform(sparse.count(), 0.f, 1.f, sparse.mutable_cpu_data());
+  int* indices = sparse.mutable_cpu_indices();
+  int* ptr = sparse.mutable_cpu_ptr();
+  vector<int> columns(dim);
+  for (int j = 0; j < dim; ++j) {
+    columns[j] = j;
+  }
+  caffe::rng_t* rng = caffe_rng();
+  for (int i = 0; i < batch_size; ++i) {
+    ptr[i] = i * nnz_per_row;
+    for (int k = 0; k < nnz_per_row; ++k) {
+      std::swap(columns[k], columns[k + (*rng)() % (dim - k)]);
+    }
+    std::sort(columns.begin(), columns.begin() + nnz_per_row);
+    std::copy(columns.begin(), columns.begin() + nnz_per_row,
+        indices + ptr[i]);
+  }
+  ptr[batch_size] = batch_size * nnz_per_row;
+  Blob<float> dense(shape);
+  sparse.ToDense(dense.mutable_cpu_data());
+
+  LayerParameter param;
+  InnerProductParameter* ip_param = param.mutable_inner_product_param();
+  ip_param->set_num_output(num_output);
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  ip_param->mutable_weight_filler()->set_std(0.01);
+  double sparse_forward, sparse_backward, dense_forward, dense_backward;
+  TimeLayer(param, &sparse, iterations, &sparse_forward, &sparse_backward);
+  TimeLayer(param, &dense, iterations, &dense_forward, &dense_backward);
+
+  const size_t sparse_bytes = sparse.nnz() * (sizeof(float) + sizeof(int))
+      + (batch_size + 1) * sizeof(int);
+  const size_t dense_bytes = dense.count() * sizeof(float);
+  LOG(INFO) << batch_size << " x " << dim << " inputs with " << nnz_per_row
+      << " nonzeros per row, " << num_output << " outputs";
+  LOG(INFO) << "Input memory: sparse " << sparse_bytes << " bytes, dense "
+      << dense_bytes << " bytes";
+  LOG(INFO) << "Forward: sparse " << sparse_forward << " ms, dense "
+      << dense_forward << " ms";
+  LOG(INFO) << "Backward: sparse " << sparse_backward << " ms, dense "
+      << dense_backward << " ms";
+  return 0;
+}